@@ -108,6 +108,15 @@ ldap_pvt_thread_cond_wait LDAP_P((
 	ldap_pvt_thread_cond_t *cond,
 	ldap_pvt_thread_mutex_t *mutex ));
 
+/* Like cond_wait, but give up after usec microseconds.
+ * Returns 0 when it times out too.
+ */
+LDAP_F( int )
+ldap_pvt_thread_cond_timedwait LDAP_P((
+	ldap_pvt_thread_cond_t *cond,
+	ldap_pvt_thread_mutex_t *mutex,
+	long usec ));
+
 LDAP_F( int )
 ldap_pvt_thread_mutex_init LDAP_P(( ldap_pvt_thread_mutex_t *mutex ));
 
@@ -237,6 +246,16 @@ ldap_pvt_thread_pool_maxthreads LDAP_P((
 	ldap_pvt_thread_pool_t *pool,
 	int max_threads ));
 
+LDAP_F( int )
+ldap_pvt_thread_pool_queues LDAP_P((
+	ldap_pvt_thread_pool_t *pool,
+	int numqs ));
+
+LDAP_F( int )
+ldap_pvt_thread_pool_steal LDAP_P((
+	ldap_pvt_thread_pool_t *pool,
+	int steal ));
+
 #ifndef LDAP_PVT_THREAD_H_DONE
 typedef enum {
 	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN = -1,
@@ -251,7 +270,9 @@ typedef enum {
 	LDAP_PVT_THREAD_POOL_PARAM_ACTIVE_MAX,
 	LDAP_PVT_THREAD_POOL_PARAM_PENDING_MAX,
 	LDAP_PVT_THREAD_POOL_PARAM_BACKLOAD_MAX,
-	LDAP_PVT_THREAD_POOL_PARAM_STATE
+	LDAP_PVT_THREAD_POOL_PARAM_STATE,
+	LDAP_PVT_THREAD_POOL_PARAM_STEALS,
+	LDAP_PVT_THREAD_POOL_PARAM_QUEUES
 } ldap_pvt_thread_pool_param_t;
 #endif /* !LDAP_PVT_THREAD_H_DONE */
 
@@ -260,6 +281,12 @@ ldap_pvt_thread_pool_query LDAP_P((
 	ldap_pvt_thread_pool_t *pool,
 	ldap_pvt_thread_pool_param_t param, void *value ));
 
+LDAP_F( int )
+ldap_pvt_thread_pool_queue_query LDAP_P((
+	ldap_pvt_thread_pool_t *pool,
+	int qnum,
+	ldap_pvt_thread_pool_param_t param, void *value ));
+
 LDAP_F( int )
 ldap_pvt_thread_pool_pausing LDAP_P((
 	ldap_pvt_thread_pool_t *pool ));
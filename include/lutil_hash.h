@@ -71,6 +71,22 @@ lutil_HASH64Final LDAP_P((
 	unsigned char digest[LUTIL_HASH64_BYTES],
 	lutil_HASH_CTX *context));
 
+/* Word-at-a-time 64 bit hash. Each Update hashes its buffer seeded
+ * with the state left by the previous one, so the digest depends on
+ * how the input is split between calls.
+ */
+LDAP_LUTIL_F( void )
+lutil_HASHW64Init LDAP_P((
+	lutil_HASH_CTX *context));
+
+LDAP_LUTIL_F( void )
+lutil_HASHW64Update LDAP_P((
+	lutil_HASH_CTX *context,
+	unsigned char const *buf,
+	ber_len_t len));
+
+#define lutil_HASHW64Final	lutil_HASH64Final
+
 #endif /* HAVE_LONG_LONG */
 
 LDAP_END_DECL
@@ -20,6 +20,8 @@
 #include "portable.h"
 
 #if defined( HAVE_MACH_CTHREADS )
+#include <ac/socket.h>
+#include <ac/time.h>
 #include "ldap_pvt_thread.h" /* Get the thread interface */
 #define LDAP_THREAD_IMPLEMENTATION
 #include "ldap_thr_debug.h"  /* May rename the symbols defined below */
@@ -112,6 +114,21 @@ ldap_pvt_thread_cond_wait( ldap_pvt_thread_cond_t *cond,
 	return( 0 );	
 }
 
+/* cthreads has no timed wait; just sleep with the mutex released */
+int 
+ldap_pvt_thread_cond_timedwait( ldap_pvt_thread_cond_t *cond, 
+			  ldap_pvt_thread_mutex_t *mutex, long usec )
+{
+	struct timeval tv;
+
+	tv.tv_sec = usec / 1000000;
+	tv.tv_usec = usec % 1000000;
+	mutex_unlock( mutex );
+	select( 0, NULL, NULL, NULL, &tv );
+	mutex_lock( mutex );
+	return( 0 );	
+}
+
 int 
 ldap_pvt_thread_mutex_init( ldap_pvt_thread_mutex_t *mutex )
 {
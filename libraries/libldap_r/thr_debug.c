@@ -959,6 +959,29 @@ ldap_pvt_thread_cond_wait(
 	return rc;
 }
 
+int
+ldap_pvt_thread_cond_timedwait(
+	ldap_pvt_thread_cond_t *cond,
+	ldap_pvt_thread_mutex_t *mutex,
+	long usec )
+{
+	int rc;
+	ldap_int_thread_t owner;
+	check_usage( &cond->usage, "ldap_pvt_thread_cond_timedwait:cond" );
+	check_usage( &mutex->usage, "ldap_pvt_thread_cond_timedwait:mutex" );
+	adjust_count( Idx_locked_mutex, -1 );
+	owner = GET_OWNER( mutex );
+	ASSERT_OWNER( mutex, "ldap_pvt_thread_cond_timedwait" );
+	RESET_OWNER( mutex );
+	rc = ldap_int_thread_cond_timedwait( WRAPPED( cond ), WRAPPED( mutex ),
+		usec );
+	ASSERT_NO_OWNER( mutex, "ldap_pvt_thread_cond_timedwait" );
+	SET_OWNER( mutex, rc ? owner : ldap_int_thread_self() );
+	adjust_count( Idx_locked_mutex, +1 );
+	ERROR_IF( rc, "ldap_pvt_thread_cond_timedwait" );
+	return rc;
+}
+
 int
 ldap_pvt_thread_mutex_init( ldap_pvt_thread_mutex_t *mutex )
 {
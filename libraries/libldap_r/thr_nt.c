@@ -146,6 +146,15 @@ ldap_pvt_thread_cond_wait( ldap_pvt_thread_cond_t *cond,
 	return( 0 );
 }
 
+int 
+ldap_pvt_thread_cond_timedwait( ldap_pvt_thread_cond_t *cond, 
+	ldap_pvt_thread_mutex_t *mutex, long usec )
+{
+	SignalObjectAndWait( *mutex, *cond, ( usec + 999 ) / 1000, FALSE );
+	WaitForSingleObject( *mutex, INFINITE );
+	return( 0 );
+}
+
 int
 ldap_pvt_thread_cond_broadcast( ldap_pvt_thread_cond_t *cond )
 {
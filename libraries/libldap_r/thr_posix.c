@@ -19,12 +19,12 @@
 #if defined( HAVE_PTHREADS )
 
 #include <ac/errno.h>
+#include <ac/time.h>
 
 #ifdef REPLACE_BROKEN_YIELD
 #ifndef HAVE_NANOSLEEP
 #include <ac/socket.h>
 #endif
-#include <ac/time.h>
 #endif
 
 #include "ldap_pvt_thread.h" /* Get the thread interface */
@@ -281,6 +281,26 @@ ldap_pvt_thread_cond_wait( ldap_pvt_thread_cond_t *cond,
 	return ERRVAL( pthread_cond_wait( cond, mutex ) );
 }
 
+int 
+ldap_pvt_thread_cond_timedwait( ldap_pvt_thread_cond_t *cond, 
+		      ldap_pvt_thread_mutex_t *mutex, long usec )
+{
+	struct timeval now;
+	struct timespec ts;
+	int rc;
+
+	gettimeofday( &now, NULL );
+	usec += now.tv_usec;
+	ts.tv_sec = now.tv_sec + usec / 1000000;
+	ts.tv_nsec = ( usec % 1000000 ) * 1000;
+	rc = ERRVAL( pthread_cond_timedwait( cond, mutex, &ts ) );
+#if HAVE_PTHREADS < 7
+	if ( rc == EAGAIN ) rc = 0;
+#endif
+	if ( rc == ETIMEDOUT ) rc = 0;
+	return rc;
+}
+
 int 
 ldap_pvt_thread_mutex_init( ldap_pvt_thread_mutex_t *mutex )
 {
@@ -117,6 +117,22 @@ ldap_pvt_thread_cond_wait( ldap_pvt_thread_cond_t *cond,
 	return( pth_cond_await( cond, mutex, NULL ) ? 0 : errno );
 }
 
+int 
+ldap_pvt_thread_cond_timedwait( ldap_pvt_thread_cond_t *cond, 
+	ldap_pvt_thread_mutex_t *mutex, long usec )
+{
+	pth_event_t ev;
+	int rc = 0;
+
+	ev = pth_event( PTH_EVENT_TIME,
+		pth_timeout( usec / 1000000, usec % 1000000 ));
+	if ( !pth_cond_await( cond, mutex, ev ) &&
+		pth_event_status( ev ) != PTH_STATUS_OCCURRED )
+		rc = errno;
+	pth_event_free( ev, PTH_FREE_THIS );
+	return( rc );
+}
+
 int
 ldap_pvt_thread_cond_destroy( ldap_pvt_thread_cond_t *cv )
 {
@@ -114,6 +114,13 @@ ldap_pvt_thread_cond_wait( ldap_pvt_thread_cond_t *cond,
 	return 0;
 }
 
+int 
+ldap_pvt_thread_cond_timedwait( ldap_pvt_thread_cond_t *cond,
+			  ldap_pvt_thread_mutex_t *mutex, long usec )
+{
+	return 0;
+}
+
 int 
 ldap_pvt_thread_mutex_init( ldap_pvt_thread_mutex_t *mutex )
 {
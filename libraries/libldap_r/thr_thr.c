@@ -18,6 +18,8 @@
 
 #if defined( HAVE_THR )
 
+#include <ac/errno.h>
+
 #include "ldap_pvt_thread.h" /* Get the thread interface */
 #define LDAP_THREAD_IMPLEMENTATION
 #include "ldap_thr_debug.h"	 /* May rename the symbols defined below */
@@ -117,6 +119,19 @@ ldap_pvt_thread_cond_wait( ldap_pvt_thread_cond_t *cond,
 	return( cond_wait( cond, mutex ) );
 }
 
+int 
+ldap_pvt_thread_cond_timedwait( ldap_pvt_thread_cond_t *cond, 
+	ldap_pvt_thread_mutex_t *mutex, long usec )
+{
+	timestruc_t ts;
+	int rc;
+
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = ( usec % 1000000 ) * 1000;
+	rc = cond_reltimedwait( cond, mutex, &ts );
+	return( rc == ETIME ? 0 : rc );
+}
+
 int
 ldap_pvt_thread_cond_destroy( ldap_pvt_thread_cond_t *cv )
 {
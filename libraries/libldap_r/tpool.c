@@ -128,6 +128,8 @@ struct ldap_int_thread_poolq_s {
 	int ltp_active_count;		/* Active, not paused/idle tasks */
 	int ltp_open_count;			/* Number of threads */
 	int ltp_starting;			/* Currently starting threads */
+
+	unsigned long ltp_steals;	/* Tasks taken from other queues */
 };
 
 struct ldap_int_thread_pool_s {
@@ -172,6 +174,17 @@ struct ldap_int_thread_pool_s {
 
 	/* Max pending + paused + idle tasks, negated when ltp_finishing */
 	int ltp_max_pending;
+
+	/* Idle threads may take pending tasks from other queues.
+	 * Only changed while holding every queue's ltp_mutex in turn,
+	 * read by workers while holding their own.
+	 */
+	int ltp_steal;
+
+	/* Next queue to nudge when a queue has more work than threads.
+	 * Updated without locking, it is only a hint.
+	 */
+	unsigned ltp_nudge;
 };
 
 static ldap_int_tpool_plist_t empty_pending_list =
@@ -351,6 +364,47 @@ ldap_int_poolq_hash(
 	return i;
 }
 
+/* Take the oldest pending task of another queue for a thread of pq.
+ * Called with pq->ltp_mutex locked. Other queues are only tried, never
+ * waited for, so there is no lock ordering between queues. Stealing
+ * from the victim's ltp_work_list keeps pauses working: it is empty
+ * while a pause is in effect, and a pause that already passed pq was
+ * requested before we locked pq, so ltp_pause is set by then.
+ */
+static ldap_int_thread_task_t *
+ldap_int_poolq_steal(
+	struct ldap_int_thread_poolq_s *pq )
+{
+	struct ldap_int_thread_pool_s *pool = pq->ltp_pool;
+	struct ldap_int_thread_poolq_s *vq;
+	ldap_int_thread_task_t *task = NULL;
+	int i, j, n;
+
+	n = pool->ltp_numqs;
+	if (!pool->ltp_steal || pool->ltp_pause || pool->ltp_finishing || n < 2)
+		return NULL;
+
+	for (i=0; i<n; i++)
+		if (pool->ltp_wqs[i] == pq) break;
+
+	for (j=1; j<n; j++) {
+		vq = pool->ltp_wqs[(i+j) % n];
+		if (ldap_pvt_thread_mutex_trylock(&vq->ltp_mutex))
+			continue;
+		task = LDAP_STAILQ_FIRST(vq->ltp_work_list);
+		if (task) {
+			LDAP_STAILQ_REMOVE_HEAD(vq->ltp_work_list, ltt_next.q);
+			vq->ltp_pending_count--;
+		}
+		ldap_pvt_thread_mutex_unlock(&vq->ltp_mutex);
+		if (task) {
+			pq->ltp_steals++;
+			break;
+		}
+	}
+	return task;
+}
+
 /* Submit a task to be performed by the thread pool */
 int
 ldap_pvt_thread_pool_submit (
@@ -454,6 +508,19 @@ ldap_pvt_thread_pool_submit (
 	}
 	ldap_pvt_thread_cond_signal(&pq->ltp_cond);
 
+	/* all of this queue's threads are busy: wake an idle thread
+	 * of some other queue to come and take the task
+	 */
+	if (pool->ltp_steal && pool->ltp_numqs > 1 &&
+		pq->ltp_open_count >= pq->ltp_max_count &&
+		pq->ltp_active_count + pq->ltp_pending_count > pq->ltp_open_count)
+	{
+		j = pool->ltp_nudge++ % (pool->ltp_numqs - 1);
+		if (j >= i)
+			j++;
+		ldap_pvt_thread_cond_signal(&pool->ltp_wqs[j]->ltp_cond);
+	}
+
  done:
 	ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
 	return(0);
@@ -578,6 +645,44 @@ ldap_pvt_thread_pool_queues(
 	return 0;
 }
 
+static void
+ldap_int_pool_setsteal(
+	struct ldap_int_thread_pool_s *pool,
+	int steal )
+{
+	int i;
+
+	/* Once every queue has been locked, no thread is still stealing
+	 * under the old setting.
+	 */
+	pool->ltp_steal = steal;
+	for (i=0; i<pool->ltp_numqs; i++) {
+		ldap_pvt_thread_mutex_lock(&pool->ltp_wqs[i]->ltp_mutex);
+		ldap_pvt_thread_mutex_unlock(&pool->ltp_wqs[i]->ltp_mutex);
+	}
+}
+
+/* Let idle threads take pending tasks queued for other work queues.
+ * Only meaningful with more than one queue. */
+int
+ldap_pvt_thread_pool_steal(
+	ldap_pvt_thread_pool_t *tpool,
+	int steal )
+{
+	struct ldap_int_thread_pool_s *pool;
+
+	if (tpool == NULL)
+		return(-1);
+
+	pool = *tpool;
+
+	if (pool == NULL)
+		return(-1);
+
+	ldap_int_pool_setsteal( pool, steal != 0 );
+	return(0);
+}
+
 /* Set max #threads.  value <= 0 means max supported #threads (LDAP_MAXTHR) */
 int
 ldap_pvt_thread_pool_maxthreads(
@@ -618,6 +723,30 @@ ldap_pvt_thread_pool_maxthreads(
 	return(0);
 }
 
+/* Read one counter of a work queue. Called with pq->ltp_mutex locked. */
+static int
+ldap_int_poolq_count(
+	struct ldap_int_thread_poolq_s *pq,
+	ldap_pvt_thread_pool_param_t param )
+{
+	switch(param) {
+	case LDAP_PVT_THREAD_POOL_PARAM_OPEN:
+		return pq->ltp_open_count;
+	case LDAP_PVT_THREAD_POOL_PARAM_STARTING:
+		return pq->ltp_starting;
+	case LDAP_PVT_THREAD_POOL_PARAM_ACTIVE:
+		return pq->ltp_active_count;
+	case LDAP_PVT_THREAD_POOL_PARAM_PENDING:
+		return pq->ltp_pending_count;
+	case LDAP_PVT_THREAD_POOL_PARAM_BACKLOAD:
+		return pq->ltp_pending_count + pq->ltp_active_count;
+	case LDAP_PVT_THREAD_POOL_PARAM_STEALS:
+		return (int)(pq->ltp_steals & INT_MAX);
+	default:
+		return 0;
+	}
+}
+
 /* Inspect the pool */
 int
 ldap_pvt_thread_pool_query(
@@ -662,29 +791,14 @@ ldap_pvt_thread_pool_query(
 	case LDAP_PVT_THREAD_POOL_PARAM_ACTIVE:
 	case LDAP_PVT_THREAD_POOL_PARAM_PENDING:
 	case LDAP_PVT_THREAD_POOL_PARAM_BACKLOAD:
+	case LDAP_PVT_THREAD_POOL_PARAM_STEALS:
 		{
 			int i;
 			count = 0;
 			for (i=0; i<pool->ltp_numqs; i++) {
 				struct ldap_int_thread_poolq_s *pq = pool->ltp_wqs[i];
 				ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
-				switch(param) {
-					case LDAP_PVT_THREAD_POOL_PARAM_OPEN:
-						count += pq->ltp_open_count;
-						break;
-					case LDAP_PVT_THREAD_POOL_PARAM_STARTING:
-						count += pq->ltp_starting;
-						break;
-					case LDAP_PVT_THREAD_POOL_PARAM_ACTIVE:
-						count += pq->ltp_active_count;
-						break;
-					case LDAP_PVT_THREAD_POOL_PARAM_PENDING:
-						count += pq->ltp_pending_count;
-						break;
-					case LDAP_PVT_THREAD_POOL_PARAM_BACKLOAD:
-						count += pq->ltp_pending_count + pq->ltp_active_count;
-						break;
-				}
+				count += ldap_int_poolq_count(pq, param);
 				ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
 			}
 			if (count < 0)
@@ -692,6 +806,10 @@ ldap_pvt_thread_pool_query(
 		}
 		break;
 
+	case LDAP_PVT_THREAD_POOL_PARAM_QUEUES:
+		count = pool->ltp_numqs;
+		break;
+
 	case LDAP_PVT_THREAD_POOL_PARAM_ACTIVE_MAX:
 		break;
 
@@ -728,6 +846,52 @@ ldap_pvt_thread_pool_query(
 	return ( count == -1 ? -1 : 0 );
 }
 
+/* Inspect one work queue of the pool. Only the per-queue counters
+ * OPEN, STARTING, ACTIVE, PENDING, BACKLOAD and STEALS are accepted.
+ * Returns -1 if qnum is not a queue of the pool.
+ */
+int
+ldap_pvt_thread_pool_queue_query(
+	ldap_pvt_thread_pool_t *tpool,
+	int qnum,
+	ldap_pvt_thread_pool_param_t param,
+	void *value )
+{
+	struct ldap_int_thread_pool_s	*pool;
+	struct ldap_int_thread_poolq_s	*pq;
+
+	if ( tpool == NULL || value == NULL ) {
+		return -1;
+	}
+
+	pool = *tpool;
+
+	if ( pool == NULL || qnum < 0 || qnum >= pool->ltp_numqs ) {
+		return -1;
+	}
+
+	switch ( param ) {
+	case LDAP_PVT_THREAD_POOL_PARAM_OPEN:
+	case LDAP_PVT_THREAD_POOL_PARAM_STARTING:
+	case LDAP_PVT_THREAD_POOL_PARAM_ACTIVE:
+	case LDAP_PVT_THREAD_POOL_PARAM_PENDING:
+	case LDAP_PVT_THREAD_POOL_PARAM_BACKLOAD:
+	case LDAP_PVT_THREAD_POOL_PARAM_STEALS:
+		break;
+	default:
+		return -1;
+	}
+
+	pq = pool->ltp_wqs[qnum];
+	ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
+	*((int *)value) = ldap_int_poolq_count(pq, param);
+	ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
+	if ( *((int *)value) < 0 )
+		*((int *)value) = -*((int *)value);
+
+	return 0;
+}
+
 /*
  * true if pool is pausing; does not lock any mutex to check.
  * 0 if not pause, 1 if pause, -1 if error or no pool.
@@ -799,6 +963,11 @@ ldap_pvt_thread_pool_destroy ( ldap_pvt_thread_pool_t *tpool, int run_pending )
 	ldap_pvt_thread_cond_broadcast(&pool->ltp_cond);
 	ldap_pvt_thread_mutex_unlock(&pool->ltp_mutex);
 
+	/* queues are torn down one at a time below, stop threads
+	 * of the remaining queues from looking into them
+	 */
+	ldap_int_pool_setsteal( pool, 0 );
+
 	for (i=0; i<pool->ltp_numqs; i++) {
 		pq = pool->ltp_wqs[i];
 		ldap_pvt_thread_mutex_lock(&pq->ltp_mutex);
@@ -854,7 +1023,7 @@ ldap_int_thread_pool_wrapper (
 	ldap_int_tpool_plist_t *work_list;
 	ldap_int_thread_userctx_t ctx, *kctx;
 	unsigned i, keyslot, hash;
-	int pool_lock = 0, freeme = 0;
+	int pool_lock = 0, freeme = 0, stolen;
 
 	assert(pool != NULL);
 
@@ -894,6 +1063,9 @@ ldap_int_thread_pool_wrapper (
 	for (;;) {
 		work_list = pq->ltp_work_list; /* help the compiler a bit */
 		task = LDAP_STAILQ_FIRST(work_list);
+		stolen = 0;
+		if (task == NULL && (task = ldap_int_poolq_steal(pq)) != NULL)
+			stolen = 1;
 		if (task == NULL) {	/* paused or no pending tasks */
 			if (--(pq->ltp_active_count) < 1) {
 				if (pool->ltp_pause) {
@@ -939,6 +1111,9 @@ ldap_int_thread_pool_wrapper (
 
 				work_list = pq->ltp_work_list;
 				task = LDAP_STAILQ_FIRST(work_list);
+				if (task == NULL && !pool_lock &&
+					(task = ldap_int_poolq_steal(pq)) != NULL)
+					stolen = 1;
 			} while (task == NULL);
 
 			if (pool_lock) {
@@ -949,8 +1124,10 @@ ldap_int_thread_pool_wrapper (
 			pq->ltp_active_count++;
 		}
 
-		LDAP_STAILQ_REMOVE_HEAD(work_list, ltt_next.q);
-		pq->ltp_pending_count--;
+		if (!stolen) {
+			LDAP_STAILQ_REMOVE_HEAD(work_list, ltt_next.q);
+			pq->ltp_pending_count--;
+		}
 		ldap_pvt_thread_mutex_unlock(&pq->ltp_mutex);
 
 		task->ltt_start_routine(&ctx, task->ltt_arg);
@@ -277,6 +277,10 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
  */
 	/** mmap at a fixed address (experimental) */
 #define MDB_FIXEDMAP	0x01
+	/** record in each page the txn that wrote it */
+#define MDB_PAGETXN	0x1000
+	/** store a checksum in each page */
+#define MDB_PAGECRC	0x2000
 	/** no environment directory */
 #define MDB_NOSUBDIR	0x4000
 	/** don't fsync after commit */
@@ -297,6 +301,8 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_NORDAHEAD	0x800000
 	/** don't initialize malloc'd memory before writing to datafile */
 #define MDB_NOMEMINIT	0x1000000
+	/** verify page checksums when pages are read */
+#define MDB_PAGEVERIFY	0x2000000
 /** @} */
 
 /**	@defgroup	mdb_dbi_open	Database Flags
@@ -465,6 +471,22 @@ typedef struct MDB_envinfo {
 	unsigned int me_numreaders;		/**< max reader slots used in the environment */
 } MDB_envinfo;
 
+/** @brief Progress of page checksum verification
+ *
+ *	This is kept in a reader slot of the lock file, so it is shared
+ *	by all processes using the environment. The scrubber updates it
+ *	without locking, so a copy may show one field already updated and
+ *	another not yet, and on systems that can't write a size_t in one
+ *	step, a value that is partly updated.
+ */
+typedef struct MDB_scrubstat {
+	size_t	ms_passes;		/**< Number of complete passes */
+	size_t	ms_checked;		/**< Pages verified so far in the current pass */
+	size_t	ms_pages;		/**< Pages in use when the current pass began */
+	size_t	ms_errors;		/**< Number of checksum mismatches found */
+	size_t	ms_badpage;		/**< Page number of the last mismatch */
+} MDB_scrubstat;
+
 	/** @brief Return the LMDB library version information.
 	 *
 	 * @param[out] major if non-NULL, the library major version number is copied here
@@ -606,6 +628,34 @@ int  mdb_env_create(MDB_env **env);
 	 *		caller is expected to overwrite all of the memory that was
 	 *		reserved in that case.
 	 *		This flag may be changed at any time using #mdb_env_set_flags().
+	 *	<li>#MDB_PAGETXN
+	 *		Record in every page written to the data file the ID of the
+	 *		transaction that wrote it, so that #mdb_env_incr_copy() can find
+	 *		the pages changed since an earlier copy. Like #MDB_PAGECRC, which
+	 *		implies it, this is a property of the data file that can only be
+	 *		chosen when the environment is created. The ID is kept in the
+	 *		last bytes of each page, so a little less data fits in a page,
+	 *		and older versions of the library refuse to open the environment.
+	 *	<li>#MDB_PAGECRC
+	 *		Store a CRC32C checksum in every page written to the data file,
+	 *		so that corruption of the file can be detected by
+	 *		#MDB_PAGEVERIFY or #mdb_env_scrub(). This is a property of the
+	 *		data file: it only has an effect when the environment is created,
+	 *		and is set automatically when an environment created with it is
+	 *		opened. Checksums cannot be added to an existing environment.
+	 *		The checksum is kept in the last bytes of each page, so a little
+	 *		less data fits in a page, and older versions of the library
+	 *		refuse to open the environment. One reader slot of the lock file
+	 *		holds the progress of #mdb_env_scrub(), so one fewer reader than
+	 *		set by #mdb_env_set_maxreaders() can be active.
+	 *	<li>#MDB_PAGEVERIFY
+	 *		Verify the checksum of each page as it is read from the map,
+	 *		failing with #MDB_CORRUPTED on a mismatch. This has no effect
+	 *		unless the environment has #MDB_PAGECRC. Each access to a page
+	 *		pays for the check, so it is more usual to leave this off and
+	 *		verify the whole environment in the background with
+	 *		#mdb_env_scrub_start().
+	 *		This flag may be changed at any time using #mdb_env_set_flags().
 	 * </ul>
 	 * @param[in] mode The UNIX permissions to set on created files and semaphores.
 	 * This parameter is ignored on Windows.
@@ -615,6 +665,8 @@ int  mdb_env_create(MDB_env **env);
 	 *	<li>#MDB_VERSION_MISMATCH - the version of the LMDB library doesn't match the
 	 *	version that created the database environment.
 	 *	<li>#MDB_INVALID - the environment file headers are corrupted.
+	 *	<li>#MDB_INCOMPATIBLE - #MDB_PAGECRC or #MDB_PAGETXN was given for
+	 *	an existing environment which was created without it.
 	 *	<li>ENOENT - the directory specified by the path parameter doesn't exist.
 	 *	<li>EACCES - the user didn't have permission to access the environment files.
 	 *	<li>EAGAIN - the environment was locked by another process.
@@ -696,6 +748,146 @@ int  mdb_env_copy2(MDB_env *env, const char *path, unsigned int flags);
 	 */
 int  mdb_env_copyfd2(MDB_env *env, mdb_filehandle_t fd, unsigned int flags);
 
+	/** @brief Make an incremental copy of an LMDB environment.
+	 *
+	 * Only the pages written after transaction \b since that are still in
+	 * use are copied, so the work done and the size of the copy depend on
+	 * how much has changed rather than on the size of the environment.
+	 * The copy can be applied with #mdb_env_incr_apply() to a plain copy
+	 * of the environment made at or after transaction \b since, such as
+	 * one made by #mdb_env_copy() without #MDB_CP_COMPACT or restored
+	 * from earlier incremental copies. A compacted copy cannot be used.
+	 * Pages are only stamped with the transaction that wrote them in
+	 * environments created with #MDB_PAGETXN or #MDB_PAGECRC.
+	 * @note This call can trigger significant file size growth if run in
+	 * parallel with write transactions, because it employs a read-only
+	 * transaction. See long-lived transactions under @ref caveats_sec.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] path The file in which the copy will reside. It must
+	 * not already exist.
+	 * @param[in] since The ID of the transaction the previous copy was
+	 * made at, or 0 to copy every page in use.
+	 * @param[out] txnid If non-NULL, the ID of the transaction this copy
+	 * was made at, to be passed as \b since to make the next one.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - \b since is newer than the last committed transaction.
+	 *	<li>#MDB_INCOMPATIBLE - the environment was created without
+	 *		#MDB_PAGETXN or #MDB_PAGECRC.
+	 * </ul>
+	 */
+int  mdb_env_incr_copy(MDB_env *env, const char *path, size_t since, size_t *txnid);
+
+	/** @brief Make an incremental copy of an LMDB environment to the
+	 *	specified file descriptor.
+	 *
+	 * See #mdb_env_incr_copy() for further details.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] fd The filedescriptor to write the copy to. It must
+	 * have already been opened for Write access.
+	 * @param[in] since The ID of the transaction the previous copy was
+	 * made at, or 0 to copy every page in use.
+	 * @param[out] txnid If non-NULL, the ID of the transaction this copy
+	 * was made at.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_incr_copyfd(MDB_env *env, mdb_filehandle_t fd, size_t since, size_t *txnid);
+
+	/** @brief Apply an incremental copy to an LMDB environment.
+	 *
+	 * The environment is updated in place to the transaction the copy
+	 * was made at. A chain of incremental copies is applied in the order
+	 * they were made. The copy is checked to be complete before any page
+	 * is written, but if this call fails part way the environment must
+	 * be restored again from its base copy.
+	 * @note The environment must not be in use by any other thread or
+	 * process while the copy is applied, and should be closed afterwards.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully, without #MDB_RDONLY.
+	 * @param[in] path The incremental copy to apply.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_INVALID - the file is not a complete incremental copy.
+	 *	<li>#MDB_INCOMPATIBLE - the copy has a different page size or page
+	 *		format, or does not continue from the environment's last
+	 *		transaction.
+	 *	<li>EACCES - the environment is read-only.
+	 * </ul>
+	 */
+int  mdb_env_incr_apply(MDB_env *env, const char *path);
+
+	/** @brief Verify the checksums of all pages in use in an LMDB environment.
+	 *
+	 * Every page reachable from the last committed transaction is checked
+	 * against the checksum stored when it was written. Progress and any
+	 * mismatches found are recorded for #mdb_env_scrub_stat().
+	 * The pages are read in a read-only transaction that is reset every
+	 * 1024 pages, or ten times a second with a \b rate, and only renewed
+	 * after the pause that keeps to the rate, so that scrubbing does not
+	 * keep write transactions from reusing free pages. A pass then picks
+	 * up where it left off in the new snapshot. If the database changed
+	 * meanwhile, some pages may be checked twice or not at all in that
+	 * pass, but all of them are checked by a pass over an unchanging
+	 * database.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully, with #MDB_PAGECRC.
+	 * @param[in] rate The maximum number of pages to check per second,
+	 * or 0 to check them as fast as possible.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_CORRUPTED - a page did not match its checksum.
+	 *	<li>#MDB_INCOMPATIBLE - the environment has no page checksums.
+	 * </ul>
+	 */
+int  mdb_env_scrub(MDB_env *env, unsigned int rate);
+
+	/** @brief Verify the checksums of an LMDB environment in the background.
+	 *
+	 * A thread of the lowest scheduling priority the system allows runs
+	 * #mdb_env_scrub() repeatedly, until #mdb_env_scrub_stop() or
+	 * #mdb_env_close() is called. If a scrubbing thread is already
+	 * running, it is restarted with the new parameters.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully, with #MDB_PAGECRC.
+	 * @param[in] rate The maximum number of pages to check per second,
+	 * or 0 to check them as fast as possible.
+	 * @param[in] interval The number of seconds to wait after each pass
+	 * before starting the next, or 0 to stop after one pass.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_INCOMPATIBLE - the environment has no page checksums.
+	 *	<li>EINVAL - the environment is not open.
+	 * </ul>
+	 */
+int  mdb_env_scrub_start(MDB_env *env, unsigned int rate, unsigned int interval);
+
+	/** @brief Stop verifying the checksums of an LMDB environment.
+	 *
+	 * Stop the thread started by #mdb_env_scrub_start() and wait for it
+	 * to finish.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_scrub_stop(MDB_env *env);
+
+	/** @brief Return the progress of checksum verification.
+	 *
+	 * The progress is that of any thread or process scrubbing the
+	 * environment, as long as it has the same lock file.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[out] stat The address of an #MDB_scrubstat structure
+	 * 	where the progress will be copied
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_scrub_stat(MDB_env *env, MDB_scrubstat *stat);
+
 	/** @brief Return statistics about the LMDB environment.
 	 *
 	 * @param[in] env An environment handle returned by #mdb_env_create()
@@ -62,6 +62,7 @@
 #define MDB_PID_T	pid_t
 #define MDB_THR_T	pthread_t
 #include <sys/param.h>
+#include <sys/time.h>
 #include <sys/uio.h>
 #include <sys/mman.h>
 #ifdef HAVE_SYS_FILE_H
@@ -521,6 +522,11 @@ static txnid_t mdb_debug_start;
 
 	/**	The version number for a database's datafile format. */
 #define MDB_DATA_VERSION	 ((MDB_DEVEL) ? 999 : 1)
+	/**	The version number for a datafile whose pages end with
+	 *	an #MDB_pgtail. Libraries which don't know it refuse to
+	 *	open the file, rather than overwrite the trailers.
+	 */
+#define MDB_DATA_VERSION_TAIL	 (MDB_DATA_VERSION + 1)
 	/**	The version number for a database's lockfile format. */
 #define MDB_LOCK_VERSION	 1
 
@@ -821,8 +827,8 @@ typedef struct MDB_page {
 #define SIZELEFT(p)	 (indx_t)((p)->mp_upper - (p)->mp_lower)
 
 	/** The percentage of space used in the page, in tenths of a percent. */
-#define PAGEFILL(env, p) (1000L * ((env)->me_psize - PAGEHDRSZ - SIZELEFT(p)) / \
-				((env)->me_psize - PAGEHDRSZ))
+#define PAGEFILL(env, p) (1000L * (PAGESPACE(env) - PAGEHDRSZ - SIZELEFT(p)) / \
+				(PAGESPACE(env) - PAGEHDRSZ))
 	/** The minimum page fill factor, in tenths of a percent.
 	 *	Pages emptier than this are candidates for merging.
 	 */
@@ -839,8 +845,34 @@ typedef struct MDB_page {
 	/** Test if a page is a sub page */
 #define IS_SUBP(p)	 F_ISSET((p)->mp_flags, P_SUBP)
 
+	/** Trailer at the end of each page, or each overflow run, of
+	 *	an environment created with #MDB_PAGECRC or #MDB_PAGETXN. The
+	 *	trailer is not part of the page proper: branch and leaf pages
+	 *	end before it, and it is only filled in when the page is
+	 *	written out. Other environments have no trailers, so their
+	 *	pages keep the layout older versions of the library expect.
+	 */
+typedef struct MDB_pgtail {
+	/** ID of the txn that last wrote this page. Since committed pages
+	 *	are never modified in place, and a page's parent is always
+	 *	rewritten along with it, no page in a subtree is newer than
+	 *	the subtree's root.
+	 */
+	txnid_t		mpt_txnid;
+	uint32_t	mpt_cksum;		/**< see @ref cksum, or 0 */
+	uint32_t	mpt_pad;
+} MDB_pgtail;
+
+	/** Address of the trailer of a page, or of an overflow run */
+#define PAGETAIL(env, p)	((MDB_pgtail *)((char *)(p) - sizeof(MDB_pgtail) + \
+	(IS_OVERFLOW(p) ? (size_t)(p)->mp_pages : 1) * (env)->me_psize))
+
+	/** The size of a page, less the trailer if the environment has one */
+#define PAGESPACE(env)	((env)->me_psize - (env)->me_pgtail)
+
 	/** The number of overflow pages needed to store the given size. */
-#define OVPAGES(size, psize)	((PAGEHDRSZ-1 + (size)) / (psize) + 1)
+#define OVPAGES(env, size)	((PAGEHDRSZ-1 + (env)->me_pgtail + (size)) / \
+	(env)->me_psize + 1)
 
 	/** Link in #MDB_txn.%mt_loose_pgs list */
 #define NEXT_LOOSE_PAGE(p)		(*(MDB_page **)((p) + 2))
@@ -1189,6 +1221,8 @@ typedef struct MDB_xcursor {
 typedef struct MDB_pgstate {
 	pgno_t		*mf_pghead;	/**< Reclaimed freeDB pages, or NULL before use */
 	txnid_t		mf_pglast;	/**< ID of last used record, or 0 if !mf_pghead */
+	pgno_t		mf_pgnorun;	/**< mf_pghead has no contiguous run of this
+						 *	many pages, or 0 if unknown */
 } MDB_pgstate;
 
 	/** The database environment. */
@@ -1207,6 +1241,7 @@ struct MDB_env {
 	uint32_t 	me_flags;		/**< @ref mdb_env */
 	unsigned int	me_psize;	/**< DB page size, inited from me_os_psize */
 	unsigned int	me_os_psize;	/**< OS page size, from #GET_PAGESIZE */
+	unsigned int	me_pgtail;	/**< size of the #MDB_pgtail of each page, or 0 */
 	unsigned int	me_maxreaders;	/**< size of the reader table */
 	/** Max #MDB_txninfo.%mti_numreaders of interest to #mdb_env_close() */
 	volatile int	me_close_readers;
@@ -1231,6 +1266,7 @@ struct MDB_env {
 	MDB_pgstate	me_pgstate;		/**< state of old pages from freeDB */
 #	define		me_pglast	me_pgstate.mf_pglast
 #	define		me_pghead	me_pgstate.mf_pghead
+#	define		me_pgnorun	me_pgstate.mf_pgnorun
 	MDB_page	*me_dpages;		/**< list of malloc'd blocks for re-use */
 	/** IDL of pages that became unused in a write txn */
 	MDB_IDL		me_free_pgs;
@@ -1256,8 +1292,25 @@ struct MDB_env {
 #endif
 	void		*me_userctx;	 /**< User-settable context */
 	MDB_assert_func *me_assert_func; /**< Callback for assertion failures */
+	pthread_t	me_scrubthr;	/**< thread started by #mdb_env_scrub_start() */
+	pthread_mutex_t	me_scrubmutex;	/**< protects #me_scrubstop */
+	pthread_cond_t	me_scrubcond;	/**< signalled to stop the scrubber */
+	volatile int	me_scrubstop;	/**< the scrubber must stop */
+	int			me_scrubbing;	/**< #me_scrubthr is running */
+	unsigned int	me_scrubrate;	/**< pages per second to scrub, or 0 */
+	unsigned int	me_scrubival;	/**< seconds between scrubbing passes */
+	MDB_scrubstat	me_scrubst;		/**< scrub progress without a lock file */
+	/** Scrub progress in the last reader slot, shared by all processes.
+	 *	Only environments with #MDB_PAGECRC reserve the slot, so the
+	 *	lock file layout is the same as for older versions.
+	 */
+	MDB_scrubstat	*me_scrubsh;
 };
 
+	/** The scrub progress of an environment, shared if possible */
+#define MDB_SCRUBST(env) \
+	((env)->me_scrubsh ? (env)->me_scrubsh : &(env)->me_scrubst)
+
 	/** Nested transaction */
 typedef struct MDB_ntxn {
 	MDB_txn		mnt_txn;		/**< the transaction */
@@ -2068,6 +2121,55 @@ mdb_page_dirty(MDB_txn *txn, MDB_page *mp)
 	txn->mt_dirty_room--;
 }
 
+/** Find the end of the contiguous page run through mop[i].
+ * Page numbers in mop[] are unique and descending, so mop[i+d] equals
+ * mop[i]-d exactly up to the end of the run: binary search for it.
+ * @param[in] mop the IDL to search.
+ * @param[in] i index of a page in \b mop.
+ * @param[in] dir 1 to search towards lower page numbers, -1 for higher.
+ * @return index of the last page of the run in that direction.
+ */
+static unsigned
+mdb_pgrun_end(pgno_t *mop, unsigned i, int dir)
+{
+	unsigned lo = 0, hi = dir > 0 ? mop[0] - i : i - 1, d;
+
+	while (lo < hi) {
+		d = (lo + hi + 1) >> 1;
+		if (dir > 0 ? mop[i + d] == mop[i] - d : mop[i - d] == mop[i] + d)
+			lo = d;
+		else
+			hi = d - 1;
+	}
+	return dir > 0 ? i + lo : i - lo;
+}
+
+/** Update me_pgnorun after merging \b idl into me_pghead.
+ * Only runs through the merged pages can have grown, so look
+ * those up instead of rescanning all of me_pghead.
+ * @param[in] env the environment.
+ * @param[in] idl the pages just merged, in descending order.
+ */
+static void
+mdb_pgrun_merged(MDB_env *env, MDB_IDL idl)
+{
+	pgno_t *mop = env->me_pghead, norun = env->me_pgnorun, low = 0;
+	unsigned i, j, hi, lo;
+
+	for (i = 1; i <= idl[0]; i++) {
+		/* Already seen as part of the previous run? */
+		if (low && idl[i] >= low)
+			continue;
+		j = mdb_midl_search(mop, idl[i]);
+		hi = mdb_pgrun_end(mop, j, -1);
+		lo = mdb_pgrun_end(mop, j, 1);
+		low = mop[lo];
+		if (lo - hi + 1 >= norun)
+			norun = lo - hi + 2;
+	}
+	env->me_pgnorun = norun;
+}
+
 /** Allocate page numbers and memory for writing.  Maintain me_pglast,
  * me_pghead and mt_next_pgno.
  *
@@ -2134,14 +2236,18 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 
 		/* Seek a big enough contiguous page range. Prefer
 		 * pages at the tail, just truncating the list.
+		 * Don't bother if me_pgnorun says there is none.
 		 */
 		if (mop_len > n2) {
-			i = mop_len;
-			do {
-				pgno = mop[i];
-				if (mop[i-n2] == pgno+n2)
-					goto search_done;
-			} while (--i > n2);
+			if (!env->me_pgnorun || (pgno_t)num < env->me_pgnorun) {
+				i = mop_len;
+				do {
+					pgno = mop[i];
+					if (mop[i-n2] == pgno+n2)
+						goto search_done;
+				} while (--i > n2);
+				env->me_pgnorun = num;
+			}
 			if (--retry < 0)
 				break;
 		}
@@ -2216,6 +2322,8 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		/* Merge in descending sorted order */
 		mdb_midl_xmerge(mop, idl);
 		mop_len = mop[0];
+		if (env->me_pgnorun)
+			mdb_pgrun_merged(env, idl);
 	}
 
 	/* Use new pages from the map when nothing suitable in the freeDB */
@@ -2654,7 +2762,7 @@ mdb_txn_renew0(MDB_txn *txn)
 				for (i=0; i<nr; i++)
 					if (ti->mti_readers[i].mr_pid == 0)
 						break;
-				if (i == env->me_maxreaders) {
+				if (i == env->me_maxreaders - (env->me_scrubsh != NULL)) {
 					UNLOCK_MUTEX(rmutex);
 					return MDB_READERS_FULL;
 				}
@@ -2960,6 +3068,7 @@ mdb_txn_end(MDB_txn *txn, unsigned mode)
 			/* me_pgstate: */
 			env->me_pghead = NULL;
 			env->me_pglast = 0;
+			env->me_pgnorun = 0;
 
 			env->me_txn = NULL;
 			mode = 0;	/* txn == env->me_txn0, do not free() it */
@@ -3165,6 +3274,7 @@ mdb_freelist_save(MDB_txn *txn)
 		loose[0] = count;
 		mdb_midl_sort(loose);
 		mdb_midl_xmerge(mop, loose);
+		env->me_pgnorun = 0;
 		txn->mt_loose_pgs = NULL;
 		txn->mt_loose_count = 0;
 		mop_len = mop[0];
@@ -3200,6 +3310,232 @@ mdb_freelist_save(MDB_txn *txn)
 	return rc;
 }
 
+/** @defgroup cksum	Page Checksums
+ *	@ingroup internal
+ *	With #MDB_PAGECRC every page written to the data file carries a
+ *	CRC32C of its header and of the parts of the page that are in use,
+ *	stored in its #MDB_pgtail. An overflow run has a single trailer,
+ *	at the end of its last page. The free space in the middle of a
+ *	branch or leaf page is not covered, so it needn't be initialized.
+ *	@{
+ */
+	/** CRC32C (Castagnoli) lookup table, for the reflected
+	 *	polynomial 0x82F63B78.
+	 */
+static const uint32_t mdb_crc32c_tab[256] = {
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+	0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+	0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+	0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+	0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+	0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+	0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+	0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+	0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+	0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+	0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+	0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+	0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+	0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+	0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+	0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+	0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+	0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+	0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+	0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+	0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+	0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+	0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+	0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+	0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+	0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+	0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+	0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+	0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+	0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+	0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+	0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+	0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+	/** Update a CRC32C with bytes, one at a time. */
+static uint32_t
+mdb_crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len--)
+		crc = mdb_crc32c_tab[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#if defined(__x86_64__) && (defined(__clang__) || \
+	(defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+	/** Update a CRC32C with the SSE4.2 crc32 instruction. */
+static uint32_t __attribute__((target("sse4.2")))
+mdb_crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t c = crc, v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, 8);
+		c = __builtin_ia32_crc32di(c, v);
+	}
+	for (; len; len--)
+		c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+	return (uint32_t)c;
+}
+#define MDB_CRC32C_HW()	__builtin_cpu_supports("sse4.2")
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+#include <arm_acle.h>
+	/** Update a CRC32C with the ARMv8 crc32c instructions. */
+static uint32_t
+mdb_crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		crc = __crc32cb(crc, *p++);
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, 8);
+		crc = __crc32cd(crc, v);
+	}
+	for (; len; len--)
+		crc = __crc32cb(crc, *p++);
+	return crc;
+}
+#define MDB_CRC32C_HW()	1
+#endif
+
+	/** Update a CRC32C, using the CPU's instructions for it if it has any.
+	 *	The register is not inverted here; callers start with ~0 and
+	 *	invert the final value.
+	 */
+static uint32_t
+mdb_crc32c(uint32_t crc, const void *p, size_t len)
+{
+#ifdef MDB_CRC32C_HW
+	if (MDB_CRC32C_HW())
+		return mdb_crc32c_hw(crc, p, len);
+#endif
+	return mdb_crc32c_sw(crc, p, len);
+}
+
+	/** Compute the checksum of a page.
+	 * @param[in] env the environment the page belongs to.
+	 * @param[in] mp the page. Its bounds must already have been checked.
+	 * @param[in] tail for an overflow page, the pages after the first,
+	 *	or NULL if they follow it in memory.
+	 * @param[in] txnid the txn ID stored in the page's trailer.
+	 * @return the checksum.
+	 */
+static uint32_t
+mdb_page_cksum(MDB_env *env, MDB_page *mp, const char *tail, txnid_t txnid)
+{
+	unsigned int psize = env->me_psize, space = PAGESPACE(env);
+	uint32_t crc;
+
+	crc = mdb_crc32c(~0U, mp, PAGEHDRSZ);
+	if (IS_OVERFLOW(mp)) {
+		if (mp->mp_pages > 1) {
+			crc = mdb_crc32c(crc, METADATA(mp), psize - PAGEHDRSZ);
+			crc = mdb_crc32c(crc, tail ? tail : (char *)mp + psize,
+				(size_t)psize * (mp->mp_pages - 2) + space);
+		} else {
+			crc = mdb_crc32c(crc, METADATA(mp), space - PAGEHDRSZ);
+		}
+	} else if (IS_LEAF2(mp)) {
+		crc = mdb_crc32c(crc, METADATA(mp), NUMKEYS(mp) * mp->mp_pad);
+	} else {
+		crc = mdb_crc32c(crc, METADATA(mp),
+			mp->mp_lower + PAGEBASE - PAGEHDRSZ);
+		crc = mdb_crc32c(crc, (char *)mp + PAGEBASE + mp->mp_upper,
+			space - PAGEBASE - mp->mp_upper);
+	}
+	crc = mdb_crc32c(crc, &txnid, sizeof(txnid));
+	return ~crc;
+}
+
+	/** Check a page read from the map against its checksum.
+	 *	The header is checked for sanity first, so that a damaged
+	 *	page can't make us read outside the map.
+	 * @param[in] env the environment the page belongs to.
+	 * @param[in] mp the page.
+	 * @param[in] pgno the number the page was read at.
+	 * @param[in] maxpg the first page number past the end of the data.
+	 * @return 0 if the page is intact, otherwise #MDB_CORRUPTED.
+	 */
+static int
+mdb_page_verify(MDB_env *env, MDB_page *mp, pgno_t pgno, pgno_t maxpg)
+{
+	unsigned int space = PAGESPACE(env);
+	MDB_pgtail *pt;
+
+	if (mp->mp_pgno != pgno)
+		return MDB_CORRUPTED;
+	switch (mp->mp_flags & (P_BRANCH|P_LEAF|P_OVERFLOW|P_META|P_LEAF2|P_SUBP)) {
+	case P_OVERFLOW:
+		if (!mp->mp_pages || mp->mp_pages > maxpg - pgno)
+			return MDB_CORRUPTED;
+		break;
+	case P_LEAF|P_LEAF2:
+		if (mp->mp_lower < PAGEHDRSZ - PAGEBASE ||
+			(size_t)NUMKEYS(mp) * mp->mp_pad > space - PAGEHDRSZ)
+			return MDB_CORRUPTED;
+		break;
+	case P_BRANCH:
+	case P_LEAF:
+		if (mp->mp_lower < PAGEHDRSZ - PAGEBASE || mp->mp_lower > mp->mp_upper ||
+			(unsigned int)mp->mp_upper + PAGEBASE > space)
+			return MDB_CORRUPTED;
+		break;
+	default:
+		return MDB_CORRUPTED;
+	}
+	pt = PAGETAIL(env, mp);
+	return pt->mpt_cksum == mdb_page_cksum(env, mp, NULL, pt->mpt_txnid) ?
+		0 : MDB_CORRUPTED;
+}
+
+	/** Fill in the trailer of a page about to be written.
+	 * @param[in] env the environment the page belongs to.
+	 * @param[in] mp the page.
+	 * @param[in] tail for an overflow page, the pages after the first,
+	 *	or NULL if they follow it in memory.
+	 * @param[out] pt the trailer, which needn't be in the page yet.
+	 * @param[in] txnid the ID of the txn writing the page.
+	 */
+static void
+mdb_page_settail(MDB_env *env, MDB_page *mp, const char *tail,
+	MDB_pgtail *pt, txnid_t txnid)
+{
+	pt->mpt_txnid = txnid;
+	pt->mpt_pad = 0;
+	pt->mpt_cksum = (env->me_flags & MDB_PAGECRC) ?
+		mdb_page_cksum(env, mp, tail, txnid) : 0;
+}
+
+	/** Stamp a page about to be written with its txn and checksum. */
+static void
+mdb_page_stamp(MDB_txn *txn, MDB_page *mp)
+{
+	MDB_env *env = txn->mt_env;
+
+	if (env->me_pgtail)
+		mdb_page_settail(env, mp, NULL, PAGETAIL(env, mp), txn->mt_txnid);
+}
+/** @} */
+
 /** Flush (some) dirty pages to the map, after clearing their dirty flag.
  * @param[in] txn the transaction that's being committed
  * @param[in] keep number of initial pages in dirty_list to keep dirty.
@@ -3237,6 +3573,7 @@ mdb_page_flush(MDB_txn *txn, int keep)
 				continue;
 			}
 			dp->mp_flags &= ~P_DIRTY;
+			mdb_page_stamp(txn, dp);
 		}
 		goto done;
 	}
@@ -3254,6 +3591,7 @@ mdb_page_flush(MDB_txn *txn, int keep)
 			pgno = dl[i].mid;
 			/* clear dirty flag */
 			dp->mp_flags &= ~P_DIRTY;
+			mdb_page_stamp(txn, dp);
 			pos = pgno * psize;
 			size = psize;
 			if (IS_OVERFLOW(dp)) size *= dp->mp_pages;
@@ -3633,7 +3971,8 @@ mdb_env_read_header(MDB_env *env, MDB_meta *meta)
 			return MDB_INVALID;
 		}
 
-		if (m->mm_version != MDB_DATA_VERSION) {
+		if (m->mm_version != MDB_DATA_VERSION &&
+			m->mm_version != MDB_DATA_VERSION_TAIL) {
 			DPRINTF(("database is version %u, expected version %u",
 				m->mm_version, MDB_DATA_VERSION));
 			return MDB_VERSION_MISMATCH;
@@ -3650,7 +3989,8 @@ static void ESECT
 mdb_env_init_meta0(MDB_env *env, MDB_meta *meta)
 {
 	meta->mm_magic = MDB_MAGIC;
-	meta->mm_version = MDB_DATA_VERSION;
+	meta->mm_version = (env->me_flags & (MDB_PAGECRC|MDB_PAGETXN)) ?
+		MDB_DATA_VERSION_TAIL : MDB_DATA_VERSION;
 	meta->mm_mapsize = env->me_mapsize;
 	meta->mm_psize = env->me_psize;
 	meta->mm_last_pg = NUM_METAS-1;
@@ -4122,12 +4462,24 @@ mdb_env_open2(MDB_env *env)
 		env->me_psize = env->me_os_psize;
 		if (env->me_psize > MAX_PAGESIZE)
 			env->me_psize = MAX_PAGESIZE;
+		/* Checksums cover the txn ID stamped next to them */
+		if (flags & MDB_PAGECRC)
+			env->me_flags |= MDB_PAGETXN;
 		memset(&meta, 0, sizeof(meta));
 		mdb_env_init_meta0(env, &meta);
 		meta.mm_mapsize = DEFAULT_MAPSIZE;
 	} else {
 		env->me_psize = meta.mm_psize;
+		/* Page trailers are a property of the data file */
+		if ((meta.mm_version == MDB_DATA_VERSION_TAIL) !=
+			!!(meta.mm_flags & (MDB_PAGECRC|MDB_PAGETXN)))
+			return MDB_INVALID;
+		if (flags & ~meta.mm_flags & (MDB_PAGECRC|MDB_PAGETXN))
+			return MDB_INCOMPATIBLE;
+		env->me_flags |= meta.mm_flags & (MDB_PAGECRC|MDB_PAGETXN);
 	}
+	if (env->me_flags & (MDB_PAGECRC|MDB_PAGETXN))
+		env->me_pgtail = sizeof(MDB_pgtail);
 
 	/* Was a mapsize configured? */
 	if (!env->me_mapsize) {
@@ -4170,8 +4522,8 @@ mdb_env_open2(MDB_env *env)
 		}
 	}
 
-	env->me_maxfree_1pg = (env->me_psize - PAGEHDRSZ) / sizeof(pgno_t) - 1;
-	env->me_nodemax = (((env->me_psize - PAGEHDRSZ) / MDB_MINKEYS) & -2)
+	env->me_maxfree_1pg = (PAGESPACE(env) - PAGEHDRSZ) / sizeof(pgno_t) - 1;
+	env->me_nodemax = (((PAGESPACE(env) - PAGEHDRSZ) / MDB_MINKEYS) & -2)
 		- sizeof(indx_t);
 #if !(MDB_MAXKEYSIZE)
 	env->me_maxkey = env->me_nodemax - (NODESIZE + sizeof(MDB_db));
@@ -4646,6 +4998,9 @@ mdb_env_setup_locks(MDB_env *env, char *lpath, int mode, int *excl)
 		env->me_txns->mti_format = MDB_LOCK_FORMAT;
 		env->me_txns->mti_txnid = 0;
 		env->me_txns->mti_numreaders = 0;
+		/* The slot #me_scrubsh may use */
+		memset(&env->me_txns->mti_readers[env->me_maxreaders-1], 0,
+			sizeof(MDB_reader));
 
 	} else {
 		if (env->me_txns->mti_magic != MDB_MAGIC) {
@@ -4693,9 +5048,10 @@ fail:
 	 *	at runtime. Changing other flags requires closing the
 	 *	environment and re-opening it with the new flags.
 	 */
-#define	CHANGEABLE	(MDB_NOSYNC|MDB_NOMETASYNC|MDB_MAPASYNC|MDB_NOMEMINIT)
+#define	CHANGEABLE	(MDB_NOSYNC|MDB_NOMETASYNC|MDB_MAPASYNC|MDB_NOMEMINIT| \
+	MDB_PAGEVERIFY)
 #define	CHANGELESS	(MDB_FIXEDMAP|MDB_NOSUBDIR|MDB_RDONLY| \
-	MDB_WRITEMAP|MDB_NOTLS|MDB_NOLOCK|MDB_NORDAHEAD)
+	MDB_WRITEMAP|MDB_NOTLS|MDB_NOLOCK|MDB_NORDAHEAD|MDB_PAGECRC|MDB_PAGETXN)
 
 #if VALID_FLAGS & PERSISTENT_FLAGS & (CHANGEABLE|CHANGELESS)
 # error "Persistent DB flags & env flags overlap, but both go in mm_flags"
@@ -4798,6 +5154,10 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 	}
 
 	if ((rc = mdb_env_open2(env)) == MDB_SUCCESS) {
+		if ((env->me_flags & MDB_PAGECRC) && env->me_txns &&
+			env->me_maxreaders > 1)
+			env->me_scrubsh = (MDB_scrubstat *)
+				&env->me_txns->mti_readers[env->me_maxreaders-1];
 		if (flags & (MDB_RDONLY|MDB_WRITEMAP)) {
 			env->me_mfd = env->me_fd;
 		} else {
@@ -4962,6 +5322,9 @@ mdb_env_close(MDB_env *env)
 	if (env == NULL)
 		return;
 
+	if (env->me_scrubbing)
+		mdb_env_scrub_stop(env);
+
 	VGMEMP_DESTROY(env);
 	while ((dp = env->me_dpages) != NULL) {
 		VGMEMP_DEFINED(&dp->mp_next, sizeof(dp->mp_next));
@@ -5263,6 +5626,14 @@ mdb_page_get(MDB_txn *txn, pgno_t pgno, MDB_page **ret, int *lvl)
 	if (pgno < txn->mt_next_pgno) {
 		level = 0;
 		p = (MDB_page *)(env->me_map + env->me_psize * pgno);
+		/* Pages dirty in the map are only checked once committed */
+		if (F_ISSET(env->me_flags, MDB_PAGECRC|MDB_PAGEVERIFY) &&
+			!(p->mp_flags & P_DIRTY) &&
+			mdb_page_verify(env, p, pgno, txn->mt_next_pgno)) {
+			DPRINTF(("page %"Z"u checksum mismatch", pgno));
+			txn->mt_flags |= MDB_TXN_ERROR;
+			return MDB_CORRUPTED;
+		}
 	} else {
 		DPRINTF(("page %"Z"u not found", pgno));
 		txn->mt_flags |= MDB_TXN_ERROR;
@@ -5525,6 +5896,13 @@ release:
 		while (j>i)
 			mop[j--] = pg++;
 		mop[0] += ovpages;
+		if (env->me_pgnorun) {
+			/* The pages are contiguous, one lookup finds their run */
+			pgno_t run[2];
+			run[0] = 1;
+			run[1] = pg - 1;
+			mdb_pgrun_merged(env, run);
+		}
 	} else {
 		rc = mdb_midl_append_range(&txn->mt_free_pgs, pg, ovpages);
 		if (rc)
@@ -6576,7 +6954,7 @@ prep_subDB:
 					xdata.mv_data = &dummy;
 					if ((rc = mdb_page_alloc(mc, 1, &mp)))
 						return rc;
-					offset = env->me_psize - olddata.mv_size;
+					offset = PAGESPACE(env) - olddata.mv_size;
 					flags |= F_DUPDATA|F_SUBDATA;
 					dummy.md_root = mp->mp_pgno;
 					sub_root = mp;
@@ -6611,7 +6989,7 @@ current:
 		if (F_ISSET(leaf->mn_flags, F_BIGDATA)) {
 			MDB_page *omp;
 			pgno_t pg;
-			int level, ovpages, dpages = OVPAGES(data->mv_size, env->me_psize);
+			int level, ovpages, dpages = OVPAGES(env, data->mv_size);
 
 			memcpy(&pg, olddata.mv_data, sizeof(pg));
 			if ((rc2 = mdb_page_get(mc->mc_txn, pg, &omp, &level)) != 0)
@@ -6953,7 +7331,7 @@ mdb_page_new(MDB_cursor *mc, uint32_t flags, int num, MDB_page **mp)
 	    np->mp_pgno, mc->mc_txn->mt_env->me_psize));
 	np->mp_flags = flags | P_DIRTY;
 	np->mp_lower = (PAGEHDRSZ-PAGEBASE);
-	np->mp_upper = mc->mc_txn->mt_env->me_psize - PAGEBASE;
+	np->mp_upper = PAGESPACE(mc->mc_txn->mt_env) - PAGEBASE;
 
 	if (IS_BRANCH(np))
 		mc->mc_db->md_branch_pages++;
@@ -7080,7 +7458,7 @@ mdb_node_add(MDB_cursor *mc, indx_t indx,
 			/* Data already on overflow page. */
 			node_size += sizeof(pgno_t);
 		} else if (node_size + data->mv_size > mc->mc_txn->mt_env->me_nodemax) {
-			int ovpages = OVPAGES(data->mv_size, mc->mc_txn->mt_env->me_psize);
+			int ovpages = OVPAGES(mc->mc_txn->mt_env, data->mv_size);
 			int rc;
 			/* Put data on overflow page. */
 			DPRINTF(("data size is %"Z"u, node would be %"Z"u, put data on overflow page",
@@ -8471,7 +8849,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 		} else {
 			int psize, nsize, k;
 			/* Maximum free space in an empty page */
-			pmax = env->me_psize - PAGEHDRSZ;
+			pmax = PAGESPACE(env) - PAGEHDRSZ;
 			if (IS_LEAF(mp))
 				nsize = mdb_leaf_size(env, newkey, newdata);
 			else
@@ -8487,7 +8865,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			copy->mp_pgno  = mp->mp_pgno;
 			copy->mp_flags = mp->mp_flags;
 			copy->mp_lower = (PAGEHDRSZ-PAGEBASE);
-			copy->mp_upper = env->me_psize - PAGEBASE;
+			copy->mp_upper = PAGESPACE(env) - PAGEBASE;
 
 			/* prepare to insert */
 			for (i=0, j=0; i<nkeys; i++) {
@@ -8660,7 +9038,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 		mp->mp_lower = copy->mp_lower;
 		mp->mp_upper = copy->mp_upper;
 		memcpy(NODEPTR(mp, nkeys-1), NODEPTR(copy, nkeys-1),
-			env->me_psize - copy->mp_upper - PAGEBASE);
+			PAGESPACE(env) - copy->mp_upper - PAGEBASE);
 
 		/* reset back to original page */
 		if (newindx < split_indx) {
@@ -8795,6 +9173,59 @@ mdb_put(MDB_txn *txn, MDB_dbi dbi,
 #define MDB_WBUF	(1024*1024)
 #endif
 
+#ifndef MDB_CP_THREADS
+	/** Maximum number of threads copying subtrees for a compacting copy,
+	 *	besides the calling thread. Fewer are used if there are fewer CPUs.
+	 */
+#define MDB_CP_THREADS	8
+#endif
+
+	/** Subtrees of up to this many levels are copied by a single
+	 *	thread in a compacting copy. Larger ones are split up.
+	 */
+#define MDB_CP_HEIGHT	2
+
+	/** Maximum depth of nested trees in a subtree being copied. */
+#define MDB_CP_DEPTH	(CURSOR_STACK * 2)
+
+	/** The rest of an overflow run, to be written from the map
+	 *	after the page at \b tl_off in a task's buffer.
+	 */
+typedef struct mdb_ctail {
+	size_t	tl_off;
+	char	*tl_ptr;
+} mdb_ctail;
+
+	/** A subtree to be copied by a single thread.
+	 *	Its pages are numbered from 0, and renumbered when
+	 *	they are written out.
+	 */
+typedef struct mdb_ctask {
+	pgno_t		ct_pgno;		/**< root of the subtree */
+	int			ct_flags;		/**< #F_DUPDATA for a sub-DB of duplicates */
+	int			ct_state;		/**< #CT_QUEUED, #CT_RUNNING or #CT_DONE */
+#define CT_QUEUED	0
+#define CT_RUNNING	1
+#define CT_DONE		2
+	int			ct_rc;
+	pgno_t		ct_next;		/**< number of pages copied so far */
+	char		*ct_buf;		/**< copied pages */
+	size_t		ct_len;
+	size_t		ct_size;
+	mdb_ctail	*ct_tails;		/**< overflow runs, in page order */
+	unsigned	ct_ntails;
+	unsigned	ct_maxtails;
+} mdb_ctask;
+
+	/** A step in the plan of a compacting copy. */
+typedef struct mdb_citem {
+	MDB_ID		ci_id;			/**< task index, or page number */
+	int			ci_type;
+#define CI_TASK		0			/**< write the output of a task */
+#define CI_PAGE		1			/**< copy a page above the tasks */
+#define CI_OVER		2			/**< copy an overflow run of the main DB */
+} mdb_citem;
+
 	/** State needed for a compacting copy. */
 typedef struct mdb_copy {
 	pthread_mutex_t mc_mutex;
@@ -8810,7 +9241,23 @@ typedef struct mdb_copy {
 	int mc_status;
 	volatile int mc_new;
 	int mc_toggle;
-
+	mdb_citem *mc_items;	/**< the plan, in the order pages are written */
+	unsigned mc_nitems;
+	unsigned mc_maxitems;
+	mdb_ctask *mc_tasks;
+	unsigned mc_ntasks;
+	unsigned mc_maxtasks;
+	pgno_t *mc_res;			/**< new page numbers of copied subtrees */
+	unsigned mc_nres;
+	unsigned mc_maxres;
+	/** Protects the following fields and the tasks' states */
+	pthread_mutex_t mc_tmutex;
+	pthread_cond_t mc_tcond;	/**< a task may be started */
+	pthread_cond_t mc_dcond;	/**< a task is done */
+	unsigned mc_tnext;		/**< the next task to start */
+	unsigned mc_tdone;		/**< tasks written out so far */
+	unsigned mc_window;		/**< tasks that may be ahead of the writer */
+	int mc_tstop;
 } mdb_copy;
 
 	/** Dedicated writer thread for compacting copy. */
@@ -8897,183 +9344,604 @@ mdb_env_cthr_toggle(mdb_copy *my, int st)
 	return 0;
 }
 
-	/** Depth-first tree traversal for compacting copy. */
+	/** Make room for one more page in the current write buffer. */
 static int ESECT
-mdb_env_cwalk(mdb_copy *my, pgno_t *pg, int flags)
+mdb_cp_out(mdb_copy *my, MDB_page **mo)
 {
-	MDB_cursor mc = {0};
-	MDB_txn *txn = my->mc_txn;
-	MDB_node *ni;
-	MDB_page *mo, *mp, *leaf;
-	char *buf, *ptr;
-	int rc, toggle;
-	unsigned int i;
+	int rc;
 
-	/* Empty DB, nothing to do */
-	if (*pg == P_INVALID)
-		return MDB_SUCCESS;
+	if (my->mc_wlen[my->mc_toggle] >= MDB_WBUF) {
+		rc = mdb_env_cthr_toggle(my, 1);
+		if (rc)
+			return rc;
+	}
+	*mo = (MDB_page *)(my->mc_wbuf[my->mc_toggle] + my->mc_wlen[my->mc_toggle]);
+	my->mc_wlen[my->mc_toggle] += my->mc_env->me_psize;
+	return MDB_SUCCESS;
+}
 
-	mc.mc_snum = 1;
-	mc.mc_txn = txn;
+	/** Write the rest of an overflow run after the current write buffer. */
+static int ESECT
+mdb_cp_tail(mdb_copy *my, char *ptr, size_t len)
+{
+	my->mc_olen[my->mc_toggle] = len;
+	my->mc_over[my->mc_toggle] = ptr;
+	return mdb_env_cthr_toggle(my, 1);
+}
 
-	rc = mdb_page_get(my->mc_txn, *pg, &mc.mc_pg[0], NULL);
-	if (rc)
+	/** The txn ID of the pages of a compacted copy, as in its meta page */
+#define MDB_CP_TXNID	1
+
+	/** Write the rest of the overflow run starting with the page \b mo,
+	 *	and update its trailer for the page's new number.
+	 * @param[in] my the copy in progress.
+	 * @param[in] mo the first page, in the current write buffer.
+	 * @param[in] ptr the pages after the first, in the map.
+	 * @return 0 on success, non-zero on failure.
+	 */
+static int ESECT
+mdb_cp_ovtail(mdb_copy *my, MDB_page *mo, char *ptr)
+{
+	MDB_env *env = my->mc_env;
+	unsigned int psize = env->me_psize;
+	size_t len = (size_t)psize * (mo->mp_pages - 1);
+	MDB_page *mp;
+	MDB_pgtail pt;
+	int rc;
+
+	if (!env->me_pgtail)
+		return len ? mdb_cp_tail(my, ptr, len) : MDB_SUCCESS;
+	if (!len) {
+		mdb_page_settail(env, mo, NULL, PAGETAIL(env, mo), MDB_CP_TXNID);
+		return MDB_SUCCESS;
+	}
+	mdb_page_settail(env, mo, ptr, &pt, MDB_CP_TXNID);
+	/* The trailer is on the last page, so that one can't be
+	 * written straight from the map
+	 */
+	len -= psize;
+	if (len && (rc = mdb_cp_tail(my, ptr, len)) != 0)
 		return rc;
-	rc = mdb_page_search_root(&mc, NULL, MDB_PS_FIRST);
-	if (rc)
+	if ((rc = mdb_cp_out(my, &mp)) != 0)
 		return rc;
+	memcpy(mp, ptr + len, psize);
+	((MDB_pgtail *)((char *)mp + psize))[-1] = pt;
+	return MDB_SUCCESS;
+}
 
-	/* Make cursor pages writable */
-	buf = ptr = malloc(my->mc_env->me_psize * mc.mc_snum);
-	if (buf == NULL)
-		return ENOMEM;
+	/** Push the new page number of a copied page or subtree. */
+static int ESECT
+mdb_cp_push(mdb_copy *my, pgno_t pg)
+{
+	if (my->mc_nres == my->mc_maxres) {
+		unsigned n = my->mc_maxres ? my->mc_maxres * 2 : 256;
+		pgno_t *res = realloc(my->mc_res, n * sizeof(pgno_t));
+		if (!res)
+			return ENOMEM;
+		my->mc_res = res;
+		my->mc_maxres = n;
+	}
+	my->mc_res[my->mc_nres++] = pg;
+	return MDB_SUCCESS;
+}
 
-	for (i=0; i<mc.mc_top; i++) {
-		mdb_page_copy((MDB_page *)ptr, mc.mc_pg[i], my->mc_env->me_psize);
-		mc.mc_pg[i] = (MDB_page *)ptr;
-		ptr += my->mc_env->me_psize;
+	/** Append an item to the plan of a compacting copy. */
+static int ESECT
+mdb_cp_plan_add(mdb_copy *my, int type, MDB_ID id)
+{
+	if (my->mc_nitems == my->mc_maxitems) {
+		unsigned n = my->mc_maxitems ? my->mc_maxitems * 2 : 256;
+		mdb_citem *ci = realloc(my->mc_items, n * sizeof(mdb_citem));
+		if (!ci)
+			return ENOMEM;
+		my->mc_items = ci;
+		my->mc_maxitems = n;
 	}
+	my->mc_items[my->mc_nitems].ci_type = type;
+	my->mc_items[my->mc_nitems].ci_id = id;
+	my->mc_nitems++;
+	return MDB_SUCCESS;
+}
 
-	/* This is writable space for a leaf page. Usually not needed. */
-	leaf = (MDB_page *)ptr;
+	/** Plan the copy of a tree.
+	 *	Subtrees of at most #MDB_CP_HEIGHT levels become tasks for the
+	 *	copying threads. The pages above them are copied by the caller
+	 *	after their children, as are the leaves of a shallow main DB,
+	 *	so that each named DB in it gets tasks of its own.
+	 * @param[in] my the copy being planned.
+	 * @param[in] pg root of the tree.
+	 * @param[in] flags #F_DUPDATA for a sub-DB of duplicates.
+	 * @param[in] height levels in the tree.
+	 * @param[in] tasks whether subtrees may become tasks.
+	 * @return 0 on success, non-zero on failure.
+	 */
+static int ESECT
+mdb_cp_plan(mdb_copy *my, pgno_t pg, int flags, unsigned height, int tasks)
+{
+	MDB_page *mp;
+	MDB_node *ni;
+	MDB_db db;
+	pgno_t opg;
+	unsigned int i, n;
+	int rc;
 
-	toggle = my->mc_toggle;
-	while (mc.mc_snum > 0) {
-		unsigned n;
-		mp = mc.mc_pg[mc.mc_top];
-		n = NUMKEYS(mp);
+	if (pg == P_INVALID)
+		return MDB_SUCCESS;
 
-		if (IS_LEAF(mp)) {
-			if (!IS_LEAF2(mp) && !(flags & F_DUPDATA)) {
-				for (i=0; i<n; i++) {
-					ni = NODEPTR(mp, i);
-					if (ni->mn_flags & F_BIGDATA) {
-						MDB_page *omp;
-						pgno_t pg;
+	if (tasks && height <= MDB_CP_HEIGHT) {
+		mdb_ctask *ct;
+		if (my->mc_ntasks == my->mc_maxtasks) {
+			n = my->mc_maxtasks ? my->mc_maxtasks * 2 : 256;
+			ct = realloc(my->mc_tasks, n * sizeof(mdb_ctask));
+			if (!ct)
+				return ENOMEM;
+			my->mc_tasks = ct;
+			my->mc_maxtasks = n;
+		}
+		ct = &my->mc_tasks[my->mc_ntasks];
+		memset(ct, 0, sizeof(*ct));
+		ct->ct_pgno = pg;
+		ct->ct_flags = flags;
+		return mdb_cp_plan_add(my, CI_TASK, my->mc_ntasks++);
+	}
 
-						/* Need writable leaf */
-						if (mp != leaf) {
-							mc.mc_pg[mc.mc_top] = leaf;
-							mdb_page_copy(leaf, mp, my->mc_env->me_psize);
-							mp = leaf;
-							ni = NODEPTR(mp, i);
-						}
+	rc = mdb_page_get(my->mc_txn, pg, &mp, NULL);
+	if (rc)
+		return rc;
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		if (height < 2)
+			return MDB_CORRUPTED;
+		for (i=0; i<n; i++) {
+			rc = mdb_cp_plan(my, NODEPGNO(NODEPTR(mp, i)), flags, height-1, tasks);
+			if (rc)
+				return rc;
+		}
+	} else if (!IS_LEAF2(mp) && !(flags & F_DUPDATA)) {
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			if (ni->mn_flags & F_BIGDATA) {
+				memcpy(&opg, NODEDATA(ni), sizeof(opg));
+				rc = mdb_cp_plan_add(my, CI_OVER, opg);
+			} else if (ni->mn_flags & F_SUBDATA) {
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				rc = mdb_cp_plan(my, db.md_root, ni->mn_flags & F_DUPDATA,
+					db.md_depth, 1);
+			}
+			if (rc)
+				return rc;
+		}
+	}
+	return mdb_cp_plan_add(my, CI_PAGE, pg);
+}
 
-						memcpy(&pg, NODEDATA(ni), sizeof(pg));
-						rc = mdb_page_get(txn, pg, &omp, NULL);
-						if (rc)
-							goto done;
-						if (my->mc_wlen[toggle] >= MDB_WBUF) {
-							rc = mdb_env_cthr_toggle(my, 1);
-							if (rc)
-								goto done;
-							toggle = my->mc_toggle;
-						}
-						mo = (MDB_page *)(my->mc_wbuf[toggle] + my->mc_wlen[toggle]);
-						memcpy(mo, omp, my->mc_env->me_psize);
-						mo->mp_pgno = my->mc_next_pgno;
-						my->mc_next_pgno += omp->mp_pages;
-						my->mc_wlen[toggle] += my->mc_env->me_psize;
-						if (omp->mp_pages > 1) {
-							my->mc_olen[toggle] = my->mc_env->me_psize * (omp->mp_pages - 1);
-							my->mc_over[toggle] = (char *)omp + my->mc_env->me_psize;
-							rc = mdb_env_cthr_toggle(my, 1);
-							if (rc)
-								goto done;
-							toggle = my->mc_toggle;
-						}
-						memcpy(NODEDATA(ni), &mo->mp_pgno, sizeof(pgno_t));
-					} else if (ni->mn_flags & F_SUBDATA) {
-						MDB_db db;
+	/** Append space for a page to a task's output. */
+static char * ESECT
+mdb_cp_grow(mdb_ctask *ct, unsigned int psize)
+{
+	char *ptr;
 
-						/* Need writable leaf */
-						if (mp != leaf) {
-							mc.mc_pg[mc.mc_top] = leaf;
-							mdb_page_copy(leaf, mp, my->mc_env->me_psize);
-							mp = leaf;
-							ni = NODEPTR(mp, i);
-						}
+	if (ct->ct_len + psize > ct->ct_size) {
+		size_t n = ct->ct_size ? ct->ct_size * 2 : 64 * psize;
+		ptr = realloc(ct->ct_buf, n);
+		if (!ptr)
+			return NULL;
+		ct->ct_buf = ptr;
+		ct->ct_size = n;
+	}
+	ptr = ct->ct_buf + ct->ct_len;
+	ct->ct_len += psize;
+	return ptr;
+}
 
-						memcpy(&db, NODEDATA(ni), sizeof(db));
-						my->mc_toggle = toggle;
-						rc = mdb_env_cwalk(my, &db.md_root, ni->mn_flags & F_DUPDATA);
-						if (rc)
-							goto done;
-						toggle = my->mc_toggle;
-						memcpy(NODEDATA(ni), &db, sizeof(db));
+	/** Copy a subtree depth-first for a task.
+	 *	Pages are numbered from 0 in the order they are written
+	 *	to the task's buffer, which puts every page after its
+	 *	children. Overflow runs are not copied beyond their first
+	 *	page: the rest is written straight from the map later.
+	 * @param[in] my the copy in progress.
+	 * @param[in] ct the task being run.
+	 * @param[in] scratch per-level page buffers of the running thread.
+	 * @param[in] depth the level of recursion.
+	 * @param[in,out] pg the subtree's root, replaced by its new number.
+	 * @param[in] flags #F_DUPDATA for a sub-DB of duplicates.
+	 * @return 0 on success, non-zero on failure.
+	 */
+static int ESECT
+mdb_cp_subtree(mdb_copy *my, mdb_ctask *ct, char **scratch, unsigned depth,
+	pgno_t *pg, int flags)
+{
+	unsigned int psize = my->mc_env->me_psize, i, n;
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	MDB_db db;
+	pgno_t opg;
+	char *ptr;
+	int rc;
+
+	if (depth >= MDB_CP_DEPTH)
+		return MDB_CORRUPTED;
+	if (!scratch[depth] && !(scratch[depth] = malloc(psize)))
+		return ENOMEM;
+	rc = mdb_page_get(my->mc_txn, *pg, &omp, NULL);
+	if (rc)
+		return rc;
+	/* Copy the whole page, so the output doesn't depend on
+	 * which thread's buffers were used
+	 */
+	mp = (MDB_page *)scratch[depth];
+	memcpy(mp, omp, psize);
+
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			opg = NODEPGNO(ni);
+			rc = mdb_cp_subtree(my, ct, scratch, depth+1, &opg, flags);
+			if (rc)
+				return rc;
+			SETPGNO(ni, opg);
+		}
+	} else if (!IS_LEAF2(mp) && !(flags & F_DUPDATA)) {
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			if (ni->mn_flags & F_BIGDATA) {
+				memcpy(&opg, NODEDATA(ni), sizeof(opg));
+				rc = mdb_page_get(my->mc_txn, opg, &omp, NULL);
+				if (rc)
+					return rc;
+				if (!(ptr = mdb_cp_grow(ct, psize)))
+					return ENOMEM;
+				memcpy(ptr, omp, psize);
+				((MDB_page *)ptr)->mp_pgno = ct->ct_next;
+				if (omp->mp_pages > 1) {
+					mdb_ctail *tl;
+					if (ct->ct_ntails == ct->ct_maxtails) {
+						unsigned nt = ct->ct_maxtails ? ct->ct_maxtails * 2 : 16;
+						tl = realloc(ct->ct_tails, nt * sizeof(mdb_ctail));
+						if (!tl)
+							return ENOMEM;
+						ct->ct_tails = tl;
+						ct->ct_maxtails = nt;
 					}
+					tl = &ct->ct_tails[ct->ct_ntails++];
+					tl->tl_off = ct->ct_len;
+					tl->tl_ptr = (char *)omp + psize;
+				}
+				memcpy(NODEDATA(ni), &ct->ct_next, sizeof(pgno_t));
+				ct->ct_next += omp->mp_pages;
+			} else if (ni->mn_flags & F_SUBDATA) {
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				if (db.md_root != P_INVALID) {
+					rc = mdb_cp_subtree(my, ct, scratch, depth+1, &db.md_root,
+						ni->mn_flags & F_DUPDATA);
+					if (rc)
+						return rc;
+					memcpy(NODEDATA(ni), &db, sizeof(db));
 				}
 			}
-		} else {
-			mc.mc_ki[mc.mc_top]++;
-			if (mc.mc_ki[mc.mc_top] < n) {
-				pgno_t pg;
-again:
-				ni = NODEPTR(mp, mc.mc_ki[mc.mc_top]);
-				pg = NODEPGNO(ni);
-				rc = mdb_page_get(txn, pg, &mp, NULL);
-				if (rc)
-					goto done;
-				mc.mc_top++;
-				mc.mc_snum++;
-				mc.mc_ki[mc.mc_top] = 0;
-				if (IS_BRANCH(mp)) {
-					/* Whenever we advance to a sibling branch page,
-					 * we must proceed all the way down to its first leaf.
-					 */
-					mdb_page_copy(mc.mc_pg[mc.mc_top], mp, my->mc_env->me_psize);
-					goto again;
-				} else
-					mc.mc_pg[mc.mc_top] = mp;
-				continue;
+		}
+	}
+
+	if (!(ptr = mdb_cp_grow(ct, psize)))
+		return ENOMEM;
+	memcpy(ptr, mp, psize);
+	((MDB_page *)ptr)->mp_pgno = *pg = ct->ct_next++;
+	return MDB_SUCCESS;
+}
+
+	/** Take the next task whose output will be needed soon, run it,
+	 *	and repeat until there are none left.
+	 */
+static THREAD_RET ESECT CALL_CONV
+mdb_env_cpthr(void *arg)
+{
+	mdb_copy *my = arg;
+	char *scratch[MDB_CP_DEPTH] = {0};
+	mdb_ctask *ct;
+	pgno_t pg;
+	int i, rc;
+
+	pthread_mutex_lock(&my->mc_tmutex);
+	for (;;) {
+		while (!my->mc_tstop && my->mc_tnext < my->mc_ntasks &&
+			my->mc_tnext >= my->mc_tdone + my->mc_window)
+			pthread_cond_wait(&my->mc_tcond, &my->mc_tmutex);
+		if (my->mc_tstop || my->mc_tnext >= my->mc_ntasks)
+			break;
+		ct = &my->mc_tasks[my->mc_tnext++];
+		ct->ct_state = CT_RUNNING;
+		pthread_mutex_unlock(&my->mc_tmutex);
+		pg = ct->ct_pgno;
+		rc = mdb_cp_subtree(my, ct, scratch, 0, &pg, ct->ct_flags);
+		pthread_mutex_lock(&my->mc_tmutex);
+		ct->ct_rc = rc;
+		ct->ct_state = CT_DONE;
+		pthread_cond_signal(&my->mc_dcond);
+	}
+	/* Pass the wakeup on to the next idle thread */
+	pthread_cond_signal(&my->mc_tcond);
+	pthread_mutex_unlock(&my->mc_tmutex);
+	for (i=0; i<MDB_CP_DEPTH; i++)
+		free(scratch[i]);
+	return (THREAD_RET)0;
+}
+
+	/** Renumber a page copied by a task whose first page is \b base. */
+static void ESECT
+mdb_cp_reloc(MDB_page *mp, pgno_t base)
+{
+	MDB_node *ni;
+	MDB_db db;
+	pgno_t pg;
+	unsigned int i, n;
+
+	mp->mp_pgno += base;
+	if (IS_OVERFLOW(mp) || IS_LEAF2(mp))
+		return;
+	n = NUMKEYS(mp);
+	for (i=0; i<n; i++) {
+		ni = NODEPTR(mp, i);
+		if (IS_BRANCH(mp)) {
+			pg = NODEPGNO(ni) + base;
+			SETPGNO(ni, pg);
+		} else if (ni->mn_flags & F_BIGDATA) {
+			memcpy(&pg, NODEDATA(ni), sizeof(pg));
+			pg += base;
+			memcpy(NODEDATA(ni), &pg, sizeof(pg));
+		} else if (ni->mn_flags & F_SUBDATA) {
+			memcpy(&db, NODEDATA(ni), sizeof(db));
+			if (db.md_root != P_INVALID) {
+				db.md_root += base;
+				memcpy(NODEDATA(ni), &db, sizeof(db));
 			}
 		}
-		if (my->mc_wlen[toggle] >= MDB_WBUF) {
-			rc = mdb_env_cthr_toggle(my, 1);
+	}
+}
+
+	/** Write the output of a task, running it here if no thread has. */
+static int ESECT
+mdb_cp_task(mdb_copy *my, mdb_ctask *ct, char **scratch)
+{
+	MDB_env *env = my->mc_env;
+	unsigned int psize = env->me_psize, j = 0;
+	MDB_page *mo;
+	pgno_t pg, base = my->mc_next_pgno;
+	size_t off;
+	int rc;
+
+	pthread_mutex_lock(&my->mc_tmutex);
+	if (ct->ct_state == CT_QUEUED) {
+		/* Tasks are taken in order, so this must be the next one */
+		my->mc_tnext++;
+		ct->ct_state = CT_RUNNING;
+		pthread_mutex_unlock(&my->mc_tmutex);
+		pg = ct->ct_pgno;
+		rc = mdb_cp_subtree(my, ct, scratch, 0, &pg, ct->ct_flags);
+		pthread_mutex_lock(&my->mc_tmutex);
+		ct->ct_rc = rc;
+		ct->ct_state = CT_DONE;
+	}
+	while (ct->ct_state != CT_DONE)
+		pthread_cond_wait(&my->mc_dcond, &my->mc_tmutex);
+	pthread_mutex_unlock(&my->mc_tmutex);
+	if ((rc = ct->ct_rc))
+		return rc;
+
+	for (off = 0; off < ct->ct_len; off += psize) {
+		rc = mdb_cp_out(my, &mo);
+		if (rc)
+			return rc;
+		memcpy(mo, ct->ct_buf + off, psize);
+		mdb_cp_reloc(mo, base);
+		if (j < ct->ct_ntails && ct->ct_tails[j].tl_off == off + psize) {
+			rc = mdb_cp_ovtail(my, mo, ct->ct_tails[j++].tl_ptr);
 			if (rc)
-				goto done;
-			toggle = my->mc_toggle;
-		}
-		mo = (MDB_page *)(my->mc_wbuf[toggle] + my->mc_wlen[toggle]);
-		mdb_page_copy(mo, mp, my->mc_env->me_psize);
-		mo->mp_pgno = my->mc_next_pgno++;
-		my->mc_wlen[toggle] += my->mc_env->me_psize;
-		if (mc.mc_top) {
-			/* Update parent if there is one */
-			ni = NODEPTR(mc.mc_pg[mc.mc_top-1], mc.mc_ki[mc.mc_top-1]);
-			SETPGNO(ni, mo->mp_pgno);
-			mdb_cursor_pop(&mc);
-		} else {
-			/* Otherwise we're done */
-			*pg = mo->mp_pgno;
-			break;
+				return rc;
+		} else if (env->me_pgtail) {
+			mdb_page_settail(env, mo, NULL, PAGETAIL(env, mo), MDB_CP_TXNID);
 		}
 	}
-done:
-	free(buf);
+	my->mc_next_pgno += ct->ct_next;
+	rc = mdb_cp_push(my, my->mc_next_pgno - 1);
+
+	free(ct->ct_buf);
+	free(ct->ct_tails);
+	ct->ct_buf = NULL;
+	ct->ct_tails = NULL;
+
+	/* Let another task start */
+	pthread_mutex_lock(&my->mc_tmutex);
+	my->mc_tdone++;
+	pthread_cond_signal(&my->mc_tcond);
+	pthread_mutex_unlock(&my->mc_tmutex);
 	return rc;
 }
 
-	/** Copy environment with compaction. */
+	/** Write a page planned above the tasks, or an overflow run from
+	 *	the main DB. Its children have already been written, and their
+	 *	new page numbers are on top of the result stack.
+	 */
 static int ESECT
-mdb_env_copyfd1(MDB_env *env, HANDLE fd)
+mdb_cp_page(mdb_copy *my, mdb_citem *ci)
 {
-	MDB_meta *mm;
-	MDB_page *mp;
-	mdb_copy my;
-	MDB_txn *txn = NULL;
-	pthread_t thr;
+	unsigned int psize = my->mc_env->me_psize, i, n, k;
+	MDB_page *mp, *mo;
+	MDB_node *ni;
+	MDB_db db;
+	pgno_t *res;
 	int rc;
 
-#ifdef _WIN32
-	my.mc_mutex = CreateMutex(NULL, FALSE, NULL);
-	my.mc_cond = CreateEvent(NULL, FALSE, FALSE, NULL);
-	my.mc_wbuf[0] = _aligned_malloc(MDB_WBUF*2, env->me_os_psize);
+	rc = mdb_page_get(my->mc_txn, ci->ci_id, &mp, NULL);
+	if (rc)
+		return rc;
+	rc = mdb_cp_out(my, &mo);
+	if (rc)
+		return rc;
+
+	if (ci->ci_type == CI_OVER) {
+		memcpy(mo, mp, psize);
+		mo->mp_pgno = my->mc_next_pgno;
+		my->mc_next_pgno += mp->mp_pages;
+		rc = mdb_cp_ovtail(my, mo, (char *)mp + psize);
+		if (rc)
+			return rc;
+		return mdb_cp_push(my, mo->mp_pgno);
+	}
+
+	memcpy(mo, mp, psize);
+	n = NUMKEYS(mo);
+	if (IS_BRANCH(mo)) {
+		k = n;
+	} else {
+		for (i=k=0; i<n; i++) {
+			ni = NODEPTR(mo, i);
+			if (ni->mn_flags & F_BIGDATA)
+				k++;
+			else if (ni->mn_flags & F_SUBDATA) {
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				if (db.md_root != P_INVALID)
+					k++;
+			}
+		}
+	}
+	if (k > my->mc_nres)
+		return MDB_CORRUPTED;
+	res = my->mc_res + my->mc_nres - k;
+	my->mc_nres -= k;
+	for (i=0; i<n && k; i++) {
+		ni = NODEPTR(mo, i);
+		if (IS_BRANCH(mo)) {
+			SETPGNO(ni, *res);
+			res++;
+		} else if (ni->mn_flags & F_BIGDATA) {
+			memcpy(NODEDATA(ni), res++, sizeof(pgno_t));
+		} else if (ni->mn_flags & F_SUBDATA) {
+			memcpy(&db, NODEDATA(ni), sizeof(db));
+			if (db.md_root != P_INVALID) {
+				db.md_root = *res++;
+				memcpy(NODEDATA(ni), &db, sizeof(db));
+			}
+		}
+	}
+	mo->mp_pgno = my->mc_next_pgno++;
+	if (my->mc_env->me_pgtail)
+		mdb_page_settail(my->mc_env, mo, NULL, PAGETAIL(my->mc_env, mo),
+			MDB_CP_TXNID);
+	return mdb_cp_push(my, mo->mp_pgno);
+}
+
+	/** Number of threads to copy subtrees with, besides the caller. */
+static int ESECT
+mdb_cp_nthreads(void)
+{
+	long n;
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	n = si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	n = 1;
+#endif
+	n--;
+	if (n > MDB_CP_THREADS)
+		n = MDB_CP_THREADS;
+	return n > 0 ? n : 0;
+}
+
+	/** Copy the main DB and everything in it, in parallel.
+	 *	The plan lists tasks and pages in the order they are written,
+	 *	which depends only on the shape of the trees, so the copy is the
+	 *	same however many threads make it.
+	 */
+static int ESECT
+mdb_env_cpwalk(mdb_copy *my)
+{
+	MDB_db *db = &my->mc_txn->mt_dbs[MAIN_DBI];
+	pthread_t thr[MDB_CP_THREADS];
+	char *scratch[MDB_CP_DEPTH] = {0};
+	unsigned int i;
+	int nthr = 0, n, rc;
+
+	rc = mdb_cp_plan(my, db->md_root, 0, db->md_depth,
+		db->md_depth > MDB_CP_HEIGHT);
+	if (rc)
+		return rc;
+
+	n = my->mc_ntasks > 1 ? mdb_cp_nthreads() : 0;
+	my->mc_window = 2 * n + 2;
+	for (; nthr < n; nthr++) {
+		/* Copy with the threads we get. The caller does any task
+		 * no thread takes, so it can copy by itself if need be.
+		 */
+#ifdef _WIN32
+		THREAD_CREATE(thr[nthr], mdb_env_cpthr, my);
+		if (!thr[nthr])
+			break;
+#else
+		if (THREAD_CREATE(thr[nthr], mdb_env_cpthr, my) != 0)
+			break;
+#endif
+	}
+	if (nthr < n) {
+		pthread_mutex_lock(&my->mc_tmutex);
+		my->mc_window = 2 * nthr + 2;
+		pthread_mutex_unlock(&my->mc_tmutex);
+	}
+
+	for (i=0; i<my->mc_nitems && !rc; i++) {
+		mdb_citem *ci = &my->mc_items[i];
+		if (ci->ci_type == CI_TASK)
+			rc = mdb_cp_task(my, &my->mc_tasks[ci->ci_id], scratch);
+		else
+			rc = mdb_cp_page(my, ci);
+	}
+
+	pthread_mutex_lock(&my->mc_tmutex);
+	my->mc_tstop = 1;
+	pthread_cond_signal(&my->mc_tcond);
+	pthread_mutex_unlock(&my->mc_tmutex);
+	while (nthr)
+		THREAD_FINISH(thr[--nthr]);
+
+	for (i=0; i<my->mc_ntasks; i++) {
+		free(my->mc_tasks[i].ct_buf);
+		free(my->mc_tasks[i].ct_tails);
+	}
+	for (i=0; i<MDB_CP_DEPTH; i++)
+		free(scratch[i]);
+	return rc;
+}
+
+	/** Copy environment with compaction. */
+static int ESECT
+mdb_env_copyfd1(MDB_env *env, HANDLE fd)
+{
+	MDB_meta *mm;
+	MDB_page *mp;
+	mdb_copy my;
+	MDB_txn *txn = NULL;
+	pthread_t thr;
+	int rc;
+
+	memset(&my, 0, sizeof(my));
+#ifdef _WIN32
+	my.mc_mutex = CreateMutex(NULL, FALSE, NULL);
+	my.mc_cond = CreateEvent(NULL, FALSE, FALSE, NULL);
+	my.mc_tmutex = CreateMutex(NULL, FALSE, NULL);
+	my.mc_tcond = CreateEvent(NULL, FALSE, FALSE, NULL);
+	my.mc_dcond = CreateEvent(NULL, FALSE, FALSE, NULL);
+	my.mc_wbuf[0] = _aligned_malloc(MDB_WBUF*2, env->me_os_psize);
 	if (my.mc_wbuf[0] == NULL)
 		return errno;
 #else
 	pthread_mutex_init(&my.mc_mutex, NULL);
 	pthread_cond_init(&my.mc_cond, NULL);
+	pthread_mutex_init(&my.mc_tmutex, NULL);
+	pthread_cond_init(&my.mc_tcond, NULL);
+	pthread_cond_init(&my.mc_dcond, NULL);
 #ifdef HAVE_MEMALIGN
 	my.mc_wbuf[0] = memalign(env->me_os_psize, MDB_WBUF*2);
 	if (my.mc_wbuf[0] == NULL)
@@ -9135,7 +10003,7 @@ mdb_env_copyfd1(MDB_env *env, HANDLE fd)
 		mm->mm_dbs[MAIN_DBI] = txn->mt_dbs[MAIN_DBI];
 		if (mm->mm_last_pg > NUM_METAS-1) {
 			mm->mm_dbs[MAIN_DBI].md_root = mm->mm_last_pg;
-			mm->mm_txnid = 1;
+			mm->mm_txnid = MDB_CP_TXNID;
 		} else {
 			mm->mm_dbs[MAIN_DBI].md_root = P_INVALID;
 		}
@@ -9146,7 +10014,7 @@ mdb_env_copyfd1(MDB_env *env, HANDLE fd)
 	while(my.mc_new)
 		pthread_cond_wait(&my.mc_cond, &my.mc_mutex);
 	pthread_mutex_unlock(&my.mc_mutex);
-	rc = mdb_env_cwalk(&my, &txn->mt_dbs[MAIN_DBI].md_root, 0);
+	rc = mdb_env_cpwalk(&my);
 	if (rc == MDB_SUCCESS && my.mc_wlen[my.mc_toggle])
 		rc = mdb_env_cthr_toggle(&my, 1);
 	mdb_env_cthr_toggle(&my, -1);
@@ -9157,11 +10025,20 @@ mdb_env_copyfd1(MDB_env *env, HANDLE fd)
 	THREAD_FINISH(thr);
 
 	mdb_txn_abort(txn);
+	free(my.mc_items);
+	free(my.mc_tasks);
+	free(my.mc_res);
 #ifdef _WIN32
+	CloseHandle(my.mc_dcond);
+	CloseHandle(my.mc_tcond);
+	CloseHandle(my.mc_tmutex);
 	CloseHandle(my.mc_cond);
 	CloseHandle(my.mc_mutex);
 	_aligned_free(my.mc_wbuf[0]);
 #else
+	pthread_cond_destroy(&my.mc_dcond);
+	pthread_cond_destroy(&my.mc_tcond);
+	pthread_mutex_destroy(&my.mc_tmutex);
 	pthread_cond_destroy(&my.mc_cond);
 	pthread_mutex_destroy(&my.mc_mutex);
 	free(my.mc_wbuf[0]);
@@ -9357,6 +10234,838 @@ mdb_env_copy(MDB_env *env, const char *path)
 	return mdb_env_copy2(env, path, 0);
 }
 
+	/** Marks the first and last pages of an incremental copy. */
+#define MDB_INCR_MAGIC	 0xBEEFD1FF
+
+	/** The version number of the incremental copy format. */
+#define MDB_INCR_VERSION	 1
+
+	/** Contents of the first and last pages of an incremental copy.
+	 *	The pages in between are copied verbatim from the environment,
+	 *	each carrying its own page number. An overflow page is followed
+	 *	by the rest of its run.
+	 */
+typedef struct MDB_incrhdr {
+	uint32_t	mh_magic;		/**< #MDB_INCR_MAGIC */
+	uint32_t	mh_version;		/**< #MDB_INCR_VERSION */
+	txnid_t		mh_since;		/**< pages written after this txn are present */
+	MDB_ID		mh_npages;		/**< number of pages copied, 0 in the first page */
+	MDB_meta	mh_meta;		/**< meta page of the copied snapshot */
+} MDB_incrhdr;
+
+	/** State needed for an incremental copy. */
+typedef struct mdb_incr {
+	MDB_txn		*mi_txn;
+	HANDLE		mi_fd;
+	txnid_t		mi_since;
+	MDB_ID		mi_npages;
+	size_t		mi_wlen;
+	char		*mi_wbuf;
+} mdb_incr;
+
+	/** Write a buffer to the output of an incremental copy. */
+static int ESECT
+mdb_incr_write(HANDLE fd, const char *ptr, size_t wsize)
+{
+	int rc = MDB_SUCCESS;
+#ifdef _WIN32
+	DWORD len, w2;
+#define DO_WRITE(rc, fd, ptr, w2, len)	rc = WriteFile(fd, ptr, w2, &len, NULL)
+#else
+	ssize_t len;
+	size_t w2;
+#define DO_WRITE(rc, fd, ptr, w2, len)	len = write(fd, ptr, w2); rc = (len >= 0)
+#endif
+
+	while (wsize > 0) {
+		w2 = wsize > MAX_WRITE ? MAX_WRITE : wsize;
+		DO_WRITE(rc, fd, ptr, w2, len);
+		if (!rc) {
+			rc = ErrCode();
+			break;
+		} else if (len > 0) {
+			rc = MDB_SUCCESS;
+			ptr += len;
+			wsize -= len;
+		} else {
+			/* Non-blocking or async handles are not supported */
+			rc = EIO;
+			break;
+		}
+	}
+	return rc;
+#undef DO_WRITE
+}
+
+	/** Append a page, or a run of overflow pages, to an incremental copy. */
+static int ESECT
+mdb_incr_put(mdb_incr *my, MDB_page *mp)
+{
+	size_t size = my->mi_txn->mt_env->me_psize;
+	int rc;
+
+	if (IS_OVERFLOW(mp))
+		size *= mp->mp_pages;
+	if (my->mi_wlen + size > MDB_WBUF) {
+		rc = mdb_incr_write(my->mi_fd, my->mi_wbuf, my->mi_wlen);
+		if (rc)
+			return rc;
+		my->mi_wlen = 0;
+	}
+	if (size > MDB_WBUF) {
+		rc = mdb_incr_write(my->mi_fd, (char *)mp, size);
+		if (rc)
+			return rc;
+	} else {
+		memcpy(my->mi_wbuf + my->mi_wlen, mp, size);
+		my->mi_wlen += size;
+	}
+	my->mi_npages += IS_OVERFLOW(mp) ? mp->mp_pages : 1;
+	return MDB_SUCCESS;
+}
+
+	/** Copy the pages of a tree written after my->mi_since.
+	 *	Subtrees whose root is older are skipped entirely, so the
+	 *	work done is proportional to the number of changed pages.
+	 */
+static int ESECT
+mdb_incr_walk(mdb_incr *my, pgno_t pg)
+{
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	MDB_db db;
+	unsigned int i, n;
+	int rc;
+
+	if (pg == P_INVALID)
+		return MDB_SUCCESS;
+	rc = mdb_page_get(my->mi_txn, pg, &mp, NULL);
+	if (rc)
+		return rc;
+	if (PAGETAIL(my->mi_txn->mt_env, mp)->mpt_txnid <= my->mi_since)
+		return MDB_SUCCESS;
+	rc = mdb_incr_put(my, mp);
+	if (rc)
+		return rc;
+
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		for (i=0; i<n; i++) {
+			rc = mdb_incr_walk(my, NODEPGNO(NODEPTR(mp, i)));
+			if (rc)
+				return rc;
+		}
+	} else if (!IS_LEAF2(mp)) {
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			if (ni->mn_flags & F_BIGDATA) {
+				/* A leaf may be rewritten without its overflow pages */
+				memcpy(&pg, NODEDATA(ni), sizeof(pg));
+				rc = mdb_page_get(my->mi_txn, pg, &omp, NULL);
+				if (rc)
+					return rc;
+				if (PAGETAIL(my->mi_txn->mt_env, omp)->mpt_txnid > my->mi_since) {
+					rc = mdb_incr_put(my, omp);
+					if (rc)
+						return rc;
+				}
+			} else if (ni->mn_flags & F_SUBDATA) {
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				rc = mdb_incr_walk(my, db.md_root);
+				if (rc)
+					return rc;
+			}
+		}
+	}
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_incr_copyfd(MDB_env *env, HANDLE fd, size_t since, size_t *txnid)
+{
+	mdb_incr my;
+	MDB_txn *txn = NULL;
+	MDB_page *mp;
+	MDB_incrhdr *mh;
+	unsigned int psize = env->me_psize;
+	int rc;
+
+	/* Changed pages are found by the txn ID in their trailers */
+	if (!env->me_pgtail)
+		return MDB_INCOMPATIBLE;
+
+	my.mi_wbuf = calloc(1, MDB_WBUF);
+	if (my.mi_wbuf == NULL)
+		return ENOMEM;
+
+	rc = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+	if (rc)
+		goto leave;
+	if (since > txn->mt_txnid) {
+		rc = EINVAL;
+		goto leave;
+	}
+
+	mp = (MDB_page *)my.mi_wbuf;
+	mp->mp_pgno = P_INVALID;
+	mp->mp_flags = P_META;
+	mh = (MDB_incrhdr *)METADATA(mp);
+	mh->mh_magic = MDB_INCR_MAGIC;
+	mh->mh_version = MDB_INCR_VERSION;
+	mh->mh_since = since;
+	mdb_env_init_meta0(env, &mh->mh_meta);
+	mh->mh_meta.mm_address = env->me_metas[0]->mm_address;
+	mh->mh_meta.mm_dbs[FREE_DBI] = txn->mt_dbs[FREE_DBI];
+	mh->mh_meta.mm_dbs[MAIN_DBI] = txn->mt_dbs[MAIN_DBI];
+	mh->mh_meta.mm_last_pg = txn->mt_next_pgno - 1;
+	mh->mh_meta.mm_txnid = txn->mt_txnid;
+
+	my.mi_txn = txn;
+	my.mi_fd = fd;
+	my.mi_since = since;
+	my.mi_npages = 0;
+	my.mi_wlen = psize;
+
+	rc = mdb_incr_walk(&my, txn->mt_dbs[FREE_DBI].md_root);
+	if (rc == MDB_SUCCESS)
+		rc = mdb_incr_walk(&my, txn->mt_dbs[MAIN_DBI].md_root);
+	if (rc)
+		goto leave;
+
+	/* The last page repeats the first, with the page count, so
+	 * that a truncated copy can be detected before it is applied.
+	 */
+	if (my.mi_wlen + psize > MDB_WBUF) {
+		rc = mdb_incr_write(fd, my.mi_wbuf, my.mi_wlen);
+		if (rc)
+			goto leave;
+		my.mi_wlen = 0;
+	}
+	mp = (MDB_page *)(my.mi_wbuf + my.mi_wlen);
+	memset(mp, 0, psize);
+	mp->mp_pgno = P_INVALID;
+	mp->mp_flags = P_META;
+	mh = (MDB_incrhdr *)METADATA(mp);
+	mh->mh_magic = MDB_INCR_MAGIC;
+	mh->mh_version = MDB_INCR_VERSION;
+	mh->mh_since = since;
+	mh->mh_npages = my.mi_npages;
+	mh->mh_meta.mm_txnid = txn->mt_txnid;
+	my.mi_wlen += psize;
+	rc = mdb_incr_write(fd, my.mi_wbuf, my.mi_wlen);
+	if (rc == MDB_SUCCESS && txnid)
+		*txnid = txn->mt_txnid;
+
+leave:
+	mdb_txn_abort(txn);
+	free(my.mi_wbuf);
+	return rc;
+}
+
+int ESECT
+mdb_env_incr_copy(MDB_env *env, const char *path, size_t since, size_t *txnid)
+{
+	int rc;
+	HANDLE newfd;
+#ifdef _WIN32
+	wchar_t *wpath;
+#endif
+
+	/* Don't leave an empty file behind */
+	if (!env->me_pgtail)
+		return MDB_INCOMPATIBLE;
+#ifdef _WIN32
+	rc = utf8_to_utf16(path, -1, &wpath, NULL);
+	if (rc)
+		return rc;
+	newfd = CreateFileW(wpath, GENERIC_WRITE, 0, NULL, CREATE_NEW,
+				FILE_ATTRIBUTE_NORMAL, NULL);
+	free(wpath);
+#else
+	newfd = open(path, O_WRONLY|O_CREAT|O_EXCL, 0666);
+#endif
+	if (newfd == INVALID_HANDLE_VALUE)
+		return ErrCode();
+
+	rc = mdb_env_incr_copyfd(env, newfd, since, txnid);
+
+	if (close(newfd) < 0 && rc == MDB_SUCCESS)
+		rc = ErrCode();
+	return rc;
+}
+
+	/** Read or write part of a file at the given offset. */
+static int ESECT
+mdb_incr_pio(HANDLE fd, char *buf, size_t len, size_t off, int wr)
+{
+#ifdef _WIN32
+	OVERLAPPED ov;
+	DWORD n;
+
+	memset(&ov, 0, sizeof(ov));
+	ov.Offset = off & 0xffffffff;
+	ov.OffsetHigh = off >> 16 >> 16;
+	if (!(wr ? WriteFile(fd, buf, len, &n, &ov) : ReadFile(fd, buf, len, &n, &ov)))
+		return ErrCode();
+#else
+	ssize_t n;
+
+	do
+		n = wr ? pwrite(fd, buf, len, off) : pread(fd, buf, len, off);
+	while (n < 0 && ErrCode() == EINTR);
+	if (n < 0)
+		return ErrCode();
+#endif
+	if ((size_t)n != len)
+		return wr ? EIO : MDB_INVALID;
+	return MDB_SUCCESS;
+}
+
+	/** Read the first or last page of an incremental copy. */
+static int ESECT
+mdb_incr_header(HANDLE fd, size_t off, MDB_incrhdr *mh)
+{
+	struct {
+		char		mb_pad[PAGEHDRSZ];
+		MDB_incrhdr	mb_hdr;
+	} buf;
+	MDB_page *mp = (MDB_page *)&buf;
+	int rc;
+
+	rc = mdb_incr_pio(fd, (char *)&buf, sizeof(buf), off, 0);
+	if (rc)
+		return rc;
+	if (mp->mp_pgno != P_INVALID || !F_ISSET(mp->mp_flags, P_META) ||
+		buf.mb_hdr.mh_magic != MDB_INCR_MAGIC)
+		return MDB_INVALID;
+	if (buf.mb_hdr.mh_version != MDB_INCR_VERSION)
+		return MDB_VERSION_MISMATCH;
+	*mh = buf.mb_hdr;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_incr_apply(MDB_env *env, const char *path)
+{
+	MDB_txn *txn = NULL;
+	MDB_incrhdr hdr, tlr;
+	MDB_meta meta;
+	MDB_page *mp;
+	HANDLE fd;
+	size_t fsize = 0, off, end, pos, size, len;
+	unsigned int psize = env->me_psize;
+	pgno_t pgno, n;
+	char *buf = NULL;
+	int i, rc;
+#ifdef _WIN32
+	wchar_t *wpath;
+#endif
+
+	if (env->me_flags & MDB_RDONLY)
+		return EACCES;
+
+#ifdef _WIN32
+	rc = utf8_to_utf16(path, -1, &wpath, NULL);
+	if (rc)
+		return rc;
+	fd = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, NULL);
+	free(wpath);
+#else
+	fd = open(path, O_RDONLY);
+#endif
+	if (fd == INVALID_HANDLE_VALUE)
+		return ErrCode();
+
+	/* Check the whole copy is present before touching the environment */
+	if ((rc = mdb_fsize(fd, &fsize)))
+		goto leave;
+	if ((rc = mdb_incr_header(fd, 0, &hdr)))
+		goto leave;
+	if (hdr.mh_meta.mm_psize != psize) {
+		rc = MDB_INCOMPATIBLE;
+		goto leave;
+	}
+	if (fsize % psize || fsize < 2 * psize) {
+		rc = MDB_INVALID;
+		goto leave;
+	}
+	end = fsize - psize;
+	if ((rc = mdb_incr_header(fd, end, &tlr)))
+		goto leave;
+	if (tlr.mh_since != hdr.mh_since ||
+		tlr.mh_meta.mm_txnid != hdr.mh_meta.mm_txnid ||
+		tlr.mh_npages != end / psize - 1) {
+		rc = MDB_INVALID;
+		goto leave;
+	}
+
+	buf = malloc(MDB_WBUF);
+	if (buf == NULL) {
+		rc = ENOMEM;
+		goto leave;
+	}
+
+	/* Keep writers out while the pages are replaced */
+	rc = mdb_txn_begin(env, NULL, 0, &txn);
+	if (rc)
+		goto leave;
+
+	/* The copy has every page written after mh_since that is still
+	 * in use at its own txn, so it may be applied to any snapshot
+	 * in between.
+	 */
+	if ((rc = mdb_env_read_header(env, &meta)))
+		goto leave;
+	if (hdr.mh_since > meta.mm_txnid ||
+		meta.mm_txnid > hdr.mh_meta.mm_txnid ||
+		((hdr.mh_meta.mm_flags ^ meta.mm_flags) & (MDB_PAGECRC|MDB_PAGETXN))) {
+		rc = MDB_INCOMPATIBLE;
+		goto leave;
+	}
+
+	for (off = psize; off < end; ) {
+		if ((rc = mdb_incr_pio(fd, buf, psize, off, 0)))
+			goto leave;
+		mp = (MDB_page *)buf;
+		pgno = mp->mp_pgno;
+		n = IS_OVERFLOW(mp) ? mp->mp_pages : 1;
+		size = n * psize;
+		if (pgno < NUM_METAS || pgno + n > hdr.mh_meta.mm_last_pg + 1 ||
+			size > end - off) {
+			rc = MDB_INVALID;
+			goto leave;
+		}
+		for (pos = pgno * psize; size; size -= len) {
+			len = size > MDB_WBUF ? MDB_WBUF : size;
+			if ((rc = mdb_incr_pio(fd, buf, len, off, 0)) ||
+				(rc = mdb_incr_pio(env->me_fd, buf, len, pos, 1)))
+				goto leave;
+			off += len;
+			pos += len;
+		}
+	}
+	if (MDB_FDATASYNC(env->me_fd)) {
+		rc = ErrCode();
+		goto leave;
+	}
+
+	/* Only now point the environment at the new pages */
+	if (meta.mm_mapsize > hdr.mh_meta.mm_mapsize)
+		hdr.mh_meta.mm_mapsize = meta.mm_mapsize;
+	hdr.mh_meta.mm_address = meta.mm_address;
+	memset(buf, 0, psize);
+	mp = (MDB_page *)buf;
+	mp->mp_flags = P_META;
+	*(MDB_meta *)METADATA(mp) = hdr.mh_meta;
+	for (i=0; i<NUM_METAS; i++) {
+		mp->mp_pgno = i;
+		if ((rc = mdb_incr_pio(env->me_fd, buf, psize, i * psize, 1)))
+			goto leave;
+	}
+	if (MDB_FDATASYNC(env->me_fd)) {
+		rc = ErrCode();
+		goto leave;
+	}
+	if (env->me_txns)
+		env->me_txns->mti_txnid = hdr.mh_meta.mm_txnid;
+
+leave:
+	if (txn)
+		mdb_txn_abort(txn);
+	free(buf);
+	close(fd);
+	return rc;
+}
+
+	/** Pages a pass checks between releases of its snapshot, when
+	 *	it isn't limited to a rate.
+	 */
+#define MDB_SCRUB_CHUNK	1024
+
+	/** Depth of a position in the walk of #mdb_env_scrub(): the choice
+	 *	of tree, then a branch or leaf node index per page, through the
+	 *	main DB, a named DB and a sorted-duplicate DB.
+	 */
+#define MDB_SCRUB_DEPTH	(1 + 3 * CURSOR_STACK)
+
+	/** #mdb_scrub_page() result: the pass must release its snapshot
+	 *	before the page is checked.
+	 */
+#define MDB_SCRUB_PAUSE	(-1)
+
+	/** State of a pass of #mdb_env_scrub(). */
+typedef struct mdb_scrub {
+	MDB_txn		*sc_txn;
+	MDB_scrubstat	*sc_st;		/**< where progress is reported */
+	unsigned int	sc_chunk;	/**< pages to check between pauses */
+	unsigned int	sc_pause;	/**< milliseconds to pause for, or 0 */
+	unsigned int	sc_count;	/**< pages checked since the last pause */
+	int			sc_bg;		/**< running in #mdb_env_scrubthr() */
+	size_t		sc_checked;	/**< pages checked in this pass */
+	size_t		sc_errors;	/**< mismatches found in this pass */
+	/** While the walk resumes after a pause, the number of entries
+	 *	of #sc_path that lead to the next page to check, otherwise 0.
+	 */
+	int			sc_depth;
+	indx_t		sc_path[MDB_SCRUB_DEPTH];	/**< position in the walk */
+} mdb_scrub;
+
+	/** Wait for \b msec milliseconds, or less if #mdb_env_scrub_stop()
+	 *	is called meanwhile.
+	 * @param[in] env the environment being scrubbed.
+	 * @param[in] msec the time to wait.
+	 * @param[in] bg whether the caller is the scrubbing thread.
+	 * @return nonzero if the scrubbing thread must stop.
+	 */
+static int ESECT
+mdb_scrub_wait(MDB_env *env, unsigned long msec, int bg)
+{
+#ifdef _WIN32
+	if (!bg) {
+		Sleep(msec);
+		return 0;
+	}
+	WaitForSingleObject(env->me_scrubcond, msec);
+	return env->me_scrubstop;
+#else
+	struct timeval now;
+	struct timespec ts;
+	int stop;
+
+	if (!bg) {
+		ts.tv_sec = msec / 1000;
+		ts.tv_nsec = (msec % 1000) * 1000000;
+		while (nanosleep(&ts, &ts) && errno == EINTR) ;
+		return 0;
+	}
+	gettimeofday(&now, NULL);
+	ts.tv_sec = now.tv_sec + msec / 1000;
+	ts.tv_nsec = now.tv_usec * 1000 + (msec % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	pthread_mutex_lock(&env->me_scrubmutex);
+	while (!env->me_scrubstop &&
+		pthread_cond_timedwait(&env->me_scrubcond, &env->me_scrubmutex, &ts) != ETIMEDOUT) ;
+	stop = env->me_scrubstop;
+	pthread_mutex_unlock(&env->me_scrubmutex);
+	return stop;
+#endif
+}
+
+	/** Verify one page, or one overflow run, for #mdb_env_scrub().
+	 * @param[in] sc the pass in progress.
+	 * @param[in] pgno the page to check.
+	 * @param[out] ret the page, if it is intact.
+	 * @return 0 on success, #MDB_CORRUPTED if the page is damaged,
+	 *	#MDB_SCRUB_PAUSE if the pass must pause first, or EINTR if
+	 *	the scrubbing thread must stop.
+	 */
+static int ESECT
+mdb_scrub_page(mdb_scrub *sc, pgno_t pgno, MDB_page **ret)
+{
+	MDB_txn *txn = sc->sc_txn;
+	MDB_env *env = txn->mt_env;
+	MDB_page *mp;
+	unsigned int n = 1;
+
+	if (sc->sc_bg && env->me_scrubstop)
+		return EINTR;
+	if (sc->sc_count >= sc->sc_chunk)
+		return MDB_SCRUB_PAUSE;
+
+	mp = NULL;
+	if (pgno >= NUM_METAS && pgno < txn->mt_next_pgno)
+		mp = (MDB_page *)(env->me_map + (size_t)env->me_psize * pgno);
+	if (!mp || mdb_page_verify(env, mp, pgno, txn->mt_next_pgno)) {
+		DPRINTF(("page %"Z"u checksum mismatch", pgno));
+		sc->sc_st->ms_errors++;
+		sc->sc_st->ms_badpage = pgno;
+		sc->sc_errors++;
+		mp = NULL;
+	} else {
+		if (IS_OVERFLOW(mp))
+			n = mp->mp_pages;
+		sc->sc_checked += n;
+	}
+	sc->sc_count += n;
+	*ret = mp;
+	return mp ? MDB_SUCCESS : MDB_CORRUPTED;
+}
+
+	/** Verify every page of a tree for #mdb_env_scrub().
+	 *	The children of a damaged branch page can't be found, so
+	 *	they are skipped until the page is repaired.
+	 *
+	 *	The index of the node being followed is kept in \b sc_path
+	 *	at \b depth, so that after a pause the walk can find its way
+	 *	back down the tree from the root of the new snapshot. Pages
+	 *	on that way were checked before the pause and aren't counted
+	 *	again. If the tree has changed meanwhile, the way may lead
+	 *	elsewhere, and some pages are then checked twice or not at
+	 *	all in this pass; pages written since the pass began were
+	 *	given fresh checksums anyway.
+	 */
+static int ESECT
+mdb_scrub_walk(mdb_scrub *sc, pgno_t pg, int depth)
+{
+	MDB_txn *txn = sc->sc_txn;
+	MDB_env *env = txn->mt_env;
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	MDB_db db;
+	unsigned int i, n;
+	int rc;
+
+	if (pg == P_INVALID || depth >= MDB_SCRUB_DEPTH) {
+		sc->sc_depth = 0;
+		return MDB_SUCCESS;
+	}
+	if (depth < sc->sc_depth) {
+		/* On the way back to where the pass paused */
+		mp = NULL;
+		if (pg >= NUM_METAS && pg < txn->mt_next_pgno)
+			mp = (MDB_page *)(env->me_map + (size_t)env->me_psize * pg);
+		i = sc->sc_path[depth];
+		if (!mp || mdb_page_verify(env, mp, pg, txn->mt_next_pgno) ||
+			IS_LEAF2(mp) || i >= NUMKEYS(mp)) {
+			sc->sc_depth = 0;
+			return MDB_SUCCESS;
+		}
+	} else {
+		sc->sc_depth = 0;
+		rc = mdb_scrub_page(sc, pg, &mp);
+		if (rc == MDB_SCRUB_PAUSE)
+			sc->sc_depth = depth;
+		if (rc)
+			return rc == MDB_CORRUPTED ? MDB_SUCCESS : rc;
+		i = 0;
+	}
+
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		for (; i<n; i++) {
+			sc->sc_path[depth] = i;
+			rc = mdb_scrub_walk(sc, NODEPGNO(NODEPTR(mp, i)), depth + 1);
+			if (rc)
+				return rc;
+		}
+	} else if (!IS_LEAF2(mp)) {
+		for (; i<n; i++) {
+			sc->sc_path[depth] = i;
+			ni = NODEPTR(mp, i);
+			rc = MDB_SUCCESS;
+			if (ni->mn_flags & F_BIGDATA) {
+				memcpy(&pg, NODEDATA(ni), sizeof(pg));
+				sc->sc_depth = 0;
+				rc = mdb_scrub_page(sc, pg, &omp);
+				if (rc == MDB_SCRUB_PAUSE)
+					sc->sc_depth = depth + 1;
+			} else if (ni->mn_flags & F_SUBDATA) {
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				rc = mdb_scrub_walk(sc, db.md_root, depth + 1);
+			} else {
+				sc->sc_depth = 0;
+			}
+			if (rc && rc != MDB_CORRUPTED)
+				return rc;
+		}
+	}
+	return MDB_SUCCESS;
+}
+
+	/** Make a pass of #mdb_env_scrub().
+	 *	The snapshot is released every \b sc_chunk pages, and not
+	 *	taken again until the pause that keeps to \b rate is over,
+	 *	so that the pass never keeps writers from reusing pages for
+	 *	long.
+	 * @param[in] env the environment to scrub.
+	 * @param[in] rate the maximum number of pages to check per second, or 0.
+	 * @param[in] bg whether the caller is the scrubbing thread.
+	 * @return 0 on success, non-zero on failure.
+	 */
+static int ESECT
+mdb_env_scrub0(MDB_env *env, unsigned int rate, int bg)
+{
+	mdb_scrub sc;
+	MDB_scrubstat *st = MDB_SCRUBST(env);
+	MDB_cursor mc;
+	MDB_val key, data;
+	MDB_ID freecount = 0;
+	int i, rc;
+
+	if (!(env->me_flags & MDB_PAGECRC))
+		return MDB_INCOMPATIBLE;
+
+	memset(&sc, 0, sizeof(sc));
+	sc.sc_st = st;
+	sc.sc_bg = bg;
+	if (rate) {
+		/* Pause ten times a second, or after each page if slower */
+		sc.sc_chunk = (rate + 9) / 10;
+		sc.sc_pause = sc.sc_chunk * 1000 / rate;
+	} else {
+		sc.sc_chunk = MDB_SCRUB_CHUNK;
+	}
+
+	rc = mdb_txn_begin(env, NULL, MDB_RDONLY, &sc.sc_txn);
+	if (rc)
+		return rc;
+
+	/* Count the pages in use, to show how far along the pass is */
+	mdb_cursor_init(&mc, sc.sc_txn, FREE_DBI, NULL);
+	while ((rc = mdb_cursor_get(&mc, &key, &data, MDB_NEXT)) == 0)
+		freecount += *(MDB_ID *)data.mv_data;
+	if (rc != MDB_NOTFOUND)
+		freecount = 0;
+	st->ms_pages = sc.sc_txn->mt_next_pgno - NUM_METAS - freecount;
+	st->ms_checked = 0;
+
+	for (;;) {
+		/* sc_path[0] is the tree: FREE_DBI, then MAIN_DBI */
+		for (i = sc.sc_depth ? sc.sc_path[0] : FREE_DBI; i <= MAIN_DBI; i++) {
+			sc.sc_path[0] = i;
+			rc = mdb_scrub_walk(&sc, sc.sc_txn->mt_dbs[i].md_root, 1);
+			if (rc)
+				break;
+		}
+		st->ms_checked = sc.sc_checked;
+		if (rc != MDB_SCRUB_PAUSE)
+			break;
+		mdb_txn_reset(sc.sc_txn);
+		if (sc.sc_pause &&
+			mdb_scrub_wait(env, (unsigned long)sc.sc_pause *
+				(sc.sc_count / sc.sc_chunk), bg)) {
+			rc = EINTR;
+			break;
+		}
+		sc.sc_count %= sc.sc_chunk;
+		rc = mdb_txn_renew(sc.sc_txn);
+		if (rc)
+			break;
+	}
+	mdb_txn_abort(sc.sc_txn);
+	if (!rc) {
+		st->ms_passes++;
+		if (sc.sc_errors)
+			rc = MDB_CORRUPTED;
+	}
+	return rc;
+}
+
+int ESECT
+mdb_env_scrub(MDB_env *env, unsigned int rate)
+{
+	if (!env || !env->me_map)
+		return EINVAL;
+	return mdb_env_scrub0(env, rate, 0);
+}
+
+	/** Thread started by #mdb_env_scrub_start(). */
+static THREAD_RET ESECT CALL_CONV
+mdb_env_scrubthr(void *arg)
+{
+	MDB_env *env = arg;
+	int rc;
+
+	/* Stay out of the way of everything else */
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(SCHED_IDLE)
+	{
+		struct sched_param sp;
+		memset(&sp, 0, sizeof(sp));
+		pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+	}
+#endif
+	do {
+		rc = mdb_env_scrub0(env, env->me_scrubrate, 1);
+	} while (rc != EINTR && env->me_scrubival &&
+		!mdb_scrub_wait(env, env->me_scrubival * 1000UL, 1));
+	return (THREAD_RET)0;
+}
+
+int ESECT
+mdb_env_scrub_start(MDB_env *env, unsigned int rate, unsigned int interval)
+{
+	int rc;
+
+	if (!env || !env->me_map)
+		return EINVAL;
+	if (!(env->me_flags & MDB_PAGECRC))
+		return MDB_INCOMPATIBLE;
+	if (env->me_scrubbing)
+		mdb_env_scrub_stop(env);
+
+	env->me_scrubrate = rate;
+	env->me_scrubival = interval;
+	env->me_scrubstop = 0;
+#ifdef _WIN32
+	env->me_scrubcond = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!env->me_scrubcond)
+		return ErrCode();
+	THREAD_CREATE(env->me_scrubthr, mdb_env_scrubthr, env);
+	if (!env->me_scrubthr) {
+		rc = ErrCode();
+		CloseHandle(env->me_scrubcond);
+		return rc;
+	}
+#else
+	if ((rc = pthread_mutex_init(&env->me_scrubmutex, NULL)) != 0)
+		return rc;
+	if ((rc = pthread_cond_init(&env->me_scrubcond, NULL)) != 0) {
+		pthread_mutex_destroy(&env->me_scrubmutex);
+		return rc;
+	}
+	if ((rc = THREAD_CREATE(env->me_scrubthr, mdb_env_scrubthr, env)) != 0) {
+		pthread_cond_destroy(&env->me_scrubcond);
+		pthread_mutex_destroy(&env->me_scrubmutex);
+		return rc;
+	}
+#endif
+	env->me_scrubbing = 1;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_scrub_stop(MDB_env *env)
+{
+	if (!env)
+		return EINVAL;
+	if (!env->me_scrubbing)
+		return MDB_SUCCESS;
+
+#ifdef _WIN32
+	env->me_scrubstop = 1;
+	SetEvent(env->me_scrubcond);
+	THREAD_FINISH(env->me_scrubthr);
+	CloseHandle(env->me_scrubthr);
+	CloseHandle(env->me_scrubcond);
+#else
+	pthread_mutex_lock(&env->me_scrubmutex);
+	env->me_scrubstop = 1;
+	pthread_cond_signal(&env->me_scrubcond);
+	pthread_mutex_unlock(&env->me_scrubmutex);
+	THREAD_FINISH(env->me_scrubthr);
+	pthread_cond_destroy(&env->me_scrubcond);
+	pthread_mutex_destroy(&env->me_scrubmutex);
+#endif
+	env->me_scrubbing = 0;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_scrub_stat(MDB_env *env, MDB_scrubstat *arg)
+{
+	if (!env || !arg)
+		return EINVAL;
+
+	*arg = *MDB_SCRUBST(env);
+	return MDB_SUCCESS;
+}
+
 int ESECT
 mdb_env_set_flags(MDB_env *env, unsigned int flag, int onoff)
 {
@@ -22,6 +22,12 @@
 #include <signal.h>
 #include "lmdb.h"
 
+#ifdef	_WIN32
+#define	Z	"I"
+#else
+#define	Z	"z"
+#endif
+
 static void
 sighandle(int sig)
 {
@@ -34,12 +40,25 @@ int main(int argc,char * argv[])
 	const char *progname = argv[0], *act;
 	unsigned flags = MDB_RDONLY;
 	unsigned cpflags = 0;
+	size_t since = 0, txnid = 0;
+	int incr = 0;
+	char *ptr;
 
 	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
 		if (argv[1][1] == 'n' && argv[1][2] == '\0')
 			flags |= MDB_NOSUBDIR;
 		else if (argv[1][1] == 'c' && argv[1][2] == '\0')
 			cpflags |= MDB_CP_COMPACT;
+		else if (argv[1][1] == 'i' && argv[1][2] == '\0' && argc > 2) {
+			since = strtoul(argv[2], &ptr, 10);
+			if (*ptr != '\0' || ptr == argv[2]) {
+				argc = 0;
+				break;
+			}
+			incr = 1;
+			argc--;
+			argv++;
+		}
 		else if (argv[1][1] == 'V' && argv[1][2] == '\0') {
 			printf("%s\n", MDB_VERSION_STRING);
 			exit(0);
@@ -47,8 +66,8 @@ int main(int argc,char * argv[])
 			argc = 0;
 	}
 
-	if (argc<2 || argc>3) {
-		fprintf(stderr, "usage: %s [-V] [-c] [-n] srcpath [dstpath]\n", progname);
+	if (argc<2 || argc>3 || (incr && cpflags)) {
+		fprintf(stderr, "usage: %s [-V] [-c | -i txnid] [-n] srcpath [dstpath]\n", progname);
 		exit(EXIT_FAILURE);
 	}
 
@@ -68,7 +87,15 @@ int main(int argc,char * argv[])
 	}
 	if (rc == MDB_SUCCESS) {
 		act = "copying";
-		if (argc == 2)
+		if (incr) {
+			if (argc == 2)
+				rc = mdb_env_incr_copyfd(env, MDB_STDOUT, since, &txnid);
+			else
+				rc = mdb_env_incr_copy(env, argv[2], since, &txnid);
+			if (rc == MDB_SUCCESS)
+				fprintf(stderr, "%s: copied changes up to transaction %"Z"u\n",
+					progname, txnid);
+		} else if (argc == 2)
 			rc = mdb_env_copyfd2(env, MDB_STDOUT, cpflags);
 		else
 			rc = mdb_env_copy2(env, argv[2], cpflags);
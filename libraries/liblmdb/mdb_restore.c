@@ -0,0 +1,60 @@
+/* mdb_restore.c - memory-mapped database incremental restore tool */
+/*
+ * Copyright 2012-2016 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "lmdb.h"
+
+int main(int argc,char * argv[])
+{
+	int i, rc = MDB_SUCCESS;
+	MDB_env *env;
+	const char *progname = argv[0], *act;
+	unsigned flags = 0;
+
+	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+		if (argv[1][1] == 'n' && argv[1][2] == '\0')
+			flags |= MDB_NOSUBDIR;
+		else if (argv[1][1] == 'V' && argv[1][2] == '\0') {
+			printf("%s\n", MDB_VERSION_STRING);
+			exit(0);
+		} else
+			argc = 0;
+	}
+
+	if (argc<3) {
+		fprintf(stderr, "usage: %s [-V] [-n] dstpath incrfile...\n", progname);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Reopen the environment for each copy, since applying one
+	 * may grow the environment beyond its current map.
+	 */
+	for (i = 2; i < argc && rc == MDB_SUCCESS; i++) {
+		act = "opening environment";
+		rc = mdb_env_create(&env);
+		if (rc == MDB_SUCCESS) {
+			rc = mdb_env_open(env, argv[1], flags, 0664);
+		}
+		if (rc == MDB_SUCCESS) {
+			act = "applying";
+			rc = mdb_env_incr_apply(env, argv[i]);
+		}
+		if (rc)
+			fprintf(stderr, "%s: %s %s failed, error %d (%s)\n",
+				progname, act, argv[i], rc, mdb_strerror(rc));
+		mdb_env_close(env);
+	}
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -23,6 +23,12 @@
 #define	Z	"z"
 #endif
 
+static int pgcmp(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a, y = *(const size_t *)b;
+	return x < y ? -1 : x > y;
+}
+
 static void prstat(MDB_stat *ms)
 {
 #if 0
@@ -52,6 +58,7 @@ int main(int argc, char *argv[])
 	char *prog = argv[0];
 	char *envname;
 	char *subname = NULL;
+	unsigned int flags;
 	int alldbs = 0, envinfo = 0, envflags = 0, freinfo = 0, rdrinfo = 0;
 
 	if (argc < 2) {
@@ -132,6 +139,18 @@ int main(int argc, char *argv[])
 		printf("  Last transaction ID: %"Z"u\n", mei.me_last_txnid);
 		printf("  Max readers: %u\n", mei.me_maxreaders);
 		printf("  Number of readers used: %u\n", mei.me_numreaders);
+		(void)mdb_env_get_flags(env, &flags);
+		if (flags & MDB_PAGECRC) {
+			MDB_scrubstat mss;
+			(void)mdb_env_scrub_stat(env, &mss);
+			printf("  Page checksums: enabled\n");
+			printf("  Scrub passes completed: %"Z"u\n", mss.ms_passes);
+			printf("  Scrub progress: %"Z"u/%"Z"u pages\n",
+				mss.ms_checked, mss.ms_pages);
+			printf("  Checksum errors: %"Z"u\n", mss.ms_errors);
+			if (mss.ms_errors)
+				printf("  Last bad page: %"Z"u\n", mss.ms_badpage);
+		}
 	}
 
 	if (rdrinfo) {
@@ -156,7 +175,8 @@ int main(int argc, char *argv[])
 	if (freinfo) {
 		MDB_cursor *cursor;
 		MDB_val key, data;
-		size_t pages = 0, *iptr;
+		size_t pages = 0, *iptr, *all = NULL, nall = 0;
+		size_t runs = 0, maxrun = 0;
 
 		printf("Freelist Status\n");
 		dbi = 0;
@@ -174,6 +194,17 @@ int main(int argc, char *argv[])
 		while ((rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
 			iptr = data.mv_data;
 			pages += *iptr;
+			if (*iptr) {
+				size_t *ptr = realloc(all, (nall + *iptr) * sizeof(size_t));
+				if (!ptr) {
+					fprintf(stderr, "realloc failed\n");
+					free(all);
+					goto txn_abort;
+				}
+				all = ptr;
+				memcpy(all + nall, iptr + 1, *iptr * sizeof(size_t));
+				nall += *iptr;
+			}
 			if (freinfo > 1) {
 				char *bad = "";
 				size_t pg, prev;
@@ -201,6 +232,20 @@ int main(int argc, char *argv[])
 		}
 		mdb_cursor_close(cursor);
 		printf("  Free pages: %"Z"u\n", pages);
+		/* Fragmentation: how many contiguous runs the free pages form */
+		if (nall) {
+			size_t i, span;
+			qsort(all, nall, sizeof(size_t), pgcmp);
+			for (i = 0; i < nall; i += span) {
+				for (span = 1; i + span < nall && all[i+span] == all[i] + span; span++) ;
+				runs++;
+				if (span > maxrun)
+					maxrun = span;
+			}
+		}
+		free(all);
+		printf("  Free page runs: %"Z"u\n", runs);
+		printf("  Largest free run: %"Z"u\n", maxrun);
 	}
 
 	rc = mdb_open(txn, subname, 0, &dbi);
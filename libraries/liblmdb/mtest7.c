@@ -0,0 +1,249 @@
+/* mtest7.c - memory-mapped database tester/toy */
+/*
+ * Copyright 2011-2016 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Tests for page checksums: scrubbing, verification on read, and
+ * compacting copies of an environment created with MDB_PAGECRC.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define RES(err, expr) ((rc = expr) == (err) || (CHECK(!rc, #expr), 0))
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+#define DBPATH	"./testdb"
+#define COPY	"./testdb/copy.mdb"
+#define NKEYS	1000
+#define NDUPS	200
+
+	/* Values of several sizes, so that there are overflow runs of
+	 * one page and of several pages as well as plain nodes.
+	 */
+static size_t vsize(int i, unsigned int psize)
+{
+	if (i % 50 == 0)
+		return psize * 3;
+	if (i % 50 == 25)
+		return psize - 1000;
+	return 100;
+}
+
+static void fill(MDB_env *env, unsigned int psize, char *buf)
+{
+	int i, j, rc;
+	MDB_dbi dbi, dbd;
+	MDB_val key, data;
+	MDB_txn *txn;
+	char kval[16];
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	E(mdb_dbi_open(txn, "dups", MDB_CREATE|MDB_DUPSORT, &dbd));
+	key.mv_data = kval;
+	for (i=0; i<NKEYS; i++) {
+		key.mv_size = sprintf(kval, "%08d", i);
+		memset(buf, 'a' + i % 26, vsize(i, psize));
+		data.mv_size = vsize(i, psize);
+		data.mv_data = buf;
+		E(mdb_put(txn, dbi, &key, &data, 0));
+	}
+	for (i=0; i<4; i++) {
+		key.mv_size = sprintf(kval, "dup%d", i);
+		for (j=0; j<NDUPS; j++) {
+			data.mv_size = sprintf(buf, "%05d", j);
+			data.mv_data = buf;
+			E(mdb_put(txn, dbd, &key, &data, 0));
+		}
+	}
+	E(mdb_txn_commit(txn));
+}
+
+	/* Read back what fill() stored. The values are only compared
+	 * when \b cmp is set, since damaging the checksum at the end of
+	 * a page damages the data of an overflow run that goes past it.
+	 */
+static int check(MDB_env *env, unsigned int psize, char *buf, int cmp)
+{
+	int i, rc;
+	MDB_dbi dbi, dbd;
+	MDB_val key, data;
+	MDB_txn *txn;
+	MDB_cursor *cursor;
+	size_t count;
+	char kval[16];
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	key.mv_data = kval;
+	for (i=0; i<NKEYS; i++) {
+		key.mv_size = sprintf(kval, "%08d", i);
+		if ((rc = mdb_get(txn, dbi, &key, &data)) != MDB_SUCCESS) {
+			mdb_txn_abort(txn);
+			return rc;
+		}
+		if (!cmp)
+			continue;
+		memset(buf, 'a' + i % 26, vsize(i, psize));
+		CHECK(data.mv_size == vsize(i, psize) &&
+			!memcmp(data.mv_data, buf, data.mv_size), "value");
+	}
+	E(mdb_dbi_open(txn, "dups", MDB_DUPSORT, &dbd));
+	E(mdb_cursor_open(txn, dbd, &cursor));
+	key.mv_size = sprintf(kval, "dup3");
+	E(mdb_cursor_get(cursor, &key, &data, MDB_SET));
+	E(mdb_cursor_count(cursor, &count));
+	CHECK(count == NDUPS, "dup count");
+	mdb_cursor_close(cursor);
+	mdb_txn_abort(txn);
+	return MDB_SUCCESS;
+}
+
+	/* Count the readers that hold a snapshot, from mdb_reader_list() */
+static int held(const char *msg, void *ctx)
+{
+	size_t len = strlen(msg);
+
+	if (len > 2 && msg[len - 2] >= '0' && msg[len - 2] <= '9')
+		++*(int *)ctx;
+	return 0;
+}
+
+int main(int argc,char * argv[])
+{
+	int i, rc, fd, nheld;
+	size_t checked;
+	MDB_env *env;
+	MDB_envinfo info;
+	MDB_stat mst;
+	MDB_scrubstat mss;
+	unsigned int psize;
+	char *buf;
+	FILE *fp;
+	size_t pg;
+	unsigned char b;
+
+	/* Checksums can't be added to an existing environment */
+	E(mdb_env_create(&env));
+	E(mdb_env_open(env, DBPATH, 0, 0664));
+	mdb_env_close(env);
+	E(mdb_env_create(&env));
+	rc = mdb_env_open(env, DBPATH, MDB_PAGECRC, 0664);
+	CHECK(rc == MDB_INCOMPATIBLE, "mdb_env_open(MDB_PAGECRC)");
+	mdb_env_close(env);
+	remove(DBPATH "/data.mdb");
+	remove(DBPATH "/lock.mdb");
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 104857600));
+	E(mdb_env_set_maxdbs(env, 4));
+	E(mdb_env_open(env, DBPATH, MDB_PAGECRC|MDB_PAGEVERIFY|MDB_NOSYNC, 0664));
+	E(mdb_env_stat(env, &mst));
+	psize = mst.ms_psize;
+	buf = malloc(psize * 3);
+
+	fill(env, psize, buf);
+	E(check(env, psize, buf, 1));
+	E(mdb_env_scrub(env, 0));
+	E(mdb_env_scrub_stat(env, &mss));
+	printf("Scrubbed %zu of %zu pages, %zu errors\n",
+		mss.ms_checked, mss.ms_pages, mss.ms_errors);
+	CHECK(mss.ms_passes == 1 && mss.ms_errors == 0, "scrub");
+	CHECK(mss.ms_checked > NKEYS / 50 * 3, "scrub count");
+
+	/* A compacted copy renumbers every page, so its checksums
+	 * are all recomputed
+	 */
+	remove(COPY);
+	remove(COPY "-lock");
+	fd = open(COPY, O_WRONLY|O_CREAT|O_EXCL, 0664);
+	CHECK(fd >= 0, "open");
+	E(mdb_env_copyfd2(env, fd, MDB_CP_COMPACT));
+	close(fd);
+	E(mdb_env_info(env, &info));
+	mdb_env_close(env);
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_maxdbs(env, 4));
+	E(mdb_env_open(env, COPY, MDB_NOSUBDIR|MDB_PAGEVERIFY, 0664));
+	E(check(env, psize, buf, 1));
+	E(mdb_env_scrub_start(env, 0, 0));
+	for (i=0; i<60; i++) {
+		E(mdb_env_scrub_stat(env, &mss));
+		if (mss.ms_passes)
+			break;
+		sleep(1);
+	}
+	E(mdb_env_scrub_stop(env));
+	printf("Scrubbed copy: %zu pages, %zu errors\n",
+		mss.ms_checked, mss.ms_errors);
+	CHECK(mss.ms_passes == 1 && mss.ms_errors == 0, "background scrub");
+
+	/* A slow pass checks the same pages, and holds no snapshot
+	 * while it waits between batches
+	 */
+	checked = mss.ms_checked;
+	E(mdb_env_scrub_start(env, 50, 0));
+	nheld = 0;
+	for (i=0; i<20; i++) {
+		usleep(50000);
+		E(mdb_reader_list(env, held, &nheld));
+	}
+	for (i=0; i<60; i++) {
+		E(mdb_env_scrub_stat(env, &mss));
+		if (mss.ms_passes == 2)
+			break;
+		sleep(1);
+	}
+	E(mdb_env_scrub_stop(env));
+	printf("Slow scrub: %zu pages, snapshot held in %d of 20 samples\n",
+		mss.ms_checked, nheld);
+	CHECK(mss.ms_passes == 2 && mss.ms_errors == 0, "slow scrub");
+	CHECK(mss.ms_checked == checked, "slow scrub count");
+	CHECK(nheld < 10, "slow scrub snapshot");
+	mdb_env_close(env);
+
+	/* Damage the checksum of every page in use */
+	fp = fopen(DBPATH "/data.mdb", "r+b");
+	CHECK(fp != NULL, "fopen");
+	for (pg = 2; pg <= info.me_last_pgno; pg++) {
+		fseek(fp, (long)((pg + 1) * psize - 8), SEEK_SET);
+		b = getc(fp);
+		fseek(fp, (long)((pg + 1) * psize - 8), SEEK_SET);
+		putc(b ^ 0xff, fp);
+	}
+	fclose(fp);
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_maxdbs(env, 4));
+	E(mdb_env_open(env, DBPATH, MDB_PAGEVERIFY, 0664));
+	rc = check(env, psize, buf, 0);
+	CHECK(rc == MDB_CORRUPTED, "check with MDB_PAGEVERIFY");
+	E(mdb_env_set_flags(env, MDB_PAGEVERIFY, 0));
+	E(check(env, psize, buf, 0));
+	rc = mdb_env_scrub(env, 0);
+	CHECK(rc == MDB_CORRUPTED, "mdb_env_scrub");
+	E(mdb_env_scrub_stat(env, &mss));
+	printf("Scrubbed damaged env: %zu errors, last bad page %zu\n",
+		mss.ms_errors, mss.ms_badpage);
+	CHECK(mss.ms_errors > 0, "scrub errors");
+	mdb_env_close(env);
+	free(buf);
+
+	return 0;
+}
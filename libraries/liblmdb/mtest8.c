@@ -0,0 +1,188 @@
+/* mtest8.c - memory-mapped database tester/toy */
+/*
+ * Copyright 2011-2016 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Tests for incremental copies. Without arguments, makes a full copy
+ * of an environment created with MDB_PAGETXN and two incremental copies
+ * after later changes. With "compare", checks that the full copy, once
+ * the incremental copies were applied to it by mdb_restore, matches the
+ * environment.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define RES(err, expr) ((rc = expr) == (err) || (CHECK(!rc, #expr), 0))
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+#define DBPATH	"./testdb"
+#define FULL	"./testdb/full.mdb"
+#define PLAIN	"./testdb/plain.mdb"
+
+static char vbuf[20000];
+
+	/* Write, rewrite and delete keys of the main DB and of a DB of
+	 * duplicates. Every 40th value needs several overflow pages.
+	 */
+static void change(MDB_env *env, int start, int count, int del, int seed)
+{
+	int i, rc;
+	MDB_txn *txn;
+	MDB_dbi dbi, dbd;
+	MDB_val key, data;
+	char kval[32], dval[32];
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	E(mdb_dbi_open(txn, "dups", MDB_CREATE|MDB_DUPSORT, &dbd));
+	key.mv_data = kval;
+	for (i=start; i<start+count; i++) {
+		key.mv_size = sprintf(kval, "%08d", i);
+		if (del && i % del == 0) {
+			RES(MDB_NOTFOUND, mdb_del(txn, dbi, &key, NULL));
+			continue;
+		}
+		data.mv_size = i % 40 ? 50 + (i + seed) % 200 : 10000 + seed % 5000;
+		memset(vbuf, 'a' + (i + seed) % 26, data.mv_size);
+		data.mv_data = vbuf;
+		E(mdb_put(txn, dbi, &key, &data, 0));
+		key.mv_size = sprintf(kval, "dup%03d", i % 100);
+		data.mv_size = sprintf(dval, "%08d.%d", i, seed);
+		data.mv_data = dval;
+		E(mdb_put(txn, dbd, &key, &data, 0));
+		if (del && i % del == 1) {
+			data.mv_size = sprintf(dval, "%08d.%d", i - 1, seed);
+			RES(MDB_NOTFOUND, mdb_del(txn, dbd, &key, &data));
+		}
+	}
+	E(mdb_txn_commit(txn));
+}
+
+	/* Check that two DBs hold the same records */
+static void compare(MDB_txn *t1, MDB_txn *t2, const char *name)
+{
+	int rc, r1, r2;
+	MDB_dbi d1, d2;
+	MDB_cursor *c1, *c2;
+	MDB_val k1, v1, k2, v2;
+	size_t n = 0;
+
+	E(mdb_dbi_open(t1, name, 0, &d1));
+	E(mdb_dbi_open(t2, name, 0, &d2));
+	E(mdb_cursor_open(t1, d1, &c1));
+	E(mdb_cursor_open(t2, d2, &c2));
+	for (;;) {
+		r1 = mdb_cursor_get(c1, &k1, &v1, MDB_NEXT);
+		r2 = mdb_cursor_get(c2, &k2, &v2, MDB_NEXT);
+		rc = r1 ? r1 : r2;
+		CHECK(r1 == r2, "record count");
+		if (r1 == MDB_NOTFOUND)
+			break;
+		E(r1);
+		CHECK(k1.mv_size == k2.mv_size &&
+			!memcmp(k1.mv_data, k2.mv_data, k1.mv_size), "key");
+		CHECK(v1.mv_size == v2.mv_size &&
+			!memcmp(v1.mv_data, v2.mv_data, v1.mv_size), "data");
+		n++;
+	}
+	printf("%s: %zu records match\n", name ? name : "main", n);
+	mdb_cursor_close(c1);
+	mdb_cursor_close(c2);
+}
+
+int main(int argc,char * argv[])
+{
+	int rc, fd;
+	MDB_env *env, *env2;
+	MDB_envinfo info, info2;
+	MDB_txn *t1, *t2;
+	size_t since;
+	unsigned int version;
+	FILE *fp;
+
+	if (argc > 1 && !strcmp(argv[1], "compare")) {
+		E(mdb_env_create(&env));
+		E(mdb_env_set_maxdbs(env, 4));
+		E(mdb_env_open(env, DBPATH, MDB_RDONLY, 0664));
+		E(mdb_env_create(&env2));
+		E(mdb_env_set_maxdbs(env2, 4));
+		E(mdb_env_open(env2, FULL, MDB_NOSUBDIR|MDB_RDONLY, 0664));
+		E(mdb_env_info(env, &info));
+		E(mdb_env_info(env2, &info2));
+		CHECK(info.me_last_txnid == info2.me_last_txnid, "txnid");
+		E(mdb_txn_begin(env, NULL, MDB_RDONLY, &t1));
+		E(mdb_txn_begin(env2, NULL, MDB_RDONLY, &t2));
+		compare(t1, t2, "dups");
+		compare(t1, t2, NULL);
+		mdb_txn_abort(t2);
+		mdb_txn_abort(t1);
+		mdb_env_close(env2);
+		mdb_env_close(env);
+		return 0;
+	}
+
+	/* Environments created without MDB_PAGETXN keep the page layout
+	 * of older versions, and can't be copied incrementally
+	 */
+	remove(PLAIN);
+	remove(PLAIN "-lock");
+	E(mdb_env_create(&env));
+	E(mdb_env_open(env, PLAIN, MDB_NOSUBDIR, 0664));
+	rc = mdb_env_incr_copy(env, DBPATH "/plain.incr", 0, NULL);
+	CHECK(rc == MDB_INCOMPATIBLE, "mdb_env_incr_copy");
+	mdb_env_close(env);
+	fp = fopen(PLAIN, "rb");
+	CHECK(fp != NULL, "fopen");
+	/* mm_version follows mm_magic after the 16 byte page header */
+	CHECK(fseek(fp, 20, SEEK_SET) == 0 &&
+		fread(&version, sizeof(version), 1, fp) == 1, "fread");
+	fclose(fp);
+	CHECK(version == 1, "data version");
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 104857600));
+	E(mdb_env_set_maxdbs(env, 4));
+	E(mdb_env_open(env, DBPATH, MDB_PAGETXN|MDB_NOSYNC, 0664));
+	change(env, 0, 3000, 0, 0);
+	change(env, 3000, 1000, 0, 1);
+
+	/* The base of the chain is a plain copy */
+	remove(FULL);
+	remove(FULL "-lock");
+	fd = open(FULL, O_WRONLY|O_CREAT|O_EXCL, 0664);
+	CHECK(fd >= 0, "open");
+	E(mdb_env_copyfd2(env, fd, 0));
+	close(fd);
+	E(mdb_env_info(env, &info));
+	since = info.me_last_txnid;
+
+	change(env, 500, 1000, 7, 2);
+	change(env, 3900, 400, 0, 3);
+	remove(DBPATH "/incr1.mdb");
+	E(mdb_env_incr_copy(env, DBPATH "/incr1.mdb", since, &since));
+	printf("First incremental copy at txn %zu\n", since);
+
+	change(env, 0, 4300, 5, 4);
+	change(env, 100, 50, 0, 5);
+	remove(DBPATH "/incr2.mdb");
+	E(mdb_env_incr_copy(env, DBPATH "/incr2.mdb", since, &since));
+	printf("Second incremental copy at txn %zu\n", since);
+	mdb_env_close(env);
+
+	return 0;
+}
@@ -21,6 +21,8 @@
 
 #include "portable.h"
 
+#include <ac/string.h>
+
 #include <lutil_hash.h>
 
 /* offset and prime for 32-bit FNV-1 */
@@ -138,4 +140,129 @@ lutil_HASH64Final( unsigned char *digest, lutil_HASH_CTX *ctx )
 	digest[6] = (h>>48) & 0xffU;
 	digest[7] = (h>>56) & 0xffU;
 }
+
+/* 64 bit word-at-a-time hash, following the structure of wyhash
+ * (final version 4) by Wang Yi: input is read 8 bytes at a time and
+ * folded with 64x64->128 bit multiplies.
+ */
+
+static const unsigned long long hashw64_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+/* Replace *a and *b with the low and high halves of their product */
+static void
+hashw64_mum( unsigned long long *a, unsigned long long *b )
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 r = *a;
+	r *= *b;
+	*a = (unsigned long long) r;
+	*b = (unsigned long long) ( r >> 64 );
+#else
+	unsigned long long ha = *a >> 32, la = (ber_uint_t) *a;
+	unsigned long long hb = *b >> 32, lb = (ber_uint_t) *b;
+	unsigned long long rh = ha * hb, rm0 = ha * lb, rm1 = hb * la,
+		rl = la * lb, t = rl + ( rm0 << 32 ), c = t < rl, lo;
+
+	lo = t + ( rm1 << 32 );
+	c += lo < t;
+	*a = lo;
+	*b = rh + ( rm0 >> 32 ) + ( rm1 >> 32 ) + c;
+#endif
+}
+
+static unsigned long long
+hashw64_mix( unsigned long long a, unsigned long long b )
+{
+	hashw64_mum( &a, &b );
+	return a ^ b;
+}
+
+static unsigned long long
+hashw64_r8( const unsigned char *p )
+{
+	unsigned long long v;
+	AC_MEMCPY( &v, p, sizeof(v) );
+	return v;
+}
+
+static unsigned long long
+hashw64_r4( const unsigned char *p )
+{
+	ber_uint_t v;
+	AC_MEMCPY( &v, p, sizeof(v) );
+	return v;
+}
+
+/*
+ * Initialize context
+ */
+void
+lutil_HASHW64Init( lutil_HASH_CTX *ctx )
+{
+	ctx->hash64 = HASH64_OFFSET;
+}
+
+/*
+ * Update hash
+ */
+void
+lutil_HASHW64Update(
+    lutil_HASH_CTX	*ctx,
+    const unsigned char		*buf,
+    ber_len_t		len )
+{
+	const unsigned long long *s = hashw64_secret;
+	const unsigned char *p = buf;
+	unsigned long long seed, a, b;
+	ber_len_t i;
+
+	seed = ctx->hash64;
+	seed ^= hashw64_mix( seed ^ s[0], s[1] );
+
+	if ( len <= 16 ) {
+		if ( len >= 4 ) {
+			a = ( hashw64_r4( p ) << 32 ) | hashw64_r4( p + (( len >> 3 ) << 2 ));
+			b = ( hashw64_r4( p + len - 4 ) << 32 ) |
+				hashw64_r4( p + len - 4 - (( len >> 3 ) << 2 ));
+		} else if ( len > 0 ) {
+			a = ( (unsigned long long) p[0] << 16 ) |
+				( (unsigned long long) p[len >> 1] << 8 ) | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		i = len;
+		if ( i > 48 ) {
+			unsigned long long see1 = seed, see2 = seed;
+			do {
+				seed = hashw64_mix( hashw64_r8( p ) ^ s[1],
+					hashw64_r8( p + 8 ) ^ seed );
+				see1 = hashw64_mix( hashw64_r8( p + 16 ) ^ s[2],
+					hashw64_r8( p + 24 ) ^ see1 );
+				see2 = hashw64_mix( hashw64_r8( p + 32 ) ^ s[3],
+					hashw64_r8( p + 40 ) ^ see2 );
+				p += 48;
+				i -= 48;
+			} while ( i > 48 );
+			seed ^= see1 ^ see2;
+		}
+		while ( i > 16 ) {
+			seed = hashw64_mix( hashw64_r8( p ) ^ s[1],
+				hashw64_r8( p + 8 ) ^ seed );
+			i -= 16;
+			p += 16;
+		}
+		a = hashw64_r8( p + i - 16 );
+		b = hashw64_r8( p + i - 8 );
+	}
+
+	a ^= s[1];
+	b ^= seed;
+	hashw64_mum( &a, &b );
+	ctx->hash64 = hashw64_mix( a ^ s[0] ^ len, b ^ s[1] );
+}
 #endif /* HAVE_LONG_LONG */
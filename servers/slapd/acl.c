@@ -69,7 +69,7 @@ static slap_control_t slap_acl_mask(
 	slap_access_t access );
 
 static int	regex_matches(
-	struct berval *pat, char *str,
+	Operation *op, struct berval *pat, char *str,
 	struct berval *dn_matches, struct berval *val_matches,
 	AclRegexMatches *matches);
 
@@ -131,6 +131,124 @@ slap_access_always_allowed(
 	(m)->val_count = MATCHES_VALMAXCOUNT( (m) );		\
 } while ( 0 /* CONSTCOND */ )
 
+/*
+ * Outcomes of slap_acl_mask() for the access statements whose "by"
+ * clauses do not look at the entry (acl_memo), kept per thread for
+ * the search operation it is running, so that a search over many
+ * entries evaluates such a statement once per attribute and incoming
+ * mask instead of once per entry. The memo belongs to one identity
+ * of one operation, and is dropped when an access control list changes.
+ */
+#define ACL_MEMO_SLOTS	256
+
+typedef struct AclMemoSlot {
+	AccessControl		*am_acl;
+	AttributeDescription	*am_desc;
+	slap_mask_t		am_in;
+	slap_mask_t		am_out;
+	slap_control_t		am_control;
+} AclMemoSlot;
+
+typedef struct AclMemo {
+	int		am_valid;
+	unsigned long	am_resets;
+	unsigned long	am_gen;
+	unsigned long	am_connid;
+	unsigned long	am_opid;
+	time_t		am_time;
+	int		am_tincr;
+	struct berval	am_ndn;
+	ber_len_t	am_ndnsize;
+	AclMemoSlot	am_slots[ACL_MEMO_SLOTS];
+} AclMemo;
+
+/* bumped by acl_changed() */
+static unsigned long	acl_gen;
+
+/* Called when access statements are added to a list or freed */
+void
+acl_changed( void )
+{
+	acl_gen++;
+}
+
+static void
+acl_memo_free( void *key, void *data )
+{
+	AclMemo *memo = data;
+
+	ch_free( memo->am_ndn.bv_val );
+	ch_free( memo );
+}
+
+static AclMemo *
+acl_memo_get( Operation *op )
+{
+	AclMemo *memo;
+	void *data = NULL;
+
+	if ( op->o_tag != LDAP_REQ_SEARCH || op->o_do_not_cache ||
+		!op->o_threadctx )
+		return NULL;
+
+	if ( ldap_pvt_thread_pool_getkey( op->o_threadctx,
+			(void *)acl_memo_get, &data, NULL ) || !data ) {
+		data = ch_calloc( 1, sizeof( AclMemo ) );
+		if ( ldap_pvt_thread_pool_setkey( op->o_threadctx,
+				(void *)acl_memo_get, data, acl_memo_free,
+				NULL, NULL ) ) {
+			ch_free( data );
+			return NULL;
+		}
+	}
+	memo = data;
+
+	if ( memo->am_valid && memo->am_gen == acl_gen &&
+		memo->am_connid == op->o_connid &&
+		memo->am_opid == op->o_opid &&
+		memo->am_time == op->o_time &&
+		memo->am_tincr == op->o_tincr &&
+		ber_bvcmp( &memo->am_ndn, &op->o_ndn ) == 0 )
+		return memo;
+
+	if ( memo->am_ndnsize <= op->o_ndn.bv_len ) {
+		memo->am_ndnsize = op->o_ndn.bv_len + 1;
+		memo->am_ndn.bv_val = ch_realloc( memo->am_ndn.bv_val,
+			memo->am_ndnsize );
+	}
+	memo->am_ndn.bv_len = op->o_ndn.bv_len;
+	if ( op->o_ndn.bv_len )
+		AC_MEMCPY( memo->am_ndn.bv_val, op->o_ndn.bv_val,
+			op->o_ndn.bv_len );
+	memo->am_ndn.bv_val[memo->am_ndn.bv_len] = '\0';
+	memo->am_gen = acl_gen;
+	memo->am_connid = op->o_connid;
+	memo->am_opid = op->o_opid;
+	memo->am_time = op->o_time;
+	memo->am_tincr = op->o_tincr;
+	memset( memo->am_slots, 0, sizeof( memo->am_slots ) );
+	memo->am_resets++;
+	memo->am_valid = 1;
+
+	return memo;
+}
+
+static AclMemoSlot *
+acl_memo_slot(
+	AclMemo			*memo,
+	AccessControl		*a,
+	AttributeDescription	*desc,
+	slap_mask_t		mask )
+{
+	unsigned long h;
+
+	h = (unsigned long)a >> 4;
+	h = h * 31 + ( (unsigned long)desc >> 4 );
+	h = h * 31 + mask;
+
+	return &memo->am_slots[h % ACL_MEMO_SLOTS];
+}
+
 int
 slap_access_allowed(
 	Operation		*op,
@@ -155,6 +273,10 @@ slap_access_allowed(
 	AclRegexMatches			matches;
 	AccessControlState		acl_state = ACL_STATE_INIT;
 	static AccessControlState	state_init = ACL_STATE_INIT;
+	AclMemo				*memo;
+	AclMemoSlot			*slot;
+	unsigned long			resets = 0;
+	slap_mask_t			in;
 
 	assert( op != NULL );
 	assert( e != NULL );
@@ -237,6 +359,10 @@ slap_access_allowed(
 		ACL_PRIV_ASSIGN( mask, *maskp );
 	}
 
+	memo = acl_memo_get( op );
+	if ( memo )
+		resets = memo->am_resets;
+
 	MATCHES_MEMSET( &matches );
 	prev = a;
 
@@ -285,9 +411,38 @@ slap_access_allowed(
 			Debug( LDAP_DEBUG_ACL, "\n", 0, 0, 0 );
 		}
 
+		/* a nested operation may have taken over the memo */
+		if ( memo && memo->am_resets != resets )
+			memo = NULL;
+
+		slot = NULL;
+		if ( memo && a->acl_memo ) {
+			slot = acl_memo_slot( memo, a, desc, mask );
+			if ( slot->am_acl == a && slot->am_desc == desc &&
+				slot->am_in == mask )
+			{
+				Debug( LDAP_DEBUG_ACL,
+					"=> slap_access_allowed: [%d] memoized\n",
+					count, 0, 0 );
+				ACL_PRIV_ASSIGN( mask, slot->am_out );
+				control = slot->am_control;
+				goto memoized;
+			}
+			ACL_PRIV_ASSIGN( in, mask );
+		}
+
 		control = slap_acl_mask( a, prev, &mask, op,
 			e, desc, val, &matches, count, state, access );
 
+		if ( slot && memo->am_resets == resets ) {
+			slot->am_acl = a;
+			slot->am_desc = desc;
+			slot->am_in = in;
+			slot->am_out = mask;
+			slot->am_control = control;
+		}
+
+memoized:;
 		if ( control != ACL_BREAK ) {
 			break;
 		}
@@ -489,6 +644,350 @@ done:
 }
 
 
+/*
+ * Index of an access control list, so that slap_acl_get() only looks
+ * at the statements that may apply to the entry and attribute at hand.
+ * Statements with a "to" DN that must end with a given DN are found by
+ * looking up each suffix of the entry DN that starts at a separator;
+ * the others are always candidates. Statements whose DN cannot match
+ * are skipped, as they leave no trace; the candidates are checked as
+ * usual, so the outcome is that of the plain walk. Which statements
+ * name an attribute is computed once per attribute; those that do not
+ * must still be walked, as they reset the match data "by" clauses see.
+ * Indexes are built per thread as lists are used, and built again once
+ * any list changed.
+ */
+#define ACL_INDEX_MIN	16	/* shorter lists are walked */
+#define ACL_INDEX_BITS	( sizeof( unsigned long ) * CHAR_BIT )
+#define ACL_INDEX_WORDS(n)	( ( (n) + ACL_INDEX_BITS - 1 ) / ACL_INDEX_BITS )
+#define ACL_INDEX_SET(b, i)	\
+	( (b)[(i) / ACL_INDEX_BITS] |= 1UL << ( (i) % ACL_INDEX_BITS ) )
+#define ACL_INDEX_ISSET(b, i)	\
+	( (b)[(i) / ACL_INDEX_BITS] & ( 1UL << ( (i) % ACL_INDEX_BITS ) ) )
+
+typedef struct AclIndexDN {
+	struct berval	aid_dn;
+	unsigned long	*aid_bits;
+} AclIndexDN;
+
+typedef struct AclIndexAD {
+	AttributeDescription	*aia_desc;
+	unsigned long		*aia_bits;
+} AclIndexAD;
+
+typedef struct AclIndexPos {
+	AccessControl	*aip_acl;
+	int		aip_pos;
+} AclIndexPos;
+
+typedef struct AclIndex {
+	AccessControl	*ai_head;
+	int		ai_count;
+	AccessControl	**ai_acls;	/* NULL if the list is walked */
+	AclIndexPos	*ai_pos;
+	Avlnode		*ai_posmap;	/* AclIndexPos by statement */
+	Avlnode		*ai_dns;	/* AclIndexDN by DN suffix */
+	Avlnode		*ai_ads;	/* AclIndexAD by attribute */
+	unsigned long	*ai_always;
+	unsigned long	*ai_cand;	/* scratch for slap_acl_get() */
+} AclIndex;
+
+typedef struct AclIndexes {
+	unsigned long	ais_gen;
+	Avlnode		*ais_lists;	/* AclIndex by list head */
+} AclIndexes;
+
+static int
+acl_index_cmp( const void *v1, const void *v2 )
+{
+	const AclIndex *i1 = v1, *i2 = v2;
+
+	if ( i1->ai_head == i2->ai_head )
+		return 0;
+	return i1->ai_head < i2->ai_head ? -1 : 1;
+}
+
+static int
+acl_index_pos_cmp( const void *v1, const void *v2 )
+{
+	const AclIndexPos *p1 = v1, *p2 = v2;
+
+	if ( p1->aip_acl == p2->aip_acl )
+		return 0;
+	return p1->aip_acl < p2->aip_acl ? -1 : 1;
+}
+
+/* case-insensitive, as regex DN patterns are */
+static int
+acl_index_dn_cmp( const void *v1, const void *v2 )
+{
+	const AclIndexDN *d1 = v1, *d2 = v2;
+
+	return ber_bvstrcasecmp( &d1->aid_dn, &d2->aid_dn );
+}
+
+static int
+acl_index_ad_cmp( const void *v1, const void *v2 )
+{
+	const AclIndexAD *a1 = v1, *a2 = v2;
+
+	if ( a1->aia_desc == a2->aia_desc )
+		return 0;
+	return a1->aia_desc < a2->aia_desc ? -1 : 1;
+}
+
+static void
+acl_index_free( void *v )
+{
+	AclIndex *ai = v;
+
+	avl_free( ai->ai_dns, ch_free );
+	avl_free( ai->ai_ads, ch_free );
+	avl_free( ai->ai_posmap, NULL );
+	ch_free( ai->ai_pos );
+	ch_free( ai->ai_acls );
+	ch_free( ai->ai_always );
+	ch_free( ai );
+}
+
+static void
+acl_indexes_free( void *key, void *data )
+{
+	AclIndexes *ais = data;
+
+	avl_free( ais->ais_lists, acl_index_free );
+	ch_free( ais );
+}
+
+/*
+ * The DN the entry DN must end with at a separator, or at its start,
+ * for the "to" part of a to match; BER_BVNULL if there is none.
+ * For a regex, that is the part after the first separator of the
+ * literal text before the final $, when there is no alternation.
+ */
+static void
+acl_index_suffix( AccessControl *a, struct berval *dn )
+{
+	char *p, *end;
+
+	BER_BVZERO( dn );
+	if ( BER_BVISEMPTY( &a->acl_dn_pat ) )
+		return;
+
+	switch ( a->acl_dn_style ) {
+	case ACL_STYLE_BASE:
+	case ACL_STYLE_ONE:
+	case ACL_STYLE_SUBTREE:
+	case ACL_STYLE_CHILDREN:
+		*dn = a->acl_dn_pat;
+		return;
+
+	case ACL_STYLE_REGEX:
+		break;
+
+	default:
+		return;
+	}
+
+	p = a->acl_dn_pat.bv_val;
+	end = p + a->acl_dn_pat.bv_len;
+	if ( strchr( p, '|' ) != NULL || end[-1] != '$' )
+		return;
+	end--;
+	for ( p = end; p > a->acl_dn_pat.bv_val; p-- ) {
+		if ( (unsigned char)p[-1] >= 0x80 ||
+			strchr( ".[]()*+?{}|\\^$", p[-1] ) )
+			break;
+	}
+	/* an escaped $ is no anchor */
+	if ( p == end && p > a->acl_dn_pat.bv_val && p[-1] == '\\' )
+		return;
+	for ( ; p < end && !DN_SEPARATOR( *p ); p++ )
+		;
+	if ( end - p < 2 )
+		return;
+	dn->bv_val = p + 1;
+	dn->bv_len = end - p - 1;
+}
+
+static AclIndex *
+acl_index_build( AccessControl *head )
+{
+	AclIndex *ai;
+	AccessControl *a;
+	AclIndexDN dnkey, *d;
+	int i, n, words;
+
+	ai = ch_calloc( 1, sizeof( AclIndex ) );
+	ai->ai_head = head;
+	for ( a = head; a != NULL; a = a->acl_next )
+		ai->ai_count++;
+	if ( ai->ai_count < ACL_INDEX_MIN )
+		return ai;
+
+	n = ai->ai_count;
+	words = ACL_INDEX_WORDS( n );
+	ai->ai_acls = ch_malloc( n * sizeof( AccessControl * ) );
+	ai->ai_pos = ch_malloc( n * sizeof( AclIndexPos ) );
+	ai->ai_always = ch_calloc( 2 * words, sizeof( unsigned long ) );
+	ai->ai_cand = ai->ai_always + words;
+
+	for ( i = 0, a = head; a != NULL; i++, a = a->acl_next ) {
+		ai->ai_acls[i] = a;
+		ai->ai_pos[i].aip_acl = a;
+		ai->ai_pos[i].aip_pos = i;
+		avl_insert( &ai->ai_posmap, &ai->ai_pos[i], acl_index_pos_cmp,
+			avl_dup_error );
+
+		acl_index_suffix( a, &dnkey.aid_dn );
+		if ( BER_BVISNULL( &dnkey.aid_dn ) ) {
+			ACL_INDEX_SET( ai->ai_always, i );
+			continue;
+		}
+
+		d = avl_find( ai->ai_dns, &dnkey, acl_index_dn_cmp );
+		if ( d == NULL ) {
+			d = ch_calloc( 1, sizeof( AclIndexDN ) +
+				words * sizeof( unsigned long ) );
+			d->aid_dn = dnkey.aid_dn;
+			d->aid_bits = (unsigned long *)( d + 1 );
+			avl_insert( &ai->ai_dns, d, acl_index_dn_cmp, avl_dup_error );
+		}
+		ACL_INDEX_SET( d->aid_bits, i );
+	}
+
+	return ai;
+}
+
+/* the index of the list starting at head, NULL if it is walked */
+static AclIndex *
+acl_index_get( Operation *op, AccessControl *head )
+{
+	AclIndexes *ais;
+	AclIndex key, *ai;
+	void *data = NULL;
+
+	if ( head == NULL || !op->o_threadctx )
+		return NULL;
+
+	if ( ldap_pvt_thread_pool_getkey( op->o_threadctx,
+			(void *)acl_index_get, &data, NULL ) || !data ) {
+		data = ch_calloc( 1, sizeof( AclIndexes ) );
+		if ( ldap_pvt_thread_pool_setkey( op->o_threadctx,
+				(void *)acl_index_get, data, acl_indexes_free,
+				NULL, NULL ) ) {
+			ch_free( data );
+			return NULL;
+		}
+		( (AclIndexes *)data )->ais_gen = acl_gen;
+	}
+	ais = data;
+
+	if ( ais->ais_gen != acl_gen ) {
+		avl_free( ais->ais_lists, acl_index_free );
+		ais->ais_lists = NULL;
+		ais->ais_gen = acl_gen;
+	}
+
+	key.ai_head = head;
+	ai = avl_find( ais->ais_lists, &key, acl_index_cmp );
+	if ( ai == NULL ) {
+		ai = acl_index_build( head );
+		avl_insert( &ais->ais_lists, ai, acl_index_cmp, avl_dup_error );
+	}
+
+	return ai->ai_acls ? ai : NULL;
+}
+
+/* position of a in the list of ai, -1 if it is not there */
+static int
+acl_index_pos( AclIndex *ai, AccessControl *a )
+{
+	AclIndexPos key, *p;
+
+	key.aip_acl = a;
+	p = avl_find( ai->ai_posmap, &key, acl_index_pos_cmp );
+
+	return p ? p->aip_pos : -1;
+}
+
+/* the statements whose "to" DN may match e */
+static unsigned long *
+acl_index_cand( AclIndex *ai, Entry *e )
+{
+	AclIndexDN dnkey, *d;
+	ber_len_t i, dnlen = e->e_nname.bv_len;
+	int j, words = ACL_INDEX_WORDS( ai->ai_count );
+
+	AC_MEMCPY( ai->ai_cand, ai->ai_always, words * sizeof( unsigned long ) );
+
+	for ( i = 0; i < dnlen; i++ ) {
+		if ( i > 0 && !DN_SEPARATOR( e->e_ndn[i - 1] ) )
+			continue;
+		dnkey.aid_dn.bv_val = e->e_ndn + i;
+		dnkey.aid_dn.bv_len = dnlen - i;
+		d = avl_find( ai->ai_dns, &dnkey, acl_index_dn_cmp );
+		if ( d != NULL ) {
+			for ( j = 0; j < words; j++ )
+				ai->ai_cand[j] |= d->aid_bits[j];
+		}
+	}
+
+	return ai->ai_cand;
+}
+
+/* the statements whose "to" attributes include desc */
+static unsigned long *
+acl_index_attrs( AclIndex *ai, AttributeDescription *desc )
+{
+	AclIndexAD adkey, *ad;
+	int j, words = ACL_INDEX_WORDS( ai->ai_count );
+
+	adkey.aia_desc = desc;
+	ad = avl_find( ai->ai_ads, &adkey, acl_index_ad_cmp );
+	if ( ad == NULL ) {
+		ad = ch_calloc( 1, sizeof( AclIndexAD ) +
+			words * sizeof( unsigned long ) );
+		ad->aia_desc = desc;
+		ad->aia_bits = (unsigned long *)( ad + 1 );
+		for ( j = 0; j < ai->ai_count; j++ ) {
+			AccessControl *a = ai->ai_acls[j];
+
+			if ( a->acl_attrs == NULL || ad_inlist( desc, a->acl_attrs ) )
+				ACL_INDEX_SET( ad->aia_bits, j );
+		}
+		avl_insert( &ai->ai_ads, ad, acl_index_ad_cmp, avl_dup_error );
+	}
+
+	return ad->aia_bits;
+}
+
+/* first candidate at or after pos, n if none */
+static int
+acl_index_next( unsigned long *cand, int n, int pos )
+{
+	unsigned long w;
+	int i = pos / ACL_INDEX_BITS;
+
+	if ( pos >= n )
+		return n;
+
+	w = cand[i] & ( ~0UL << ( pos % ACL_INDEX_BITS ) );
+	for ( ;; ) {
+		if ( w ) {
+			pos = i * ACL_INDEX_BITS;
+			while ( !( w & 1 ) ) {
+				w >>= 1;
+				pos++;
+			}
+			return pos < n ? pos : n;
+		}
+		if ( ++i >= ACL_INDEX_WORDS( n ) )
+			return n;
+		w = cand[i];
+	}
+}
+
 /*
  * slap_acl_get - return the acl applicable to entry e, attribute
  * attr.  the acl returned is suitable for use in subsequent calls to
@@ -509,7 +1008,10 @@ slap_acl_get(
 {
 	const char *attr;
 	ber_len_t dnlen;
-	AccessControl *prev;
+	AccessControl *prev, *head;
+	AclIndex *ai;
+	unsigned long *cand = NULL, *attrs = NULL;
+	int pos = 0, next;
 
 	assert( e != NULL );
 	assert( count != NULL );
@@ -531,15 +1033,71 @@ slap_acl_get(
 		assert( a != NULL );
 		if ( a == frontendDB->be_acl )
 			state->as_fe_done = 1;
+
+		ai = acl_index_get( op, a );
 	} else {
 		prev = a;
 		a = a->acl_next;
+
+		/* find the list prev is in */
+		head = NULL;
+		if ( op->o_bd != NULL && op->o_bd->be_acl != NULL &&
+			op->o_bd->be_acl != frontendDB->be_acl )
+		{
+			head = op->o_bd->be_acl;
+			ai = acl_index_get( op, head );
+			if ( ai != NULL ) {
+				pos = acl_index_pos( ai, prev );
+			} else {
+				AccessControl *b;
+
+				for ( b = head; b != NULL && b != prev; b = b->acl_next )
+					;
+				pos = b != NULL ? 0 : -1;
+			}
+			if ( pos < 0 )
+				head = NULL;
+		}
+		if ( head == NULL ) {
+			ai = acl_index_get( op, frontendDB->be_acl );
+			if ( ai != NULL )
+				pos = acl_index_pos( ai, prev );
+		}
+		if ( ai != NULL && pos < 0 )
+			ai = NULL;
+		pos++;
 	}
 
 	dnlen = e->e_nname.bv_len;
 
  retry:
-	for ( ; a != NULL; prev = a, a = a->acl_next ) {
+	if ( ai != NULL ) {
+		cand = acl_index_cand( ai, e );
+		attrs = acl_index_attrs( ai, desc );
+	}
+
+	for ( ; a != NULL; prev = a, a = a->acl_next, pos++ ) {
+		if ( cand != NULL ) {
+			/* skip what cannot apply, as the walk would */
+			assert( a == ai->ai_acls[pos] );
+			next = acl_index_next( cand, ai->ai_count, pos );
+			if ( next > pos ) {
+				*count += next - pos;
+				if ( state->as_fe_done ) {
+					state->as_fe_done += next - pos;
+					if ( pos == 0 && a == frontendDB->be_acl )
+						state->as_fe_done--;
+				}
+				pos = next;
+				if ( pos == ai->ai_count ) {
+					a = NULL;
+					break;
+				}
+				prev = ai->ai_acls[pos - 1];
+				a = ai->ai_acls[pos];
+			}
+		}
+
 		(*count) ++;
 
 		if ( a != frontendDB->be_acl && state->as_fe_done )
@@ -605,7 +1163,9 @@ slap_acl_get(
 				*count, 0, 0 );
 		}
 
-		if ( a->acl_attrs && !ad_inlist( desc, a->acl_attrs ) ) {
+		if ( a->acl_attrs && !( attrs != NULL ?
+			ACL_INDEX_ISSET( attrs, pos ) : ad_inlist( desc, a->acl_attrs ) ) )
+		{
 			matches->dn_data[0].rm_so = -1;
 			matches->dn_data[0].rm_eo = -1;
 			matches->val_data[0].rm_so = -1;
@@ -708,6 +1268,9 @@ slap_acl_get(
 	if ( !state->as_fe_done ) {
 		state->as_fe_done = 1;
 		a = frontendDB->be_acl;
+		ai = acl_index_get( op, a );
+		cand = attrs = NULL;
+		pos = 0;
 		goto retry;
 	}
 
@@ -836,7 +1399,7 @@ acl_mask_dn(
 				return 1;
 			}
 
-			if ( !regex_matches( &bdn->a_pat, opndn->bv_val,
+			if ( !regex_matches( op, &bdn->a_pat, opndn->bv_val,
 				&e->e_nname, NULL, tmp_matchesp ) )
 			{
 				return 1;
@@ -1251,7 +1814,7 @@ slap_acl_mask(
 
 			if ( !ber_bvccmp( &b->a_sockurl_pat, '*' ) ) {
 				if ( b->a_sockurl_style == ACL_STYLE_REGEX) {
-					if ( !regex_matches( &b->a_sockurl_pat, op->o_conn->c_listener_url.bv_val,
+					if ( !regex_matches( op, &b->a_sockurl_pat, op->o_conn->c_listener_url.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -1290,7 +1853,7 @@ slap_acl_mask(
 				b->a_domain_pat.bv_val, 0, 0 );
 			if ( !ber_bvccmp( &b->a_domain_pat, '*' ) ) {
 				if ( b->a_domain_style == ACL_STYLE_REGEX) {
-					if ( !regex_matches( &b->a_domain_pat, op->o_conn->c_peer_domain.bv_val,
+					if ( !regex_matches( op, &b->a_domain_pat, op->o_conn->c_peer_domain.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -1344,7 +1907,7 @@ slap_acl_mask(
 				b->a_peername_pat.bv_val, 0, 0 );
 			if ( !ber_bvccmp( &b->a_peername_pat, '*' ) ) {
 				if ( b->a_peername_style == ACL_STYLE_REGEX ) {
-					if ( !regex_matches( &b->a_peername_pat, op->o_conn->c_peer_name.bv_val,
+					if ( !regex_matches( op, &b->a_peername_pat, op->o_conn->c_peer_name.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -1496,7 +2059,7 @@ slap_acl_mask(
 				b->a_sockname_pat.bv_val, 0, 0 );
 			if ( !ber_bvccmp( &b->a_sockname_pat, '*' ) ) {
 				if ( b->a_sockname_style == ACL_STYLE_REGEX) {
-					if ( !regex_matches( &b->a_sockname_pat, op->o_conn->c_sock_name.bv_val,
+					if ( !regex_matches( op, &b->a_sockname_pat, op->o_conn->c_sock_name.bv_val,
 							&e->e_nname, val, matches ) ) 
 					{
 						continue;
@@ -2638,8 +3201,121 @@ acl_string_expand(
 	return 0;
 }
 
+/*
+ * Compiled patterns of regex_matches(), by expanded pattern, kept
+ * per thread since concurrent regexec() calls on one regex_t are
+ * serialized by the C library. Each slot holds the last pattern that
+ * hashed to it. A pattern that is plain ASCII text apart from the ^ and
+ * $ anchors is not compiled at all but compared as a string.
+ */
+#define ACL_REGEX_SLOTS	64
+
+#define ACL_REGEX_LITERAL	0x1	/* no regex, match ar_lit */
+#define ACL_REGEX_HEAD		0x2	/* ar_lit anchored with ^ */
+#define ACL_REGEX_TAIL		0x4	/* ar_lit anchored with $ */
+
+typedef struct AclRegex {
+	struct berval	ar_pat;
+	struct berval	ar_lit;		/* points into ar_pat */
+	int		ar_flags;
+	regex_t		ar_re;
+} AclRegex;
+
+static void
+acl_regex_clear( AclRegex *ar )
+{
+	if ( !BER_BVISNULL( &ar->ar_pat ) ) {
+		if ( !( ar->ar_flags & ACL_REGEX_LITERAL ) )
+			regfree( &ar->ar_re );
+		ch_free( ar->ar_pat.bv_val );
+		BER_BVZERO( &ar->ar_pat );
+	}
+}
+
+static void
+acl_regex_free( void *key, void *data )
+{
+	AclRegex *ar = data;
+	int i;
+
+	for ( i = 0; i < ACL_REGEX_SLOTS; i++ )
+		acl_regex_clear( &ar[i] );
+	ch_free( ar );
+}
+
+static int
+acl_regex_compile( AclRegex *ar, struct berval *pat )
+{
+	char *p, *end;
+	int rc;
+
+	ber_dupbv( &ar->ar_pat, pat );
+	ar->ar_flags = ACL_REGEX_LITERAL;
+	p = ar->ar_pat.bv_val;
+	end = p + ar->ar_pat.bv_len;
+	if ( p < end && *p == '^' ) {
+		ar->ar_flags |= ACL_REGEX_HEAD;
+		p++;
+	}
+	if ( p < end && end[-1] == '$' ) {
+		ar->ar_flags |= ACL_REGEX_TAIL;
+		end--;
+	}
+	ar->ar_lit.bv_val = p;
+	ar->ar_lit.bv_len = end - p;
+	for ( ; p < end; p++ ) {
+		if ( (unsigned char)*p >= 0x80 || strchr( ".[]()*+?{}|\\^$", *p ) ) {
+			ar->ar_flags = 0;
+			break;
+		}
+	}
+	if ( ar->ar_flags )
+		return 0;
+
+	rc = regcomp( &ar->ar_re, ar->ar_pat.bv_val, REG_EXTENDED|REG_ICASE );
+	if ( rc ) {
+		char error[ACL_BUF_SIZE];
+		regerror( rc, &ar->ar_re, error, sizeof( error ) );
+
+		Debug( LDAP_DEBUG_TRACE,
+		    "compile( \"%s\") failed %s\n",
+			ar->ar_pat.bv_val, error, 0 );
+		ch_free( ar->ar_pat.bv_val );
+		BER_BVZERO( &ar->ar_pat );
+	}
+	return rc;
+}
+
+/* what regexec() with REG_ICASE gives for a plain text pattern */
+static int
+acl_regex_literal( AclRegex *ar, char *str )
+{
+	ber_len_t len = strlen( str ), i;
+	struct berval *lit = &ar->ar_lit;
+
+	if ( lit->bv_len > len )
+		return 0;
+
+	switch ( ar->ar_flags & ( ACL_REGEX_HEAD|ACL_REGEX_TAIL ) ) {
+	case ACL_REGEX_HEAD|ACL_REGEX_TAIL:
+		return lit->bv_len == len &&
+			!strncasecmp( str, lit->bv_val, len );
+	case ACL_REGEX_HEAD:
+		return !strncasecmp( str, lit->bv_val, lit->bv_len );
+	case ACL_REGEX_TAIL:
+		return !strncasecmp( str + len - lit->bv_len, lit->bv_val,
+			lit->bv_len );
+	}
+	for ( i = 0; i + lit->bv_len <= len; i++ ) {
+		if ( !strncasecmp( str + i, lit->bv_val, lit->bv_len ) )
+			return 1;
+	}
+	return 0;
+}
+
 static int
 regex_matches(
+	Operation	*op,
 	struct berval	*pat,		/* pattern to expand and match against */
 	char		*str,		/* string to match against pattern */
 	struct berval	*dn_matches,	/* buffer with $N expansion variables from DN */
@@ -2647,10 +3323,12 @@ regex_matches(
 	AclRegexMatches	*matches	/* offsets in buffer for $N expansion variables */
 )
 {
-	regex_t re;
+	AclRegex *cache = NULL, *ar, tmp;
 	char newbuf[ACL_BUF_SIZE];
 	struct berval bv;
-	int	rc;
+	unsigned int h;
+	ber_len_t i;
+	int	rc, hit = 0;
 
 	bv.bv_len = sizeof( newbuf ) - 1;
 	bv.bv_val = newbuf;
@@ -2665,19 +3343,58 @@ regex_matches(
 			pat->bv_val, str, 0 );
 		return( 0 );
 	}
-	rc = regcomp( &re, newbuf, REG_EXTENDED|REG_ICASE );
-	if ( rc ) {
-		char error[ACL_BUF_SIZE];
-		regerror( rc, &re, error, sizeof( error ) );
 
-		Debug( LDAP_DEBUG_TRACE,
-		    "compile( \"%s\", \"%s\") failed %s\n",
-			pat->bv_val, str, error );
-		return( 0 );
+	if ( op->o_threadctx ) {
+		void *data = NULL;
+
+		if ( ldap_pvt_thread_pool_getkey( op->o_threadctx,
+				(void *)regex_matches, &data, NULL ) || !data ) {
+			data = ch_calloc( ACL_REGEX_SLOTS, sizeof( AclRegex ) );
+			if ( ldap_pvt_thread_pool_setkey( op->o_threadctx,
+					(void *)regex_matches, data, acl_regex_free,
+					NULL, NULL ) ) {
+				ch_free( data );
+				data = NULL;
+			}
+		}
+		cache = data;
+	}
+
+	if ( cache ) {
+		for ( h = 0, i = 0; i < bv.bv_len; i++ )
+			h = h * 31 + (unsigned char)bv.bv_val[i];
+		ar = &cache[h % ACL_REGEX_SLOTS];
+		if ( !BER_BVISNULL( &ar->ar_pat ) &&
+			ber_bvcmp( &ar->ar_pat, &bv ) == 0 ) {
+			hit = 1;
+		} else {
+			acl_regex_clear( ar );
+			if ( acl_regex_compile( ar, &bv ) )
+				return( 0 );
+		}
+	} else {
+		ar = &tmp;
+		if ( acl_regex_compile( ar, &bv ) )
+			return( 0 );
+	}
+
+	if ( ar->ar_flags & ACL_REGEX_LITERAL )
+		rc = !acl_regex_literal( ar, str );
+	else
+		rc = regexec( &ar->ar_re, str, 0, NULL, 0 );
+
+	/* literal patterns are compared, not compiled */
+	if ( hit || !( ar->ar_flags & ACL_REGEX_LITERAL ) ) {
+		ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
+		if ( hit )
+			ldap_pvt_mp_add_ulong( op->o_counters->sc_regex_hits, 1 );
+		else
+			ldap_pvt_mp_add_ulong( op->o_counters->sc_regex_compiles, 1 );
+		ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
 	}
 
-	rc = regexec( &re, str, 0, NULL, 0 );
-	regfree( &re );
+	if ( ar == &tmp )
+		acl_regex_clear( ar );
 
 	Debug( LDAP_DEBUG_TRACE,
 	    "=> regex_matches: string:	 %s\n", str, 0, 0 );
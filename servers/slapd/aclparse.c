@@ -320,6 +320,83 @@ regex_done:;
 	return ACL_SCOPE_UNKNOWN;
 }
 
+/* a pattern that refers to submatches ($1, ${d1}...) of the "to" part */
+static int
+acl_pat_expands( slap_style_t style, struct berval *pat )
+{
+	ber_len_t	i;
+
+	if ( style == ACL_STYLE_EXPAND )
+		return 1;
+	if ( style != ACL_STYLE_REGEX )
+		return 0;
+
+	for ( i = 0; i + 1 < pat->bv_len; i++ ) {
+		if ( pat->bv_val[i] != '$' )
+			continue;
+		if ( pat->bv_val[i + 1] == '$' ) {
+			i++;
+			continue;
+		}
+		if ( pat->bv_val[i + 1] == '{' ||
+			( pat->bv_val[i + 1] >= '0' && pat->bv_val[i + 1] <= '9' ) )
+			return 1;
+	}
+	return 0;
+}
+
+static int
+acl_dn_memoizable( slap_dn_access *bdn )
+{
+	if ( BER_BVISEMPTY( &bdn->a_pat ) )
+		return !bdn->a_self && bdn->a_at == NULL;
+
+	return !bdn->a_self && bdn->a_at == NULL && !bdn->a_expand &&
+		bdn->a_style != ACL_STYLE_SELF &&
+		!acl_pat_expands( bdn->a_style, &bdn->a_pat );
+}
+
+/*
+ * Whether the outcome of the "by" clauses only depends on who asks
+ * and how, and not on the entry, the value or the submatches of the
+ * "to" part, so it can be reused by slap_access_allowed() for other
+ * entries within an operation.
+ */
+static int
+acl_memoizable( AccessControl *a )
+{
+	Access	*b;
+
+	for ( b = a->acl_access; b != NULL; b = b->a_next ) {
+		if ( !acl_dn_memoizable( &b->a_dn ) ||
+			!acl_dn_memoizable( &b->a_realdn ) )
+			return 0;
+
+		if ( acl_pat_expands( b->a_sockurl_style, &b->a_sockurl_pat ) ||
+			acl_pat_expands( b->a_peername_style, &b->a_peername_pat ) ||
+			acl_pat_expands( b->a_sockname_style, &b->a_sockname_pat ) )
+			return 0;
+
+		if ( b->a_domain_expand ||
+			acl_pat_expands( b->a_domain_style, &b->a_domain_pat ) )
+			return 0;
+
+		if ( !BER_BVISEMPTY( &b->a_group_pat ) &&
+			b->a_group_style == ACL_STYLE_EXPAND )
+			return 0;
+
+		if ( !BER_BVISEMPTY( &b->a_set_pat ) )
+			return 0;
+
+#ifdef SLAP_DYNACL
+		if ( b->a_dynacl != NULL )
+			return 0;
+#endif /* SLAP_DYNACL */
+	}
+
+	return 1;
+}
+
 int
 parse_acl(
 	Backend	*be,
@@ -1945,6 +2022,8 @@ parse_acl(
 			goto fail;
 		}
 
+		a->acl_memo = acl_memoizable( a );
+
 		if ( be != NULL ) {
 			if ( be->be_nsuffix == NULL ) {
 				Debug( LDAP_DEBUG_ACL, "%s: line %d: warning: "
@@ -2360,6 +2439,7 @@ acl_append( AccessControl **l, AccessControl *a, int pos )
 	if ( *l && a )
 		a->acl_next = *l;
 	*l = a;
+	acl_changed();
 }
 
 static void
@@ -2414,6 +2494,8 @@ acl_free( AccessControl *a )
 	Access *n;
 	AttributeName *an;
 
+	acl_changed();
+
 	if ( a->acl_filter ) {
 		filter_free( a->acl_filter );
 	}
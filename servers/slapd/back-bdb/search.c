@@ -355,6 +355,7 @@ bdb_search( Operation *op, SlapReply *rs )
 	struct berval	realbase = BER_BVNULL;
 	slap_mask_t	mask;
 	time_t		stoptime;
+	void		*batch;
 	int		manageDSAit;
 	int		tentries = 0;
 	unsigned	nentries = 0;
@@ -586,6 +587,7 @@ dn2entry_retry:
 
 	/* compute it anyway; root does not use it */
 	stoptime = op->o_time + op->ors_tlimit;
+	batch = slap_sendbatch_lookup( op );
 
 	/* need normalized dn below */
 	ber_dupbv( &realbase, &e->e_nname );
@@ -722,6 +724,12 @@ loop_begin:
 			goto done;
 		}
 
+		/* don't hold back entries already batched while
+		 * looking for the next match
+		 */
+		if ( batch )
+			slap_sendbatch_tick( op, batch );
+
 		/* If we inspect more entries than will
 		 * fit into the entry cache, stop caching
 		 * any subsequent entries
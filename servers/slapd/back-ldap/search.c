@@ -310,6 +310,8 @@ retry:
 		}
 
 		if ( rc == 0 || rc == -2 ) {
+			/* nothing more to send until the target answers */
+			slap_sendbatch_poll( op, 1 );
 			ldap_pvt_thread_yield();
 
 			/* check timeout */
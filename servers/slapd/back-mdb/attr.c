@@ -632,3 +632,54 @@ int mdb_ad_get( struct mdb_info *mdb, MDB_txn *txn, AttributeDescription *ad )
 
 	return rc;
 }
+
+/* The hash used for index keys, and how full index slots are stored,
+ * are recorded in the ad2i DB under key 0, which is never assigned to
+ * an attribute.
+ */
+#define MDB_IX_IDLBITMAP	0x01000000U
+
+int mdb_ixhash_read( struct mdb_info *mdb, MDB_txn *txn, slap_mask_t *hash,
+	unsigned *idlfmt )
+{
+	int rc, i = 0;
+	unsigned int h;
+	MDB_val key, val;
+
+	key.mv_size = sizeof(int);
+	key.mv_data = &i;
+
+	rc = mdb_get( txn, mdb->mi_ad2id, &key, &val );
+	if ( rc == MDB_SUCCESS ) {
+		if ( val.mv_size != sizeof(h) )
+			return MDB_CORRUPTED;
+		memcpy( &h, val.mv_data, sizeof(h) );
+		*hash = h & SLAP_INDEX_HASH_MASK;
+		*idlfmt = ( h & MDB_IX_IDLBITMAP ) ? MDB_IDLFMT_BITMAP : MDB_IDLFMT_RANGE;
+	}
+	return rc;
+}
+
+int mdb_ixhash_write( struct mdb_info *mdb, MDB_txn *txn, slap_mask_t hash,
+	unsigned idlfmt )
+{
+	int rc, i = 0;
+	unsigned int h = hash;
+	MDB_val key, val;
+
+	if ( idlfmt == MDB_IDLFMT_BITMAP )
+		h |= MDB_IX_IDLBITMAP;
+
+	key.mv_size = sizeof(int);
+	key.mv_data = &i;
+	val.mv_size = sizeof(h);
+	val.mv_data = &h;
+
+	rc = mdb_put( txn, mdb->mi_ad2id, &key, &val, 0 );
+	if ( rc ) {
+		Debug( LDAP_DEBUG_ANY,
+			"mdb_ixhash_write: mdb_put failed %s(%d)\n",
+			mdb_strerror(rc), rc, 0);
+	}
+	return rc;
+}
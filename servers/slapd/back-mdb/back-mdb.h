@@ -60,6 +60,48 @@ typedef struct mdb_monitor_t {
 
 /* From ldap_rq.h */
 struct re_s;
+struct mdb_cache;
+
+/* A group of write operations sharing one LMDB transaction.
+ * Each member runs in a nested txn of gb_txn; the thread that
+ * began gb_txn commits it once the group is closed.
+ */
+typedef struct mdb_gcbatch {
+	MDB_txn		*gb_txn;
+	struct timeval	gb_start;
+	int			gb_ops;		/* members that joined */
+	int			gb_live;	/* members whose nested txn hasn't ended */
+	int			gb_refs;	/* members that haven't seen the outcome */
+	char		gb_busy;	/* a member holds the nested txn */
+	char		gb_closed;	/* not accepting new members */
+	char		gb_done;	/* gb_txn has ended */
+	int			gb_rc;
+} mdb_gcbatch;
+
+/* Attributes wanted from a partial decode, see mdb_entry_pdecode() */
+typedef struct mdb_attrset {
+	AttributeDescription	**as_ads;	/* NULL-terminated */
+	unsigned char	*as_map;	/* by DB attribute index, 1 if wanted */
+	int			as_nmap;
+} mdb_attrset;
+
+/* An index key that single IDs are looked up in, see mdb_key_probe() */
+typedef struct mdb_ikey {
+	MDB_val		ik_key;
+	ID			ik_lo, ik_hi;	/* if ik_lo, the IDs are this range */
+	int			ik_kbuf[2];
+} mdb_ikey;
+
+/* Index probes for a filter, see mdb_filter_probes() */
+typedef struct mdb_iprobe {
+	struct mdb_iprobe	*ip_next;
+	ber_tag_t	ip_choice;	/* LDAP_FILTER_AND, _OR, or 0 for keys */
+	struct mdb_iprobe	*ip_list;
+	MDB_cursor	*ip_mc;
+	BerVarray	ip_bvals;
+	mdb_ikey	*ip_keys;	/* each of them must hold the ID */
+	int			ip_nkeys;
+} mdb_iprobe;
 
 struct mdb_info {
 	MDB_env		*mi_dbenv;
@@ -74,10 +116,17 @@ struct mdb_info {
 	size_t		mi_maxentrysize;
 
 	slap_mask_t	mi_defaultmask;
+	slap_mask_t	mi_ixhash;		/* SLAP_INDEX_HASH_* the index keys use */
+	slap_mask_t	mi_ixhash_cf;	/* configured for new or reindexed DBs */
+	unsigned	mi_idlfmt;		/* MDB_IDLFMT_* the index slots use */
+	unsigned	mi_idlfmt_cf;	/* configured for new or reindexed DBs */
+#define	MDB_IDLFMT_RANGE	1	/* full slots become ranges */
+#define	MDB_IDLFMT_BITMAP	2	/* full slots become bitmap chunks */
 	int			mi_nattrs;
 	struct mdb_attrinfo		**mi_attrs;
 	void		*mi_search_stack;
 	int			mi_search_stack_depth;
+	unsigned	mi_search_threads;
 	int			mi_readers;
 
 	uint32_t	mi_rtxn_size;
@@ -88,6 +137,19 @@ struct mdb_info {
 	struct re_s		*mi_txn_cp_task;
 	struct re_s		*mi_index_task;
 
+	int			mi_scrub;
+	unsigned	mi_scrub_rate;	/* pages per second */
+	unsigned	mi_scrub_min;	/* minutes between passes */
+
+	unsigned	mi_gc_ops;		/* max write ops per commit, 0 disables */
+	unsigned	mi_gc_usec;		/* max time to wait for more ops */
+	mdb_gcbatch	*mi_gc_batch;	/* group accepting new members */
+	ldap_pvt_thread_mutex_t	mi_gc_mutex;
+	ldap_pvt_thread_cond_t	mi_gc_cond;
+
+	unsigned	mi_cache_max;	/* max decoded entries to cache, 0 disables */
+	struct mdb_cache	*mi_cache;
+
 	mdb_monitor_t	mi_monitor;
 
 #ifdef MDB_MONITOR_IDX
@@ -124,12 +186,17 @@ struct mdb_info {
 typedef struct mdb_op_info {
 	OpExtra		moi_oe;
 	MDB_txn*	moi_txn;
+	mdb_gcbatch	*moi_gc;	/* group the write txn belongs to */
+	int			moi_numads;	/* mi_numads when the write txn began */
+	BerVarray	moi_written;	/* DNs for backend_group_forget() */
+	BerVarray	moi_moved;	/* subtrees for backend_group_forget() */
 	int			moi_ref;
 	char		moi_flag;
 } mdb_op_info;
 #define MOI_READER	0x01
 #define MOI_FREEIT	0x02
 #define MOI_KEEPER	0x04
+#define MOI_LEADER	0x08	/* began moi_gc's txn */
 
 LDAP_END_DECL
 
@@ -0,0 +1,419 @@
+/* cache.c - cache of decoded entries */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2011-2016 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+#include <ac/string.h>
+
+#include "back-mdb.h"
+
+/* Entries that are read over and over, like service accounts and the
+ * groups used in ACLs, are kept here in decoded form so readers can
+ * skip mdb_entry_decode(). A decoded entry points into the map and is
+ * only good for as long as its txn, so the cache holds a copy of the
+ * attributes in a single block.
+ *
+ * An entry cached from a snapshot with txnid S is the latest committed
+ * version of that entry, and is good for any reader whose snapshot is
+ * S or later. Writers drop an entry from the cache before they store
+ * or delete it and remember their txnid in cp_wtxn; readers with an
+ * older snapshot may then not add that entry back, since they would
+ * be adding the old version. Write txns never use the cache.
+ *
+ * The cache is split into parts by ID, each with its own lock, hash
+ * table and LRU list.
+ */
+
+#define MDB_CACHE_PARTS	16
+
+typedef struct mdb_centry {
+	struct mdb_centry *ce_next;		/* hash chain */
+	struct mdb_centry *ce_lprev;	/* LRU list, most recent first */
+	struct mdb_centry *ce_lnext;
+	struct mdb_cpart *ce_part;
+	ID		ce_id;
+	size_t	ce_txnid;		/* snapshot it was decoded in */
+	int		ce_refs;
+	int		ce_dead;		/* no longer in the cache */
+	slap_mask_t	ce_ocflags;
+	Attribute	*ce_attrs;
+} mdb_centry;
+
+typedef struct mdb_cpart {
+	ldap_pvt_thread_mutex_t	cp_mutex;
+	mdb_centry	**cp_hash;
+	unsigned	cp_hmask;
+	mdb_centry	*cp_lhead;
+	mdb_centry	*cp_ltail;
+	unsigned	cp_count;
+	unsigned	cp_max;
+	size_t		cp_wtxn;	/* last writer that dropped an entry */
+	unsigned long	cp_hits;
+	unsigned long	cp_misses;
+} mdb_cpart;
+
+struct mdb_cache {
+	mdb_cpart	mc_parts[MDB_CACHE_PARTS];
+};
+
+#define CACHE_PART(mc, id)	(&(mc)->mc_parts[(id) % MDB_CACHE_PARTS])
+#define CACHE_HASH(cp, id)	(&(cp)->cp_hash[((id) / MDB_CACHE_PARTS) & (cp)->cp_hmask])
+
+int
+mdb_cache_init( struct mdb_info *mdb )
+{
+	struct mdb_cache *mc;
+	unsigned i, max, hsize;
+
+	mdb_cache_destroy( mdb );
+	if ( !mdb->mi_cache_max )
+		return 0;
+
+	max = ( mdb->mi_cache_max + MDB_CACHE_PARTS - 1 ) / MDB_CACHE_PARTS;
+	for ( hsize = 16; hsize < max; hsize <<= 1 ) ;
+
+	mc = ch_calloc( 1, sizeof( struct mdb_cache ));
+	for ( i = 0; i < MDB_CACHE_PARTS; i++ ) {
+		mdb_cpart *cp = &mc->mc_parts[i];
+		ldap_pvt_thread_mutex_init( &cp->cp_mutex );
+		cp->cp_hash = ch_calloc( hsize, sizeof( mdb_centry * ));
+		cp->cp_hmask = hsize - 1;
+		cp->cp_max = max;
+	}
+	mdb->mi_cache = mc;
+	return 0;
+}
+
+/* Only called when no ops are running, so no entries are in use */
+void
+mdb_cache_destroy( struct mdb_info *mdb )
+{
+	struct mdb_cache *mc = mdb->mi_cache;
+	mdb_centry *ce, *next;
+	unsigned i;
+
+	if ( !mc )
+		return;
+
+	mdb->mi_cache = NULL;
+	for ( i = 0; i < MDB_CACHE_PARTS; i++ ) {
+		mdb_cpart *cp = &mc->mc_parts[i];
+		for ( ce = cp->cp_lhead; ce; ce = next ) {
+			next = ce->ce_lnext;
+			ch_free( ce );
+		}
+		ch_free( cp->cp_hash );
+		ldap_pvt_thread_mutex_destroy( &cp->cp_mutex );
+	}
+	ch_free( mc );
+}
+
+/* Is the op using a read-only txn? */
+static int
+mdb_cache_reader( Operation *op, struct mdb_info *mdb )
+{
+	OpExtra *oex;
+
+	LDAP_SLIST_FOREACH( oex, &op->o_extra, oe_next ) {
+		if ( oex->oe_key == mdb )
+			return ((mdb_op_info *)oex)->moi_flag & MOI_READER;
+	}
+	return 0;
+}
+
+static mdb_centry *
+mdb_cache_lookup( mdb_cpart *cp, ID id )
+{
+	mdb_centry *ce;
+
+	for ( ce = *CACHE_HASH( cp, id ); ce; ce = ce->ce_next ) {
+		if ( ce->ce_id == id )
+			break;
+	}
+	return ce;
+}
+
+/* Take ce out of the hash and LRU list; caller holds cp_mutex */
+static void
+mdb_cache_unlink( mdb_cpart *cp, mdb_centry *ce )
+{
+	mdb_centry **prev;
+
+	for ( prev = CACHE_HASH( cp, ce->ce_id ); *prev != ce;
+		prev = &(*prev)->ce_next ) ;
+	*prev = ce->ce_next;
+
+	if ( ce->ce_lprev )
+		ce->ce_lprev->ce_lnext = ce->ce_lnext;
+	else
+		cp->cp_lhead = ce->ce_lnext;
+	if ( ce->ce_lnext )
+		ce->ce_lnext->ce_lprev = ce->ce_lprev;
+	else
+		cp->cp_ltail = ce->ce_lprev;
+	cp->cp_count--;
+}
+
+static void
+mdb_cache_lru_head( mdb_cpart *cp, mdb_centry *ce )
+{
+	ce->ce_lprev = NULL;
+	ce->ce_lnext = cp->cp_lhead;
+	if ( cp->cp_lhead )
+		cp->cp_lhead->ce_lprev = ce;
+	else
+		cp->cp_ltail = ce;
+	cp->cp_lhead = ce;
+}
+
+/* Return a cached copy of entry id for the op's snapshot, or NULL.
+ * The entry must be returned with mdb_entry_return().
+ */
+Entry *
+mdb_cache_find( Operation *op, MDB_txn *txn, ID id )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	mdb_cpart *cp;
+	mdb_centry *ce;
+	Entry *e;
+
+	if ( !mdb_cache_reader( op, mdb ))
+		return NULL;
+
+	cp = CACHE_PART( mdb->mi_cache, id );
+	ldap_pvt_thread_mutex_lock( &cp->cp_mutex );
+	ce = mdb_cache_lookup( cp, id );
+	if ( !ce || ce->ce_txnid > mdb_txn_id( txn )) {
+		cp->cp_misses++;
+		ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+		return NULL;
+	}
+	ce->ce_refs++;
+	if ( ce != cp->cp_lhead ) {
+		ce->ce_lprev->ce_lnext = ce->ce_lnext;
+		if ( ce->ce_lnext )
+			ce->ce_lnext->ce_lprev = ce->ce_lprev;
+		else
+			cp->cp_ltail = ce->ce_lprev;
+		mdb_cache_lru_head( cp, ce );
+	}
+	cp->cp_hits++;
+	ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+
+	e = op->o_tmpalloc( sizeof( Entry ), op->o_tmpmemctx );
+	memset( e, 0, sizeof( Entry ));
+	e->e_id = id;
+	e->e_ocflags = ce->ce_ocflags;
+	e->e_attrs = ce->ce_attrs;
+	e->e_private = ce;
+	return e;
+}
+
+/* Is e a cached entry? Other entries point e_private at themselves */
+int
+mdb_cache_entry( Entry *e )
+{
+	return e->e_private && e->e_private != e;
+}
+
+void
+mdb_cache_release( Entry *e )
+{
+	mdb_centry *ce = e->e_private;
+	mdb_cpart *cp = ce->ce_part;
+	int dead;
+
+	ldap_pvt_thread_mutex_lock( &cp->cp_mutex );
+	dead = !--ce->ce_refs && ce->ce_dead;
+	ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+	if ( dead )
+		ch_free( ce );
+}
+
+static struct berval *
+mdb_cache_vals( struct berval *vals, unsigned n, struct berval **bvp, char **pp )
+{
+	struct berval *bv = *bvp, *ret = bv;
+	char *ptr = *pp;
+	unsigned i;
+
+	for ( i = 0; i < n; i++, bv++ ) {
+		bv->bv_len = vals[i].bv_len;
+		bv->bv_val = ptr;
+		memcpy( ptr, vals[i].bv_val, bv->bv_len );
+		ptr += bv->bv_len;
+		*ptr++ = '\0';
+	}
+	BER_BVZERO( bv );
+	*bvp = bv + 1;
+	*pp = ptr;
+	return ret;
+}
+
+/* Copy the attributes of a decoded entry into one block */
+static mdb_centry *
+mdb_cache_copy( Entry *e )
+{
+	mdb_centry *ce;
+	Attribute *a, *b;
+	struct berval *bv;
+	char *ptr;
+	size_t len = 0;
+	int nattrs = 0, nvals = 0;
+	unsigned i;
+
+	for ( a = e->e_attrs; a; a = a->a_next ) {
+		nattrs++;
+		nvals += a->a_numvals + 1;
+		for ( i = 0; i < a->a_numvals; i++ )
+			len += a->a_vals[i].bv_len + 1;
+		if ( a->a_nvals != a->a_vals ) {
+			nvals += a->a_numvals + 1;
+			for ( i = 0; i < a->a_numvals; i++ )
+				len += a->a_nvals[i].bv_len + 1;
+		}
+	}
+
+	ce = ch_malloc( sizeof( mdb_centry ) + nattrs * sizeof( Attribute ) +
+		nvals * sizeof( struct berval ) + len );
+	b = (Attribute *)(ce + 1);
+	bv = (struct berval *)(b + nattrs);
+	ptr = (char *)(bv + nvals);
+
+	ce->ce_attrs = nattrs ? b : NULL;
+	for ( a = e->e_attrs; a; a = a->a_next, b++ ) {
+		*b = *a;
+		b->a_flags = ( a->a_flags & ( SLAP_ATTR_SORTED_VALS|SLAP_ATTR_BIG_MULTI )) |
+			SLAP_ATTR_DONT_FREE_DATA | SLAP_ATTR_DONT_FREE_VALS;
+		b->a_vals = mdb_cache_vals( a->a_vals, a->a_numvals, &bv, &ptr );
+		if ( a->a_nvals != a->a_vals )
+			b->a_nvals = mdb_cache_vals( a->a_nvals, a->a_numvals, &bv, &ptr );
+		else
+			b->a_nvals = b->a_vals;
+		b->a_next = a->a_next ? b + 1 : NULL;
+	}
+	ce->ce_ocflags = e->e_ocflags;
+	ce->ce_refs = 0;
+	ce->ce_dead = 0;
+	return ce;
+}
+
+/* Evict unused entries from the end of the LRU list; caller holds cp_mutex */
+static void
+mdb_cache_purge( mdb_cpart *cp )
+{
+	mdb_centry *ce, *prev;
+
+	for ( ce = cp->cp_ltail; ce && cp->cp_count > cp->cp_max; ce = prev ) {
+		prev = ce->ce_lprev;
+		if ( ce->ce_refs )
+			continue;
+		mdb_cache_unlink( cp, ce );
+		ch_free( ce );
+	}
+}
+
+/* Offer an entry just decoded by a reader to the cache */
+void
+mdb_cache_add( Operation *op, MDB_txn *txn, ID id, Entry *e )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	mdb_cpart *cp;
+	mdb_centry *ce;
+	Attribute *a;
+	size_t txnid;
+
+	if ( !mdb_cache_reader( op, mdb ))
+		return;
+
+	/* don't let huge multi-valued attributes crowd out everything else */
+	for ( a = e->e_attrs; a; a = a->a_next ) {
+		if ( a->a_flags & SLAP_ATTR_BIG_MULTI )
+			return;
+	}
+
+	txnid = mdb_txn_id( txn );
+	cp = CACHE_PART( mdb->mi_cache, id );
+	ldap_pvt_thread_mutex_lock( &cp->cp_mutex );
+	if ( cp->cp_wtxn > txnid || mdb_cache_lookup( cp, id )) {
+		ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+		return;
+	}
+	ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+
+	ce = mdb_cache_copy( e );
+	ce->ce_id = id;
+	ce->ce_txnid = txnid;
+	ce->ce_part = cp;
+
+	ldap_pvt_thread_mutex_lock( &cp->cp_mutex );
+	/* check again, someone may have beaten us to it */
+	if ( cp->cp_wtxn > txnid || mdb_cache_lookup( cp, id )) {
+		ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+		ch_free( ce );
+		return;
+	}
+	ce->ce_next = *CACHE_HASH( cp, ce->ce_id );
+	*CACHE_HASH( cp, ce->ce_id ) = ce;
+	mdb_cache_lru_head( cp, ce );
+	cp->cp_count++;
+	if ( cp->cp_count > cp->cp_max )
+		mdb_cache_purge( cp );
+	ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+}
+
+/* A writer is about to store or delete entry id */
+void
+mdb_cache_delete( struct mdb_info *mdb, MDB_txn *txn, ID id )
+{
+	mdb_cpart *cp = CACHE_PART( mdb->mi_cache, id );
+	mdb_centry *ce;
+	size_t txnid = mdb_txn_id( txn );
+
+	ldap_pvt_thread_mutex_lock( &cp->cp_mutex );
+	if ( cp->cp_wtxn < txnid )
+		cp->cp_wtxn = txnid;
+	ce = mdb_cache_lookup( cp, id );
+	if ( ce ) {
+		mdb_cache_unlink( cp, ce );
+		if ( ce->ce_refs )
+			ce->ce_dead = 1;
+		else
+			ch_free( ce );
+	}
+	ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+}
+
+void
+mdb_cache_stat( struct mdb_info *mdb, unsigned long *hits,
+	unsigned long *misses, unsigned long *entries )
+{
+	struct mdb_cache *mc = mdb->mi_cache;
+	unsigned i;
+
+	*hits = *misses = *entries = 0;
+	if ( !mc )
+		return;
+	for ( i = 0; i < MDB_CACHE_PARTS; i++ ) {
+		mdb_cpart *cp = &mc->mc_parts[i];
+		ldap_pvt_thread_mutex_lock( &cp->cp_mutex );
+		*hits += cp->cp_hits;
+		*misses += cp->cp_misses;
+		*entries += cp->cp_count;
+		ldap_pvt_thread_mutex_unlock( &cp->cp_mutex );
+	}
+}
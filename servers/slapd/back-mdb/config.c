@@ -22,6 +22,7 @@
 #include <ac/errno.h>
 
 #include "back-mdb.h"
+#include "idl.h"
 
 #include "config.h"
 
@@ -34,11 +35,17 @@ enum {
 	MDB_CHKPT = 1,
 	MDB_DIRECTORY,
 	MDB_DBNOSYNC,
+	MDB_ENTRYCACHE,
 	MDB_ENVFLAGS,
+	MDB_GROUPCOMMIT,
+	MDB_IDLEXP,
+	MDB_IDLFMT,
 	MDB_INDEX,
+	MDB_IXHASH,
 	MDB_MAXREADERS,
 	MDB_MAXSIZE,
 	MDB_MODE,
+	MDB_SCRUB,
 	MDB_SSTACK,
 };
 
@@ -56,16 +63,38 @@ static ConfigTable mdbcfg[] = {
 		mdb_cf_gen, "( OLcfgDbAt:1.4 NAME 'olcDbNoSync' "
 			"DESC 'Disable synchronous database writes' "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "entrycache", "entries", 2, 2, 0, ARG_UINT|ARG_MAGIC|MDB_ENTRYCACHE,
+		mdb_cf_gen, "( OLcfgDbAt:12.12 NAME 'olcDbEntryCache' "
+		"DESC 'Number of decoded entries to cache for readers' "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "envflags", "flags", 2, 0, 0, ARG_MAGIC|MDB_ENVFLAGS,
 		mdb_cf_gen, "( OLcfgDbAt:12.3 NAME 'olcDbEnvFlags' "
 			"DESC 'Database environment flags' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "groupcommit", "ops> <usec", 3, 3, 0, ARG_MAGIC|MDB_GROUPCOMMIT,
+		mdb_cf_gen, "( OLcfgDbAt:12.11 NAME 'olcDbGroupCommit' "
+		"DESC 'Maximum write operations per commit, and microseconds to wait for them' "
+		"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
+	{ "idlexp", "exponent", 2, 2, 0, ARG_UINT|ARG_MAGIC|MDB_IDLEXP,
+		mdb_cf_gen, "( OLcfgDbAt:12.13 NAME 'olcDbIDLExp' "
+		"DESC 'Log2 of the number of IDs an index key holds before it becomes a range' "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "idlformat", "range|bitmap", 2, 2, 0, ARG_MAGIC|MDB_IDLFMT,
+		mdb_cf_gen, "( OLcfgDbAt:12.14 NAME 'olcDbIDLFormat' "
+		"DESC 'How full index keys of a new or fully reindexed DB are stored' "
+		"EQUALITY caseIgnoreMatch "
+		"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ "index", "attr> <[pres,eq,approx,sub]", 2, 3, 0, ARG_MAGIC|MDB_INDEX,
 		mdb_cf_gen, "( OLcfgDbAt:0.2 NAME 'olcDbIndex' "
 		"DESC 'Attribute index parameters' "
 		"EQUALITY caseIgnoreMatch "
 		"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "indexhash", "fnv|fnv64|wyhash", 2, 2, 0, ARG_MAGIC|MDB_IXHASH,
+		mdb_cf_gen, "( OLcfgDbAt:12.9 NAME 'olcDbIndexHash' "
+		"DESC 'Hash function for index keys of a new or fully reindexed DB' "
+		"EQUALITY caseIgnoreMatch "
+		"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ "maxentrysize", "size", 2, 2, 0, ARG_ULONG|ARG_OFFSET,
 		(void *)offsetof(struct mdb_info, mi_maxentrysize),
 		"( OLcfgDbAt:12.4 NAME 'olcDbMaxEntrySize' "
@@ -98,10 +127,19 @@ static ConfigTable mdbcfg[] = {
 		"( OLcfgDbAt:12.5 NAME 'olcDbRtxnSize' "
 		"DESC 'Number of entries to process in one read transaction' "
 		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "scrub", "pages> <min", 3, 3, 0, ARG_MAGIC|MDB_SCRUB,
+		mdb_cf_gen, "( OLcfgDbAt:12.10 NAME 'olcDbScrub' "
+		"DESC 'Page checksum verification rate in pages per second and interval in minutes' "
+		"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ "searchstack", "depth", 2, 2, 0, ARG_INT|ARG_MAGIC|MDB_SSTACK,
 		mdb_cf_gen, "( OLcfgDbAt:1.9 NAME 'olcDbSearchStack' "
 		"DESC 'Depth of search stack in IDLs' "
 		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "searchthreads", "num", 2, 2, 0, ARG_UINT|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_search_threads),
+		"( OLcfgDbAt:12.8 NAME 'olcDbSearchThreads' "
+		"DESC 'Number of threads scanning the candidates of one search' "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED,
 		NULL, NULL, NULL, NULL }
 };
@@ -116,7 +154,9 @@ static ConfigOCs mdbocs[] = {
 		"MAY ( olcDbCheckpoint $ olcDbEnvFlags $ "
 		"olcDbNoSync $ olcDbIndex $ olcDbMaxReaders $ olcDbMaxSize $ "
 		"olcDbMode $ olcDbSearchStack $ olcDbMaxEntrySize $ olcDbRtxnSize $ "
-		"olcDbMultivalHi $ olcDbMultivalLo ) )",
+		"olcDbMultivalHi $ olcDbMultivalLo $ olcDbSearchThreads $ olcDbIndexHash $ "
+		"olcDbScrub $ olcDbGroupCommit $ olcDbEntryCache $ olcDbIDLExp $ "
+		"olcDbIDLFormat ) )",
 		 	Cft_Database, mdbcfg },
 	{ NULL, 0, NULL }
 };
@@ -127,6 +167,22 @@ static slap_verbmasks mdb_envflags[] = {
 	{ BER_BVC("writemap"),	MDB_WRITEMAP },
 	{ BER_BVC("mapasync"),	MDB_MAPASYNC },
 	{ BER_BVC("nordahead"),	MDB_NORDAHEAD },
+	{ BER_BVC("checksum"),	MDB_PAGECRC },
+	{ BER_BVC("pagetxn"),	MDB_PAGETXN },
+	{ BER_BVC("verify"),	MDB_PAGEVERIFY },
+	{ BER_BVNULL, 0 }
+};
+
+static slap_verbmasks mdb_ixhashes[] = {
+	{ BER_BVC("fnv"),	SLAP_INDEX_HASH_FNV32 },
+	{ BER_BVC("fnv64"),	SLAP_INDEX_HASH_FNV64 },
+	{ BER_BVC("wyhash"),	SLAP_INDEX_HASH_W64 },
+	{ BER_BVNULL, 0 }
+};
+
+static slap_verbmasks mdb_idlfmts[] = {
+	{ BER_BVC("range"),	MDB_IDLFMT_RANGE },
+	{ BER_BVC("bitmap"),	MDB_IDLFMT_BITMAP },
 	{ BER_BVNULL, 0 }
 };
 
@@ -321,6 +377,40 @@ mdb_cf_gen( ConfigArgs *c )
 			}
 			break;
 
+		case MDB_GROUPCOMMIT:
+			if ( mdb->mi_gc_ops ) {
+				char buf[64];
+				struct berval bv;
+				bv.bv_len = snprintf( buf, sizeof(buf), "%u %u",
+					mdb->mi_gc_ops, mdb->mi_gc_usec );
+				if ( bv.bv_len > 0 && bv.bv_len < sizeof(buf) ) {
+					bv.bv_val = buf;
+					value_add_one( &c->rvalue_vals, &bv );
+				} else {
+					rc = 1;
+				}
+			} else {
+				rc = 1;
+			}
+			break;
+
+		case MDB_SCRUB:
+			if ( mdb->mi_scrub ) {
+				char buf[64];
+				struct berval bv;
+				bv.bv_len = snprintf( buf, sizeof(buf), "%u %u",
+					mdb->mi_scrub_rate, mdb->mi_scrub_min );
+				if ( bv.bv_len > 0 && bv.bv_len < sizeof(buf) ) {
+					bv.bv_val = buf;
+					value_add_one( &c->rvalue_vals, &bv );
+				} else {
+					rc = 1;
+				}
+			} else {
+				rc = 1;
+			}
+			break;
+
 		case MDB_DIRECTORY:
 			if ( mdb->mi_dbenv_home ) {
 				c->value_string = ch_strdup( mdb->mi_dbenv_home );
@@ -346,6 +436,26 @@ mdb_cf_gen( ConfigArgs *c )
 			if ( !c->rvalue_vals ) rc = 1;
 			break;
 
+		case MDB_IXHASH:
+			if ( mdb->mi_ixhash_cf ) {
+				struct berval bv;
+				enum_to_verb( mdb_ixhashes, mdb->mi_ixhash_cf, &bv );
+				value_add_one( &c->rvalue_vals, &bv );
+			} else {
+				rc = 1;
+			}
+			break;
+
+		case MDB_IDLFMT:
+			if ( mdb->mi_idlfmt_cf ) {
+				struct berval bv;
+				enum_to_verb( mdb_idlfmts, mdb->mi_idlfmt_cf, &bv );
+				value_add_one( &c->rvalue_vals, &bv );
+			} else {
+				rc = 1;
+			}
+			break;
+
 		case MDB_SSTACK:
 			c->value_int = mdb->mi_search_stack_depth;
 			break;
@@ -354,6 +464,18 @@ mdb_cf_gen( ConfigArgs *c )
 			c->value_int = mdb->mi_readers;
 			break;
 
+		case MDB_ENTRYCACHE:
+			c->value_uint = mdb->mi_cache_max;
+			break;
+
+		/* the sizes in effect, which all databases share */
+		case MDB_IDLEXP:
+			if ( MDB_idl_logn != MDB_IDL_LOGN )
+				c->value_uint = MDB_idl_logn;
+			else
+				rc = 1;
+			break;
+
 		case MDB_MAXSIZE:
 			c->value_ulong = mdb->mi_mapsize;
 			break;
@@ -370,6 +492,25 @@ mdb_cf_gen( ConfigArgs *c )
 			break;
 #endif
 
+		case MDB_IXHASH:
+			mdb->mi_ixhash_cf = 0;
+			break;
+
+		case MDB_IDLFMT:
+			mdb->mi_idlfmt_cf = 0;
+			break;
+
+		/* running searches depend on the IDL sizes */
+		case MDB_IDLEXP:
+			if ( slapMode & SLAP_SERVER_RUNNING ) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"%s: cannot be changed while slapd is running",
+					c->argv[0] );
+				Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+				rc = 1;
+			}
+			break;
+
 		/* single-valued no-ops */
 		case MDB_SSTACK:
 		case MDB_MAXREADERS:
@@ -388,6 +529,20 @@ mdb_cf_gen( ConfigArgs *c )
 			}
 			mdb->mi_txn_cp = 0;
 			break;
+		case MDB_GROUPCOMMIT:
+			/* a group already open still commits as usual */
+			mdb->mi_gc_ops = 0;
+			mdb->mi_gc_usec = 0;
+			break;
+		case MDB_SCRUB:
+			if ( mdb->mi_flags & MDB_IS_OPEN )
+				mdb_env_scrub_stop( mdb->mi_dbenv );
+			mdb->mi_scrub = 0;
+			break;
+		case MDB_ENTRYCACHE:
+			mdb->mi_cache_max = 0;
+			mdb_cache_destroy( mdb );
+			break;
 		case MDB_DIRECTORY:
 			mdb->mi_flags |= MDB_RE_OPEN;
 			ch_free( mdb->mi_dbenv_home );
@@ -574,6 +729,58 @@ mdb_cf_gen( ConfigArgs *c )
 		}
 		} break;
 
+	case MDB_GROUPCOMMIT: {
+		unsigned ops, usec;
+		if ( lutil_atoux( &ops, c->argv[1], 0 ) != 0 || ops < 2 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: invalid number of operations \"%s\"",
+				c->argv[0], c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		if ( lutil_atoux( &usec, c->argv[2], 0 ) != 0 || usec > 1000000 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: invalid microseconds \"%s\"",
+				c->argv[0], c->argv[2] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		mdb->mi_gc_usec = usec;
+		mdb->mi_gc_ops = ops;
+		} break;
+
+	case MDB_SCRUB: {
+		unsigned rate, min;
+		if ( lutil_atoux( &rate, c->argv[1], 0 ) != 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: invalid pages per second \"%s\"",
+				c->argv[0], c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		if ( lutil_atoux( &min, c->argv[2], 0 ) != 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: invalid minutes \"%s\"",
+				c->argv[0], c->argv[2] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		mdb->mi_scrub = 1;
+		mdb->mi_scrub_rate = rate;
+		mdb->mi_scrub_min = min;
+		if ( mdb->mi_flags & MDB_IS_OPEN ) {
+			rc = mdb_env_scrub_start( mdb->mi_dbenv, rate, min * 60 );
+			if ( rc ) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"%s: cannot start scrubbing: %s",
+					c->argv[0], mdb_strerror( rc ));
+				Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+				mdb->mi_scrub = 0;
+				return 1;
+			}
+		}
+		} break;
+
 	case MDB_DIRECTORY: {
 		FILE *f;
 		char *ptr, *testpath;
@@ -619,6 +826,21 @@ mdb_cf_gen( ConfigArgs *c )
 		int i, j;
 		for ( i=1; i<c->argc; i++ ) {
 			j = verb_to_mask( c->argv[i], mdb_envflags );
+			if (( mdb_envflags[j].mask & ( MDB_PAGECRC|MDB_PAGETXN )) &&
+				( mdb->mi_flags & MDB_IS_OPEN )) {
+				unsigned int envflags;
+				/* only set when the database is created, never reopen for it */
+				mdb_env_get_flags( mdb->mi_dbenv, &envflags );
+				if ( !( envflags & mdb_envflags[j].mask )) {
+					snprintf( c->cr_msg, sizeof( c->cr_msg ),
+						"%s: \"%s\" requires reloading the database",
+						c->argv[0], c->argv[i] );
+					Debug( LDAP_DEBUG_ANY, "%s %s\n", c->log, c->cr_msg, 0 );
+					return 1;
+				}
+				mdb->mi_dbenv_flags |= mdb_envflags[j].mask;
+				continue;
+			}
 			if ( mdb_envflags[j].mask ) {
 				if ( mdb->mi_flags & MDB_IS_OPEN )
 					rc = mdb_env_set_flags( mdb->mi_dbenv, mdb_envflags[j].mask, 1 );
@@ -668,6 +890,32 @@ mdb_cf_gen( ConfigArgs *c )
 		}
 		break;
 
+	case MDB_IXHASH: {
+		int i = verb_to_mask( c->argv[1], mdb_ixhashes );
+		if ( !mdb_ixhashes[i].mask ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ), "%s: unknown hash \"%s\"",
+				c->argv[0], c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		/* an open DB keeps the hash its keys were written with */
+		mdb->mi_ixhash_cf = mdb_ixhashes[i].mask;
+		}
+		break;
+
+	case MDB_IDLFMT: {
+		int i = verb_to_mask( c->argv[1], mdb_idlfmts );
+		if ( !mdb_idlfmts[i].mask ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ), "%s: unknown format \"%s\"",
+				c->argv[0], c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		/* likewise, an open DB keeps the format of its slots */
+		mdb->mi_idlfmt_cf = mdb_idlfmts[i].mask;
+		}
+		break;
+
 	case MDB_SSTACK:
 		if ( c->value_int < MINIMUM_SEARCH_STACK_DEPTH ) {
 			fprintf( stderr,
@@ -678,6 +926,43 @@ mdb_cf_gen( ConfigArgs *c )
 		mdb->mi_search_stack_depth = c->value_int;
 		break;
 
+	case MDB_ENTRYCACHE:
+		mdb->mi_cache_max = c->value_uint;
+		/* no operations are running while we're called */
+		if (( mdb->mi_flags & MDB_IS_OPEN ) && !( slapMode & SLAP_TOOL_MODE ))
+			mdb_cache_init( mdb );
+		break;
+
+	case MDB_IDLEXP:
+		if ( c->value_uint < MDB_IDL_LOGN || c->value_uint > MDB_IDL_LOGN_MAX ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: exponent must be between %d and %d",
+				c->argv[0], MDB_IDL_LOGN, MDB_IDL_LOGN_MAX );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		/* The sizes are shared by all databases, and the buffers
+		 * of running searches are sized by them.
+		 */
+		if ( c->value_uint < MDB_idl_logn ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: is below the %u already in effect for all mdb databases",
+				c->argv[0], MDB_idl_logn );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+			return 1;
+		}
+		if ( c->value_uint > MDB_idl_logn ) {
+			if ( slapMode & SLAP_SERVER_RUNNING ) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"%s: cannot be changed while slapd is running",
+					c->argv[0] );
+				Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg, 0 );
+				return 1;
+			}
+			mdb_idl_reset( c->value_uint );
+		}
+		break;
+
 	case MDB_MAXREADERS:
 		mdb->mi_readers = c->value_int;
 		if ( mdb->mi_flags & MDB_IS_OPEN ) {
@@ -25,6 +25,9 @@
 #include <component.h>
 #endif
 
+/* An AND stops reading indices once it is down to this many candidates */
+#define MDB_AND_SHORTCUT	16
+
 static int presence_candidates(
 	Operation *op,
 	MDB_txn *rtxn,
@@ -374,7 +377,7 @@ comp_equality_candidates (
 
 	rc = (ca->ca_ma_rule->smr_filter)(
 				LDAP_FILTER_EQUALITY,
-				cr->cr_indexmask,
+				cr->cr_indexmask | ( mask & SLAP_INDEX_HASH_MASK ),
 				sat_syntax,
 				ca->ca_ma_rule,
 				&prefix,
@@ -558,6 +561,160 @@ base:
 	return 0;
 }
 
+/* Estimate how many IDs the index keys for one assertion would yield,
+ * as the smallest key count; NOID if the assertion isn't indexed.
+ */
+static ID
+keys_estimate(
+	Operation *op,
+	MDB_txn *rtxn,
+	AttributeDescription *desc,
+	int ftype,
+	MatchingRule *mr,
+	void *assertion )
+{
+	MDB_dbi dbi;
+	slap_mask_t mask;
+	struct berval prefix = {0, NULL};
+	struct berval *keys = NULL;
+	ID est = NOID, count;
+	int i, rc;
+
+	rc = mdb_index_param( op->o_bd, desc, ftype, &dbi, &mask, &prefix );
+	if ( rc != LDAP_SUCCESS )
+		return NOID;
+
+	if ( ftype == LDAP_FILTER_PRESENT ) {
+		if ( prefix.bv_val == NULL )
+			return NOID;
+		rc = mdb_key_count( rtxn, dbi, &prefix, &est );
+		if ( rc == MDB_NOTFOUND )
+			est = 0;
+		else if ( rc != 0 )
+			est = NOID;
+		return est;
+	}
+
+	if ( !mr || !mr->smr_filter )
+		return NOID;
+
+	rc = (mr->smr_filter)( ftype, mask, desc->ad_type->sat_syntax, mr,
+		&prefix, assertion, &keys, op->o_tmpmemctx );
+	if ( rc != LDAP_SUCCESS || keys == NULL )
+		return NOID;
+
+	for ( i = 0; keys[i].bv_val != NULL; i++ ) {
+		rc = mdb_key_count( rtxn, dbi, &keys[i], &count );
+		if ( rc == MDB_NOTFOUND ) {
+			est = 0;
+			break;
+		}
+		if ( rc == 0 && count < est )
+			est = count;
+	}
+	ber_bvarray_free_x( keys, op->o_tmpmemctx );
+
+	return est;
+}
+
+/* Estimate the number of candidates a filter will produce, using
+ * only index key counts. NOID means no useful estimate.
+ */
+static ID
+filter_estimate(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter *f )
+{
+	AttributeDescription *desc;
+	MatchingRule *mr;
+	Filter *f2;
+	ID est, sub;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return 0;
+
+	switch ( f->f_choice ) {
+	case SLAPD_FILTER_COMPUTED:
+		return f->f_result == LDAP_COMPARE_TRUE ||
+			f->f_result == LDAP_SUCCESS ? NOID : 0;
+
+	case LDAP_FILTER_PRESENT:
+		if ( f->f_desc == slap_schema.si_ad_objectClass )
+			return NOID;
+		return keys_estimate( op, rtxn, f->f_desc,
+			LDAP_FILTER_PRESENT, NULL, NULL );
+
+	case LDAP_FILTER_EQUALITY:
+		desc = f->f_ava->aa_desc;
+		if ( desc == slap_schema.si_ad_entryDN )
+			return 1;
+#ifdef LDAP_COMP_MATCH
+		if ( is_aliased_attribute && is_aliased_attribute( desc ))
+			return NOID;
+#endif
+		return keys_estimate( op, rtxn, desc, LDAP_FILTER_EQUALITY,
+			desc->ad_type->sat_equality, &f->f_ava->aa_value );
+
+	case LDAP_FILTER_APPROX:
+		desc = f->f_ava->aa_desc;
+		mr = desc->ad_type->sat_approx;
+		if ( !mr )
+			mr = desc->ad_type->sat_equality;
+		return keys_estimate( op, rtxn, desc, LDAP_FILTER_APPROX,
+			mr, &f->f_ava->aa_value );
+
+	case LDAP_FILTER_SUBSTRINGS:
+		desc = f->f_sub->sa_desc;
+		return keys_estimate( op, rtxn, desc, LDAP_FILTER_SUBSTRINGS,
+			desc->ad_type->sat_substr, f->f_sub );
+
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+		/* bounded by the presence index, if there is one */
+		return keys_estimate( op, rtxn, f->f_ava->aa_desc,
+			LDAP_FILTER_PRESENT, NULL, NULL );
+
+	case LDAP_FILTER_AND:
+		est = NOID;
+		for ( f2 = f->f_and; f2 != NULL; f2 = f2->f_next ) {
+			sub = filter_estimate( op, rtxn, f2 );
+			if ( sub < est )
+				est = sub;
+			if ( est == 0 )
+				break;
+		}
+		return est;
+
+	case LDAP_FILTER_OR:
+		est = 0;
+		for ( f2 = f->f_or; f2 != NULL; f2 = f2->f_next ) {
+			/* precomputed scopes are skipped by list_candidates */
+			if ( f2->f_choice == SLAPD_FILTER_COMPUTED &&
+				f2->f_result == LDAP_SUCCESS )
+				continue;
+			sub = filter_estimate( op, rtxn, f2 );
+			if ( sub >= NOID - est )
+				return NOID;
+			est += sub;
+		}
+		return est;
+
+	case LDAP_FILTER_EXT:
+		if ( f->f_mra->ma_desc == slap_schema.si_ad_entryDN &&
+			f->f_mra->ma_rule == slap_schema.si_mr_distinguishedNameMatch )
+			return 1;
+		return NOID;
+	}
+
+	return NOID;
+}
+
+typedef struct filter_plan {
+	Filter *fp_filter;
+	ID fp_est;
+} filter_plan;
+
 static int
 list_candidates(
 	Operation *op,
@@ -570,14 +727,71 @@ list_candidates(
 {
 	int rc = 0;
 	Filter	*f;
+	filter_plan *plan = NULL;
+	int i, j, n = 0, first = 1;
 
 	Debug( LDAP_DEBUG_FILTER, "=> mdb_list_candidates 0x%x\n", ftype, 0, 0 );
+
+	/* a leading precomputed scope has already been loaded into ids */
+	if ( flist && flist->f_choice == SLAPD_FILTER_COMPUTED &&
+		flist->f_result == LDAP_SUCCESS )
+		first = 0;
+
 	for ( f = flist; f != NULL; f = f->f_next ) {
 		/* ignore precomputed scopes */
 		if ( f->f_choice == SLAPD_FILTER_COMPUTED &&
 		     f->f_result == LDAP_SUCCESS ) {
 			continue;
 		}
+		n++;
+	}
+
+	/* Evaluate the components of an AND from the most selective to
+	 * the least, by their estimated number of candidates. OR
+	 * components are all needed anyway, so keep their order.
+	 */
+	if ( n ) {
+		plan = op->o_tmpalloc( n * sizeof(filter_plan), op->o_tmpmemctx );
+		for ( i = 0, f = flist; f != NULL; f = f->f_next ) {
+			if ( f->f_choice == SLAPD_FILTER_COMPUTED &&
+			     f->f_result == LDAP_SUCCESS ) {
+				continue;
+			}
+			plan[i].fp_filter = f;
+			plan[i].fp_est = ( ftype == LDAP_FILTER_AND && n > 1 ) ?
+				filter_estimate( op, rtxn, f ) : 0;
+			/* keep it stable, so ties stay in filter order */
+			for ( j = i; j > 0 && plan[j-1].fp_est > plan[i].fp_est; j-- ) ;
+			if ( j < i ) {
+				filter_plan fp = plan[i];
+				AC_MEMCPY( plan+j+1, plan+j, ( i - j ) * sizeof(filter_plan) );
+				plan[j] = fp;
+			}
+			i++;
+		}
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		f = plan[i].fp_filter;
+		if ( ftype == LDAP_FILTER_AND && n > 1 ) {
+			Debug( LDAP_DEBUG_FILTER,
+				"mdb_list_candidates: AND component %d, estimate %ld\n",
+				i, (long) plan[i].fp_est, 0 );
+
+			/* Once the candidates are few, testing them against the
+			 * whole filter is cheaper than reading more indices.
+			 */
+			if ( !first && MDB_IDL_IS_LIST( ids ) &&
+				ids[0] <= MDB_AND_SHORTCUT &&
+				plan[i].fp_est > ids[0] ) {
+				Debug( LDAP_DEBUG_FILTER,
+					"mdb_list_candidates: %ld candidates, skipping "
+					"%d remaining components\n",
+					(long) ids[0], n - i, 0 );
+				break;
+			}
+		}
+
 		MDB_IDL_ZERO( save );
 		rc = mdb_filter_candidates( op, rtxn, f, save, tmp,
 			save+MDB_IDL_UM_SIZE );
@@ -592,22 +806,27 @@ list_candidates(
 
 		
 		if ( ftype == LDAP_FILTER_AND ) {
-			if ( f == flist ) {
+			if ( first ) {
 				MDB_IDL_CPY( ids, save );
 			} else {
 				mdb_idl_intersection( ids, save );
 			}
+			first = 0;
 			if( MDB_IDL_IS_ZERO( ids ) )
 				break;
 		} else {
-			if ( f == flist ) {
+			if ( first ) {
 				MDB_IDL_CPY( ids, save );
 			} else {
 				mdb_idl_union( ids, save );
 			}
+			first = 0;
 		}
 	}
 
+	if ( plan )
+		op->o_tmpfree( plan, op->o_tmpmemctx );
+
 	if( rc == LDAP_SUCCESS ) {
 		Debug( LDAP_DEBUG_FILTER,
 			"<= mdb_list_candidates: id=%ld first=%ld last=%ld\n",
@@ -1171,3 +1390,188 @@ inequality_candidates(
 		(long) MDB_IDL_LAST(ids) );
 	return( rc );
 }
+
+/* Index probes.
+ *
+ * When the candidates of a search are only known as a range, every
+ * entry in the range or in the search scope has to be fetched and
+ * tested. The index keys of the filter can still rule most of them
+ * out: mdb_filter_probes() builds a tree of the filter's ANDs and ORs
+ * of indexed equality and presence assertions, and mdb_filter_probe()
+ * looks a single ID up under their keys. Anything that cannot be
+ * probed counts as a match, so an ID is only rejected if it could
+ * not have been a candidate either.
+ */
+static mdb_iprobe *
+probe_keys(
+	Operation *op,
+	MDB_txn *rtxn,
+	MDB_dbi dbi,
+	struct berval *keys,
+	BerVarray bvals )
+{
+	mdb_iprobe *ip;
+	int i, n;
+
+	for ( n = 0; keys[n].bv_val != NULL; n++ )
+		;
+
+	ip = op->o_tmpcalloc( 1, sizeof(mdb_iprobe), op->o_tmpmemctx );
+	ip->ip_bvals = bvals;
+	if ( !n || mdb_cursor_open( rtxn, dbi, &ip->ip_mc ) != 0 )
+		goto fail;
+
+	ip->ip_keys = op->o_tmpalloc( n * sizeof(mdb_ikey), op->o_tmpmemctx );
+	ip->ip_nkeys = n;
+	for ( i = 0; i < n; i++ ) {
+		if ( mdb_key_probe_init( ip->ip_mc, &keys[i], &ip->ip_keys[i] ))
+			goto fail;
+	}
+	return ip;
+
+fail:
+	mdb_filter_probes_free( op, ip );
+	return NULL;
+}
+
+mdb_iprobe *
+mdb_filter_probes(
+	Operation *op,
+	MDB_txn *rtxn,
+	Filter *f )
+{
+	mdb_iprobe *ip, *list = NULL, **next = &list;
+	Filter *g;
+	MDB_dbi dbi;
+	slap_mask_t mask;
+	struct berval prefix = BER_BVNULL, pkeys[2], *keys = NULL;
+	MatchingRule *mr;
+	int n = 0;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return NULL;
+
+	switch ( f->f_choice ) {
+	case LDAP_FILTER_PRESENT:
+		if ( f->f_desc == slap_schema.si_ad_objectClass )
+			return NULL;
+		if ( mdb_index_param( op->o_bd, f->f_desc, LDAP_FILTER_PRESENT,
+			&dbi, &mask, &prefix ) != LDAP_SUCCESS ||
+			prefix.bv_val == NULL )
+			return NULL;
+		pkeys[0] = prefix;
+		BER_BVZERO( &pkeys[1] );
+		return probe_keys( op, rtxn, dbi, pkeys, NULL );
+
+	case LDAP_FILTER_EQUALITY:
+		if ( f->f_av_desc == slap_schema.si_ad_entryDN )
+			return NULL;
+		if ( mdb_index_param( op->o_bd, f->f_av_desc, LDAP_FILTER_EQUALITY,
+			&dbi, &mask, &prefix ) != LDAP_SUCCESS )
+			return NULL;
+		mr = f->f_av_desc->ad_type->sat_equality;
+		if ( !mr || !mr->smr_filter )
+			return NULL;
+		if ( (mr->smr_filter)( LDAP_FILTER_EQUALITY, mask,
+			f->f_av_desc->ad_type->sat_syntax, mr, &prefix,
+			&f->f_av_value, &keys, op->o_tmpmemctx ) != LDAP_SUCCESS ||
+			keys == NULL )
+			return NULL;
+		return probe_keys( op, rtxn, dbi, keys, keys );
+
+	case LDAP_FILTER_AND:
+	case LDAP_FILTER_OR:
+		for ( g = f->f_list; g != NULL; g = g->f_next ) {
+			ip = mdb_filter_probes( op, rtxn, g );
+			if ( ip ) {
+				*next = ip;
+				next = &ip->ip_next;
+				n++;
+			} else if ( f->f_choice == LDAP_FILTER_OR ) {
+				/* this branch may match anything */
+				mdb_filter_probes_free( op, list );
+				return NULL;
+			}
+		}
+		if ( n < 2 )
+			return list;
+		ip = op->o_tmpcalloc( 1, sizeof(mdb_iprobe), op->o_tmpmemctx );
+		ip->ip_choice = f->f_choice;
+		ip->ip_list = list;
+		return ip;
+	}
+
+	return NULL;
+}
+
+/* Returns 0 if id cannot match the probed filter */
+int
+mdb_filter_probe(
+	mdb_iprobe *ip,
+	ID id )
+{
+	mdb_iprobe *jp;
+	int i;
+
+	switch ( ip->ip_choice ) {
+	case LDAP_FILTER_AND:
+		for ( jp = ip->ip_list; jp != NULL; jp = jp->ip_next ) {
+			if ( !mdb_filter_probe( jp, id ))
+				return 0;
+		}
+		return 1;
+
+	case LDAP_FILTER_OR:
+		for ( jp = ip->ip_list; jp != NULL; jp = jp->ip_next ) {
+			if ( mdb_filter_probe( jp, id ))
+				return 1;
+		}
+		return 0;
+	}
+
+	for ( i = 0; i < ip->ip_nkeys; i++ ) {
+		if ( mdb_key_probe( ip->ip_mc, &ip->ip_keys[i], id ) == MDB_NOTFOUND )
+			return 0;
+	}
+	return 1;
+}
+
+/* The read txn was reset and renewed */
+void
+mdb_filter_probes_renew(
+	MDB_txn *txn,
+	mdb_iprobe *ip )
+{
+	int i;
+
+	for ( ; ip != NULL; ip = ip->ip_next ) {
+		if ( ip->ip_list )
+			mdb_filter_probes_renew( txn, ip->ip_list );
+		if ( ip->ip_mc ) {
+			mdb_cursor_renew( txn, ip->ip_mc );
+			for ( i = 0; i < ip->ip_nkeys; i++ )
+				mdb_key_probe_reset( ip->ip_mc, &ip->ip_keys[i] );
+		}
+	}
+}
+
+void
+mdb_filter_probes_free(
+	Operation *op,
+	mdb_iprobe *ip )
+{
+	mdb_iprobe *next;
+
+	for ( ; ip != NULL; ip = next ) {
+		next = ip->ip_next;
+		if ( ip->ip_list )
+			mdb_filter_probes_free( op, ip->ip_list );
+		if ( ip->ip_mc )
+			mdb_cursor_close( ip->ip_mc );
+		if ( ip->ip_bvals )
+			ber_bvarray_free_x( ip->ip_bvals, op->o_tmpmemctx );
+		if ( ip->ip_keys )
+			op->o_tmpfree( ip->ip_keys, op->o_tmpmemctx );
+		op->o_tmpfree( ip, op->o_tmpmemctx );
+	}
+}
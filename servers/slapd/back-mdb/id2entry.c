@@ -223,6 +223,10 @@ static int mdb_id2entry_put(
 	if (mdb->mi_maxentrysize && ec.len > mdb->mi_maxentrysize)
 		return LDAP_ADMINLIMIT_EXCEEDED;
 
+	/* New IDs can't be in any reader's snapshot yet */
+	if ( mdb->mi_cache && !adding )
+		mdb_cache_delete( mdb, txn, e->e_id );
+
 again:
 	data.mv_size = ec.dlen;
 	if ( mc )
@@ -389,6 +393,9 @@ int mdb_id2entry_delete(
 	key.mv_data = &e->e_id;
 	key.mv_size = sizeof(ID);
 
+	if ( mdb->mi_cache )
+		mdb_cache_delete( mdb, tid, e->e_id );
+
 	/* delete from database */
 	rc = mdb_del( tid, dbi, &key, NULL );
 	if (rc)
@@ -445,6 +452,8 @@ int mdb_entry_return(
 	if ( !e )
 		return 0;
 	if ( e->e_private ) {
+		if ( mdb_cache_entry( e ))
+			mdb_cache_release( e );
 		if ( op->o_hdr && op->o_tmpmfuncs ) {
 			op->o_tmpfree( e->e_nname.bv_val, op->o_tmpmemctx );
 			op->o_tmpfree( e->e_name.bv_val, op->o_tmpmemctx );
@@ -604,6 +613,257 @@ mdb_reader_flush( MDB_env *env )
 
 extern MDB_txn *mdb_tool_txn;
 
+/* Group commit: concurrent write ops share one txn and one sync.
+ * The first op to arrive begins the shared txn and becomes the
+ * leader. Each member, the leader included, does its work in a
+ * nested txn, one at a time, so it can still fail alone. Once its
+ * own op is done the leader lets in more members while any member
+ * is still running, up to mi_gc_usec or until mi_gc_ops have joined,
+ * then commits the shared txn itself, since only the thread that
+ * began it may. No member returns a result until that commit is done.
+ */
+
+static long
+mdb_gc_remaining( struct mdb_info *mdb, mdb_gcbatch *gb )
+{
+	struct timeval now;
+	long usec;
+
+	gettimeofday( &now, NULL );
+	usec = ( now.tv_sec - gb->gb_start.tv_sec ) * 1000000L +
+		now.tv_usec - gb->gb_start.tv_usec;
+	return (long)mdb->mi_gc_usec - usec;
+}
+
+/* Stop new ops from joining gb. Caller holds mi_gc_mutex. */
+static void
+mdb_gc_close( struct mdb_info *mdb, mdb_gcbatch *gb )
+{
+	gb->gb_closed = 1;
+	if ( mdb->mi_gc_batch == gb )
+		mdb->mi_gc_batch = NULL;
+	ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+}
+
+/* Forget gb once the op has seen its outcome. Caller holds mi_gc_mutex. */
+static void
+mdb_gc_release( mdb_gcbatch *gb, mdb_op_info *moi )
+{
+	if ( --gb->gb_refs == 0 )
+		ch_free( gb );
+	moi->moi_gc = NULL;
+	moi->moi_flag &= ~MOI_LEADER;
+}
+
+/* End an op's nested txn. If it was committed, wait for the outcome
+ * of the shared txn; the leader commits the shared txn here.
+ */
+static int
+mdb_gc_leave( struct mdb_info *mdb, mdb_op_info *moi, int commit )
+{
+	mdb_gcbatch *gb = moi->moi_gc;
+	long usec;
+	int rc = 0;
+
+	if ( moi->moi_txn ) {
+		if ( commit )
+			rc = mdb_txn_commit( moi->moi_txn );
+		else
+			mdb_txn_abort( moi->moi_txn );
+		moi->moi_txn = NULL;
+		/* still the only member using the shared txn */
+		if ( rc || !commit )
+			mdb->mi_numads = moi->moi_numads;
+	} else {
+		commit = 0;
+	}
+
+	ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+	gb->gb_busy = 0;
+	gb->gb_live--;
+	ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+
+	if ( moi->moi_flag & MOI_LEADER ) {
+		/* members signal mi_gc_cond as they join and leave */
+		while ( !gb->gb_closed ) {
+			usec = mdb_gc_remaining( mdb, gb );
+			/* commit at once if no other member is running */
+			if ( usec <= 0 || gb->gb_ops >= mdb->mi_gc_ops || !gb->gb_live ) {
+				mdb_gc_close( mdb, gb );
+				break;
+			}
+			ldap_pvt_thread_cond_timedwait( &mdb->mi_gc_cond,
+				&mdb->mi_gc_mutex, usec );
+		}
+		/* everyone who joined must finish first */
+		while ( gb->gb_live )
+			ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+		ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+
+		gb->gb_rc = mdb_txn_commit( gb->gb_txn );
+		gb->gb_txn = NULL;
+
+		ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+		if ( gb->gb_rc ) {
+			Debug( LDAP_DEBUG_ANY,
+				"mdb_gc_leave: commit of %d ops failed: %s (%d)\n",
+				gb->gb_ops, mdb_strerror(gb->gb_rc), gb->gb_rc );
+			/* reload the attribute list on next use */
+			mdb->mi_numads = 0;
+		}
+		gb->gb_done = 1;
+		ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+	} else if ( commit && !rc ) {
+		while ( !gb->gb_done )
+			ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+	}
+	if ( commit && !rc )
+		rc = gb->gb_rc;
+	mdb_gc_release( gb, moi );
+	ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+
+	return rc;
+}
+
+/* Join the open group, or start a new one, and begin a nested txn */
+static int
+mdb_gc_join( struct mdb_info *mdb, mdb_op_info *moi )
+{
+	mdb_gcbatch *gb;
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+	/* if the open group is full, wait for the next one */
+	while (( gb = mdb->mi_gc_batch ) && gb->gb_ops >= mdb->mi_gc_ops )
+		ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+
+	if ( !gb ) {
+		gb = ch_calloc( 1, sizeof( mdb_gcbatch ));
+		gb->gb_ops = gb->gb_live = gb->gb_refs = 1;
+		gb->gb_busy = 1;
+		mdb->mi_gc_batch = gb;
+		moi->moi_gc = gb;
+		moi->moi_flag |= MOI_LEADER;
+		ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+
+		/* may wait for a previous group to finish its commit */
+		rc = mdb_txn_begin( mdb->mi_dbenv, NULL, 0, &gb->gb_txn );
+		gettimeofday( &gb->gb_start, NULL );
+		if ( rc ) {
+			ldap_pvt_thread_mutex_lock( &mdb->mi_gc_mutex );
+			gb->gb_txn = NULL;
+			gb->gb_rc = rc;
+			gb->gb_done = 1;
+			gb->gb_busy = 0;
+			gb->gb_live--;
+			mdb_gc_close( mdb, gb );
+			mdb_gc_release( gb, moi );
+			ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+			return rc;
+		}
+	} else {
+		gb->gb_ops++;
+		gb->gb_live++;
+		gb->gb_refs++;
+		moi->moi_gc = gb;
+		/* the leader may be waiting for a full group */
+		ldap_pvt_thread_cond_broadcast( &mdb->mi_gc_cond );
+		while ( gb->gb_busy && !gb->gb_done )
+			ldap_pvt_thread_cond_wait( &mdb->mi_gc_cond, &mdb->mi_gc_mutex );
+		if ( gb->gb_done ) {
+			/* the leader couldn't begin the shared txn */
+			rc = gb->gb_rc;
+			gb->gb_live--;
+			mdb_gc_release( gb, moi );
+			ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+			return rc;
+		}
+		gb->gb_busy = 1;
+		ldap_pvt_thread_mutex_unlock( &mdb->mi_gc_mutex );
+	}
+
+	rc = mdb_txn_begin( mdb->mi_dbenv, gb->gb_txn, 0, &moi->moi_txn );
+	if ( rc ) {
+		moi->moi_txn = NULL;
+		mdb_gc_leave( mdb, moi, 0 );
+		return rc;
+	}
+	moi->moi_numads = mdb->mi_numads;
+	return 0;
+}
+
+/* Commit the write txn of an op, as a member of its group if any.
+ * The changes are durable once this returns success.
+ */
+int
+mdb_opinfo_commit( struct mdb_info *mdb, mdb_op_info *moi )
+{
+	int rc, i;
+
+	if ( moi->moi_gc ) {
+		rc = mdb_gc_leave( mdb, moi, 1 );
+	} else {
+		rc = mdb_txn_commit( moi->moi_txn );
+		moi->moi_txn = NULL;
+		if ( rc )
+			mdb->mi_numads = moi->moi_numads;
+	}
+
+	if ( moi->moi_written ) {
+		if ( !rc ) {
+			for ( i = 0; !BER_BVISNULL( &moi->moi_written[i] ); i++ )
+				backend_group_forget( &moi->moi_written[i], LDAP_SCOPE_BASE );
+		}
+		ber_bvarray_free( moi->moi_written );
+		moi->moi_written = NULL;
+	}
+	if ( moi->moi_moved ) {
+		if ( !rc ) {
+			for ( i = 0; !BER_BVISNULL( &moi->moi_moved[i] ); i++ )
+				backend_group_forget( &moi->moi_moved[i], LDAP_SCOPE_SUBTREE );
+		}
+		ber_bvarray_free( moi->moi_moved );
+		moi->moi_moved = NULL;
+	}
+	return rc;
+}
+
+void
+mdb_opinfo_abort( struct mdb_info *mdb, mdb_op_info *moi )
+{
+	if ( moi->moi_written ) {
+		ber_bvarray_free( moi->moi_written );
+		moi->moi_written = NULL;
+	}
+	if ( moi->moi_moved ) {
+		ber_bvarray_free( moi->moi_moved );
+		moi->moi_moved = NULL;
+	}
+
+	if ( moi->moi_gc ) {
+		mdb_gc_leave( mdb, moi, 0 );
+		return;
+	}
+
+	mdb_txn_abort( moi->moi_txn );
+	moi->moi_txn = NULL;
+	mdb->mi_numads = moi->moi_numads;
+}
+
+/* Note a change to the entry ndn, so that groups cached from it are
+ * forgotten when the txn commits. A rename also moves the entries
+ * below ndn, so with LDAP_SCOPE_SUBTREE their groups go as well.
+ */
+void
+mdb_opinfo_written( mdb_op_info *moi, struct berval *ndn, int scope )
+{
+	struct berval bv;
+
+	ber_dupbv( &bv, ndn );
+	ber_bvarray_add( scope == LDAP_SCOPE_SUBTREE ?
+		&moi->moi_moved : &moi->moi_written, &bv );
+}
+
 int
 mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **moip )
 {
@@ -647,6 +907,9 @@ mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **m
 		moi->moi_oe.oe_key = mdb;
 		moi->moi_ref = 0;
 		moi->moi_txn = NULL;
+		moi->moi_gc = NULL;
+		moi->moi_written = NULL;
+		moi->moi_moved = NULL;
 	}
 
 	if ( !rdonly ) {
@@ -662,6 +925,16 @@ mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **m
 		if ( !moi->moi_txn ) {
 			if (( slapMode & SLAP_TOOL_MODE ) && mdb_tool_txn ) {
 				moi->moi_txn = mdb_tool_txn;
+				moi->moi_numads = mdb->mi_numads;
+			} else if ( mdb->mi_gc_ops && !( slapMode & SLAP_TOOL_MODE ) &&
+				/* LMDB has no nested txns with a writable map */
+				!( mdb->mi_dbenv_flags & MDB_WRITEMAP )) {
+				rc = mdb_gc_join( mdb, moi );
+				if (rc) {
+					Debug( LDAP_DEBUG_ANY, "mdb_opinfo_get: err %s(%d)\n",
+						mdb_strerror(rc), rc, 0 );
+				}
+				return rc;
 			} else {
 				int flag = 0;
 				if ( get_lazyCommit( op ))
@@ -670,6 +943,8 @@ mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **m
 				if (rc) {
 					Debug( LDAP_DEBUG_ANY, "mdb_opinfo_get: err %s(%d)\n",
 						mdb_strerror(rc), rc, 0 );
+				} else {
+					moi->moi_numads = mdb->mi_numads;
 				}
 				return rc;
 			}
@@ -745,14 +1020,14 @@ int mdb_txn( Operation *op, int txnop, OpExtra **ptr )
 		}
 		return rc;
 	case SLAP_TXN_COMMIT:
-		rc = mdb_txn_commit( moi->moi_txn );
+		rc = mdb_opinfo_commit( mdb, moi );
 		if ( rc )
 			mdb->mi_numads = 0;
 		op->o_tmpfree( moi, op->o_tmpmemctx );
 		return rc;
 	case SLAP_TXN_ABORT:
+		mdb_opinfo_abort( mdb, moi );
 		mdb->mi_numads = 0;
-		mdb_txn_abort( moi->moi_txn );
 		op->o_tmpfree( moi, op->o_tmpmemctx );
 		return 0;
 	}
@@ -929,6 +1204,44 @@ static int mdb_entry_encode(Operation *op, Entry *e, MDB_val *data, Ecount *eh)
 	return 0;
 }
 
+/* Unwanted attributes of entries with fewer attributes than this are
+ * only skipped if their values are in id2val; skipping a few small
+ * ones is not worth decoding the entry twice when the caller does
+ * need all of it.
+ */
+#define MDB_PDECODE_MIN	16
+
+static int mdb_ad_wanted(AttributeDescription **ads, AttributeDescription *ad)
+{
+	for (; *ads; ads++) {
+		if (is_ad_subtype(ad, *ads))
+			return 1;
+	}
+	return 0;
+}
+
+/* Look up which of the attributes known so far are wanted, so a
+ * partial decode doesn't need to compare each one against the list.
+ */
+void mdb_attrset_init(Operation *op, mdb_attrset *as, AttributeDescription **ads)
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	int i;
+
+	as->as_ads = ads;
+	as->as_nmap = mdb->mi_numads + 1;
+	as->as_map = op->o_tmpalloc(as->as_nmap, op->o_tmpmemctx);
+	as->as_map[0] = 0;
+	for (i=1; i<as->as_nmap; i++)
+		as->as_map[i] = mdb_ad_wanted(ads, mdb->mi_ads[i]);
+}
+
+void mdb_attrset_destroy(Operation *op, mdb_attrset *as)
+{
+	op->o_tmpfree(as->as_map, op->o_tmpmemctx);
+	as->as_map = NULL;
+}
+
 /* Retrieve an Entry that was stored using entry_encode above.
  *
  * Note: everything is stored in a single contiguous block, so
@@ -937,10 +1250,23 @@ static int mdb_entry_encode(Operation *op, Entry *e, MDB_val *data, Ecount *eh)
  */
 
 int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **e)
+{
+	int partial;
+
+	return mdb_entry_pdecode(op, txn, data, id, NULL, e, &partial);
+}
+
+/* Like mdb_entry_decode, but if as is non-NULL only the attributes
+ * in it, and their subtypes, may be decoded. *partial tells whether
+ * any attributes were left out. The values of large multi-valued
+ * attributes are only read if they're wanted.
+ */
+int mdb_entry_pdecode(Operation *op, MDB_txn *txn, MDB_val *data, ID id,
+	mdb_attrset *as, Entry **e, int *partial)
 {
 	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
 	int i, j, nattrs, nvals;
-	int rc;
+	int rc, skipped = 0, narrow;
 	Attribute *a;
 	Entry *x;
 	const char *text;
@@ -954,8 +1280,15 @@ int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **
 		"=> mdb_entry_decode:\n",
 		0, 0, 0 );
 
+	if ( mdb->mi_cache && ( x = mdb_cache_find( op, txn, id )) != NULL ) {
+		*e = x;
+		*partial = 0;
+		return 0;
+	}
+
 	nattrs = *lp++;
 	nvals = *lp++;
+	narrow = nattrs < MDB_PDECODE_MIN;
 	x = mdb_entry_alloc(op, nattrs, nvals);
 	x->e_ocflags = *lp++;
 	if (!nvals) {
@@ -997,6 +1330,20 @@ int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **
 			a->a_numvals ^= MDB_AT_NVALS;
 			have_nval = 1;
 		}
+		if (as && (multi || !narrow) && !(i < as->as_nmap ? as->as_map[i] :
+			mdb_ad_wanted(as->as_ads, a->a_desc))) {
+			/* step over its values, if they're stored here */
+			if (!multi) {
+				for (i=0; i<a->a_numvals; i++)
+					ptr += *lp++ + 1;
+				if (have_nval) {
+					for (i=0; i<a->a_numvals; i++)
+						ptr += *lp++ + 1;
+				}
+			}
+			skipped = 1;
+			continue;
+		}
 		a->a_vals = bptr;
 		if (multi) {
 			if (!mvc) {
@@ -1052,11 +1399,17 @@ int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **
 		a->a_next = a+1;
 		a = a->a_next;
 	}
-	a[-1].a_next = NULL;
+	if (a == x->e_attrs)
+		x->e_attrs = NULL;
+	else
+		a[-1].a_next = NULL;
 done:
 	Debug(LDAP_DEBUG_TRACE, "<= mdb_entry_decode\n",
 		0, 0, 0 );
+	if ( mdb->mi_cache && !skipped )
+		mdb_cache_add( op, txn, id, x );
 	*e = x;
+	*partial = skipped;
 	rc = 0;
 
 leave:
@@ -26,11 +26,30 @@
 #define IDL_MIN(x,y)	( (x) < (y) ? (x) : (y) )
 #define IDL_CMP(x,y)	( (x) < (y) ? -1 : (x) > (y) )
 
+unsigned int MDB_idl_logn = MDB_IDL_LOGN;
+ID MDB_idl_db_size = 1 << MDB_IDL_LOGN;
+ID MDB_idl_um_size = 1 << (MDB_IDL_LOGN+1);
+
+/* Set the IDL sizes. Index keys with more than 2^logn IDs are stored
+ * as ranges, and in-memory IDLs hold twice as many.
+ */
+void
+mdb_idl_reset( unsigned int logn )
+{
+	MDB_idl_logn = logn;
+	MDB_idl_db_size = (ID)1 << logn;
+	MDB_idl_um_size = (ID)1 << (logn+1);
+}
+
 #if IDL_DEBUG > 0
 static void idl_check( ID *ids )
 {
 	if( MDB_IDL_IS_RANGE( ids ) ) {
 		assert( MDB_IDL_RANGE_FIRST(ids) <= MDB_IDL_RANGE_LAST(ids) );
+	} else if( MDB_IDL_IS_BITMAP( ids ) ) {
+		assert( MDB_IDL_BITMAP_NWORDS(ids) > 0 );
+		assert( MDB_IDL_BITMAP_TEST( ids, ids[1] ) );
+		assert( MDB_IDL_BITMAP_TEST( ids, ids[2] ) );
 	} else {
 		ID i;
 		for( i=1; i < ids[0]; i++ ) {
@@ -48,6 +67,13 @@ static void idl_dump( ID *ids )
 			(long) MDB_IDL_RANGE_FIRST( ids ),
 			(long) MDB_IDL_RANGE_LAST( ids ) );
 
+	} else if( MDB_IDL_IS_BITMAP( ids ) ) {
+		Debug( LDAP_DEBUG_ANY,
+			"IDL: bitmap %ld ( %ld - %ld )\n",
+			(long) MDB_IDL_BITMAP_COUNT( ids ),
+			(long) MDB_IDL_FIRST( ids ),
+			(long) MDB_IDL_LAST( ids ) );
+
 	} else {
 		ID i;
 		Debug( LDAP_DEBUG_ANY, "IDL: size %ld", (long) ids[0], 0, 0 );
@@ -67,10 +93,356 @@ static void idl_dump( ID *ids )
 #endif /* IDL_DEBUG > 1 */
 #endif /* IDL_DEBUG > 0 */
 
-unsigned mdb_idl_search( ID *ids, ID id )
+/* Bitmap IDL helpers */
+
+#if defined(__GNUC__)
+#define IDL_POPCOUNT(w)	__builtin_popcountl(w)
+#define IDL_CTZ(w)	__builtin_ctzl(w)
+#define IDL_MSB(w)	(MDB_IDL_BITMAP_BITS - 1 - __builtin_clzl(w))
+#else
+static int IDL_POPCOUNT( ID w )
+{
+	int n = 0;
+	for (; w; w &= w-1 ) n++;
+	return n;
+}
+
+static int IDL_CTZ( ID w )
+{
+	int n = 0;
+	for (; !(w & 1); w >>= 1 ) n++;
+	return n;
+}
+
+static int IDL_MSB( ID w )
+{
+	int n = 0;
+	while ( w >>= 1 ) n++;
+	return n;
+}
+#endif
+
+#define IDL_BIT_ALIGN(id)	((id) & ~(ID)(MDB_IDL_BITMAP_BITS-1))
+
+/* Recompute first, last and count of a bitmap, trimming empty
+ * words at either end. An empty bitmap becomes a zero IDL.
+ */
+static void
+idl_bitmap_fixup( ID *ids )
+{
+	ID *w = MDB_IDL_BITMAP_WORDS( ids );
+	ID i, lo, hi, n = MDB_IDL_BITMAP_NWORDS( ids ), count = 0;
+
+	for ( lo = 0; lo < n && !w[lo]; lo++ ) ;
+	if ( lo == n ) {
+		MDB_IDL_ZERO( ids );
+		return;
+	}
+	for ( hi = n-1; !w[hi]; hi-- ) ;
+	for ( i = lo; i <= hi; i++ )
+		count += IDL_POPCOUNT( w[i] );
+	n = hi - lo + 1;
+	if ( lo ) {
+		AC_MEMCPY( w, w+lo, n * sizeof(ID) );
+		MDB_IDL_BITMAP_BASE( ids ) += lo * MDB_IDL_BITMAP_BITS;
+	}
+	MDB_IDL_BITMAP_NWORDS( ids ) = n;
+	MDB_IDL_BITMAP_COUNT( ids ) = count;
+	ids[1] = MDB_IDL_BITMAP_BASE( ids ) + IDL_CTZ( w[0] );
+	ids[2] = MDB_IDL_BITMAP_BASE( ids ) + (n-1) * MDB_IDL_BITMAP_BITS +
+		IDL_MSB( w[n-1] );
+}
+
+/* Widen the bitmap window to cover lo..hi. Fails without touching
+ * the bitmap if the result would need more than maxwords words.
+ */
+static int
+idl_bitmap_cover( ID *ids, ID lo, ID hi, ID maxwords )
+{
+	ID *w = MDB_IDL_BITMAP_WORDS( ids );
+	ID base = MDB_IDL_BITMAP_BASE( ids ), n = MDB_IDL_BITMAP_NWORDS( ids );
+	ID top = base + n * MDB_IDL_BITMAP_BITS - 1;
+	ID nn, shift;
+
+	if ( lo >= base && hi <= top )
+		return 0;
+
+	lo = IDL_BIT_ALIGN( IDL_MIN( lo, base ));
+	hi = IDL_MAX( hi, top );
+	nn = (hi - lo) / MDB_IDL_BITMAP_BITS + 1;
+	if ( nn > maxwords )
+		return -1;
+
+	shift = (base - lo) / MDB_IDL_BITMAP_BITS;
+	if ( shift ) {
+		AC_MEMCPY( w+shift, w, n * sizeof(ID) );
+		memset( w, 0, shift * sizeof(ID) );
+	}
+	memset( w+shift+n, 0, (nn-shift-n) * sizeof(ID) );
+	MDB_IDL_BITMAP_BASE( ids ) = lo;
+	MDB_IDL_BITMAP_NWORDS( ids ) = nn;
+	return 0;
+}
+
+/* Add one ID to a bitmap. If the window can't be widened to hold it,
+ * the bitmap degrades to a range.
+ */
+static int
+idl_bitmap_add( ID *ids, ID id, ID maxwords )
+{
+	ID off, bit;
+
+	if ( idl_bitmap_cover( ids, id, id, maxwords )) {
+		ids[0] = NOID;
+		ids[1] = IDL_MIN( ids[1], id );
+		ids[2] = IDL_MAX( ids[2], id );
+		return 0;
+	}
+
+	off = id - MDB_IDL_BITMAP_BASE( ids );
+	bit = (ID)1 << (off % MDB_IDL_BITMAP_BITS);
+	if ( MDB_IDL_BITMAP_WORDS( ids )[off / MDB_IDL_BITMAP_BITS] & bit )
+		return -1;
+
+	MDB_IDL_BITMAP_WORDS( ids )[off / MDB_IDL_BITMAP_BITS] |= bit;
+	MDB_IDL_BITMAP_COUNT( ids )++;
+	if ( id < ids[1] )
+		ids[1] = id;
+	if ( id > ids[2] )
+		ids[2] = id;
+	return 0;
+}
+
+/* Return the smallest ID in the bitmap that is >= id */
+static ID
+idl_bitmap_next( ID *ids, ID id )
+{
+	ID *w = MDB_IDL_BITMAP_WORDS( ids );
+	ID off, i, word;
+
+	if ( id < ids[1] )
+		id = ids[1];
+	if ( id > ids[2] )
+		return NOID;
+
+	off = id - MDB_IDL_BITMAP_BASE( ids );
+	i = off / MDB_IDL_BITMAP_BITS;
+	word = w[i] & (~(ID)0 << (off % MDB_IDL_BITMAP_BITS));
+	while ( !word ) {
+		if ( ++i >= MDB_IDL_BITMAP_NWORDS( ids ))
+			return NOID;
+		word = w[i];
+	}
+	return MDB_IDL_BITMAP_BASE( ids ) + i * MDB_IDL_BITMAP_BITS + IDL_CTZ( word );
+}
+
+/* Build a bitmap in ids from the lists a and b (b may be NULL). The
+ * lists need not be sorted, but their first and last elements must be
+ * their min and max. ids may be the same buffer as a or b.
+ */
+static int
+idl_bitmap_build( ID *ids, ID *a, ID *b, ID maxwords )
+{
+	ID *w, lo, hi, base, n, i;
+
+	lo = a[1];
+	hi = a[a[0]];
+	if ( b && b[0] ) {
+		lo = IDL_MIN( lo, b[1] );
+		hi = IDL_MAX( hi, b[b[0]] );
+	}
+	base = IDL_BIT_ALIGN( lo );
+	n = (hi - base) / MDB_IDL_BITMAP_BITS + 1;
+	if ( n > maxwords )
+		return -1;
+
+	w = ch_calloc( n, sizeof(ID) );
+	for ( i=1; i<=a[0]; i++ )
+		w[(a[i] - base) / MDB_IDL_BITMAP_BITS] |=
+			(ID)1 << ((a[i] - base) % MDB_IDL_BITMAP_BITS);
+	if ( b ) {
+		for ( i=1; i<=b[0]; i++ )
+			w[(b[i] - base) / MDB_IDL_BITMAP_BITS] |=
+				(ID)1 << ((b[i] - base) % MDB_IDL_BITMAP_BITS);
+	}
+
+	ids[0] = MDB_IDL_BITMAP_TAG;
+	MDB_IDL_BITMAP_BASE( ids ) = base;
+	MDB_IDL_BITMAP_NWORDS( ids ) = n;
+	AC_MEMCPY( MDB_IDL_BITMAP_WORDS( ids ), w, n * sizeof(ID) );
+	ch_free( w );
+	idl_bitmap_fixup( ids );
+	return 0;
+}
+
+/* ids = ids union b, where ids is a bitmap and b a list or bitmap.
+ * Fails without touching ids if the result won't fit in maxwords.
+ */
+static int
+idl_bitmap_merge( ID *ids, ID *b, ID maxwords )
+{
+	ID i;
+
+	if ( idl_bitmap_cover( ids, MDB_IDL_FIRST( b ), MDB_IDL_LAST( b ), maxwords ))
+		return -1;
+
+	if ( MDB_IDL_IS_BITMAP( b )) {
+		ID *w = MDB_IDL_BITMAP_WORDS( ids ), *bw = MDB_IDL_BITMAP_WORDS( b );
+		ID off = (MDB_IDL_BITMAP_BASE( b ) - MDB_IDL_BITMAP_BASE( ids )) /
+			MDB_IDL_BITMAP_BITS;
+		for ( i=0; i<MDB_IDL_BITMAP_NWORDS( b ); i++ )
+			w[off+i] |= bw[i];
+		idl_bitmap_fixup( ids );
+	} else {
+		for ( i=1; i<=b[0]; i++ )
+			idl_bitmap_add( ids, b[i], maxwords );
+	}
+	return 0;
+}
+
+/* ids = ids intersection b, where ids is a bitmap and b a range or
+ * bitmap; lo and hi are the bounds of the intersection.
+ */
+static void
+idl_bitmap_and( ID *ids, ID *b, ID lo, ID hi )
+{
+	ID *w = MDB_IDL_BITMAP_WORDS( ids );
+	ID i, first, n = MDB_IDL_BITMAP_NWORDS( ids );
+
+	for ( i=0; i<n; i++ ) {
+		first = MDB_IDL_BITMAP_BASE( ids ) + i * MDB_IDL_BITMAP_BITS;
+		if ( first + MDB_IDL_BITMAP_BITS - 1 < lo || first > hi ) {
+			w[i] = 0;
+			continue;
+		}
+		if ( MDB_IDL_IS_BITMAP( b )) {
+			if ( first < MDB_IDL_BITMAP_BASE( b ) ||
+				(first - MDB_IDL_BITMAP_BASE( b )) / MDB_IDL_BITMAP_BITS >=
+				MDB_IDL_BITMAP_NWORDS( b )) {
+				w[i] = 0;
+				continue;
+			}
+			w[i] &= MDB_IDL_BITMAP_WORDS( b )[(first - MDB_IDL_BITMAP_BASE( b )) /
+				MDB_IDL_BITMAP_BITS];
+		}
+		if ( first < lo )
+			w[i] &= ~(ID)0 << (lo - first);
+		if ( hi - first < MDB_IDL_BITMAP_BITS - 1 )
+			w[i] &= ~(ID)0 >> (MDB_IDL_BITMAP_BITS - 1 - (hi - first));
+	}
+	idl_bitmap_fixup( ids );
+}
+
+/* Sorted list kernels.
+ *
+ * These work on plain lists only, never on ranges or bitmaps. The
+ * scalar versions are always available; on x86-64 with gcc or clang,
+ * SSE4.2 and AVX2 versions are compiled as well and the best one the
+ * CPU supports is selected at startup by mdb_idl_kernels_init().
+ *
+ * The vector compares are signed, which is fine since IDs stored in
+ * a list are always far below 2^63.
+ */
+
+typedef struct idl_kernels {
+	const char *ik_name;
+	unsigned (*ik_search)( ID *ids, ID id );
+	ID (*ik_isect)( ID *a, ID *b );
+	ID (*ik_notin)( ID *a, ID *b, ID *ids );
+	ID (*ik_merge)( ID *a, ID *b );
+	int (*ik_sorted)( ID *ids );
+} idl_kernels;
+
+/* Lists differing in length by more than this are intersected by
+ * galloping through the longer one instead of merging.
+ */
+#define IDL_GALLOP_RATIO	32
+
+/* Return the first position >= pos whose ID is >= id, or ids[0]+1.
+ * Exponential probe, then binary search.
+ */
+static ID
+idl_gallop( ID *ids, ID pos, ID id )
+{
+	ID n = ids[0], step = 1, hi;
+
+	if ( pos > n || ids[pos] >= id )
+		return pos;
+
+	hi = pos + 1;
+	while ( hi <= n && ids[hi] < id ) {
+		pos = hi;
+		step <<= 1;
+		hi = pos + step;
+	}
+	if ( hi > n )
+		hi = n + 1;
+
+	/* ids[pos] < id, and ids[hi] >= id or hi is past the end */
+	while ( hi - pos > 1 ) {
+		ID mid = pos + (hi - pos) / 2;
+		if ( ids[mid] < id )
+			pos = mid;
+		else
+			hi = mid;
+	}
+	return hi;
+}
+
+/* a = a intersect b when one list is much longer than the other */
+static ID
+idl_isect_gallop( ID *a, ID *b )
+{
+	ID i, j = 1, k = 0;
+
+	if ( a[0] <= b[0] ) {
+		for ( i = 1; i <= a[0]; i++ ) {
+			j = idl_gallop( b, j, a[i] );
+			if ( j > b[0] )
+				break;
+			if ( b[j] == a[i] )
+				a[++k] = a[i];
+		}
+	} else {
+		for ( i = 1; i <= b[0]; i++ ) {
+			j = idl_gallop( a, j, b[i] );
+			if ( j > a[0] )
+				break;
+			if ( a[j] == b[i] )
+				a[++k] = b[i];
+		}
+	}
+	return k;
+}
+
+/* ids = a minus b when b is much longer than a */
+static ID
+idl_notin_gallop( ID *a, ID *b, ID *ids )
+{
+	ID i, j = 1, k = 0;
+
+	for ( i = 1; i <= a[0]; i++ ) {
+		j = idl_gallop( b, j, a[i] );
+		if ( j > b[0] || b[j] != a[i] )
+			ids[++k] = a[i];
+	}
+	return k;
+}
+
+/* Close the gap left between the unmerged head of a (a[1..ia]) and
+ * the merged tail (a[w+1..n]) by a top-down merge. Returns the count.
+ */
+static ID
+idl_merge_finish( ID *a, ID ia, ID w, ID n )
+{
+	if ( w > ia )
+		AC_MEMCPY( a+ia+1, a+w+1, (n - w) * sizeof(ID) );
+	return ia + n - w;
+}
+
+static unsigned
+idl_search_scalar( ID *ids, ID id )
 {
-#define IDL_BINARY_SEARCH 1
-#ifdef IDL_BINARY_SEARCH
 	/*
 	 * binary search of id in ids
 	 * if found, returns position of id
@@ -81,10 +453,6 @@ unsigned mdb_idl_search( ID *ids, ID id )
 	int val = 0;
 	unsigned n = ids[0];
 
-#if IDL_DEBUG > 0
-	idl_check( ids );
-#endif
-
 	while( 0 < n ) {
 		unsigned pivot = n >> 1;
 		cursor = base + pivot + 1;
@@ -101,28 +469,402 @@ unsigned mdb_idl_search( ID *ids, ID id )
 			return cursor;
 		}
 	}
-	
+
 	if( val > 0 ) {
 		++cursor;
 	}
 	return cursor;
+}
 
-#else
-	/* (reverse) linear search */
-	int i;
+static ID
+idl_isect_scalar( ID *a, ID *b )
+{
+	ID i = 1, j = 1, k = 0;
 
-#if IDL_DEBUG > 0
-	idl_check( ids );
+	while ( i <= a[0] && j <= b[0] ) {
+		if ( a[i] < b[j] ) {
+			i++;
+		} else if ( a[i] > b[j] ) {
+			j++;
+		} else {
+			a[++k] = a[i];
+			i++;
+			j++;
+		}
+	}
+	return k;
+}
+
+static ID
+idl_notin_scalar( ID *a, ID *b, ID *ids )
+{
+	ID i = 1, j = 1, k = 0;
+
+	while ( i <= a[0] ) {
+		if ( j > b[0] || a[i] < b[j] ) {
+			ids[++k] = a[i++];
+		} else if ( a[i] > b[j] ) {
+			j++;
+		} else {
+			i++;
+			j++;
+		}
+	}
+	return k;
+}
+
+/* The vector union falls back on this; keep it out of line so that it
+ * is not recompiled for the vector target, which runs it much slower.
+ */
+#ifdef __GNUC__
+#define IDL_NOINLINE	__attribute__((noinline))
+#else
+#define IDL_NOINLINE
 #endif
 
-	for( i=ids[0]; i; i-- ) {
-		if( id > ids[i] ) {
-			break;
+/* a = a union b, merging from the top down so that no scratch space
+ * is needed. The caller must ensure a[0]+b[0] IDs fit in a.
+ */
+static ID IDL_NOINLINE
+idl_merge_scalar( ID *a, ID *b )
+{
+	ID ia = a[0], ib = b[0], n = a[0] + b[0], w = n;
+
+	while ( ia && ib ) {
+		if ( a[ia] > b[ib] ) {
+			a[w--] = a[ia--];
+		} else if ( a[ia] < b[ib] ) {
+			a[w--] = b[ib--];
+		} else {
+			a[w--] = a[ia--];
+			ib--;
 		}
 	}
+	while ( ib )
+		a[w--] = b[ib--];
+	return idl_merge_finish( a, ia, w, n );
+}
+
+static int
+idl_sorted_scalar( ID *ids )
+{
+	ID i;
+
+	for ( i = 1; i < ids[0]; i++ ) {
+		if ( ids[i] > ids[i+1] )
+			return 0;
+	}
+	return 1;
+}
+
+static const idl_kernels idl_kern_scalar = {
+	"scalar",
+	idl_search_scalar,
+	idl_isect_scalar,
+	idl_notin_scalar,
+	idl_merge_scalar,
+	idl_sorted_scalar
+};
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__LP64__) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define IDL_SIMD	1
+#endif
+
+#ifdef IDL_SIMD
+#include <immintrin.h>
+
+/* Each vector flavor supplies three primitives on a block of 4 IDs:
+ *   blk_eq( p, x )		nonzero if any of p[0..3] == x
+ *   blk_gt( p, x )		how many of p[0..3] are > x
+ *   blk_lt( p, x )		how many of p[0..3] are < x
+ *   blk_desc( p )		nonzero if p[0..4] is not ascending
+ * and the kernels below are stamped out once per flavor.
+ */
+
+#define IDL_AVX2	__attribute__((target("avx2,popcnt")))
+#define IDL_SSE42	__attribute__((target("sse4.2,popcnt")))
+
+static inline int IDL_AVX2
+idl_blk_eq_avx2( ID *p, ID x )
+{
+	__m256i v = _mm256_loadu_si256( (__m256i const *)p );
+	return _mm256_movemask_pd( _mm256_castsi256_pd(
+		_mm256_cmpeq_epi64( v, _mm256_set1_epi64x( (long long)x ))));
+}
+
+static inline int IDL_AVX2
+idl_blk_gt_avx2( ID *p, ID x )
+{
+	__m256i v = _mm256_loadu_si256( (__m256i const *)p );
+	return __builtin_popcount( _mm256_movemask_pd( _mm256_castsi256_pd(
+		_mm256_cmpgt_epi64( v, _mm256_set1_epi64x( (long long)x )))));
+}
+
+static inline int IDL_AVX2
+idl_blk_lt_avx2( ID *p, ID x )
+{
+	__m256i v = _mm256_loadu_si256( (__m256i const *)p );
+	return __builtin_popcount( _mm256_movemask_pd( _mm256_castsi256_pd(
+		_mm256_cmpgt_epi64( _mm256_set1_epi64x( (long long)x ), v ))));
+}
+
+static inline int IDL_AVX2
+idl_blk_desc_avx2( ID *p )
+{
+	__m256i v0 = _mm256_loadu_si256( (__m256i const *)p );
+	__m256i v1 = _mm256_loadu_si256( (__m256i const *)(p+1) );
+	return _mm256_movemask_pd( _mm256_castsi256_pd(
+		_mm256_cmpgt_epi64( v0, v1 )));
+}
+
+static inline int IDL_SSE42
+idl_blk_eq_sse42( ID *p, ID x )
+{
+	__m128i k = _mm_set1_epi64x( (long long)x );
+	__m128i v0 = _mm_loadu_si128( (__m128i const *)p );
+	__m128i v1 = _mm_loadu_si128( (__m128i const *)(p+2) );
+	return _mm_movemask_pd( _mm_castsi128_pd( _mm_or_si128(
+		_mm_cmpeq_epi64( v0, k ), _mm_cmpeq_epi64( v1, k ))));
+}
+
+static inline int IDL_SSE42
+idl_blk_gt_sse42( ID *p, ID x )
+{
+	__m128i k = _mm_set1_epi64x( (long long)x );
+	__m128i v0 = _mm_loadu_si128( (__m128i const *)p );
+	__m128i v1 = _mm_loadu_si128( (__m128i const *)(p+2) );
+	return __builtin_popcount(
+		_mm_movemask_pd( _mm_castsi128_pd( _mm_cmpgt_epi64( v0, k ))) |
+		_mm_movemask_pd( _mm_castsi128_pd( _mm_cmpgt_epi64( v1, k ))) << 2 );
+}
+
+static inline int IDL_SSE42
+idl_blk_lt_sse42( ID *p, ID x )
+{
+	__m128i k = _mm_set1_epi64x( (long long)x );
+	__m128i v0 = _mm_loadu_si128( (__m128i const *)p );
+	__m128i v1 = _mm_loadu_si128( (__m128i const *)(p+2) );
+	return __builtin_popcount(
+		_mm_movemask_pd( _mm_castsi128_pd( _mm_cmpgt_epi64( k, v0 ))) |
+		_mm_movemask_pd( _mm_castsi128_pd( _mm_cmpgt_epi64( k, v1 ))) << 2 );
+}
+
+static inline int IDL_SSE42
+idl_blk_desc_sse42( ID *p )
+{
+	__m128i v0 = _mm_loadu_si128( (__m128i const *)p );
+	__m128i v1 = _mm_loadu_si128( (__m128i const *)(p+1) );
+	__m128i v2 = _mm_loadu_si128( (__m128i const *)(p+2) );
+	__m128i v3 = _mm_loadu_si128( (__m128i const *)(p+3) );
+	return _mm_movemask_pd( _mm_castsi128_pd( _mm_or_si128(
+		_mm_cmpgt_epi64( v0, v1 ), _mm_cmpgt_epi64( v2, v3 ))));
+}
 
-	return i+1;
+/* Below this length ratio the vector union defers to the scalar one */
+#define IDL_MERGE_RATIO	8
+
+#define IDL_VECTOR_KERNELS( sfx, TARGET ) \
+\
+static unsigned TARGET \
+idl_search_##sfx( ID *ids, ID id ) \
+{ \
+	/* narrow down with a binary search, finish with block compares */ \
+	unsigned base = 0, n = ids[0], half; \
+	ID *p; \
+\
+	while ( n > 16 ) { \
+		half = n >> 1; \
+		if ( ids[base + half] < id ) { \
+			base += half; \
+			n -= half; \
+		} else { \
+			n = half; \
+		} \
+	} \
+	p = ids + base + 1; \
+	for (; n >= 4; n -= 4, p += 4 ) { \
+		int lt = idl_blk_lt_##sfx( p, id ); \
+		if ( lt < 4 ) \
+			return p - ids + lt; \
+	} \
+	for (; n && *p < id; n--, p++ ) ; \
+	return p - ids; \
+} \
+\
+static ID TARGET \
+idl_isect_##sfx( ID *a, ID *b ) \
+{ \
+	ID i = 1, j = 1, k = 0, na = a[0], nb = b[0]; \
+\
+	while ( i + 3 <= na && j + 3 <= nb ) { \
+		if ( b[j+3] < a[i] ) { \
+			j += 4; \
+		} else if ( a[i+3] < b[j] ) { \
+			i += 4; \
+		} else { \
+			if ( idl_blk_eq_##sfx( b+j, a[i] )) \
+				a[++k] = a[i]; \
+			i++; \
+		} \
+	} \
+	while ( i <= na && j <= nb ) { \
+		if ( a[i] < b[j] ) { \
+			i++; \
+		} else if ( a[i] > b[j] ) { \
+			j++; \
+		} else { \
+			a[++k] = a[i]; \
+			i++; \
+			j++; \
+		} \
+	} \
+	return k; \
+} \
+\
+static ID TARGET \
+idl_notin_##sfx( ID *a, ID *b, ID *ids ) \
+{ \
+	ID i = 1, j = 1, k = 0, na = a[0], nb = b[0]; \
+\
+	while ( i <= na && j + 3 <= nb ) { \
+		if ( b[j+3] < a[i] ) { \
+			j += 4; \
+		} else { \
+			if ( !idl_blk_eq_##sfx( b+j, a[i] )) \
+				ids[++k] = a[i]; \
+			i++; \
+		} \
+	} \
+	while ( i <= na ) { \
+		if ( j > nb || a[i] < b[j] ) { \
+			ids[++k] = a[i++]; \
+		} else if ( a[i] > b[j] ) { \
+			j++; \
+		} else { \
+			i++; \
+			j++; \
+		} \
+	} \
+	return k; \
+} \
+\
+static ID TARGET \
+idl_merge_##sfx( ID *a, ID *b ) \
+{ \
+	ID ia = a[0], ib = b[0], n = a[0] + b[0], w = n, run; \
+\
+	/* lists of similar length interleave finely, where the scalar \
+	 * merge's predictable loop wins */ \
+	if ( ia < ib * IDL_MERGE_RATIO && ib < ia * IDL_MERGE_RATIO ) \
+		return idl_merge_scalar( a, b ); \
+\
+	/* when the next four IDs all come from one side, size the \
+	 * run with block compares and move it at once */ \
+	while ( ia && ib ) { \
+		if ( a[ia] > b[ib] ) { \
+			if ( ia < 4 || a[ia-3] <= b[ib] ) { \
+				a[w--] = a[ia--]; \
+				continue; \
+			} \
+			for ( run = 4; run + 4 <= ia; run += 4 ) { \
+				int gt = idl_blk_gt_##sfx( a+ia-run-3, b[ib] ); \
+				if ( gt < 4 ) { \
+					run += gt; \
+					goto arun; \
+				} \
+			} \
+			while ( run < ia && a[ia-run] > b[ib] ) \
+				run++; \
+arun: \
+			w -= run; \
+			ia -= run; \
+			AC_MEMCPY( a+w+1, a+ia+1, run * sizeof(ID) ); \
+		} else if ( a[ia] < b[ib] ) { \
+			if ( ib < 4 || b[ib-3] <= a[ia] ) { \
+				a[w--] = b[ib--]; \
+				continue; \
+			} \
+			for ( run = 4; run + 4 <= ib; run += 4 ) { \
+				int gt = idl_blk_gt_##sfx( b+ib-run-3, a[ia] ); \
+				if ( gt < 4 ) { \
+					run += gt; \
+					goto brun; \
+				} \
+			} \
+			while ( run < ib && b[ib-run] > a[ia] ) \
+				run++; \
+brun: \
+			w -= run; \
+			ib -= run; \
+			memcpy( a+w+1, b+ib+1, run * sizeof(ID) ); \
+		} else { \
+			a[w--] = a[ia--]; \
+			ib--; \
+		} \
+	} \
+	if ( ib ) { \
+		w -= ib; \
+		memcpy( a+w+1, b+1, ib * sizeof(ID) ); \
+	} \
+	return idl_merge_finish( a, ia, w, n ); \
+} \
+\
+static int TARGET \
+idl_sorted_##sfx( ID *ids ) \
+{ \
+	ID i; \
+\
+	for ( i = 1; i + 4 <= ids[0]; i += 4 ) { \
+		if ( idl_blk_desc_##sfx( ids+i )) \
+			return 0; \
+	} \
+	for (; i < ids[0]; i++ ) { \
+		if ( ids[i] > ids[i+1] ) \
+			return 0; \
+	} \
+	return 1; \
+} \
+\
+static const idl_kernels idl_kern_##sfx = { \
+	#sfx, \
+	idl_search_##sfx, \
+	idl_isect_##sfx, \
+	idl_notin_##sfx, \
+	idl_merge_##sfx, \
+	idl_sorted_##sfx \
+};
+
+IDL_VECTOR_KERNELS( avx2, IDL_AVX2 )
+IDL_VECTOR_KERNELS( sse42, IDL_SSE42 )
+
+#endif /* IDL_SIMD */
+
+static const idl_kernels *idl_kern = &idl_kern_scalar;
+
+/* Pick the list kernels to use. Returns the name of the chosen set. */
+const char *
+mdb_idl_kernels_init( void )
+{
+#ifdef IDL_SIMD
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "popcnt" ))
+		idl_kern = &idl_kern_avx2;
+	else if ( __builtin_cpu_supports( "sse4.2" ) && __builtin_cpu_supports( "popcnt" ))
+		idl_kern = &idl_kern_sse42;
+	else
+#endif
+		idl_kern = &idl_kern_scalar;
+	return idl_kern->ik_name;
+}
+
+unsigned mdb_idl_search( ID *ids, ID id )
+{
+#if IDL_DEBUG > 0
+	idl_check( ids );
 #endif
+
+	return idl_kern->ik_search( ids, id );
 }
 
 int mdb_idl_insert( ID *ids, ID id )
@@ -147,6 +889,11 @@ int mdb_idl_insert( ID *ids, ID id )
 		return 0;
 	}
 
+	if (MDB_IDL_IS_BITMAP( ids )) {
+		return idl_bitmap_add( ids, id, IDL_MAX( MDB_IDL_BITMAP_NWORDS( ids ),
+			MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_DB_SIZE )));
+	}
+
 	x = mdb_idl_search( ids, id );
 	assert( x > 0 );
 
@@ -160,6 +907,12 @@ int mdb_idl_insert( ID *ids, ID id )
 		return -1;
 	}
 
+	/* No room, keep it exact as a bitmap if we can */
+	if ( ids[0] + 1 >= MDB_IDL_DB_MAX && !idl_bitmap_build( ids, ids, NULL,
+		MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_DB_SIZE ))) {
+		return idl_bitmap_add( ids, id, MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_DB_SIZE ));
+	}
+
 	if ( ++ids[0] >= MDB_IDL_DB_MAX ) {
 		if( id < ids[1] ) {
 			ids[1] = id;
@@ -213,6 +966,16 @@ static int mdb_idl_delete( ID *ids, ID id )
 		return 0;
 	}
 
+	if (MDB_IDL_IS_BITMAP( ids )) {
+		if ( !MDB_IDL_BITMAP_TEST( ids, id ))
+			return -1;
+		x = id - MDB_IDL_BITMAP_BASE( ids );
+		MDB_IDL_BITMAP_WORDS( ids )[x / MDB_IDL_BITMAP_BITS] &=
+			~((ID)1 << (x % MDB_IDL_BITMAP_BITS));
+		idl_bitmap_fixup( ids );
+		return 0;
+	}
+
 	x = mdb_idl_search( ids, id );
 	assert( x > 0 );
 
@@ -258,6 +1021,170 @@ mdb_show_key(
 	}
 }
 
+/* Read the bitmap chunks of the slot the cursor is on into ids: a
+ * bitmap if their span fits in an IDL, else a list if there are few
+ * enough IDs, else their bounds as a range.
+ */
+static int
+idl_fetch_chunks( MDB_cursor *cursor, MDB_val *key, ID *ids )
+{
+	MDB_val data;
+	ID c, lo, hi, base = 0, *w = NULL, *p, *end, i, off;
+	int rc;
+
+	rc = mdb_cursor_get( cursor, key, &data, MDB_FIRST_DUP );
+	if ( rc == 0 ) {
+		memcpy( &c, data.mv_data, sizeof(ID) );
+		lo = MDB_IDL_CHUNK_BASE( c ) + IDL_CTZ( MDB_IDL_CHUNK_MASK( c ));
+		rc = mdb_cursor_get( cursor, key, &data, MDB_LAST_DUP );
+	}
+	if ( rc == 0 ) {
+		memcpy( &c, data.mv_data, sizeof(ID) );
+		hi = MDB_IDL_CHUNK_BASE( c ) + IDL_MSB( MDB_IDL_CHUNK_MASK( c ));
+		rc = mdb_cursor_get( cursor, key, &data, MDB_FIRST_DUP );
+	}
+	if ( rc == 0 )
+		rc = mdb_cursor_get( cursor, key, &data, MDB_GET_MULTIPLE );
+	if ( rc )
+		return rc;
+
+	if ( (hi - IDL_BIT_ALIGN( lo )) / MDB_IDL_BITMAP_BITS <
+		MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_UM_SIZE )) {
+		base = IDL_BIT_ALIGN( lo );
+		ids[0] = MDB_IDL_BITMAP_TAG;
+		MDB_IDL_BITMAP_BASE( ids ) = base;
+		MDB_IDL_BITMAP_NWORDS( ids ) = (hi - base) / MDB_IDL_BITMAP_BITS + 1;
+		w = MDB_IDL_BITMAP_WORDS( ids );
+		memset( w, 0, MDB_IDL_BITMAP_NWORDS( ids ) * sizeof(ID) );
+	} else {
+		ids[0] = 0;
+	}
+
+	while ( rc == 0 ) {
+		p = data.mv_data;
+		end = p + data.mv_size / sizeof(ID);
+		for ( ; p < end; p++ ) {
+			memcpy( &c, p, sizeof(ID) );
+			if ( w ) {
+				/* chunks are aligned to half a bitmap word */
+				off = MDB_IDL_CHUNK_BASE( c ) - base;
+				w[off / MDB_IDL_BITMAP_BITS] |= MDB_IDL_CHUNK_MASK( c ) <<
+					(off % MDB_IDL_BITMAP_BITS);
+				continue;
+			}
+			for ( i = MDB_IDL_CHUNK_MASK( c ); i; i &= i-1 ) {
+				if ( ids[0] == MDB_IDL_UM_MAX ) {
+					MDB_IDL_RANGE( ids, lo, hi );
+					return 0;
+				}
+				ids[++ids[0]] = MDB_IDL_CHUNK_BASE( c ) + IDL_CTZ( i );
+			}
+		}
+		rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_MULTIPLE );
+	}
+	if ( rc != MDB_NOTFOUND )
+		return rc;
+	if ( w )
+		idl_bitmap_fixup( ids );
+	return 0;
+}
+
+/* Turn the plain slot the cursor is on into bitmap chunks, when it
+ * outgrows MDB_IDL_DB_MAX. Returns MDB_KEYEXIST, with nothing done,
+ * if its IDs don't fit in chunks.
+ */
+static int
+idl_make_chunks( MDB_cursor *cursor, MDB_val *key, ID id )
+{
+	MDB_val data[2], k;
+	ID *ids, *p, *end, c = 0, n = 0, i;
+	size_t count;
+	int rc;
+
+	rc = mdb_cursor_get( cursor, key, data, MDB_LAST_DUP );
+	if ( rc )
+		return rc;
+	memcpy( &c, data[0].mv_data, sizeof(ID) );
+	if ( c > MDB_IDL_CHUNK_MAXID || id > MDB_IDL_CHUNK_MAXID )
+		return MDB_KEYEXIST;
+
+	rc = mdb_cursor_count( cursor, &count );
+	if ( rc == 0 )
+		rc = mdb_cursor_get( cursor, key, data, MDB_FIRST_DUP );
+	if ( rc == 0 )
+		rc = mdb_cursor_get( cursor, key, data, MDB_GET_MULTIPLE );
+	if ( rc )
+		return rc;
+
+	/* the IDs are sorted, so are their chunks */
+	ids = ch_malloc( count * sizeof(ID) );
+	c = 0;
+	while ( rc == 0 ) {
+		p = data[0].mv_data;
+		end = p + data[0].mv_size / sizeof(ID);
+		for ( ; p < end; p++ ) {
+			memcpy( &i, p, sizeof(ID) );
+			if ( c - MDB_IDL_CHUNK_MASK( c ) != MDB_IDL_CHUNK( i )) {
+				if ( c )
+					ids[n++] = c;
+				c = MDB_IDL_CHUNK( i );
+			}
+			c |= MDB_IDL_CHUNK_BIT( i );
+		}
+		/* NEXT_MULTIPLE points the key into the page, keep ours */
+		rc = mdb_cursor_get( cursor, &k, data, MDB_NEXT_MULTIPLE );
+	}
+	ids[n++] = c;
+	if ( rc == MDB_NOTFOUND )
+		rc = mdb_cursor_del( cursor, MDB_NODUPDATA );
+	if ( rc == 0 ) {
+		data[0].mv_size = sizeof(ID);
+		data[0].mv_data = ids;
+		data[1].mv_size = n;
+		rc = mdb_cursor_put( cursor, key, data, MDB_MULTIPLE );
+	}
+	ch_free( ids );
+	return rc;
+}
+
+/* Set or clear the bit of id in a slot of bitmap chunks */
+static int
+idl_chunk_update( MDB_cursor *cursor, MDB_val *key, ID id, int set )
+{
+	MDB_val data;
+	ID c = MDB_IDL_CHUNK( id ), old;
+	int rc;
+
+	data.mv_size = sizeof(ID);
+	data.mv_data = &c;
+	rc = mdb_cursor_get( cursor, key, &data, MDB_GET_BOTH_RANGE );
+	if ( rc == 0 ) {
+		memcpy( &old, data.mv_data, sizeof(ID) );
+		if ( old - MDB_IDL_CHUNK_MASK( old ) != c )
+			rc = MDB_NOTFOUND;
+	}
+	if ( rc == MDB_NOTFOUND ) {
+		if ( !set )
+			return 0;
+		c |= MDB_IDL_CHUNK_BIT( id );
+		data.mv_size = sizeof(ID);
+		data.mv_data = &c;
+		return mdb_cursor_put( cursor, key, &data, MDB_NODUPDATA );
+	}
+	if ( rc )
+		return rc;
+
+	c = set ? old | MDB_IDL_CHUNK_BIT( id ) : old & ~MDB_IDL_CHUNK_BIT( id );
+	if ( c == old )
+		return 0;
+	if ( !MDB_IDL_CHUNK_MASK( c ))
+		return mdb_cursor_del( cursor, 0 );
+	/* only the low bits change, so it sorts in the same place */
+	data.mv_size = sizeof(ID);
+	data.mv_data = &c;
+	return mdb_cursor_put( cursor, key, &data, MDB_CURRENT );
+}
+
 int
 mdb_idl_fetch_key(
 	BackendDB	*be,
@@ -270,7 +1197,7 @@ mdb_idl_fetch_key(
 {
 	MDB_val data, key2, *kptr;
 	MDB_cursor *cursor;
-	ID *i;
+	ID *i, first;
 	size_t len;
 	int rc;
 	MDB_cursor_op opflag;
@@ -334,7 +1261,33 @@ mdb_idl_fetch_key(
 	if (rc == 0) {
 		i = ids+1;
 		rc = mdb_cursor_get( cursor, key, &data, MDB_GET_MULTIPLE );
+		if ( rc == 0 )
+			memcpy( &first, data.mv_data, sizeof(ID) );
+		if ( rc == 0 && MDB_IDL_IS_CHUNK( first )) {
+			rc = idl_fetch_chunks( cursor, key, ids );
+			if ( rc == 0 )
+				data.mv_size = MDB_IDL_SIZEOF(ids);
+			goto chunks;
+		}
 		while (rc == 0) {
+			if ( i - ids + data.mv_size / sizeof(ID) > MDB_IDL_UM_SIZE ) {
+				/* written with a larger idlexp, only keep the bounds */
+				ID lo, hi;
+				if ( i > ids+1 )
+					lo = ids[1];
+				else
+					memcpy( &lo, data.mv_data, sizeof(ID) );
+				rc = mdb_cursor_get( cursor, key, &data, MDB_LAST_DUP );
+				if ( rc == 0 ) {
+					memcpy( &hi, data.mv_data, sizeof(ID) );
+					i = ids+1;
+					*i++ = 0;
+					*i++ = lo;
+					*i++ = hi;
+					rc = MDB_NOTFOUND;
+				}
+				break;
+			}
 			memcpy( i, data.mv_data, data.mv_size );
 			i += data.mv_size / sizeof(ID);
 			rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_MULTIPLE );
@@ -354,6 +1307,7 @@ mdb_idl_fetch_key(
 		}
 		data.mv_size = MDB_IDL_SIZEOF(ids);
 	}
+chunks:
 
 	if ( saved_cursor && rc == 0 ) {
 		if ( !*saved_cursor )
@@ -389,6 +1343,139 @@ mdb_idl_fetch_key(
 	return rc;
 }
 
+/* Return in *count how many IDs are stored under key, without
+ * reading them. Used for planning filter evaluation.
+ */
+int
+mdb_idl_count_key(
+	MDB_txn		*txn,
+	MDB_dbi		dbi,
+	MDB_val		*key,
+	ID			*count )
+{
+	MDB_cursor *cursor;
+	MDB_val data;
+	ID lo, hi;
+	size_t n;
+	int rc;
+
+	*count = 0;
+	rc = mdb_cursor_open( txn, dbi, &cursor );
+	if ( rc != 0 )
+		return rc;
+
+	rc = mdb_cursor_get( cursor, key, &data, MDB_SET );
+	if ( rc == 0 ) {
+		memcpy( &lo, data.mv_data, sizeof(ID) );
+		/* On disk, a range is denoted by 0 in the first element */
+		if ( lo == 0 ) {
+			rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+			if ( rc == 0 ) {
+				memcpy( &lo, data.mv_data, sizeof(ID) );
+				rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+			}
+			if ( rc == 0 ) {
+				memcpy( &hi, data.mv_data, sizeof(ID) );
+				*count = hi - lo + 1;
+			}
+		} else if ( MDB_IDL_IS_CHUNK( lo )) {
+			ID *p, *end;
+			rc = mdb_cursor_get( cursor, key, &data, MDB_GET_MULTIPLE );
+			while ( rc == 0 ) {
+				p = data.mv_data;
+				end = p + data.mv_size / sizeof(ID);
+				for ( ; p < end; p++ ) {
+					memcpy( &lo, p, sizeof(ID) );
+					*count += IDL_POPCOUNT( MDB_IDL_CHUNK_MASK( lo ));
+				}
+				rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_MULTIPLE );
+			}
+			if ( rc == MDB_NOTFOUND )
+				rc = 0;
+		} else {
+			rc = mdb_cursor_count( cursor, &n );
+			if ( rc == 0 )
+				*count = n;
+		}
+	}
+	mdb_cursor_close( cursor );
+
+	return rc;
+}
+
+/* If the IDs of key are stored as a range, return its bounds in
+ * *lo and *hi; otherwise set both to 0, and single IDs must be
+ * looked up with mdb_idl_probe_key().
+ */
+int
+mdb_idl_key_range(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	ID			*lo,
+	ID			*hi )
+{
+	MDB_val data;
+	int rc;
+
+	*lo = *hi = 0;
+	rc = mdb_cursor_get( cursor, key, &data, MDB_SET );
+	if ( rc == 0 ) {
+		memcpy( lo, data.mv_data, sizeof(ID) );
+		/* On disk, a range is denoted by 0 in the first element */
+		if ( *lo == 0 ) {
+			rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+			if ( rc == 0 ) {
+				memcpy( lo, data.mv_data, sizeof(ID) );
+				rc = mdb_cursor_get( cursor, key, &data, MDB_NEXT_DUP );
+			}
+			if ( rc == 0 )
+				memcpy( hi, data.mv_data, sizeof(ID) );
+			else
+				*lo = 0;
+		} else {
+			*lo = 0;
+		}
+	}
+	return rc;
+}
+
+/* Return 0 if id is stored under a key that is not a range,
+ * MDB_NOTFOUND if it is not.
+ */
+int
+mdb_idl_probe_key(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	ID			id )
+{
+	MDB_val k, data;
+	ID c;
+	int rc;
+
+	k = *key;
+	data.mv_data = &id;
+	data.mv_size = sizeof(ID);
+	rc = mdb_cursor_get( cursor, &k, &data, MDB_GET_BOTH_RANGE );
+	if ( rc )
+		return rc;
+	memcpy( &c, data.mv_data, sizeof(ID) );
+	if ( c == id )
+		return 0;
+	if ( !MDB_IDL_IS_CHUNK( c ))
+		return MDB_NOTFOUND;
+
+	/* a slot of bitmap chunks */
+	c = MDB_IDL_CHUNK( id );
+	data.mv_data = &c;
+	data.mv_size = sizeof(ID);
+	rc = mdb_cursor_get( cursor, &k, &data, MDB_GET_BOTH_RANGE );
+	if ( rc )
+		return rc;
+	memcpy( &c, data.mv_data, sizeof(ID) );
+	return c - MDB_IDL_CHUNK_MASK( c ) == MDB_IDL_CHUNK( id ) &&
+		( c & MDB_IDL_CHUNK_BIT( id )) ? 0 : MDB_NOTFOUND;
+}
+
 int
 mdb_idl_insert_keys(
 	BackendDB	*be,
@@ -439,17 +1526,40 @@ mdb_idl_insert_keys(
 	if ( rc == 0 ) {
 		i = data.mv_data;
 		memcpy(&lo, data.mv_data, sizeof(ID));
-		if ( lo != 0 ) {
-			/* not a range, count the number of items */
-			size_t count;
-			rc = mdb_cursor_count( cursor, &count );
+		if ( MDB_IDL_IS_CHUNK( lo ) && id <= MDB_IDL_CHUNK_MAXID ) {
+			/* bitmap chunks, set the bit of id */
+			rc = idl_chunk_update( cursor, &key, id, 1 );
 			if ( rc != 0 ) {
-				err = "c_count";
+				err = "c_put chunk";
 				goto fail;
 			}
-			if ( count >= MDB_IDL_DB_MAX ) {
+		} else if ( lo != 0 ) {
+			/* not a range, count the number of items */
+			size_t count = 0;
+			if ( !MDB_IDL_IS_CHUNK( lo )) {
+				rc = mdb_cursor_count( cursor, &count );
+				if ( rc != 0 ) {
+					err = "c_count";
+					goto fail;
+				}
+			}
+			if ( count >= MDB_IDL_DB_MAX &&
+				mdb->mi_idlfmt == MDB_IDLFMT_BITMAP &&
+				( rc = idl_make_chunks( cursor, &key, id )) != MDB_KEYEXIST ) {
+			/* No room, keep it exact as bitmap chunks */
+				if ( rc == 0 )
+					rc = idl_chunk_update( cursor, &key, id, 1 );
+				if ( rc != 0 ) {
+					err = "c_put chunks";
+					goto fail;
+				}
+			} else if ( MDB_IDL_IS_CHUNK( lo ) || count >= MDB_IDL_DB_MAX ) {
 			/* No room, convert to a range */
-				lo = *i;
+				if ( MDB_IDL_IS_CHUNK( lo ))
+					lo = MDB_IDL_CHUNK_BASE( lo ) +
+						IDL_CTZ( MDB_IDL_CHUNK_MASK( lo ));
+				else
+					lo = *i;
 				rc = mdb_cursor_get( cursor, &key, &data, MDB_LAST_DUP );
 				if ( rc != 0 && rc != MDB_NOTFOUND ) {
 					err = "c_get last_dup";
@@ -457,6 +1567,9 @@ mdb_idl_insert_keys(
 				}
 				i = data.mv_data;
 				hi = *i;
+				if ( MDB_IDL_IS_CHUNK( hi ))
+					hi = MDB_IDL_CHUNK_BASE( hi ) +
+						IDL_MSB( MDB_IDL_CHUNK_MASK( hi ));
 				/* Update hi/lo if needed */
 				if ( id < lo ) {
 					lo = id;
@@ -597,7 +1710,14 @@ mdb_idl_delete_keys(
 	if ( rc == 0 ) {
 		memcpy( &tmp, data.mv_data, sizeof(ID) );
 		i = data.mv_data;
-		if ( tmp != 0 ) {
+		if ( MDB_IDL_IS_CHUNK( tmp )) {
+			/* bitmap chunks, clear the bit of id */
+			rc = idl_chunk_update( cursor, &key, id, 0 );
+			if ( rc != 0 ) {
+				err = "c_put chunk";
+				goto fail;
+			}
+		} else if ( tmp != 0 ) {
 			/* Not a range, just delete it */
 			data.mv_data = &id;
 			rc = mdb_cursor_get( cursor, &key, &data, MDB_GET_BOTH );
@@ -702,12 +1822,35 @@ mdb_idl_intersection(
 			a[2] = idmax;
 			return 0;
 		} else {
-		/* Else swap so that b is the range, a is a list */
+		/* Else swap so that b is the range, a is a list or bitmap */
 			ID *tmp = a;
 			a = b;
 			b = tmp;
 			swap = 1;
 		}
+	} else if ( MDB_IDL_IS_BITMAP( a ) && MDB_IDL_IS_LIST( b )) {
+		/* Swap so that b is the bitmap, a is a list */
+		ID *tmp = a;
+		a = b;
+		b = tmp;
+		swap = 1;
+	}
+
+	if ( MDB_IDL_IS_BITMAP( a )) {
+		/* b is a range or a bitmap, the result is a bitmap */
+		idl_bitmap_and( a, b, idmin, idmax );
+		goto done;
+	}
+
+	if ( MDB_IDL_IS_BITMAP( b )) {
+		/* Keep the members of list a that are set in bitmap b */
+		cursorc = 0;
+		for ( cursora = 1; cursora <= a[0]; cursora++ ) {
+			if ( MDB_IDL_BITMAP_TEST( b, a[cursora] ))
+				a[++cursorc] = a[cursora];
+		}
+		a[0] = cursorc;
+		goto done;
 	}
 
 	/* If a range completely covers the list, the result is
@@ -726,6 +1869,14 @@ mdb_idl_intersection(
 		goto done;
 	}
 
+	if ( MDB_IDL_IS_LIST( b )) {
+		if ( a[0] > b[0] * IDL_GALLOP_RATIO || b[0] > a[0] * IDL_GALLOP_RATIO )
+			a[0] = idl_isect_gallop( a, b );
+		else
+			a[0] = idl_kern->ik_isect( a, b );
+		goto done;
+	}
+
 	/* Fine, do the intersection one element at a time.
 	 * First advance to idmin in both IDLs.
 	 */
@@ -783,6 +1934,26 @@ over:		ida = IDL_MIN( MDB_IDL_FIRST(a), MDB_IDL_FIRST(b) );
 		return 0;
 	}
 
+	if ( MDB_IDL_IS_BITMAP( a )) {
+		if ( idl_bitmap_merge( a, b, MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_UM_SIZE )))
+			goto over;
+		return 0;
+	}
+
+	if ( MDB_IDL_IS_BITMAP( b )) {
+		/* Merge a into b's bitmap and copy the result back */
+		if ( idl_bitmap_merge( b, a, MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_UM_SIZE )))
+			goto over;
+		MDB_IDL_CPY( a, b );
+		return 0;
+	}
+
+	/* If the result is sure to fit, merge in place */
+	if ( a[0] + b[0] <= MDB_IDL_UM_MAX ) {
+		a[0] = idl_kern->ik_merge( a, b );
+		return 0;
+	}
+
 	ida = mdb_idl_first( a, &cursora );
 	idb = mdb_idl_first( b, &cursorb );
 
@@ -792,6 +1963,10 @@ over:		ida = IDL_MIN( MDB_IDL_FIRST(a), MDB_IDL_FIRST(b) );
 	while( ida != NOID || idb != NOID ) {
 		if ( ida < idb ) {
 			if( ++cursorc > MDB_IDL_UM_MAX ) {
+				/* b's own elements are still intact */
+				if ( !idl_bitmap_build( a, a, b,
+					MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_UM_SIZE )))
+					return 0;
 				goto over;
 			}
 			b[cursorc] = ida;
@@ -826,7 +2001,6 @@ over:		ida = IDL_MIN( MDB_IDL_FIRST(a), MDB_IDL_FIRST(b) );
 }
 
 
-#if 0
 /*
  * mdb_idl_notin - return a intersection ~b (or a minus b)
  */
@@ -836,7 +2010,7 @@ mdb_idl_notin(
 	ID	*b,
 	ID *ids )
 {
-	ID ida, idb;
+	ID ida;
 	ID cursora = 0, cursorb = 0;
 
 	if( MDB_IDL_IS_ZERO( a ) ||
@@ -852,33 +2026,49 @@ mdb_idl_notin(
 		return 0;
 	}
 
-	ida = mdb_idl_first( a, &cursora ),
-	idb = mdb_idl_first( b, &cursorb );
-
-	ids[0] = 0;
-
-	while( ida != NOID ) {
-		if ( idb == NOID ) {
-			/* we could shortcut this */
-			ids[++ids[0]] = ida;
-			ida = mdb_idl_next( a, &cursora );
-
-		} else if ( ida < idb ) {
-			ids[++ids[0]] = ida;
-			ida = mdb_idl_next( a, &cursora );
-
-		} else if ( ida > idb ) {
-			idb = mdb_idl_next( b, &cursorb );
-
+	if( MDB_IDL_IS_BITMAP( a ) ) {
+		ID *w;
+		MDB_IDL_CPY( ids, a );
+		w = MDB_IDL_BITMAP_WORDS( ids );
+		if ( MDB_IDL_IS_BITMAP( b ) ) {
+			for ( cursorb = 0; cursorb < MDB_IDL_BITMAP_NWORDS( b ); cursorb++ ) {
+				ida = MDB_IDL_BITMAP_BASE( b ) + cursorb * MDB_IDL_BITMAP_BITS;
+				if ( ida < MDB_IDL_BITMAP_BASE( ids ))
+					continue;
+				cursora = (ida - MDB_IDL_BITMAP_BASE( ids )) / MDB_IDL_BITMAP_BITS;
+				if ( cursora >= MDB_IDL_BITMAP_NWORDS( ids ))
+					break;
+				w[cursora] &= ~MDB_IDL_BITMAP_WORDS( b )[cursorb];
+			}
 		} else {
-			ida = mdb_idl_next( a, &cursora );
-			idb = mdb_idl_next( b, &cursorb );
+			for ( cursorb = 1; cursorb <= b[0]; cursorb++ ) {
+				if ( !MDB_IDL_BITMAP_TEST( ids, b[cursorb] ))
+					continue;
+				ida = b[cursorb] - MDB_IDL_BITMAP_BASE( ids );
+				w[ida / MDB_IDL_BITMAP_BITS] &=
+					~((ID)1 << (ida % MDB_IDL_BITMAP_BITS));
+			}
 		}
+		idl_bitmap_fixup( ids );
+		return 0;
 	}
 
+	if( MDB_IDL_IS_BITMAP( b ) ) {
+		ids[0] = 0;
+		for ( cursora = 1; cursora <= a[0]; cursora++ ) {
+			if ( !MDB_IDL_BITMAP_TEST( b, a[cursora] ))
+				ids[++ids[0]] = a[cursora];
+		}
+		return 0;
+	}
+
+	if ( b[0] > a[0] * IDL_GALLOP_RATIO )
+		ids[0] = idl_notin_gallop( a, b, ids );
+	else
+		ids[0] = idl_kern->ik_notin( a, b, ids );
+
 	return 0;
 }
-#endif
 
 ID mdb_idl_first( ID *ids, ID *cursor )
 {
@@ -896,6 +2086,13 @@ ID mdb_idl_first( ID *ids, ID *cursor )
 		return *cursor;
 	}
 
+	if ( MDB_IDL_IS_BITMAP( ids ) ) {
+		pos = idl_bitmap_next( ids, *cursor );
+		if ( pos != NOID )
+			*cursor = pos;
+		return pos;
+	}
+
 	if ( *cursor == 0 )
 		pos = 1;
 	else
@@ -918,6 +2115,13 @@ ID mdb_idl_next( ID *ids, ID *cursor )
 		return *cursor;
 	}
 
+	if ( MDB_IDL_IS_BITMAP( ids ) ) {
+		ID id = idl_bitmap_next( ids, *cursor + 1 );
+		if ( id != NOID )
+			*cursor = id;
+		return id;
+	}
+
 	if ( ++(*cursor) <= ids[0] ) {
 		return ids[*cursor];
 	}
@@ -941,6 +2145,10 @@ int mdb_idl_append_one( ID *ids, ID id )
 			ids[2] = id;
 		return 0;
 	}
+	if (MDB_IDL_IS_BITMAP( ids )) {
+		return idl_bitmap_add( ids, id, IDL_MAX( MDB_IDL_BITMAP_NWORDS( ids ),
+			MDB_IDL_BITMAP_MAXWORDS( MDB_IDL_UM_SIZE )));
+	}
 	if ( ids[0] ) {
 		ID tmp;
 
@@ -981,6 +2189,11 @@ int mdb_idl_append( ID *a, ID *b )
 		return 0;
 	}
 
+	/* bitmaps are already sorted, nothing to gain by appending */
+	if ( MDB_IDL_IS_BITMAP( a ) || MDB_IDL_IS_BITMAP( b )) {
+		return mdb_idl_union( a, b );
+	}
+
 	ida = MDB_IDL_LAST( a );
 	idb = MDB_IDL_LAST( b );
 	if ( MDB_IDL_IS_RANGE( a ) || MDB_IDL_IS_RANGE(b) ||
@@ -1031,7 +2244,7 @@ mdb_idl_sort( ID *ids, ID *tmp )
 	int i,j,k,l,ir,jstack;
 	ID a, itmp;
 
-	if ( MDB_IDL_IS_RANGE( ids ))
+	if ( !MDB_IDL_IS_LIST( ids ) || idl_kern->ik_sorted( ids ))
 		return;
 
 	ir = ids[0];
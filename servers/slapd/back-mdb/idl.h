@@ -17,12 +17,19 @@
 #ifndef _MDB_IDL_H_
 #define _MDB_IDL_H_
 
-/* IDL sizes - likely should be even bigger
- *   limiting factors: sizeof(ID), thread stack size
+/* IDL sizes - set at startup by the idlexp keyword
+ *   limiting factors: sizeof(ID), memory per search
+ * Each thread that searches keeps searchstack+4.5 UM_SIZE IDLs, that
+ * is 328MB with 64 bit IDs at the maximum.
  */
 #define	MDB_IDL_LOGN	16	/* DB_SIZE is 2^16, UM_SIZE is 2^17 */
-#define MDB_IDL_DB_SIZE		(1<<MDB_IDL_LOGN)
-#define MDB_IDL_UM_SIZE		(1<<(MDB_IDL_LOGN+1))
+#define	MDB_IDL_LOGN_MAX	20
+
+extern unsigned int MDB_idl_logn;
+extern ID MDB_idl_db_size, MDB_idl_um_size;
+
+#define MDB_IDL_DB_SIZE		MDB_idl_db_size
+#define MDB_IDL_UM_SIZE		MDB_idl_um_size
 #define MDB_IDL_UM_SIZEOF	(MDB_IDL_UM_SIZE * sizeof(ID))
 
 #define MDB_IDL_DB_MAX		(MDB_IDL_DB_SIZE-1)
@@ -32,8 +39,62 @@
 #define MDB_IDL_IS_RANGE(ids)	((ids)[0] == NOID)
 #define MDB_IDL_RANGE_SIZE		(3)
 #define MDB_IDL_RANGE_SIZEOF	(MDB_IDL_RANGE_SIZE * sizeof(ID))
+
+/* Bitmap IDLs - used instead of a range when a list overflows but
+ * its IDs span a small enough window to be kept exact in the same
+ * buffer as a bitmap. Layout:
+ *   [0] MDB_IDL_BITMAP_TAG
+ *   [1] first ID in the set
+ *   [2] last ID in the set
+ *   [3] ID corresponding to bit 0 of the first word
+ *   [4] number of IDs in the set
+ *   [5] number of bitmap words
+ *   [6] ... bitmap words
+ * First and last are kept in the same slots as a range, so code that
+ * only needs the bounds can treat both alike.
+ */
+#define MDB_IDL_BITMAP_TAG		(NOID-1)
+#define MDB_IDL_IS_BITMAP(ids)	((ids)[0] == MDB_IDL_BITMAP_TAG)
+#define MDB_IDL_BITMAP_HDR		(6)
+#define MDB_IDL_BITMAP_BITS		(sizeof(ID) * 8)
+#define MDB_IDL_BITMAP_BASE(ids)	((ids)[3])
+#define MDB_IDL_BITMAP_COUNT(ids)	((ids)[4])
+#define MDB_IDL_BITMAP_NWORDS(ids)	((ids)[5])
+#define MDB_IDL_BITMAP_WORDS(ids)	((ids)+MDB_IDL_BITMAP_HDR)
+#define MDB_IDL_BITMAP_SIZE(ids)	(MDB_IDL_BITMAP_HDR + MDB_IDL_BITMAP_NWORDS(ids))
+
+/* max bitmap words that fit in a buffer of the given size */
+#define MDB_IDL_BITMAP_MAXWORDS(size)	((size) - MDB_IDL_BITMAP_HDR)
+
+#define MDB_IDL_BITMAP_TEST(ids, id)	( (id) >= MDB_IDL_BITMAP_BASE(ids) && \
+	(id) - MDB_IDL_BITMAP_BASE(ids) < MDB_IDL_BITMAP_NWORDS(ids) * MDB_IDL_BITMAP_BITS && \
+	( MDB_IDL_BITMAP_WORDS(ids)[((id) - MDB_IDL_BITMAP_BASE(ids)) / MDB_IDL_BITMAP_BITS] & \
+	((ID)1 << (((id) - MDB_IDL_BITMAP_BASE(ids)) % MDB_IDL_BITMAP_BITS))))
+
+/* Bitmap chunks - how an index slot that outgrows MDB_IDL_DB_MAX is
+ * stored with "idlformat bitmap", instead of as a range. Each chunk
+ * is one duplicate of the slot: the top bit is set, so that it sorts
+ * after any plain ID and the 0 that starts a range; below it is the
+ * number of the chunk, and the low half holds one bit per ID. IDs
+ * past MDB_IDL_CHUNK_MAXID (2^36-1 with 64 bit IDs) don't fit, and
+ * a slot that gets one becomes a range after all.
+ */
+#define MDB_IDL_CHUNK_BITS		(MDB_IDL_BITMAP_BITS/2)
+#define MDB_IDL_CHUNK_FLAG		((ID)1 << (MDB_IDL_BITMAP_BITS-1))
+#define MDB_IDL_CHUNK_MAXID		(((MDB_IDL_CHUNK_FLAG >> MDB_IDL_CHUNK_BITS) * \
+	MDB_IDL_CHUNK_BITS) - 1)
+#define MDB_IDL_IS_CHUNK(c)		((c) & MDB_IDL_CHUNK_FLAG)
+#define MDB_IDL_CHUNK_MASK(c)	((c) & (((ID)1 << MDB_IDL_CHUNK_BITS) - 1))
+#define MDB_IDL_CHUNK_BASE(c)	((((c) & ~MDB_IDL_CHUNK_FLAG) >> MDB_IDL_CHUNK_BITS) * \
+	MDB_IDL_CHUNK_BITS)
+/* the chunk holding id, with no bits set */
+#define MDB_IDL_CHUNK(id)		(MDB_IDL_CHUNK_FLAG | \
+	((id) / MDB_IDL_CHUNK_BITS) << MDB_IDL_CHUNK_BITS)
+#define MDB_IDL_CHUNK_BIT(id)	((ID)1 << ((id) % MDB_IDL_CHUNK_BITS))
+
 #define MDB_IDL_SIZEOF(ids)		((MDB_IDL_IS_RANGE(ids) \
-	? MDB_IDL_RANGE_SIZE : ((ids)[0]+1)) * sizeof(ID))
+	? MDB_IDL_RANGE_SIZE : MDB_IDL_IS_BITMAP(ids) \
+	? MDB_IDL_BITMAP_SIZE(ids) : ((ids)[0]+1)) * sizeof(ID))
 
 #define MDB_IDL_RANGE_FIRST(ids)	((ids)[1])
 #define MDB_IDL_RANGE_LAST(ids)		((ids)[2])
@@ -63,11 +124,15 @@
 
 #define MDB_IDL_FIRST( ids )	( (ids)[1] )
 #define MDB_IDL_LLAST( ids )	( (ids)[(ids)[0]] )
-#define MDB_IDL_LAST( ids )		( MDB_IDL_IS_RANGE(ids) \
+#define MDB_IDL_LAST( ids )		( MDB_IDL_IS_RANGE(ids) || MDB_IDL_IS_BITMAP(ids) \
 	? (ids)[2] : (ids)[(ids)[0]] )
 
 #define MDB_IDL_N( ids )		( MDB_IDL_IS_RANGE(ids) \
-	? ((ids)[2]-(ids)[1])+1 : (ids)[0] )
+	? ((ids)[2]-(ids)[1])+1 : MDB_IDL_IS_BITMAP(ids) \
+	? MDB_IDL_BITMAP_COUNT(ids) : (ids)[0] )
+
+/* a plain sorted array of IDs */
+#define MDB_IDL_IS_LIST( ids )	( !MDB_IDL_IS_RANGE(ids) && !MDB_IDL_IS_BITMAP(ids) )
 
 	/** An ID2 is an ID/value pair.
 	 */
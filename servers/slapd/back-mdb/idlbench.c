@@ -0,0 +1,233 @@
+/* idlbench.c - micro-benchmark for the IDL list kernels */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2000-2016 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Times each available kernel set on random sorted lists and checks
+ * that they all produce the same results as the scalar set. It pulls
+ * in idl.c directly so the kernel tables can be selected by hand.
+ *
+ * Not built by default; use "make idlbench" in this directory.
+ *
+ * Usage: idlbench [-n iterations] [-a size] [-b size] [-s span]
+ */
+
+#include "idl.c"
+
+#include <ac/stdlib.h>
+#include <ac/time.h>
+#include <ac/unistd.h>
+
+#undef malloc
+#undef calloc
+#undef free
+
+/* Minimal stand-ins for the few slapd symbols idl.c refers to */
+int slap_debug;
+int ldap_syslog;
+int ldap_syslog_level;
+
+void *
+ch_calloc( ber_len_t nelem, ber_len_t size )
+{
+	void *p = calloc( nelem, size );
+	if ( p == NULL ) {
+		fprintf( stderr, "ch_calloc: out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+	return p;
+}
+
+void
+ch_free( void *p )
+{
+	free( p );
+}
+
+static const idl_kernels *kernels[] = {
+	&idl_kern_scalar,
+#ifdef IDL_SIMD
+	&idl_kern_sse42,
+	&idl_kern_avx2,
+#endif
+	NULL
+};
+
+static int
+kernel_usable( const idl_kernels *k )
+{
+#ifdef IDL_SIMD
+	__builtin_cpu_init();
+	if ( k == &idl_kern_avx2 )
+		return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "popcnt" );
+	if ( k == &idl_kern_sse42 )
+		return __builtin_cpu_supports( "sse4.2" ) && __builtin_cpu_supports( "popcnt" );
+#endif
+	return 1;
+}
+
+static double
+now( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Fill ids with about n distinct sorted IDs drawn from [1,span] */
+static void
+mklist( ID *ids, ID n, ID span )
+{
+	ID i, step;
+
+	if ( n > span ) n = span;
+	if ( n > MDB_IDL_UM_MAX ) n = MDB_IDL_UM_MAX;
+	step = span / ( n ? n : 1 );
+	ids[0] = 0;
+	for ( i = 0; i < n; i++ ) {
+		ID id = 1 + i * step + ( step > 1 ? random() % step : 0 );
+		if ( ids[0] && id <= ids[ids[0]] )
+			continue;
+		ids[++ids[0]] = id;
+	}
+}
+
+#define	NOPS	5
+static const char *opnames[NOPS] = {
+	"search", "intersect", "union", "notin", "sorted"
+};
+
+/* Results of the scalar kernels, which the others must reproduce */
+static ID *ref[NOPS-1];
+
+static int
+check( int k, int op, ID *ids )
+{
+	if ( k == 0 ) {
+		AC_MEMCPY( ref[op], ids, ( ids[0]+1 ) * sizeof(ID) );
+		return 0;
+	}
+	if ( ref[op][0] != ids[0] ||
+		memcmp( ref[op]+1, ids+1, ids[0] * sizeof(ID) ))
+		return 1 << op;
+	return 0;
+}
+
+int
+main( int argc, char **argv )
+{
+	ID *a, *b, *t;
+	ID asize = 10000, bsize = 100000, span = 1000000;
+	int iters = 200, i, j, k, c, fail = 0;
+	double start, elapsed[NOPS];
+	ID chk;
+
+	while (( c = getopt( argc, argv, "n:a:b:s:" )) != EOF ) {
+		switch ( c ) {
+		case 'n': iters = atoi( optarg ); break;
+		case 'a': asize = strtoul( optarg, NULL, 0 ); break;
+		case 'b': bsize = strtoul( optarg, NULL, 0 ); break;
+		case 's': span = strtoul( optarg, NULL, 0 ); break;
+		default:
+			fprintf( stderr, "usage: %s [-n iterations] [-a size] [-b size] [-s span]\n",
+				argv[0] );
+			return EXIT_FAILURE;
+		}
+	}
+	/* a union must fit in a list for the merge kernel to be used */
+	if ( asize + bsize > MDB_IDL_UM_MAX ) {
+		fprintf( stderr, "%s: -a plus -b must not exceed %ld\n",
+			argv[0], (long) MDB_IDL_UM_MAX );
+		return EXIT_FAILURE;
+	}
+
+	a = ch_calloc( MDB_IDL_UM_SIZE, sizeof(ID) );
+	b = ch_calloc( MDB_IDL_UM_SIZE, sizeof(ID) );
+	t = ch_calloc( MDB_IDL_UM_SIZE, sizeof(ID) );
+	for ( j = 0; j < NOPS-1; j++ )
+		ref[j] = ch_calloc( MDB_IDL_UM_SIZE, sizeof(ID) );
+
+	srandom( 42 );
+	mklist( a, asize, span );
+	mklist( b, bsize, span );
+
+	printf( "a=%lu b=%lu span=%lu iterations=%d default=%s\n",
+		a[0], b[0], span, iters, mdb_idl_kernels_init() );
+	printf( "%-8s", "kernels" );
+	for ( j = 0; j < NOPS; j++ )
+		printf( " %12s", opnames[j] );
+	printf( "   (usec per call)\n" );
+
+	for ( k = 0; kernels[k]; k++ ) {
+		if ( !kernel_usable( kernels[k] ))
+			continue;
+		idl_kern = kernels[k];
+
+		/* search: look up every ID of a in b */
+		chk = 0;
+		start = now();
+		for ( i = 0; i < iters; i++ )
+			for ( j = 1; j <= a[0]; j++ )
+				chk += idl_kern->ik_search( b, a[j] );
+		elapsed[0] = ( now() - start ) / iters;
+		t[0] = 1;
+		t[1] = chk;
+		fail |= check( k, 0, t );
+
+		start = now();
+		for ( i = 0; i < iters; i++ ) {
+			AC_MEMCPY( t, a, ( a[0]+1 ) * sizeof(ID) );
+			t[0] = idl_kern->ik_isect( t, b );
+		}
+		elapsed[1] = ( now() - start ) / iters;
+		fail |= check( k, 1, t );
+
+		start = now();
+		for ( i = 0; i < iters; i++ ) {
+			AC_MEMCPY( t, a, ( a[0]+1 ) * sizeof(ID) );
+			t[0] = idl_kern->ik_merge( t, b );
+		}
+		elapsed[2] = ( now() - start ) / iters;
+		fail |= check( k, 2, t );
+
+		start = now();
+		for ( i = 0; i < iters; i++ )
+			t[0] = idl_kern->ik_notin( b, a, t );
+		elapsed[3] = ( now() - start ) / iters;
+		fail |= check( k, 3, t );
+
+		start = now();
+		for ( i = 0; i < iters; i++ )
+			if ( !idl_kern->ik_sorted( b ))
+				fail |= 1 << 4;
+		elapsed[4] = ( now() - start ) / iters;
+
+		printf( "%-8s", idl_kern->ik_name );
+		for ( j = 0; j < NOPS; j++ )
+			printf( " %12.2f", elapsed[j] * 1e6 );
+		printf( "\n" );
+		if ( fail ) {
+			printf( "%s: results differ from scalar (0x%x)\n",
+				idl_kern->ik_name, fail );
+			break;
+		}
+	}
+
+	for ( j = 0; j < NOPS-1; j++ )
+		ch_free( ref[j] );
+	ch_free( t );
+	ch_free( b );
+	ch_free( a );
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -157,7 +157,7 @@ int mdb_index_param(
 
 done:
 	*dbip = ai->ai_dbi;
-	*maskp = mask;
+	*maskp = mask | ((struct mdb_info *)be->be_private)->mi_ixhash;
 	return LDAP_SUCCESS;
 }
 
@@ -180,6 +180,8 @@ static int indexer(
 
 	assert( mask != 0 );
 
+	mask |= ((struct mdb_info *)op->o_bd->be_private)->mi_ixhash;
+
 	if ( !mc ) {
 		err = "c_open";
 		rc = mdb_cursor_open( txn, ai->ai_dbi, &mc );
@@ -23,6 +23,7 @@
 #include <ac/errno.h>
 #include <sys/stat.h>
 #include "back-mdb.h"
+#include "sorted.h"
 #include <lutil.h>
 #include <ldap_rq.h>
 #include "config.h"
@@ -67,6 +68,9 @@ mdb_db_init( BackendDB *be, ConfigReply *cr )
 	mdb->mi_multi_hi = UINT_MAX;
 	mdb->mi_multi_lo = UINT_MAX;
 
+	ldap_pvt_thread_mutex_init( &mdb->mi_gc_mutex );
+	ldap_pvt_thread_cond_init( &mdb->mi_gc_cond );
+
 	be->be_private = mdb;
 	be->be_cf_ocs = be->bd_info->bi_cf_ocs;
 
@@ -178,6 +182,14 @@ mdb_db_open( BackendDB *be, ConfigReply *cr )
 	rc = mdb_env_open( mdb->mi_dbenv, dbhome,
 			flags, mdb->mi_dbenv_mode );
 
+	if ( rc == MDB_INCOMPATIBLE && ( flags & MDB_PAGECRC )) {
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_db_open) ": database \"%s\" was created "
+			"without page checksums. Remove \"checksum\" from envflags "
+			"or reload the database.\n",
+			be->be_suffix[0].bv_val, 0, 0 );
+		goto fail;
+	}
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
 			LDAP_XSTRING(mdb_db_open) ": database \"%s\" cannot be opened: %s (%d). "
@@ -273,6 +285,47 @@ mdb_db_open( BackendDB *be, ConfigReply *cr )
 		goto fail;
 	}
 
+	rc = mdb_ixhash_read( mdb, txn, &mdb->mi_ixhash, &mdb->mi_idlfmt );
+	if ( rc == MDB_NOTFOUND ) {
+		MDB_stat st;
+
+		/* no record: keys use the global hash and full slots become
+		 * ranges, unless the DB is still empty and can take the
+		 * configured ones right away
+		 */
+		mdb->mi_ixhash = 0;
+		mdb->mi_idlfmt = MDB_IDLFMT_RANGE;
+		rc = 0;
+		if ( ( mdb->mi_ixhash_cf || mdb->mi_idlfmt_cf ) &&
+			!(slapMode & SLAP_TOOL_READONLY) &&
+			mdb_stat( txn, mdb->mi_id2entry, &st ) == 0 &&
+			st.ms_entries == 0 ) {
+			unsigned idlfmt = mdb->mi_idlfmt_cf ? mdb->mi_idlfmt_cf :
+				MDB_IDLFMT_RANGE;
+			rc = mdb_ixhash_write( mdb, txn, mdb->mi_ixhash_cf, idlfmt );
+			if ( rc == 0 ) {
+				mdb->mi_ixhash = mdb->mi_ixhash_cf;
+				mdb->mi_idlfmt = idlfmt;
+			}
+		}
+	}
+	if ( rc ) {
+		mdb_txn_abort( txn );
+		goto fail;
+	}
+	if ( mdb->mi_ixhash_cf && mdb->mi_ixhash != mdb->mi_ixhash_cf ) {
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_db_open) ": database \"%s\": "
+			"indexhash takes effect after \"slapindex -t\".\n",
+			be->be_suffix[0].bv_val, 0, 0 );
+	}
+	if ( mdb->mi_idlfmt_cf && mdb->mi_idlfmt != mdb->mi_idlfmt_cf ) {
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_db_open) ": database \"%s\": "
+			"idlformat takes effect after \"slapindex -t\".\n",
+			be->be_suffix[0].bv_val, 0, 0 );
+	}
+
 	/* slapcat doesn't need indexes. avoid a failure if
 	 * a configured index wasn't created yet.
 	 */
@@ -293,6 +346,22 @@ mdb_db_open( BackendDB *be, ConfigReply *cr )
 		goto fail;
 	}
 
+	/* verify page checksums in the background */
+	if ( mdb->mi_scrub && !( slapMode & SLAP_TOOL_MODE )) {
+		rc = mdb_env_scrub_start( mdb->mi_dbenv, mdb->mi_scrub_rate,
+			mdb->mi_scrub_min * 60 );
+		if ( rc ) {
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_db_open) ": database \"%s\": "
+				"cannot start scrubbing: %s (%d)\n",
+				be->be_suffix[0].bv_val, mdb_strerror(rc), rc );
+			rc = 0;
+		}
+	}
+
+	if ( !( slapMode & SLAP_TOOL_MODE ))
+		mdb_cache_init( mdb );
+
 	/* monitor setup */
 	rc = mdb_monitor_db_open( be );
 	if ( rc != 0 ) {
@@ -323,6 +392,8 @@ mdb_db_close( BackendDB *be, ConfigReply *cr )
 		mdb_reader_flush( mdb->mi_dbenv );
 	}
 
+	mdb_cache_destroy( mdb );
+
 	if ( mdb->mi_dbenv ) {
 		if ( mdb->mi_dbis[0] ) {
 			int i;
@@ -375,12 +446,22 @@ mdb_db_destroy( BackendDB *be, ConfigReply *cr )
 
 	mdb_attr_index_destroy( mdb );
 
+	ldap_pvt_thread_cond_destroy( &mdb->mi_gc_cond );
+	ldap_pvt_thread_mutex_destroy( &mdb->mi_gc_mutex );
+
 	ch_free( mdb );
 	be->be_private = NULL;
 
 	return 0;
 }
 
+static const mdb_sorted_t mdb_sorted = {
+	mdb_sorted_open,
+	mdb_sorted_next,
+	mdb_sorted_entry,
+	mdb_sorted_close
+};
+
 int
 mdb_back_initialize(
 	BackendInfo	*bi )
@@ -411,7 +492,8 @@ mdb_back_initialize(
 		SLAP_BFLAG_INCREMENT |
 		SLAP_BFLAG_SUBENTRIES |
 		SLAP_BFLAG_ALIASES |
-		SLAP_BFLAG_REFERRALS;
+		SLAP_BFLAG_REFERRALS |
+		SLAP_BFLAG_GROUPCACHE;
 
 	bi->bi_controls = controls;
 
@@ -444,6 +526,12 @@ mdb_back_initialize(
 			": %s\n", version, 0, 0 );
 	}
 
+	{
+		const char *kernels = mdb_idl_kernels_init();
+		Debug( LDAP_DEBUG_TRACE, LDAP_XSTRING(mdb_back_initialize)
+			": using %s IDL kernels\n", kernels, 0, 0 );
+	}
+
 	bi->bi_open = 0;
 	bi->bi_close = 0;
 	bi->bi_config = 0;
@@ -475,6 +563,8 @@ mdb_back_initialize(
 	bi->bi_entry_release_rw = mdb_entry_release;
 	bi->bi_entry_get_rw = mdb_entry_get;
 
+	bi->bi_extra = (void *)&mdb_sorted;
+
 	/*
 	 * hooks for slap tools
 	 */
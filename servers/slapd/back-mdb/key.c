@@ -70,3 +70,91 @@ mdb_key_read(
 
 	return rc;
 }
+
+/* count the IDs under a key */
+int
+mdb_key_count(
+	MDB_txn *txn,
+	MDB_dbi dbi,
+	struct berval *k,
+	ID *count
+)
+{
+	MDB_val key;
+#ifndef MISALIGNED_OK
+	int kbuf[2];
+
+	if (k->bv_len & ALIGNER) {
+		key.mv_size = sizeof(kbuf);
+		key.mv_data = kbuf;
+		kbuf[1] = 0;
+		memcpy(kbuf, k->bv_val, k->bv_len);
+	} else
+#endif
+	{
+		key.mv_size = k->bv_len;
+		key.mv_data = k->bv_val;
+	}
+
+	return mdb_idl_count_key( txn, dbi, &key, count );
+}
+
+/* Prepare a key for looking up single IDs with mdb_key_probe().
+ * A key that does not exist is treated as an empty range.
+ */
+int
+mdb_key_probe_init(
+	MDB_cursor *mc,
+	struct berval *k,
+	mdb_ikey *ik
+)
+{
+#ifndef MISALIGNED_OK
+	if (k->bv_len & ALIGNER) {
+		ik->ik_key.mv_size = sizeof(ik->ik_kbuf);
+		ik->ik_key.mv_data = ik->ik_kbuf;
+		ik->ik_kbuf[1] = 0;
+		memcpy(ik->ik_kbuf, k->bv_val, k->bv_len);
+	} else
+#endif
+	{
+		ik->ik_key.mv_size = k->bv_len;
+		ik->ik_key.mv_data = k->bv_val;
+	}
+
+	return mdb_key_probe_reset( mc, ik );
+}
+
+/* Look up again how the IDs of a probed key are stored, after the
+ * cursor was renewed in a new txn.
+ */
+int
+mdb_key_probe_reset(
+	MDB_cursor *mc,
+	mdb_ikey *ik
+)
+{
+	int rc;
+
+	rc = mdb_idl_key_range( mc, &ik->ik_key, &ik->ik_lo, &ik->ik_hi );
+	if ( rc == MDB_NOTFOUND ) {
+		ik->ik_lo = 1;
+		ik->ik_hi = 0;
+		rc = 0;
+	}
+	return rc;
+}
+
+/* Is id stored under the key? Returns 0 if so, MDB_NOTFOUND if not */
+int
+mdb_key_probe(
+	MDB_cursor *mc,
+	mdb_ikey *ik,
+	ID id
+)
+{
+	if ( ik->ik_lo )
+		return ( id >= ik->ik_lo && id <= ik->ik_hi ) ? 0 : MDB_NOTFOUND;
+
+	return mdb_idl_probe_key( mc, &ik->ik_key, id );
+}
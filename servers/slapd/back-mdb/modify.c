@@ -542,7 +542,6 @@ mdb_modify( Operation *op, SlapReply *rs )
 	LDAPControl **postread_ctrl = NULL;
 	LDAPControl *ctrls[SLAP_MAX_RESPONSE_CONTROLS];
 	int num_ctrls = 0;
-	int numads = mdb->mi_numads;
 
 	Debug( LDAP_DEBUG_ARGS, LDAP_XSTRING(mdb_modify) ": %s\n",
 		op->o_req_dn.bv_val, 0, 0 );
@@ -716,19 +715,17 @@ mdb_modify( Operation *op, SlapReply *rs )
 
 	/* Only free attrs if they were dup'd.  */
 	if ( dummy.e_attrs == e->e_attrs ) dummy.e_attrs = NULL;
+	mdb_opinfo_written( moi, &op->o_req_ndn, LDAP_SCOPE_BASE );
 	if( moi == &opinfo ) {
 		LDAP_SLIST_REMOVE( &op->o_extra, &opinfo.moi_oe, OpExtra, oe_next );
 		opinfo.moi_oe.oe_key = NULL;
 		if( op->o_noop ) {
-			mdb->mi_numads = numads;
-			mdb_txn_abort( txn );
+			mdb_opinfo_abort( mdb, moi );
 			rs->sr_err = LDAP_X_NO_OPERATION;
 			txn = NULL;
 			goto return_results;
 		} else {
-			rs->sr_err = mdb_txn_commit( txn );
-			if ( rs->sr_err )
-				mdb->mi_numads = numads;
+			rs->sr_err = mdb_opinfo_commit( mdb, moi );
 			txn = NULL;
 		}
 	}
@@ -771,8 +768,7 @@ done:
 
 	if( moi == &opinfo ) {
 		if( txn != NULL ) {
-			mdb->mi_numads = numads;
-			mdb_txn_abort( txn );
+			mdb_opinfo_abort( mdb, moi );
 		}
 		if ( opinfo.moi_oe.oe_key ) {
 			LDAP_SLIST_REMOVE( &op->o_extra, &opinfo.moi_oe, OpExtra, oe_next );
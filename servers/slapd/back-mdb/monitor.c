@@ -33,6 +33,11 @@ static ObjectClass		*oc_olmMDBDatabase;
 
 static AttributeDescription *ad_olmDbDirectory;
 
+static AttributeDescription *ad_olmMDBScrubPasses,
+	*ad_olmMDBScrubProgress, *ad_olmMDBChecksumErrors,
+	*ad_olmMDBChecksumBadPage, *ad_olmMDBEntryCacheHits,
+	*ad_olmMDBEntryCacheMisses, *ad_olmMDBEntryCacheEntries;
+
 #ifdef MDB_MONITOR_IDX
 static int
 mdb_monitor_idx_entry_add(
@@ -88,6 +93,62 @@ static struct {
 		&ad_olmDbNotIndexed },
 #endif /* MDB_MONITOR_IDX */
 
+	{ "( olmMDBAttributes:1 "
+		"NAME ( 'olmMDBScrubPasses' ) "
+		"DESC 'Number of completed page checksum verification passes' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBScrubPasses },
+
+	{ "( olmMDBAttributes:2 "
+		"NAME ( 'olmMDBScrubProgress' ) "
+		"DESC 'Pages verified in the current pass, out of pages in use' "
+		"SUP monitoredInfo "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBScrubProgress },
+
+	{ "( olmMDBAttributes:3 "
+		"NAME ( 'olmMDBChecksumErrors' ) "
+		"DESC 'Number of pages that failed checksum verification' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBChecksumErrors },
+
+	{ "( olmMDBAttributes:4 "
+		"NAME ( 'olmMDBChecksumBadPage' ) "
+		"DESC 'Number of the last page that failed checksum verification' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBChecksumBadPage },
+
+	{ "( olmMDBAttributes:5 "
+		"NAME ( 'olmMDBEntryCacheHits' ) "
+		"DESC 'Number of entries found in the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheHits },
+
+	{ "( olmMDBAttributes:6 "
+		"NAME ( 'olmMDBEntryCacheMisses' ) "
+		"DESC 'Number of entries not found in the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheMisses },
+
+	{ "( olmMDBAttributes:7 "
+		"NAME ( 'olmMDBEntryCacheEntries' ) "
+		"DESC 'Number of entries in the entry cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBEntryCacheEntries },
+
 	{ NULL }
 };
 
@@ -105,6 +166,13 @@ static struct {
 #ifdef MDB_MONITOR_IDX
 			"$ olmDbNotIndexed "
 #endif /* MDB_MONITOR_IDX */
+			"$ olmMDBScrubPasses "
+			"$ olmMDBScrubProgress "
+			"$ olmMDBChecksumErrors "
+			"$ olmMDBChecksumBadPage "
+			"$ olmMDBEntryCacheHits "
+			"$ olmMDBEntryCacheMisses "
+			"$ olmMDBEntryCacheEntries "
 			") )",
 		&oc_olmMDBDatabase },
 
@@ -119,6 +187,68 @@ mdb_monitor_update(
 	void		*priv )
 {
 	struct mdb_info		*mdb = (struct mdb_info *) priv;
+	MDB_scrubstat		ms;
+	Attribute		*a;
+	char			buf[ BUFSIZ ];
+	struct berval		bv;
+	unsigned long		hits, misses, entries;
+
+	if ( mdb_env_scrub_stat( mdb->mi_dbenv, &ms ) == 0 ) {
+		a = attr_find( e->e_attrs, ad_olmMDBScrubPasses );
+		if ( a != NULL ) {
+			bv.bv_val = buf;
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu",
+				(unsigned long) ms.ms_passes );
+			ber_bvreplace( &a->a_vals[ 0 ], &bv );
+		}
+
+		a = attr_find( e->e_attrs, ad_olmMDBScrubProgress );
+		if ( a != NULL ) {
+			bv.bv_val = buf;
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu/%lu",
+				(unsigned long) ms.ms_checked,
+				(unsigned long) ms.ms_pages );
+			ber_bvreplace( &a->a_vals[ 0 ], &bv );
+		}
+
+		a = attr_find( e->e_attrs, ad_olmMDBChecksumErrors );
+		if ( a != NULL ) {
+			bv.bv_val = buf;
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu",
+				(unsigned long) ms.ms_errors );
+			ber_bvreplace( &a->a_vals[ 0 ], &bv );
+		}
+
+		a = attr_find( e->e_attrs, ad_olmMDBChecksumBadPage );
+		if ( a != NULL ) {
+			bv.bv_val = buf;
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu",
+				(unsigned long) ms.ms_badpage );
+			ber_bvreplace( &a->a_vals[ 0 ], &bv );
+		}
+	}
+
+	mdb_cache_stat( mdb, &hits, &misses, &entries );
+	a = attr_find( e->e_attrs, ad_olmMDBEntryCacheHits );
+	if ( a != NULL ) {
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", hits );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	a = attr_find( e->e_attrs, ad_olmMDBEntryCacheMisses );
+	if ( a != NULL ) {
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", misses );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	a = attr_find( e->e_attrs, ad_olmMDBEntryCacheEntries );
+	if ( a != NULL ) {
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", entries );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
 
 #ifdef MDB_MONITOR_IDX
 	mdb_monitor_idx_entry_add( mdb, e );
@@ -283,7 +413,8 @@ mdb_monitor_db_open( BackendDB *be )
 	struct mdb_info		*mdb = (struct mdb_info *) be->be_private;
 	Attribute		*a, *next;
 	monitor_callback_t	*cb = NULL;
-	int			rc = 0;
+	int			rc = 0, ncrc = 0;
+	unsigned int		envflags;
 	BackendInfo		*mi;
 	monitor_extra_t		*mbe;
 
@@ -312,8 +443,15 @@ mdb_monitor_db_open( BackendDB *be )
 		return 0;
 	}
 
+	/* page checksum counters only apply to checksummed environments */
+	if ( mdb_env_get_flags( mdb->mi_dbenv, &envflags ) == 0 &&
+		( envflags & MDB_PAGECRC ))
+	{
+		ncrc = 4;
+	}
+
 	/* alloc as many as required (plus 1 for objectClass) */
-	a = attrs_alloc( 1 + 1 );
+	a = attrs_alloc( 1 + 1 + ncrc + 3 );
 	if ( a == NULL ) {
 		rc = 1;
 		goto cleanup;
@@ -374,6 +512,42 @@ mdb_monitor_db_open( BackendDB *be )
 		next = next->a_next;
 	}
 
+	if ( ncrc ) {
+		struct berval	bv = BER_BVC( "0" ), pbv = BER_BVC( "0/0" );
+
+		next->a_desc = ad_olmMDBScrubPasses;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBScrubProgress;
+		attr_valadd( next, &pbv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBChecksumErrors;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBChecksumBadPage;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+	}
+
+	{
+		struct berval	bv = BER_BVC( "0" );
+
+		next->a_desc = ad_olmMDBEntryCacheHits;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBEntryCacheMisses;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBEntryCacheEntries;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+	}
+
 	cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
 	cb->mc_update = mdb_monitor_update;
 #if 0	/* uncomment if required */
@@ -48,6 +48,24 @@ void mdb_attr_info_free( AttrInfo *ai );
 
 int mdb_ad_read( struct mdb_info *mdb, MDB_txn *txn );
 int mdb_ad_get( struct mdb_info *mdb, MDB_txn *txn, AttributeDescription *ad );
+int mdb_ixhash_read( struct mdb_info *mdb, MDB_txn *txn, slap_mask_t *hash,
+	unsigned *idlfmt );
+int mdb_ixhash_write( struct mdb_info *mdb, MDB_txn *txn, slap_mask_t hash,
+	unsigned idlfmt );
+
+/*
+ * cache.c
+ */
+
+int mdb_cache_init( struct mdb_info *mdb );
+void mdb_cache_destroy( struct mdb_info *mdb );
+Entry *mdb_cache_find( Operation *op, MDB_txn *txn, ID id );
+void mdb_cache_add( Operation *op, MDB_txn *txn, ID id, Entry *e );
+void mdb_cache_delete( struct mdb_info *mdb, MDB_txn *txn, ID id );
+int mdb_cache_entry( Entry *e );
+void mdb_cache_release( Entry *e );
+void mdb_cache_stat( struct mdb_info *mdb, unsigned long *hits,
+	unsigned long *misses, unsigned long *entries );
 
 /*
  * config.c
@@ -164,6 +182,23 @@ int mdb_filter_candidates(
 	ID *tmp,
 	ID *stack );
 
+mdb_iprobe *mdb_filter_probes(
+	Operation *op,
+	MDB_txn *txn,
+	Filter	*f );
+
+int mdb_filter_probe(
+	mdb_iprobe *ip,
+	ID id );
+
+void mdb_filter_probes_renew(
+	MDB_txn *txn,
+	mdb_iprobe *ip );
+
+void mdb_filter_probes_free(
+	Operation *op,
+	mdb_iprobe *ip );
+
 /*
  * id2entry.c
  */
@@ -205,9 +240,16 @@ BI_entry_get_rw mdb_entry_get;
 BI_op_txn mdb_txn;
 
 int mdb_entry_decode( Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **e );
+int mdb_entry_pdecode( Operation *op, MDB_txn *txn, MDB_val *data, ID id,
+	mdb_attrset *as, Entry **e, int *partial );
+void mdb_attrset_init( Operation *op, mdb_attrset *as, AttributeDescription **ads );
+void mdb_attrset_destroy( Operation *op, mdb_attrset *as );
 
 void mdb_reader_flush( MDB_env *env );
 int mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **moi );
+int mdb_opinfo_commit( struct mdb_info *mdb, mdb_op_info *moi );
+void mdb_opinfo_abort( struct mdb_info *mdb, mdb_op_info *moi );
+void mdb_opinfo_written( mdb_op_info *moi, struct berval *ndn, int scope );
 
 int mdb_mval_put(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
 int mdb_mval_del(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
@@ -216,6 +258,10 @@ int mdb_mval_del(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
  * idl.c
  */
 
+const char *mdb_idl_kernels_init( void );
+
+void mdb_idl_reset( unsigned int logn );
+
 unsigned mdb_idl_search( ID *ids, ID id );
 
 int mdb_idl_fetch_key(
@@ -227,6 +273,23 @@ int mdb_idl_fetch_key(
 	MDB_cursor	**saved_cursor,
 	int                     get_flag );
 
+int mdb_idl_count_key(
+	MDB_txn		*txn,
+	MDB_dbi		dbi,
+	MDB_val		*key,
+	ID			*count );
+
+int mdb_idl_key_range(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	ID			*lo,
+	ID			*hi );
+
+int mdb_idl_probe_key(
+	MDB_cursor	*cursor,
+	MDB_val		*key,
+	ID			id );
+
 int mdb_idl_insert( ID *ids, ID id );
 
 typedef int (mdb_idl_keyfunc)(
@@ -248,6 +311,12 @@ mdb_idl_union(
 	ID *a,
 	ID *b );
 
+int
+mdb_idl_notin(
+	ID *a,
+	ID *b,
+	ID *ids );
+
 ID mdb_idl_first( ID *ids, ID *cursor );
 ID mdb_idl_next( ID *ids, ID *cursor );
 
@@ -322,6 +391,30 @@ mdb_key_read(
     MDB_cursor **saved_cursor,
         int get_flags );
 
+extern int
+mdb_key_count(
+	MDB_txn *txn,
+	MDB_dbi dbi,
+	struct berval *k,
+	ID *count );
+
+extern int
+mdb_key_probe_init(
+	MDB_cursor *mc,
+	struct berval *k,
+	mdb_ikey *ik );
+
+extern int
+mdb_key_probe_reset(
+	MDB_cursor *mc,
+	mdb_ikey *ik );
+
+extern int
+mdb_key_probe(
+	MDB_cursor *mc,
+	mdb_ikey *ik,
+	ID id );
+
 /*
  * nextid.c
  */
@@ -358,6 +451,16 @@ mdb_monitor_idx_add(
 	slap_mask_t		type );
 #endif /* MDB_MONITOR_IDX */
 
+/*
+ * search.c
+ */
+
+int mdb_sorted_open( Operation *op, AttributeDescription *ad, int reverse,
+	struct berval *value, void **walkp, ID *countp );
+int mdb_sorted_next( Operation *op, void *walk, ID *idp, int *belowp );
+void mdb_sorted_close( Operation *op, void *walk );
+int mdb_sorted_entry( Operation *op, ID id, Entry **ep );
+
 /*
  * former external.h
  */
@@ -34,7 +34,8 @@ static int search_candidates(
 	IdScopes *isc,
 	MDB_cursor *mci,
 	ID	*ids,
-	ID *stack );
+	ID *stack,
+	mdb_iprobe **probes );
 
 static int parse_paged_cookie( Operation *op, SlapReply *rs );
 
@@ -290,6 +291,9 @@ static void scope_chunk_free( void *key, void *data )
 	}
 }
 
+/* A chunk holds the scopes of a search, followed by its candidates
+ * and alias scopes, which are too large for the thread stack.
+ */
 static ID2 *scope_chunk_get( Operation *op )
 {
 	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
@@ -298,7 +302,8 @@ static ID2 *scope_chunk_get( Operation *op )
 	ldap_pvt_thread_pool_getkey( op->o_threadctx, (void *)scope_chunk_get,
 			(void *)&ret, NULL );
 	if ( !ret ) {
-		ret = ch_malloc( MDB_IDL_UM_SIZE * sizeof( ID2 ));
+		ret = ch_malloc( MDB_IDL_UM_SIZE * sizeof( ID2 ) +
+			( MDB_IDL_UM_SIZE + MDB_IDL_DB_SIZE ) * sizeof( ID ));
 	} else {
 		void *r2 = ret[0].mval.mv_data;
 		ldap_pvt_thread_pool_setkey( op->o_threadctx, (void *)scope_chunk_get,
@@ -412,14 +417,411 @@ mdb_waitfixup( Operation *op, ww_ctx *ww, MDB_cursor *mci, MDB_cursor *mcd, IdSc
 	return rc;
 }
 
+/* Parallel candidate scanning, enabled by the searchthreads option.
+ *
+ * Candidates are taken a window at a time. The window is cut into
+ * slices, and pool threads fetch, decode and filter-test the entries
+ * of a slice in their own read txns, marking the ones that cannot
+ * match. The search thread works on slices too, then walks the window
+ * in candidate order as usual, skipping the marked entries, so the
+ * order of results (and paged results cookies) is unchanged. Entries
+ * that aren't marked are fully processed by the search thread.
+ *
+ * A pool thread only helps if its txn sees the same snapshot as the
+ * search thread's; after a concurrent write the search thread does
+ * the window alone. Tasks still queued when the search finishes find
+ * nothing to do; the last one to leave frees the context.
+ */
+#define PSCAN_SLICE	128
+
+typedef struct pscan_ctx {
+	ldap_pvt_thread_mutex_t ps_mutex;
+	ldap_pvt_thread_cond_t ps_cond;
+	int ps_refs;		/* search thread + queued tasks */
+	int ps_queued;		/* tasks not yet running */
+	int ps_busy;		/* slices being worked on by tasks */
+	int ps_next;		/* next slice to hand out */
+	int ps_nslices;
+	size_t ps_txnid;	/* snapshot of the current window */
+	Operation ps_op;	/* copy of the search op for the tasks */
+	Opheader ps_hdr;
+	struct mdb_info *ps_mdb;
+	int ps_nthreads;
+	int ps_max;		/* window size */
+	int ps_nids;
+	int ps_pos;
+	ID *ps_ids;
+	char *ps_skip;
+	mdb_attrset *ps_as;	/* see search_filter_ads() */
+} pscan_ctx;
+
+static void
+pscan_slice( Operation *op, MDB_txn *txn, ID *ids, char *skip, int n,
+	mdb_attrset *as )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	MDB_cursor *mci, *mcd = NULL;
+	MDB_val edata;
+	Entry *e;
+	int i, rc, partial;
+
+	memset( skip, 0, n );
+	if ( mdb_cursor_open( txn, mdb->mi_id2entry, &mci ))
+		return;
+
+	for ( i = 0; i < n; i++ ) {
+		rc = mdb_id2edata( op, mci, ids[i], &edata );
+		if ( rc )
+			continue;
+		rc = mdb_entry_pdecode( op, txn, &edata, ids[i], as, &e, &partial );
+		if ( rc )
+			continue;
+		e->e_id = ids[i];
+		rc = mdb_id2name( op, txn, &mcd, ids[i], &e->e_name, &e->e_nname );
+		if ( rc ) {
+			e->e_name.bv_val = NULL;
+			e->e_nname.bv_val = NULL;
+		} else if ( !is_entry_referral( e ) &&
+			test_filter( partial ? NULL : op, e, op->ors_filter ) != LDAP_COMPARE_TRUE ) {
+			skip[i] = 1;
+		}
+		mdb_entry_return( op, e );
+	}
+
+	if ( mcd )
+		mdb_cursor_close( mcd );
+	mdb_cursor_close( mci );
+}
+
+static void
+pscan_release( pscan_ctx *ps )
+{
+	int last;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	last = !--ps->ps_refs;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	if ( last ) {
+		ldap_pvt_thread_cond_destroy( &ps->ps_cond );
+		ldap_pvt_thread_mutex_destroy( &ps->ps_mutex );
+		ch_free( ps );
+	}
+}
+
+static void *
+pscan_task( void *ctx, void *arg )
+{
+	pscan_ctx *ps = arg;
+	Operation op;
+	Opheader ohdr;
+	mdb_op_info opinfo = {{{0}}}, *moi = &opinfo;
+	size_t txnid = 0;
+	int s, n, work = 0;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	ps->ps_queued--;
+	if ( ps->ps_next < ps->ps_nslices ) {
+		work = 1;
+		txnid = ps->ps_txnid;
+		op = ps->ps_op;
+		ohdr = ps->ps_hdr;
+	}
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	if ( !work )
+		goto leave;
+
+	/* Give the task its own thread context, txn and plain heap memory */
+	op.o_hdr = &ohdr;
+	op.o_threadctx = ctx;
+	op.o_tmpmemctx = NULL;
+	op.o_tmpmfuncs = &ch_mfuncs;
+	op.o_callback = NULL;
+	op.o_groups = NULL;
+	LDAP_SLIST_INIT( &op.o_extra );
+
+	if ( mdb_opinfo_get( &op, ps->ps_mdb, 1, &moi ))
+		goto leave;
+
+	if ( mdb_txn_id( moi->moi_txn ) == txnid ) {
+		for (;;) {
+			ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+			if ( ps->ps_next >= ps->ps_nslices || ps->ps_txnid != txnid ) {
+				ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+				break;
+			}
+			s = ps->ps_next++;
+			ps->ps_busy++;
+			ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+			n = ps->ps_nids - s * PSCAN_SLICE;
+			if ( n > PSCAN_SLICE )
+				n = PSCAN_SLICE;
+			pscan_slice( &op, moi->moi_txn, ps->ps_ids + s * PSCAN_SLICE,
+				ps->ps_skip + s * PSCAN_SLICE, n, ps->ps_as );
+
+			ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+			if ( !--ps->ps_busy )
+				ldap_pvt_thread_cond_signal( &ps->ps_cond );
+			ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+		}
+	}
+
+	mdb_txn_reset( moi->moi_txn );
+	LDAP_SLIST_REMOVE( &op.o_extra, &moi->moi_oe, OpExtra, oe_next );
+	if ( op.o_groups )
+		slap_op_groups_free( &op );
+
+leave:
+	pscan_release( ps );
+	return NULL;
+}
+
+static pscan_ctx *
+pscan_init( struct mdb_info *mdb )
+{
+	pscan_ctx *ps;
+	int max = mdb->mi_search_threads * PSCAN_SLICE * 4;
+
+	ps = ch_calloc( 1, sizeof(pscan_ctx) + max * ( sizeof(ID) + 1 ));
+	ldap_pvt_thread_mutex_init( &ps->ps_mutex );
+	ldap_pvt_thread_cond_init( &ps->ps_cond );
+	ps->ps_refs = 1;
+	ps->ps_mdb = mdb;
+	ps->ps_nthreads = mdb->mi_search_threads;
+	ps->ps_max = max;
+	ps->ps_ids = (ID *)(ps+1);
+	ps->ps_skip = (char *)(ps->ps_ids + max);
+	return ps;
+}
+
+/* Load the window starting at candidate id and scan it */
+static void
+pscan_window( Operation *op, pscan_ctx *ps, MDB_txn *txn,
+	ID *candidates, ID id, ID cursor )
+{
+	int i, want, s, n;
+
+	ps->ps_ids[0] = id;
+	for ( n = 1; n < ps->ps_max; n++ ) {
+		id = mdb_idl_next( candidates, &cursor );
+		if ( id == NOID )
+			break;
+		ps->ps_ids[n] = id;
+	}
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	ps->ps_nids = n;
+	ps->ps_pos = 0;
+	ps->ps_next = 0;
+	ps->ps_nslices = ( n + PSCAN_SLICE - 1 ) / PSCAN_SLICE;
+	ps->ps_txnid = mdb_txn_id( txn );
+	ps->ps_op = *op;
+	ps->ps_hdr = *op->o_hdr;
+	want = ps->ps_nslices - 1;
+	if ( want > ps->ps_nthreads - 1 )
+		want = ps->ps_nthreads - 1;
+	want -= ps->ps_queued;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	for ( i = 0; i < want; i++ ) {
+		ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+		ps->ps_refs++;
+		ps->ps_queued++;
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+		if ( ldap_pvt_thread_pool_submit( &connection_pool,
+			pscan_task, ps )) {
+			ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+			ps->ps_refs--;
+			ps->ps_queued--;
+			ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+			break;
+		}
+	}
+
+	/* take slices ourselves until none are left */
+	for (;;) {
+		ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+		if ( ps->ps_next >= ps->ps_nslices ) {
+			while ( ps->ps_busy )
+				ldap_pvt_thread_cond_wait( &ps->ps_cond, &ps->ps_mutex );
+			ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+			break;
+		}
+		s = ps->ps_next++;
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+		n = ps->ps_nids - s * PSCAN_SLICE;
+		if ( n > PSCAN_SLICE )
+			n = PSCAN_SLICE;
+		pscan_slice( op, txn, ps->ps_ids + s * PSCAN_SLICE,
+			ps->ps_skip + s * PSCAN_SLICE, n, ps->ps_as );
+	}
+}
+
+/* Nonzero if candidate id is known not to match the filter */
+static int
+pscan_skip( Operation *op, pscan_ctx *ps, MDB_txn *txn,
+	ID *candidates, ID id, ID cursor )
+{
+	while ( ps->ps_pos < ps->ps_nids && ps->ps_ids[ps->ps_pos] < id )
+		ps->ps_pos++;
+	if ( ps->ps_pos >= ps->ps_nids )
+		pscan_window( op, ps, txn, candidates, id, cursor );
+	return ps->ps_ids[ps->ps_pos] == id && ps->ps_skip[ps->ps_pos];
+}
+
+static void
+pscan_done( pscan_ctx *ps )
+{
+	/* tasks still queued must find nothing to do */
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	ps->ps_nslices = 0;
+	ps->ps_next = 0;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+	pscan_release( ps );
+}
+
+/* Candidates are first decoded with just the attributes the filter
+ * looks at, and tested without access control. Access control can
+ * only turn a filter item Undefined, so an entry that doesn't match
+ * this way can't match at all, and is rejected without decoding the
+ * rest of it. Entries that do match are decoded in full and tested
+ * again as usual, since ACLs, overlays and the client may need any of
+ * their attributes.
+ */
+#define MDB_FILTER_ADS	32
+
+/* Collect the attributes used by filter f into ads, which has n
+ * entries so far. Returns the new count, or -1 if the filter can't
+ * be tested that way.
+ */
+static int
+search_filter_ads( Filter *f, AttributeDescription **ads, int n )
+{
+	AttributeDescription *ad;
+	int i;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return n;
+
+	switch ( f->f_choice ) {
+	case LDAP_FILTER_AND:
+	case LDAP_FILTER_OR:
+		for ( f = f->f_list; f && n >= 0; f = f->f_next )
+			n = search_filter_ads( f, ads, n );
+		return n;
+	case LDAP_FILTER_NOT:
+		return search_filter_ads( f->f_not, ads, n );
+	case LDAP_FILTER_EQUALITY:
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+	case LDAP_FILTER_APPROX:
+		ad = f->f_av_desc;
+		break;
+	case LDAP_FILTER_SUBSTRINGS:
+		ad = f->f_sub_desc;
+		break;
+	case LDAP_FILTER_PRESENT:
+		ad = f->f_desc;
+		break;
+	case LDAP_FILTER_EXT:
+		ad = f->f_mr_desc;
+		break;
+	default:
+		return n;
+	}
+
+	/* rules matching any attribute, or values computed by the backend */
+	if ( !ad || ad == slap_schema.si_ad_hasSubordinates )
+		return -1;
+
+	for ( i = 0; i < n; i++ ) {
+		if ( ads[i] == ad )
+			return n;
+	}
+	if ( n == MDB_FILTER_ADS )
+		return -1;
+	ads[n++] = ad;
+	return n;
+}
+
+static int
+search_is_candidate( ID *ids, ID id )
+{
+	unsigned i;
+
+	if ( MDB_IDL_IS_RANGE( ids ))
+		return id >= MDB_IDL_RANGE_FIRST( ids ) &&
+			id <= MDB_IDL_RANGE_LAST( ids );
+	if ( MDB_IDL_IS_BITMAP( ids ))
+		return MDB_IDL_BITMAP_TEST( ids, id ) != 0;
+	i = mdb_idl_search( ids, id );
+	return i <= ids[0] && ids[i] == id;
+}
+
+/* Paged results must be returned in ID order, so they cannot use the
+ * scope-based walk and instead check the scope of each candidate,
+ * walking up its parents. If the scope is much smaller than the
+ * candidates, walk the scope and reduce the candidates to the IDs
+ * found in it. This is redone for every page, so it only pays off
+ * when a page would otherwise check many candidates per entry in
+ * the scope.
+ */
+static int
+search_scope_ids(
+	Operation *op,
+	IdScopes *isc,
+	ID baseid,
+	ID *ids,
+	mdb_iprobe *probes )
+{
+	ID2 scopes[2];
+	ID *tmp;
+	int rc;
+
+	/* the walk uses the scopes for its own stack */
+	scopes[0] = isc->scopes[0];
+	scopes[1] = isc->scopes[1];
+	/* collect the IDs in the search stack, past what isc->sctmp
+	 * may hold; the filter is done with it by now
+	 */
+	tmp = (ID *)( isc->sctmp + MDB_IDL_UM_SIZE );
+	tmp[0] = 0;
+	isc->id = baseid;
+	isc->numrdns = 0;
+	for ( rc = mdb_dn2id_walk( op, isc ); rc == 0;
+		rc = mdb_dn2id_walk( op, isc )) {
+		if ( !search_is_candidate( ids, isc->id ))
+			continue;
+		if ( probes && !mdb_filter_probe( probes, isc->id ))
+			continue;
+		if ( tmp[0] == MDB_IDL_UM_MAX ) {
+			rc = -1;
+			break;
+		}
+		tmp[++tmp[0]] = isc->id;
+	}
+	isc->numrdns = 0;
+	isc->scopes[0] = scopes[0];
+	isc->scopes[1] = scopes[1];
+
+	if ( rc == MDB_NOTFOUND ) {
+		mdb_idl_sort( tmp, tmp + MDB_IDL_UM_SIZE );
+		MDB_IDL_CPY( ids, tmp );
+		rc = 0;
+	}
+	return rc;
+}
+
 int
 mdb_search( Operation *op, SlapReply *rs )
 {
 	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
 	ID		id, cursor, nsubs, ncand, cscope;
 	ID		lastid = NOID;
-	ID		candidates[MDB_IDL_UM_SIZE];
-	ID		iscopes[MDB_IDL_DB_SIZE];
+	ID		*candidates, *iscopes;
 	ID2		*scopes;
 	void	*stack;
 	Entry		*e = NULL, *base = NULL;
@@ -427,12 +829,20 @@ mdb_search( Operation *op, SlapReply *rs )
 	AttributeName	*attrs;
 	slap_mask_t	mask;
 	time_t		stoptime;
+	void		*batch;
 	int		manageDSAit;
 	int		tentries = 0;
 	IdScopes	isc;
 	MDB_cursor	*mci, *mcd;
 	ww_ctx wwctx;
 	slap_callback cb = { 0 };
+	pscan_ctx	*ps = NULL;
+	AttributeDescription	*fads[MDB_FILTER_ADS + 3];
+	mdb_attrset	fas = { NULL }, *as = NULL;
+	int		nads, partial = 0;
+	ID		npass = 0, nfail = 0;
+	mdb_iprobe	*probes = NULL;
+	ID		nprobe = 0, nreject = 0;
 
 	mdb_op_info	opinfo = {{{0}}}, *moi = &opinfo;
 	MDB_txn			*ltid = NULL;
@@ -467,6 +877,8 @@ mdb_search( Operation *op, SlapReply *rs )
 	}
 
 	scopes = scope_chunk_get( op );
+	candidates = (ID *)( scopes + MDB_IDL_UM_SIZE );
+	iscopes = candidates + MDB_IDL_UM_SIZE;
 	stack = search_stack( op );
 	isc.mt = ltid;
 	isc.mc = mcd;
@@ -634,6 +1046,7 @@ dn2entry_retry:
 
 	/* compute it anyway; root does not use it */
 	stoptime = op->o_time + op->ors_tlimit;
+	batch = slap_sendbatch_lookup( op );
 
 	base = e;
 
@@ -666,7 +1079,7 @@ dn2entry_retry:
 		scopes[1].mid = base->e_id;
 		scopes[1].mval.mv_data = NULL;
 		rs->sr_err = search_candidates( op, rs, base,
-			&isc, mci, candidates, stack );
+			&isc, mci, candidates, stack, &probes );
 		ncand = MDB_IDL_N( candidates );
 		if ( !base->e_id || ncand == NOID ) {
 			/* grab entry count from id2entry stat
@@ -720,8 +1133,29 @@ dn2entry_retry:
 		op->o_callback = &cb;
 	}
 
+	/* Only for candidate scans in our own read txn, whose snapshot
+	 * other threads can share.
+	 */
+	if ( mdb->mi_search_threads > 1 && moi == &opinfo &&
+		op->o_threadctx && ncand > PSCAN_SLICE ) {
+		ps = pscan_init( mdb );
+	}
+
+	nads = op->ors_scope == LDAP_SCOPE_BASE ? -1 :
+		search_filter_ads( op->ors_filter, fads, 0 );
+	if ( nads >= 0 ) {
+		/* needed for the referral and entry type checks */
+		fads[nads++] = slap_schema.si_ad_objectClass;
+		fads[nads++] = slap_schema.si_ad_ref;
+		fads[nads] = NULL;
+		mdb_attrset_init( op, &fas, fads );
+		as = &fas;
+		if ( ps )
+			ps->ps_as = as;
+	}
+
 	if ( get_pagedresults( op ) > SLAP_CONTROL_IGNORED ) {
-		PagedResultsState *ps = op->o_pagedresults_state;
+		PagedResultsState *prs = op->o_pagedresults_state;
 		/* deferred cookie parsing */
 		rs->sr_err = parse_paged_cookie( op, rs );
 		if ( rs->sr_err != LDAP_SUCCESS ) {
@@ -729,13 +1163,25 @@ dn2entry_retry:
 			goto done;
 		}
 
-		cursor = (ID) ps->ps_cookie;
-		if ( cursor && ps->ps_size == 0 ) {
+		cursor = (ID) prs->ps_cookie;
+		if ( cursor && prs->ps_size == 0 ) {
 			rs->sr_err = LDAP_SUCCESS;
 			rs->sr_text = "search abandoned by pagedResult size=0";
 			send_ldap_result( op, rs );
 			goto done;
 		}
+		if ( op->ors_scope != LDAP_SCOPE_BASE && nsubs < ncand &&
+			nsubs < MDB_IDL_UM_MAX && scopes[0].mid < 2 &&
+			nsubs * nsubs / 8 < (ID) prs->ps_size * ncand &&
+			search_scope_ids( op, &isc, base->e_id, candidates,
+				probes ) == 0 ) {
+			/* nothing left for this page */
+			if ( !candidates[0] || candidates[candidates[0]] <= cursor )
+				goto nochange;
+			ncand = MDB_IDL_N( candidates );
+			if ( tentries )
+				tentries = ncand;
+		}
 		id = mdb_idl_first( candidates, &cursor );
 		if ( id == NOID ) {
 			Debug( LDAP_DEBUG_TRACE, 
@@ -747,7 +1193,7 @@ dn2entry_retry:
 			rs->sr_err = LDAP_OTHER;
 			goto done;
 		}
-		if ( id == (ID)ps->ps_cookie )
+		if ( id == (ID)prs->ps_cookie )
 			id = mdb_idl_next( candidates, &cursor );
 		nsubs = ncand;	/* always bypass scope'd search */
 		goto loop_begin;
@@ -817,21 +1263,41 @@ loop_begin:
 			goto done;
 		}
 
+		/* don't hold back entries already batched while
+		 * looking for the next match
+		 */
+		if ( batch )
+			slap_sendbatch_tick( op, batch );
+
+		if ( ps && nsubs >= ncand &&
+			pscan_skip( op, ps, ltid, candidates, id, cursor )) {
+			Debug( LDAP_DEBUG_TRACE,
+				LDAP_XSTRING(mdb_search)
+				": %ld does not match filter\n",
+				(long) id, 0, 0 );
+			goto loop_continue;
+		}
+
+		if ( probes ) {
+			nprobe++;
+			if ( !mdb_filter_probe( probes, id )) {
+				nreject++;
+				Debug( LDAP_DEBUG_TRACE,
+					LDAP_XSTRING(mdb_search)
+					": %ld not in filter indices\n",
+					(long) id, 0, 0 );
+				goto loop_continue;
+			}
+			/* not worth it if hardly anything is rejected */
+			if ( nprobe >= 256 && nreject < nprobe / 16 ) {
+				mdb_filter_probes_free( op, probes );
+				probes = NULL;
+			}
+		}
 
 		if ( nsubs < ncand ) {
-			unsigned i;
 			/* Is this entry in the candidate list? */
-			scopeok = 0;
-			if (MDB_IDL_IS_RANGE( candidates )) {
-				if ( id >= MDB_IDL_RANGE_FIRST( candidates ) &&
-					id <= MDB_IDL_RANGE_LAST( candidates ))
-					scopeok = 1;
-			} else {
-				i = mdb_idl_search( candidates, id );
-				if (i <= candidates[0] && candidates[i] == id )
-					scopeok = 1;
-			}
-			if ( scopeok )
+			if ( search_is_candidate( candidates, id ))
 				goto scopeok;
 			goto loop_continue;
 		}
@@ -883,6 +1349,7 @@ loop_begin:
 		}
 
 scopeok:
+		partial = 0;
 		if ( id == base->e_id ) {
 			e = base;
 		} else {
@@ -923,7 +1390,9 @@ notfound:
 				goto done;
 			}
 
-			rs->sr_err = mdb_entry_decode( op, ltid, &edata, id, &e );
+			/* entries the parallel scan let through likely match */
+			rs->sr_err = mdb_entry_pdecode( op, ltid, &edata, id,
+				ps ? NULL : as, &e, &partial );
 			if ( rs->sr_err ) {
 				rs->sr_err = LDAP_OTHER;
 				rs->sr_text = "internal error in mdb_entry_decode";
@@ -1059,6 +1528,38 @@ notfound:
 			goto loop_continue;
 		}
 
+		if ( partial ) {
+			Entry *full;
+
+			if ( test_filter( NULL, e, op->oq_search.rs_filter ) != LDAP_COMPARE_TRUE ) {
+				Debug( LDAP_DEBUG_TRACE,
+					LDAP_XSTRING(mdb_search)
+					": %ld does not match filter\n",
+					(long) id, 0, 0 );
+				nfail++;
+				goto loop_continue;
+			}
+			/* not worth it if most entries get decoded twice */
+			if ( ++npass > 64 && npass > 2 * nfail )
+				as = NULL;
+			rs->sr_err = mdb_entry_decode( op, ltid, &edata, id, &full );
+			if ( rs->sr_err ) {
+				mdb_entry_return( op, e );
+				e = NULL;
+				rs->sr_err = LDAP_OTHER;
+				rs->sr_text = "internal error in mdb_entry_decode";
+				send_ldap_result( op, rs );
+				goto done;
+			}
+			full->e_id = id;
+			full->e_name = e->e_name;
+			full->e_nname = e->e_nname;
+			BER_BVZERO( &e->e_name );
+			BER_BVZERO( &e->e_nname );
+			mdb_entry_return( op, e );
+			e = full;
+		}
+
 		/* if it matches the filter and scope, send it */
 		rs->sr_err = test_filter( op, e, op->oq_search.rs_filter );
 
@@ -1133,6 +1634,8 @@ loop_continue:
 				send_ldap_result( op, rs );
 				goto done;
 			}
+			if ( probes )
+				mdb_filter_probes_renew( ltid, probes );
 		}
 
 		if( e != NULL ) {
@@ -1189,6 +1692,10 @@ nochange:
 	rs->sr_err = LDAP_SUCCESS;
 
 done:
+	if ( ps )
+		pscan_done( ps );
+	if ( fas.as_map )
+		mdb_attrset_destroy( op, &fas );
 	if ( cb.sc_private ) {
 		/* remove our writewait callback */
 		slap_callback **scp = &op->o_callback;
@@ -1200,6 +1707,8 @@ done:
 			}
 		}
 	}
+	if ( probes )
+		mdb_filter_probes_free( op, probes );
 	mdb_cursor_close( mcd );
 	mdb_cursor_close( mci );
 	if ( moi == &opinfo ) {
@@ -1219,6 +1728,570 @@ done:
 	return rs->sr_err;
 }
 
+static void
+sorted_append( ID **idsp, ID *size, ID id )
+{
+	ID *ids = *idsp;
+
+	if ( !ids || ids[0] == *size ) {
+		*size = *size ? *size * 2 : 1024;
+		ids = ch_realloc( ids, ( *size + 1 ) * sizeof( ID ));
+		if ( !*idsp )
+			ids[0] = 0;
+		*idsp = ids;
+	}
+	ids[++ids[0]] = id;
+}
+
+static int
+sorted_id_cmp( const void *a, const void *b )
+{
+	ID x = *(const ID *)a, y = *(const ID *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* A walk over the candidates of a search in sort order, see sorted.h.
+ * The candidates with a value are taken in the key order of the sort
+ * attribute's equality index, which collates like the values for
+ * ORDERED_INDEX rules. Their keys are lossy though: integers longer
+ * than index_intlen and fractions of seconds are cut off, so the
+ * candidates sharing a key are sorted by their values. Those without
+ * one sort after them: they are the candidates that the walk didn't
+ * meet in the index, so they are only known once every key was
+ * walked. Going forward, that is when the walk gets to them; in
+ * reverse, the keys are walked once when the walk starts.
+ */
+typedef struct mdb_sorted_walk mdb_sorted_walk;
+
+typedef struct sorted_val {
+	ID sv_id;
+	struct berval sv_val;	/* BER_BVNULL if the entry has none */
+	mdb_sorted_walk *sv_sw;
+} sorted_val;
+
+struct mdb_sorted_walk {
+	mdb_op_info sw_opinfo;
+	mdb_op_info *sw_moi;
+	AttributeDescription *sw_ad;
+	MDB_cursor *sw_mc;		/* the sort attribute's index */
+	MDB_cursor *sw_mci;		/* id2entry */
+	ID2 *sw_scopes;
+	ID *sw_cands;
+	mdb_iprobe *sw_probes;
+	struct berval sw_pres;	/* the presence key, if there is one */
+	struct berval *sw_keys;	/* index key of the value asked for */
+	struct berval sw_value;	/* the value asked for */
+	MDB_val sw_key;			/* the current key */
+	sorted_val *sw_run;		/* its candidates, in sort order */
+	ID sw_nrun, sw_runsize;
+	ID sw_pos;				/* the next one in sw_run */
+	int sw_valued_run;		/* whether sw_run has their values */
+	ID *sw_valued;			/* candidates met in the index */
+	ID sw_size;
+	ID sw_next;				/* cursor of the candidates without a value */
+	int sw_reverse;
+	int sw_state;
+};
+
+#define SW_START	0
+#define SW_VALUED	1
+#define SW_MISSING	2
+#define SW_END		3
+
+static int
+sorted_val_cmp( const void *a, const void *b )
+{
+	const sorted_val *x = a, *y = b;
+	MatchingRule *mr = x->sv_sw->sw_ad->ad_type->sat_ordering;
+	int cmp = 0;
+
+	if ( BER_BVISNULL( &x->sv_val ) || BER_BVISNULL( &y->sv_val )) {
+		cmp = !BER_BVISNULL( &y->sv_val ) - !BER_BVISNULL( &x->sv_val );
+	} else {
+		mr->smr_match( &cmp, 0, mr->smr_syntax, mr,
+			(struct berval *)&x->sv_val, (struct berval *)&y->sv_val );
+	}
+	if ( cmp )
+		return x->sv_sw->sw_reverse ? -cmp : cmp;
+	/* equal values come in ID order, as they do when sorted in memory */
+	return x->sv_id < y->sv_id ? -1 : x->sv_id > y->sv_id;
+}
+
+static void
+sorted_run_clear( mdb_sorted_walk *sw )
+{
+	ID i;
+
+	if ( sw->sw_valued_run ) {
+		for ( i = 0; i < sw->sw_nrun; i++ )
+			ch_free( sw->sw_run[i].sv_val.bv_val );
+		sw->sw_valued_run = 0;
+	}
+	sw->sw_nrun = sw->sw_pos = 0;
+}
+
+/* Fetch the values of the candidates in sw_run, and sort them */
+static int
+sorted_run_values( Operation *op, mdb_sorted_walk *sw )
+{
+	Entry *e;
+	Attribute *a;
+	ID i;
+	int rc;
+
+	sw->sw_valued_run = 1;
+	for ( i = 0; i < sw->sw_nrun; i++ )
+		BER_BVZERO( &sw->sw_run[i].sv_val );
+	for ( i = 0; i < sw->sw_nrun; i++ ) {
+		rc = mdb_id2entry( op, sw->sw_mci, sw->sw_run[i].sv_id, &e );
+		if ( rc == MDB_NOTFOUND )
+			continue;
+		if ( rc )
+			return rc;
+		a = attr_find( e->e_attrs, sw->sw_ad );
+		if ( a )
+			ber_dupbv( &sw->sw_run[i].sv_val, &a->a_nvals[0] );
+		mdb_entry_return( op, e );
+	}
+	if ( sw->sw_nrun > 1 )
+		qsort( sw->sw_run, sw->sw_nrun, sizeof( sorted_val ),
+			sorted_val_cmp );
+	return 0;
+}
+
+static void
+sorted_run_add( mdb_sorted_walk *sw, ID id )
+{
+	if ( !search_is_candidate( sw->sw_cands, id ) ||
+		( sw->sw_probes && !mdb_filter_probe( sw->sw_probes, id )))
+		return;
+	if ( sw->sw_nrun == sw->sw_runsize ) {
+		sw->sw_runsize = sw->sw_runsize ? sw->sw_runsize * 2 : 64;
+		sw->sw_run = ch_realloc( sw->sw_run,
+			sw->sw_runsize * sizeof( sorted_val ));
+	}
+	sw->sw_run[sw->sw_nrun].sv_id = id;
+	sw->sw_run[sw->sw_nrun].sv_sw = sw;
+	sw->sw_nrun++;
+}
+
+/* Move to the next key of the index, and load its candidates */
+static int
+sorted_run( Operation *op, mdb_sorted_walk *sw )
+{
+	MDB_cursor_op mop;
+	MDB_val data;
+	char *ptr, *end;
+	size_t dups;
+	ID id, bit;
+	int rc;
+
+	sorted_run_clear( sw );
+	do {
+		if ( sw->sw_state == SW_START )
+			mop = sw->sw_reverse ? MDB_LAST : MDB_FIRST;
+		else
+			mop = sw->sw_reverse ? MDB_PREV_NODUP : MDB_NEXT_NODUP;
+		sw->sw_state = SW_VALUED;
+		rc = mdb_cursor_get( sw->sw_mc, &sw->sw_key, &data, mop );
+		if ( rc )
+			return rc;
+	} while ( sw->sw_key.mv_size == sw->sw_pres.bv_len &&
+		!memcmp( sw->sw_key.mv_data, sw->sw_pres.bv_val, sw->sw_pres.bv_len ));
+
+	memcpy( &id, data.mv_data, sizeof( ID ));
+	if ( !id ) {
+		/* a range, its order by value is unknown */
+		return LDAP_UNWILLING_TO_PERFORM;
+	}
+	mdb_cursor_count( sw->sw_mc, &dups );
+	/* GET_MULTIPLE would return the dups of an earlier key when this
+	 * one has only one. It returns the page of the current dup, which
+	 * is the last one after MDB_LAST and MDB_PREV_NODUP.
+	 */
+	if ( dups > 1 ) {
+		rc = mdb_cursor_get( sw->sw_mc, &sw->sw_key, &data, MDB_FIRST_DUP );
+		if ( rc == 0 )
+			rc = mdb_cursor_get( sw->sw_mc, &sw->sw_key, &data,
+				MDB_GET_MULTIPLE );
+		if ( rc )
+			return rc;
+	}
+	for (;;) {
+		ptr = data.mv_data;
+		end = ptr + ( dups > 1 ? data.mv_size : sizeof( ID ));
+		for ( ; ptr < end; ptr += sizeof( ID )) {
+			memcpy( &id, ptr, sizeof( ID ));
+			if ( !MDB_IDL_IS_CHUNK( id )) {
+				sorted_run_add( sw, id );
+				continue;
+			}
+			for ( bit = 0; bit < MDB_IDL_CHUNK_BITS; bit++ )
+				if ( MDB_IDL_CHUNK_MASK( id ) & ( (ID)1 << bit ))
+					sorted_run_add( sw, MDB_IDL_CHUNK_BASE( id ) + bit );
+		}
+		if ( dups <= 1 )
+			break;
+		rc = mdb_cursor_get( sw->sw_mc, &sw->sw_key, &data,
+			MDB_NEXT_MULTIPLE );
+		if ( rc == MDB_NOTFOUND )
+			break;
+		if ( rc )
+			return rc;
+	}
+
+	/* the values tell apart what the key doesn't, and where the value
+	 * asked for goes among the candidates at its key */
+	if ( sw->sw_nrun > 1 || ( sw->sw_nrun && sw->sw_keys &&
+		sw->sw_key.mv_size == sw->sw_keys[0].bv_len &&
+		!memcmp( sw->sw_key.mv_data, sw->sw_keys[0].bv_val,
+			sw->sw_keys[0].bv_len )))
+		return sorted_run_values( op, sw );
+	return 0;
+}
+
+/* The next candidate ID that is stored under a key of the index */
+static int
+sorted_valued( Operation *op, mdb_sorted_walk *sw, ID *idp )
+{
+	int rc;
+
+	while ( sw->sw_pos == sw->sw_nrun ) {
+		rc = sorted_run( op, sw );
+		if ( rc )
+			return rc;
+	}
+	*idp = sw->sw_run[sw->sw_pos++].sv_id;
+	return 0;
+}
+
+/* The next candidate that the index has no key for */
+static int
+sorted_missing( Operation *op, mdb_sorted_walk *sw, ID *idp )
+{
+	ID *cands = sw->sw_cands, id;
+
+	for (;;) {
+		if ( MDB_IDL_IS_RANGE( cands )) {
+			id = sw->sw_next ? sw->sw_next : MDB_IDL_RANGE_FIRST( cands ) - 1;
+			if ( mdb_get_nextid( sw->sw_mci, &id ) ||
+				id > MDB_IDL_RANGE_LAST( cands ))
+				return MDB_NOTFOUND;
+			sw->sw_next = id;
+		} else {
+			id = sw->sw_next ? mdb_idl_next( cands, &sw->sw_next ) :
+				mdb_idl_first( cands, &sw->sw_next );
+			if ( id == NOID )
+				return MDB_NOTFOUND;
+		}
+		if ( sw->sw_valued && bsearch( &id, sw->sw_valued + 1,
+			sw->sw_valued[0], sizeof( ID ), sorted_id_cmp ))
+			continue;
+		if ( sw->sw_probes && !mdb_filter_probe( sw->sw_probes, id ))
+			continue;
+		*idp = id;
+		return 0;
+	}
+}
+
+int
+mdb_sorted_open( Operation *op, AttributeDescription *ad, int reverse,
+	struct berval *value, void **walkp, ID *countp )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	MatchingRule *mr = ad->ad_type->sat_equality;
+	AttrInfo *ai;
+	mdb_sorted_walk *sw;
+	MDB_txn *txn;
+	MDB_cursor *mcd = NULL;
+	MDB_val key, data;
+	SlapReply rs = { REP_RESULT };
+	IdScopes isc;
+	ID nsubs, n, id;
+	Entry *base = NULL;
+	void *stack;
+	int rc;
+
+	if ( op->ors_scope == LDAP_SCOPE_BASE ||
+		( op->ors_deref & LDAP_DEREF_SEARCHING ) ||
+		!mr || !( mr->smr_usage & SLAP_MR_ORDERED_INDEX ) ||
+		/* to sort the candidates that share a key */
+		!ad->ad_type->sat_ordering ||
+		/* an entry is met once, at its only key */
+		!is_at_single_value( ad->ad_type ))
+		return LDAP_UNWILLING_TO_PERFORM;
+
+	/* only an index of ad itself, a supertype's holds other values */
+	ai = mdb_attr_mask( mdb, ad );
+	if ( !ai || !IS_SLAP_INDEX( ai->ai_indexmask, SLAP_INDEX_EQUALITY ))
+		return LDAP_UNWILLING_TO_PERFORM;
+
+	sw = ch_calloc( 1, sizeof( mdb_sorted_walk ));
+	sw->sw_ad = ad;
+	sw->sw_reverse = reverse;
+	if ( IS_SLAP_INDEX( ai->ai_indexmask, SLAP_INDEX_PRESENT )) {
+		MDB_dbi dbi;
+		slap_mask_t mask;
+		mdb_index_param( op->o_bd, ad, LDAP_FILTER_PRESENT,
+			&dbi, &mask, &sw->sw_pres );
+	}
+	if ( value ) {
+		MDB_dbi dbi;
+		slap_mask_t mask;
+		struct berval prefix = BER_BVNULL;
+
+		if ( !mr->smr_filter ||
+			mdb_index_param( op->o_bd, ad, LDAP_FILTER_EQUALITY,
+				&dbi, &mask, &prefix ) != LDAP_SUCCESS ||
+			mr->smr_filter( LDAP_FILTER_EQUALITY, mask,
+				ad->ad_type->sat_syntax, mr, &prefix, value,
+				&sw->sw_keys, op->o_tmpmemctx ) != LDAP_SUCCESS ||
+			!sw->sw_keys ) {
+			ch_free( sw );
+			return LDAP_UNWILLING_TO_PERFORM;
+		}
+		ber_dupbv( &sw->sw_value, value );
+	}
+
+	sw->sw_moi = &sw->sw_opinfo;
+	rc = mdb_opinfo_get( op, mdb, 1, &sw->sw_moi );
+	if ( rc ) {
+		if ( sw->sw_keys )
+			ber_bvarray_free_x( sw->sw_keys, op->o_tmpmemctx );
+		ch_free( sw->sw_value.bv_val );
+		ch_free( sw );
+		return LDAP_OTHER;
+	}
+	txn = sw->sw_moi->moi_txn;
+	sw->sw_scopes = scope_chunk_get( op );
+	sw->sw_cands = (ID *)( sw->sw_scopes + MDB_IDL_UM_SIZE );
+	rc = LDAP_UNWILLING_TO_PERFORM;
+
+	if ( mdb_cursor_open( txn, mdb->mi_id2entry, &sw->sw_mci ) ||
+		mdb_cursor_open( txn, mdb->mi_dn2id, &mcd ) ||
+		mdb_cursor_open( txn, ai->ai_dbi, &sw->sw_mc ))
+		goto done;
+
+	/* anything mdb_search would report on, it still should */
+	if ( mdb_dn2entry( op, txn, mcd, &op->o_req_ndn, &base, &nsubs, 0 ) ||
+		is_entry_alias( base ) ||
+		( !get_manageDSAit( op ) && is_entry_referral( base )) ||
+		!access_allowed( op, base, slap_schema.si_ad_entry,
+			NULL, ACL_SEARCH, NULL ) ||
+		( get_assert( op ) && test_filter( op, base,
+			get_assertion( op )) != LDAP_COMPARE_TRUE ))
+		goto done;
+
+	isc.mt = txn;
+	isc.mc = mcd;
+	isc.scopes = sw->sw_scopes;
+	isc.oscope = op->ors_scope;
+	stack = search_stack( op );
+	isc.sctmp = stack;
+	if ( op->ors_scope == LDAP_SCOPE_ONELEVEL ) {
+		size_t nkids;
+		key.mv_data = &base->e_id;
+		key.mv_size = sizeof( ID );
+		mdb_cursor_get( mcd, &key, &data, MDB_SET );
+		mdb_cursor_count( mcd, &nkids );
+		nsubs = nkids - 1;
+	} else if ( !base->e_id ) {
+		MDB_stat ms;
+		mdb_stat( txn, mdb->mi_id2entry, &ms );
+		nsubs = ms.ms_entries;
+	}
+	MDB_IDL_ZERO( sw->sw_cands );
+	sw->sw_scopes[0].mid = 1;
+	sw->sw_scopes[1].mid = base->e_id;
+	sw->sw_scopes[1].mval.mv_data = NULL;
+	if ( search_candidates( op, &rs, base, &isc, sw->sw_mci, sw->sw_cands,
+		stack, &sw->sw_probes ) != LDAP_SUCCESS )
+		goto done;
+
+	n = MDB_IDL_N( sw->sw_cands );
+	if ( op->ors_limit && op->ors_limit->lms_s_unchecked != -1 &&
+		n > (unsigned) op->ors_limit->lms_s_unchecked )
+		goto done;
+	if ( nsubs < n && nsubs < MDB_IDL_UM_MAX )
+		search_scope_ids( op, &isc, base->e_id, sw->sw_cands, sw->sw_probes );
+	n = MDB_IDL_N( sw->sw_cands );
+	if ( nsubs < n )
+		n = nsubs;
+
+	/* in reverse, the candidates without a value come first */
+	if ( reverse ) {
+		while (( rc = sorted_valued( op, sw, &id )) == 0 )
+			sorted_append( &sw->sw_valued, &sw->sw_size, id );
+		if ( rc != MDB_NOTFOUND ) {
+			if ( rc != LDAP_UNWILLING_TO_PERFORM )
+				rc = LDAP_OTHER;
+			goto done;
+		}
+		if ( sw->sw_valued )
+			qsort( sw->sw_valued + 1, sw->sw_valued[0], sizeof( ID ),
+				sorted_id_cmp );
+		sw->sw_state = SW_MISSING;
+		sorted_run_clear( sw );
+	}
+
+	Debug( LDAP_DEBUG_TRACE, LDAP_XSTRING(mdb_sorted_open)
+		": about %ld candidates by %s\n",
+		(long) n, ad->ad_cname.bv_val, 0 );
+	*countp = n;
+	*walkp = sw;
+	sw = NULL;
+	rc = LDAP_SUCCESS;
+
+done:
+	mdb_cursor_close( mcd );
+	if ( base )
+		mdb_entry_return( op, base );
+	if ( sw )
+		mdb_sorted_close( op, sw );
+	return rc;
+}
+
+int
+mdb_sorted_next( Operation *op, void *walk, ID *idp, int *belowp )
+{
+	mdb_sorted_walk *sw = walk;
+	int rc;
+
+	switch ( sw->sw_state ) {
+	case SW_START:
+	case SW_VALUED:
+		rc = sorted_valued( op, sw, idp );
+		if ( rc == 0 ) {
+			*belowp = 0;
+			if ( sw->sw_keys ) {
+				MDB_val key;
+				int cmp;
+				key.mv_data = sw->sw_keys[0].bv_val;
+				key.mv_size = sw->sw_keys[0].bv_len;
+				cmp = mdb_cmp( sw->sw_moi->moi_txn,
+					mdb_cursor_dbi( sw->sw_mc ), &sw->sw_key, &key );
+				if ( !cmp && sw->sw_valued_run ) {
+					sorted_val *sv = &sw->sw_run[sw->sw_pos - 1];
+					MatchingRule *mr = sw->sw_ad->ad_type->sat_ordering;
+					if ( BER_BVISNULL( &sv->sv_val ))
+						cmp = 1;
+					else
+						mr->smr_match( &cmp, 0, mr->smr_syntax, mr,
+							&sv->sv_val, &sw->sw_value );
+				}
+				*belowp = sw->sw_reverse ? cmp > 0 : cmp < 0;
+			}
+			if ( !sw->sw_reverse )
+				sorted_append( &sw->sw_valued, &sw->sw_size, *idp );
+			return LDAP_SUCCESS;
+		}
+		if ( rc != MDB_NOTFOUND )
+			break;
+		if ( sw->sw_reverse ) {
+			sw->sw_state = SW_END;
+			return LDAP_NO_SUCH_OBJECT;
+		}
+		if ( sw->sw_valued )
+			qsort( sw->sw_valued + 1, sw->sw_valued[0], sizeof( ID ),
+				sorted_id_cmp );
+		sw->sw_state = SW_MISSING;
+		/* FALLTHRU */
+	case SW_MISSING:
+		rc = sorted_missing( op, sw, idp );
+		if ( rc == 0 ) {
+			*belowp = sw->sw_reverse;
+			return LDAP_SUCCESS;
+		}
+		if ( rc != MDB_NOTFOUND )
+			break;
+		if ( sw->sw_reverse ) {
+			/* now the keys, from the last one */
+			sw->sw_state = SW_START;
+			return mdb_sorted_next( op, walk, idp, belowp );
+		}
+		sw->sw_state = SW_END;
+		/* FALLTHRU */
+	default:
+		return LDAP_NO_SUCH_OBJECT;
+	}
+	return rc == LDAP_UNWILLING_TO_PERFORM ? rc : LDAP_OTHER;
+}
+
+void
+mdb_sorted_close( Operation *op, void *walk )
+{
+	mdb_sorted_walk *sw = walk;
+	mdb_op_info *moi = sw->sw_moi;
+
+	if ( sw->sw_keys )
+		ber_bvarray_free_x( sw->sw_keys, op->o_tmpmemctx );
+	ch_free( sw->sw_value.bv_val );
+	sorted_run_clear( sw );
+	ch_free( sw->sw_run );
+	ch_free( sw->sw_valued );
+	if ( sw->sw_probes )
+		mdb_filter_probes_free( op, sw->sw_probes );
+	mdb_cursor_close( sw->sw_mc );
+	mdb_cursor_close( sw->sw_mci );
+	scope_chunk_ret( op, sw->sw_scopes );
+	if ( moi == &sw->sw_opinfo ) {
+		mdb_txn_reset( moi->moi_txn );
+		LDAP_SLIST_REMOVE( &op->o_extra, &moi->moi_oe, OpExtra, oe_next );
+	} else {
+		moi->moi_ref--;
+	}
+	ch_free( sw );
+}
+
+/* An entry from mdb_sorted_next(), if it is still a result of the
+ * search: the same checks as mdb_search, except that referrals are
+ * skipped instead of returned as continuation references.
+ */
+int
+mdb_sorted_entry( Operation *op, ID id, Entry **ep )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	mdb_op_info *moi = NULL;
+	MDB_cursor *mc = NULL;
+	Entry *e = NULL;
+	int manageDSAit = get_manageDSAit( op );
+	int rc;
+
+	rc = mdb_opinfo_get( op, mdb, 1, &moi );
+	if ( rc )
+		return LDAP_OTHER;
+
+	rc = mdb_cursor_open( moi->moi_txn, mdb->mi_id2entry, &mc );
+	if ( rc == 0 ) {
+		rc = mdb_id2entry( op, mc, id, &e );
+		mdb_cursor_close( mc );
+		mc = NULL;
+	}
+	if ( rc == 0 ) {
+		rc = mdb_id2name( op, moi->moi_txn, &mc, id,
+			&e->e_name, &e->e_nname );
+		mdb_cursor_close( mc );
+	}
+	if ( rc == 0 ) {
+		if ( !dnIsSuffixScope( &e->e_nname, &op->o_req_ndn, op->ors_scope ) ||
+			( is_entry_subentry( e ) ? !get_subentries_visibility( op ) :
+				get_subentries_visibility( op )) ||
+			( !manageDSAit && ( is_entry_glue( e ) || is_entry_referral( e ))) ||
+			test_filter( op, e, op->ors_filter ) != LDAP_COMPARE_TRUE )
+			rc = LDAP_NO_SUCH_OBJECT;
+	} else {
+		rc = rc == MDB_NOTFOUND ? LDAP_NO_SUCH_OBJECT : LDAP_OTHER;
+	}
+
+	if ( rc == LDAP_SUCCESS ) {
+		*ep = e;
+	} else if ( e ) {
+		mdb_entry_release( op, e, 0 );
+	}
+	return rc;
+}
+
 
 static int base_candidate(
 	BackendDB	*be,
@@ -1305,7 +2378,8 @@ static int search_candidates(
 	IdScopes *isc,
 	MDB_cursor *mci,
 	ID	*ids,
-	ID *stack )
+	ID *stack,
+	mdb_iprobe **probes )
 {
 	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
 	int rc, depth = 1;
@@ -1377,6 +2451,10 @@ static int search_candidates(
 			stack, stack+MDB_IDL_UM_SIZE );
 	}
 
+	/* With only a range left, probe the indices for each entry */
+	if ( rc == LDAP_SUCCESS && MDB_IDL_IS_RANGE( ids ))
+		*probes = mdb_filter_probes( op, isc->mt, f );
+
 	if ( depth+1 > mdb->mi_search_stack_depth ) {
 		ch_free( stack );
 	}
@@ -0,0 +1,60 @@
+/* sorted.h - mdb backend API for server side sorting */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 2000-2016 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+#ifndef _MDB_SORTED_H_
+#define _MDB_SORTED_H_
+
+LDAP_BEGIN_DECL
+
+/* Exported as the bi_extra of the mdb backend, for overlays that
+ * sort search results. The candidates of a search are walked in the
+ * order of an ordered equality index (integer, generalizedTime, CSN)
+ * of a single-valued attribute, and only the entries that are
+ * actually sent get fetched.
+ */
+typedef struct mdb_sorted_t {
+	/* Starts a walk over the candidates of the search in op, ordered
+	 * by ad, entries without ad last; reverse turns the whole order
+	 * around, but IDs with equal values still come in ID order. The
+	 * candidates sharing an index key are fetched, to sort them with
+	 * the ordering rule of ad. *countp gets the number of candidates,
+	 * which can exceed the number of entries that match. With a
+	 * normalized value, sorted_next tells which candidates sort before
+	 * it. Returns LDAP_UNWILLING_TO_PERFORM if the search can't be
+	 * served this way.
+	 */
+	int (*sorted_open)( Operation *op, AttributeDescription *ad,
+		int reverse, struct berval *value, void **walkp, ID *countp );
+
+	/* The next candidate in *idp, with *belowp set if it sorts before
+	 * the value. LDAP_NO_SUCH_OBJECT at the end of the walk, and
+	 * LDAP_UNWILLING_TO_PERFORM if it meets an index key whose IDs are
+	 * only known as a range.
+	 */
+	int (*sorted_next)( Operation *op, void *walk, ID *idp, int *belowp );
+
+	/* The entry with this ID if it is a result of the search in op,
+	 * else LDAP_NO_SUCH_OBJECT. Release it with be_entry_release_r()
+	 * before the walk is closed.
+	 */
+	int (*sorted_entry)( Operation *op, ID id, Entry **ep );
+
+	void (*sorted_close)( Operation *op, void *walk );
+} mdb_sorted_t;
+
+LDAP_END_DECL
+
+#endif /* _MDB_SORTED_H_ */
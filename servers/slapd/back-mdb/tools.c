@@ -190,6 +190,26 @@ int mdb_tool_entry_close(
 	}
 #endif
 
+	/* commit what is left of a reindex in Quick mode */
+	if( txi ) {
+		struct mdb_info *mi = (struct mdb_info *) be->be_private;
+		unsigned i;
+		int rc;
+		MDB_TOOL_IDL_FLUSH( be, txi );
+		rc = mdb_txn_commit( txi );
+		txi = NULL;
+		mdb_writes = 0;
+		for ( i=0; i<mi->mi_nattrs; i++ )
+			mi->mi_attrs[i]->ai_cursor = NULL;
+		if ( rc ) {
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_tool_entry_close) ": database %s: "
+				"txn_commit failed: %s (%d)\n",
+				be->be_suffix[0].bv_val, mdb_strerror(rc), rc );
+			return -1;
+		}
+	}
+
 	if( idcursor ) {
 		mdb_cursor_close( idcursor );
 		idcursor = NULL;
@@ -885,6 +905,18 @@ int mdb_tool_entry_reindex(
 				return -1;
 			}
 		}
+		/* all index DBs are being rebuilt, switch to the configured
+		 * hash and slot format */
+		if ( !adv && (( mi->mi_ixhash_cf && mi->mi_ixhash != mi->mi_ixhash_cf ) ||
+			( mi->mi_idlfmt_cf && mi->mi_idlfmt != mi->mi_idlfmt_cf ))) {
+			slap_mask_t hash = mi->mi_ixhash_cf ? mi->mi_ixhash_cf : mi->mi_ixhash;
+			unsigned idlfmt = mi->mi_idlfmt_cf ? mi->mi_idlfmt_cf : mi->mi_idlfmt;
+			rc = mdb_ixhash_write( mi, txi, hash, idlfmt );
+			if ( rc )
+				return -1;
+			mi->mi_ixhash = hash;
+			mi->mi_idlfmt = idlfmt;
+		}
 		slapMode ^= SLAP_TRUNCATE_MODE;
 	}
 
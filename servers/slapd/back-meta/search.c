@@ -1802,6 +1802,9 @@ free_message:;
 				lutil_timermul( &save_tv, 2, &save_tv );
 			}
 
+			/* nothing more to send until a target answers */
+			slap_sendbatch_poll( op, 1 );
+
 			if ( alreadybound == 0 ) {
 				tv = save_tv;
 				(void)select( 0, NULL, NULL, NULL, &tv );
@@ -146,7 +146,8 @@ typedef struct monitor_info_t {
  */
 
 enum {
-	SLAPD_MONITOR_BACKEND = 0,
+	SLAPD_MONITOR_ACL = 0,
+	SLAPD_MONITOR_BACKEND,
 	SLAPD_MONITOR_CONN,
 	SLAPD_MONITOR_DATABASE,
 	SLAPD_MONITOR_LISTENER,
@@ -165,6 +166,12 @@ enum {
 
 #define SLAPD_MONITOR_AT		"cn"
 
+#define SLAPD_MONITOR_ACL_NAME		"ACL"
+#define SLAPD_MONITOR_ACL_RDN	\
+	SLAPD_MONITOR_AT "=" SLAPD_MONITOR_ACL_NAME
+#define SLAPD_MONITOR_ACL_DN	\
+	SLAPD_MONITOR_ACL_RDN "," SLAPD_MONITOR_DN
+
 #define SLAPD_MONITOR_BACKEND_NAME	"Backends"
 #define SLAPD_MONITOR_BACKEND_RDN	\
 	SLAPD_MONITOR_AT "=" SLAPD_MONITOR_BACKEND_NAME
@@ -35,7 +35,7 @@ monitor_subsys_listener_init(
 {
 	monitor_info_t	*mi;
 	Entry		*e_listener, **ep;
-	int		i;
+	int		i, n;
 	monitor_entry_t	*mp;
 	Listener	**l;
 
@@ -66,13 +66,18 @@ monitor_subsys_listener_init(
 	mp->mp_children = NULL;
 	ep = &mp->mp_children;
 
-	for ( i = 0; l[ i ]; i++ ) {
+	for ( i = 0, n = 0; l[ i ]; i++ ) {
 		char 		buf[ BACKMONITOR_BUFSIZE ];
 		Entry		*e;
 		struct berval bv;
 
+		/* the extra sockets of x-reuseport listeners */
+		if ( l[ i ]->sl_shard ) {
+			continue;
+		}
+
 		bv.bv_len = snprintf( buf, sizeof( buf ),
-				"cn=Listener %d", i );
+				"cn=Listener %d", n );
 		bv.bv_val = buf;
 		e = monitor_entry_stub( &ms->mss_dn, &ms->mss_ndn, &bv,
 			mi->mi_oc_monitoredObject, NULL, NULL );
@@ -81,7 +86,7 @@ monitor_subsys_listener_init(
 			Debug( LDAP_DEBUG_ANY,
 				"monitor_subsys_listener_init: "
 				"unable to create entry \"cn=Listener %d,%s\"\n",
-				i, ms->mss_ndn.bv_val, 0 );
+				n, ms->mss_ndn.bv_val, 0 );
 			return( -1 );
 		}
 
@@ -123,12 +128,13 @@ monitor_subsys_listener_init(
 			Debug( LDAP_DEBUG_ANY,
 				"monitor_subsys_listener_init: "
 				"unable to add entry \"cn=Listener %d,%s\"\n",
-				i, ms->mss_ndn.bv_val, 0 );
+				n, ms->mss_ndn.bv_val, 0 );
 			return( -1 );
 		}
 
 		*ep = e;
 		ep = &mp->mp_next;
+		n++;
 	}
 	
 	monitor_cache_release( mi, e_listener );
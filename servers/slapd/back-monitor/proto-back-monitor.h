@@ -25,6 +25,14 @@
 
 LDAP_BEGIN_DECL
 
+/*
+ * acl
+ */
+extern int
+monitor_subsys_acl_init LDAP_P((
+	BackendDB		*be,
+	monitor_subsys_t	*ms ));
+
 /*
  * backends
  */
@@ -34,6 +34,7 @@ typedef enum {
 	MT_UNKNOWN,
 	MT_RUNQUEUE,
 	MT_TASKLIST,
+	MT_QUEUES,
 
 	MT_LAST
 } monitor_thread_t;
@@ -77,6 +78,9 @@ static struct {
 		BER_BVNULL,
 		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_BACKLOAD_MAX,MT_UNKNOWN },
 #endif
+	{ BER_BVC( "cn=Steals" ),
+		BER_BVC("Number of pending tasks taken over from another work queue"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_STEALS,	MT_UNKNOWN },
 	{ BER_BVC( "cn=State" ),
 		BER_BVC("Thread pool state"),
 		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_STATE,	MT_UNKNOWN },
@@ -87,6 +91,9 @@ static struct {
 	{ BER_BVC( "cn=Tasklist" ),
 		BER_BVC("List of running plus standby threads - besides those handling operations"),
 		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_TASKLIST },
+	{ BER_BVC( "cn=Queues" ),
+		BER_BVC("Open, active and pending threads and steals of each work queue"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_QUEUES },
 
 	{ BER_BVNULL }
 };
@@ -318,6 +325,49 @@ monitor_subsys_thread_update(
 			}
 			break;
 
+		case MT_QUEUES:
+			if ( a != NULL ) {
+				if ( a->a_nvals != a->a_vals ) {
+					ber_bvarray_free( a->a_nvals );
+				}
+				ber_bvarray_free( a->a_vals );
+				a->a_vals = NULL;
+				a->a_nvals = NULL;
+				a->a_numvals = 0;
+			}
+
+			bv.bv_val = buf;
+			for ( i = 0; ; i++ ) {
+				int open, active, pending, steals;
+
+				if ( ldap_pvt_thread_pool_queue_query( &connection_pool, i,
+						LDAP_PVT_THREAD_POOL_PARAM_OPEN, (void *)&open ) ||
+					ldap_pvt_thread_pool_queue_query( &connection_pool, i,
+						LDAP_PVT_THREAD_POOL_PARAM_ACTIVE, (void *)&active ) ||
+					ldap_pvt_thread_pool_queue_query( &connection_pool, i,
+						LDAP_PVT_THREAD_POOL_PARAM_PENDING, (void *)&pending ) ||
+					ldap_pvt_thread_pool_queue_query( &connection_pool, i,
+						LDAP_PVT_THREAD_POOL_PARAM_STEALS, (void *)&steals ) )
+				{
+					break;
+				}
+				bv.bv_len = snprintf( buf, sizeof( buf ),
+					"{%d}open=%d active=%d pending=%d steals=%d",
+					i, open, active, pending, steals );
+				if ( bv.bv_len < sizeof( buf ) ) {
+					value_add_one( &vals, &bv );
+				}
+			}
+
+			if ( vals ) {
+				attr_merge_normalize( e, mi->mi_ad_monitoredInfo, vals, NULL );
+				ber_bvarray_free( vals );
+
+			} else {
+				attr_delete( &e->e_attrs, mi->mi_ad_monitoredInfo );
+			}
+			break;
+
 		default:
 			assert( 0 );
 		}
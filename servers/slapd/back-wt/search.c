@@ -342,6 +342,7 @@ wt_search( Operation *op, SlapReply *rs )
 	Entry *base = NULL;
 	slap_mask_t mask;
 	time_t stoptime;
+	void *batch;
 
 	ID candidates[WT_IDL_UM_SIZE];
 	ID iscopes[WT_IDL_DB_SIZE];
@@ -427,6 +428,7 @@ wt_search( Operation *op, SlapReply *rs )
 
 	/* compute it anyway; root does not use it */
 	stoptime = op->o_time + op->ors_tlimit;
+	batch = slap_sendbatch_lookup( op );
 
 	base = e;
 
@@ -548,6 +550,12 @@ loop_begin:
 			goto done;
 		}
 
+		/* don't hold back entries already batched while
+		 * looking for the next match
+		 */
+		if ( batch )
+			slap_sendbatch_tick( op, batch );
+
 		nentries++;
 
 	fetch_entry_retry:
@@ -50,6 +50,34 @@ int			nBackendInfo = 0;
 slap_bi_head backendInfo = LDAP_STAILQ_HEAD_INITIALIZER(backendInfo);
 
 int			nBackendDB = 0; 
+
+/*
+ * Static group memberships found by fe_acl_group(), kept across
+ * operations for the backends that report their writes through
+ * backend_group_forget(). An operation only stores what it found if
+ * it began after the last write that was reported, so it cannot have
+ * read a group before a change to it was committed.
+ */
+typedef struct GroupMember {
+	ObjectClass		*gm_oc;
+	AttributeDescription	*gm_at;
+	int			gm_res;
+	struct berval		gm_ndn;
+} GroupMember;
+
+typedef struct GroupCached {
+	struct berval		gc_ndn;
+	Avlnode			*gc_members;
+	ber_len_t		gc_count;
+	struct GroupCached	*gc_next;	/* for backend_group_forget() */
+} GroupCached;
+
+static ldap_pvt_thread_rdwr_t	group_cache_rwlock;
+static Avlnode			*group_cache;
+static ber_len_t		group_cache_count;
+static time_t			group_cache_time;
+static int			group_cache_tincr;
+
 slap_be_head backendDB = LDAP_STAILQ_HEAD_INITIALIZER(backendDB);
 
 static int
@@ -90,6 +118,8 @@ int backend_init(void)
 		return -1;
 	}
 
+	ldap_pvt_thread_rdwr_init( &group_cache_rwlock );
+
 	for( bi=slap_binfo; bi->bi_type != NULL; bi++,nBackendInfo++ ) {
 		assert( bi->bi_init != 0 );
 
@@ -471,6 +501,7 @@ void backend_destroy_one( BackendDB *bd, int dynamic )
 	}
 	acl_destroy( bd->be_acl );
 	limits_destroy( bd->be_limits );
+	backend_group_forget( NULL, 0 );
 	if ( bd->be_extra_anlist ) {
 		anlist_free( bd->be_extra_anlist, 1, NULL );
 	}
@@ -529,6 +560,8 @@ int backend_destroy(void)
 		frontendDB = NULL;
 	}
 
+	ldap_pvt_thread_rdwr_destroy( &group_cache_rwlock );
+
 	return 0;
 }
 
@@ -1439,6 +1472,221 @@ be_entry_get_rw(
 	return LDAP_UNWILLING_TO_PERFORM;
 }
 
+static int
+group_cached_cmp( const void *v1, const void *v2 )
+{
+	const GroupCached *g1 = v1, *g2 = v2;
+
+	return ber_bvcmp( &g1->gc_ndn, &g2->gc_ndn );
+}
+
+static int
+group_member_cmp( const void *v1, const void *v2 )
+{
+	const GroupMember *m1 = v1, *m2 = v2;
+
+	if ( m1->gm_oc != m2->gm_oc )
+		return m1->gm_oc < m2->gm_oc ? -1 : 1;
+	if ( m1->gm_at != m2->gm_at )
+		return m1->gm_at < m2->gm_at ? -1 : 1;
+	return ber_bvcmp( &m1->gm_ndn, &m2->gm_ndn );
+}
+
+static void
+group_cached_free( void *v )
+{
+	GroupCached *g = v;
+
+	avl_free( g->gc_members, ch_free );
+	ch_free( g );
+}
+
+/* Whether the membership of op_ndn in the group can be taken from,
+ * and stored in, the group cache. The group must be held by a backend
+ * that reports its writes. Overlays that fetch entries may make up
+ * group members, so groups below them are not cached.
+ */
+static int
+group_cacheable(
+	Operation *op,
+	Entry	*target,
+	struct berval *gr_ndn,
+	AttributeDescription *group_at )
+{
+	BackendDB *be;
+
+	if ( !slap_group_cache_size || op->o_tag == LDAP_REQ_BIND ||
+		op->o_do_not_cache )
+		return 0;
+
+	be = select_backend( gr_ndn, 0 );
+	if ( !be || !SLAP_GROUPCACHE( be ) )
+		return 0;
+
+	/* the target may not be what is stored */
+	if ( target && dn_match( &target->e_nname, gr_ndn ) )
+		return 0;
+
+	if ( is_at_subtype( group_at->ad_type,
+		slap_schema.si_ad_labeledURI->ad_type ) )
+		return 0;
+
+	if ( overlay_is_over( be ) ) {
+		slap_overinfo *oi = be->bd_info->bi_private;
+		slap_overinst *on;
+
+		for ( on = oi->oi_list; on; on = on->on_next ) {
+			if ( on->on_bi.bi_entry_get_rw )
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+group_cache_find(
+	struct berval *gr_ndn,
+	struct berval *op_ndn,
+	ObjectClass *group_oc,
+	AttributeDescription *group_at,
+	int *res )
+{
+	GroupCached gc, *g;
+	GroupMember gm, *m = NULL;
+
+	gc.gc_ndn = *gr_ndn;
+	gm.gm_oc = group_oc;
+	gm.gm_at = group_at;
+	gm.gm_ndn = *op_ndn;
+
+	ldap_pvt_thread_rdwr_rlock( &group_cache_rwlock );
+	g = avl_find( group_cache, &gc, group_cached_cmp );
+	if ( g ) {
+		m = avl_find( g->gc_members, &gm, group_member_cmp );
+		if ( m )
+			*res = m->gm_res;
+	}
+	ldap_pvt_thread_rdwr_runlock( &group_cache_rwlock );
+
+	return m == NULL;
+}
+
+static void
+group_cache_add(
+	Operation *op,
+	struct berval *gr_ndn,
+	struct berval *op_ndn,
+	ObjectClass *group_oc,
+	AttributeDescription *group_at,
+	int res )
+{
+	GroupCached gc, *g;
+	GroupMember *m;
+
+	gc.gc_ndn = *gr_ndn;
+
+	ldap_pvt_thread_rdwr_wlock( &group_cache_rwlock );
+	if ( op->o_time < group_cache_time ||
+		( op->o_time == group_cache_time &&
+			op->o_tincr <= group_cache_tincr ) )
+		goto done;
+
+	if ( group_cache_count >= slap_group_cache_size ) {
+		avl_free( group_cache, group_cached_free );
+		group_cache = NULL;
+		group_cache_count = 0;
+	}
+
+	g = avl_find( group_cache, &gc, group_cached_cmp );
+	if ( !g ) {
+		g = ch_malloc( sizeof( GroupCached ) + gr_ndn->bv_len + 1 );
+		g->gc_ndn.bv_val = (char *)(g+1);
+		g->gc_ndn.bv_len = gr_ndn->bv_len;
+		AC_MEMCPY( g->gc_ndn.bv_val, gr_ndn->bv_val, gr_ndn->bv_len + 1 );
+		g->gc_members = NULL;
+		g->gc_count = 0;
+		avl_insert( &group_cache, g, group_cached_cmp, avl_dup_error );
+	}
+
+	m = ch_malloc( sizeof( GroupMember ) + op_ndn->bv_len + 1 );
+	m->gm_oc = group_oc;
+	m->gm_at = group_at;
+	m->gm_res = res;
+	m->gm_ndn.bv_val = (char *)(m+1);
+	m->gm_ndn.bv_len = op_ndn->bv_len;
+	AC_MEMCPY( m->gm_ndn.bv_val, op_ndn->bv_val, op_ndn->bv_len + 1 );
+	if ( avl_insert( &g->gc_members, m, group_member_cmp, avl_dup_error ) ) {
+		/* stored by another operation meanwhile */
+		ch_free( m );
+	} else {
+		g->gc_count++;
+		group_cache_count++;
+	}
+
+done:
+	ldap_pvt_thread_rdwr_wunlock( &group_cache_rwlock );
+}
+
+typedef struct GroupForget {
+	struct berval		*gf_ndn;
+	GroupCached		*gf_list;
+} GroupForget;
+
+static int
+group_forget_below( void *v, void *arg )
+{
+	GroupCached *g = v;
+	GroupForget *gf = arg;
+
+	if ( dnIsSuffix( &g->gc_ndn, gf->gf_ndn ) ) {
+		g->gc_next = gf->gf_list;
+		gf->gf_list = g;
+	}
+	return 0;
+}
+
+/* Called by backends with SLAP_BFLAG_GROUPCACHE once a change to the
+ * entry ndn has been committed, and with NULL to empty the cache.
+ * With LDAP_SCOPE_SUBTREE the groups below ndn are forgotten too, as
+ * needed when ndn was renamed or moved.
+ */
+void
+backend_group_forget( struct berval *ndn, int scope )
+{
+	GroupCached gc, *g;
+
+	ldap_pvt_thread_rdwr_wlock( &group_cache_rwlock );
+	slap_op_time( &group_cache_time, &group_cache_tincr );
+	if ( ndn == NULL ) {
+		avl_free( group_cache, group_cached_free );
+		group_cache = NULL;
+		group_cache_count = 0;
+
+	} else if ( group_cache && scope == LDAP_SCOPE_SUBTREE ) {
+		GroupForget gf;
+
+		/* the cache is ordered by DN length first, so walk it all */
+		gf.gf_ndn = ndn;
+		gf.gf_list = NULL;
+		avl_apply( group_cache, group_forget_below, &gf, -1, AVL_INORDER );
+		while (( g = gf.gf_list ) != NULL ) {
+			gf.gf_list = g->gc_next;
+			avl_delete( &group_cache, g, group_cached_cmp );
+			group_cache_count -= g->gc_count;
+			group_cached_free( g );
+		}
+
+	} else if ( group_cache ) {
+		gc.gc_ndn = *ndn;
+		g = avl_delete( &group_cache, &gc, group_cached_cmp );
+		if ( g ) {
+			group_cache_count -= g->gc_count;
+			group_cached_free( g );
+		}
+	}
+	ldap_pvt_thread_rdwr_wunlock( &group_cache_rwlock );
+}
+
 int 
 fe_acl_group(
 	Operation *op,
@@ -1455,6 +1703,7 @@ fe_acl_group(
 	GroupAssertion *g;
 	Backend *be = op->o_bd;
 	OpExtra		*oex;
+	int		cached;
 
 	LDAP_SLIST_FOREACH(oex, &op->o_extra, oe_next) {
 		if ( oex->oe_key == (void *)backend_group )
@@ -1483,6 +1732,13 @@ fe_acl_group(
 		goto done;
 	}
 
+	cached = group_cacheable( op, target, gr_ndn, group_at );
+	if ( cached && !group_cache_find( gr_ndn, op_ndn, group_oc,
+		group_at, &rc ) )
+	{
+		goto found;
+	}
+
 	if ( target && dn_match( &target->e_nname, gr_ndn ) ) {
 		e = target;
 		rc = 0;
@@ -1643,6 +1899,14 @@ loopit:
 		rc = LDAP_NO_SUCH_OBJECT;
 	}
 
+	/* not a missing group, nothing tells when it gets added */
+	if ( cached && ( rc == LDAP_SUCCESS || rc == LDAP_COMPARE_FALSE ||
+		rc == LDAP_NO_SUCH_ATTRIBUTE ) )
+	{
+		group_cache_add( op, gr_ndn, op_ndn, group_oc, group_at, rc );
+	}
+
+found:
 	if ( op->o_tag != LDAP_REQ_BIND && !op->o_do_not_cache ) {
 		g = op->o_tmpalloc( sizeof( GroupAssertion ) + gr_ndn->bv_len,
 			op->o_tmpmemctx );
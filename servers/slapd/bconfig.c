@@ -200,6 +200,7 @@ enum {
 	CFG_DISABLED,
 	CFG_THREADQS,
 	CFG_TLS_ECNAME,
+	CFG_THREADSTEAL,
 
 	CFG_LAST
 };
@@ -393,6 +394,9 @@ static ConfigTable config_back_cf_table[] = {
 #endif
 		"( OLcfgGlAt:17 NAME 'olcGentleHUP' "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "groupcache-size", "entries", 2, 2, 0, ARG_BER_LEN_T,
+		&slap_group_cache_size, "( OLcfgGlAt:101 NAME 'olcGroupCacheSize' "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "hidden", "on|off", 2, 2, 0, ARG_DB|ARG_ON_OFF|ARG_MAGIC|CFG_HIDDEN,
 		&config_generic, "( OLcfgDbAt:0.17 NAME 'olcHidden' "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
@@ -435,6 +439,14 @@ static ConfigTable config_back_cf_table[] = {
 		&config_generic, "( OLcfgDbAt:0.5 NAME 'olcLimits' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString X-ORDERED 'VALUES' )", NULL, NULL },
+	{ "listener-affinity", "on|off", 2, 2, 0,
+#ifdef NO_THREADS
+		ARG_IGNORED, NULL,
+#else
+		ARG_ON_OFF, &slapd_daemon_affinity,
+#endif
+		"( OLcfgGlAt:98 NAME 'olcListenerAffinity' "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "listener-threads", "count", 2, 0, 0,
 #ifdef NO_THREADS
 		ARG_IGNORED, NULL,
@@ -693,6 +705,14 @@ static ConfigTable config_back_cf_table[] = {
 #endif
 		"( OLcfgGlAt:95 NAME 'olcThreadQueues' "
 			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "threadsteal", "on|off", 2, 2, 0,
+#ifdef NO_THREADS
+		ARG_IGNORED, NULL,
+#else
+		ARG_ON_OFF|ARG_MAGIC|CFG_THREADSTEAL, &config_generic,
+#endif
+		"( OLcfgGlAt:97 NAME 'olcThreadSteal' "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "timelimit", "limit", 2, 0, 0, ARG_MAY_DB|ARG_MAGIC,
 		&config_timelimit, "( OLcfgGlAt:67 NAME 'olcTimeLimit' "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
@@ -804,6 +824,12 @@ static ConfigTable config_back_cf_table[] = {
 		&config_updateref, "( OLcfgDbAt:0.13 NAME 'olcUpdateRef' "
 			"EQUALITY caseIgnoreMatch "
 			"SUP labeledURI )", NULL, NULL },
+	{ "writebatch-latency", "msec", 2, 2, 0, ARG_INT,
+		&slap_writebatch_latency, "( OLcfgGlAt:100 NAME 'olcWriteBatchLatency' "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "writebatch-size", "bytes", 2, 2, 0, ARG_BER_LEN_T,
+		&slap_writebatch_size, "( OLcfgGlAt:99 NAME 'olcWriteBatchSize' "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "writetimeout", "timeout", 2, 2, 0, ARG_INT,
 		&global_writetimeout, "( OLcfgGlAt:88 NAME 'olcWriteTimeout' "
 			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
@@ -850,11 +876,11 @@ static ConfigOCs cf_ocs[] = {
 		 "olcAttributeOptions $ olcAuthIDRewrite $ "
 		 "olcAuthzPolicy $ olcAuthzRegexp $ olcConcurrency $ "
 		 "olcConnMaxPending $ olcConnMaxPendingAuth $ "
-		 "olcDisallows $ olcGentleHUP $ olcIdleTimeout $ "
+		 "olcDisallows $ olcGentleHUP $ olcGroupCacheSize $ olcIdleTimeout $ "
 		 "olcIndexSubstrIfMaxLen $ olcIndexSubstrIfMinLen $ "
 		 "olcIndexSubstrAnyLen $ olcIndexSubstrAnyStep $ olcIndexHash64 $ "
 		 "olcIndexIntLen $ "
-		 "olcListenerThreads $ olcLocalSSF $ olcLogFile $ olcLogLevel $ "
+		 "olcListenerAffinity $ olcListenerThreads $ olcLocalSSF $ olcLogFile $ olcLogLevel $ "
 		 "olcPasswordCryptSaltFormat $ olcPasswordHash $ olcPidFile $ "
 		 "olcPluginLogFile $ olcReadOnly $ olcReferral $ "
 		 "olcReplogFile $ olcRequires $ olcRestrict $ olcReverseLookup $ "
@@ -864,12 +890,12 @@ static ConfigOCs cf_ocs[] = {
 		 "olcSecurity $ olcServerID $ olcSizeLimit $ "
 		 "olcSockbufMaxIncoming $ olcSockbufMaxIncomingAuth $ "
 		 "olcTCPBuffer $ "
-		 "olcThreads $ olcThreadQueues $ "
+		 "olcThreads $ olcThreadQueues $ olcThreadSteal $ "
 		 "olcTimeLimit $ olcTLSCACertificateFile $ "
 		 "olcTLSCACertificatePath $ olcTLSCertificateFile $ "
 		 "olcTLSCertificateKeyFile $ olcTLSCipherSuite $ olcTLSCRLCheck $ "
 		 "olcTLSRandFile $ olcTLSVerifyClient $ olcTLSDHParamFile $ olcTLSECName $ "
-		 "olcTLSCRLFile $ olcTLSProtocolMin $ olcToolThreads $ olcWriteTimeout $ "
+		 "olcTLSCRLFile $ olcTLSProtocolMin $ olcToolThreads $ olcWriteBatchLatency $ olcWriteBatchSize $ olcWriteTimeout $ "
 		 "olcObjectIdentifier $ olcAttributeTypes $ olcObjectClasses $ "
 		 "olcDitContentRules $ olcLdapSyntaxes ) )", Cft_Global },
 	{ "( OLcfgGlOc:2 "
@@ -970,6 +996,9 @@ config_generic(ConfigArgs *c) {
 		case CFG_THREADQS:
 			c->value_int = connection_pool_queues;
 			break;
+		case CFG_THREADSTEAL:
+			c->value_int = connection_pool_steal;
+			break;
 		case CFG_TTHREADS:
 			c->value_int = slap_tool_thread_max;
 			break;
@@ -1366,6 +1395,11 @@ config_generic(ConfigArgs *c) {
 				SLAP_DBFLAGS(c->be) |= SLAP_DBFLAG_SINGLE_SHADOW;
 			break;
 
+		case CFG_THREADSTEAL:
+			ldap_pvt_thread_pool_steal(&connection_pool, 0);
+			connection_pool_steal = 0;
+			break;
+
 #if defined(HAVE_CYRUS_SASL) && defined(SLAP_AUXPROP_DONTUSECOPY)
 		case CFG_AZDUC:
 			if ( c->valx < 0 ) {
@@ -1731,6 +1765,12 @@ config_generic(ConfigArgs *c) {
 			connection_pool_queues = c->value_int;	/* save for reference */
 			break;
 
+		case CFG_THREADSTEAL:
+			if ( slapMode & SLAP_SERVER_MODE )
+				ldap_pvt_thread_pool_steal(&connection_pool, c->value_int);
+			connection_pool_steal = c->value_int;	/* save for reference */
+			break;
+
 		case CFG_TTHREADS:
 			if ( slapMode & SLAP_TOOL_MODE )
 				ldap_pvt_thread_pool_maxthreads(&connection_pool, c->value_int);
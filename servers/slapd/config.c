@@ -79,6 +79,11 @@ struct berval default_search_nbase = BER_BVNULL;
 ber_len_t sockbuf_max_incoming = SLAP_SB_MAX_INCOMING_DEFAULT;
 ber_len_t sockbuf_max_incoming_auth= SLAP_SB_MAX_INCOMING_AUTH;
 
+ber_len_t slap_writebatch_size = SLAP_WRITEBATCH_SIZE_DEFAULT;
+int	slap_writebatch_latency = SLAP_WRITEBATCH_LATENCY_DEFAULT;
+
+ber_len_t slap_group_cache_size = SLAP_GROUP_CACHE_SIZE_DEFAULT;
+
 int	slap_conn_max_pending = SLAP_CONN_MAX_PENDING_DEFAULT;
 int	slap_conn_max_pending_auth = SLAP_CONN_MAX_PENDING_AUTH;
 
@@ -1002,6 +1002,9 @@ conn_counter_destroy( void *key, void *data )
 			ldap_pvt_mp_add( slap_counters.sc_pdu, sc->sc_pdu );
 			ldap_pvt_mp_add( slap_counters.sc_entries, sc->sc_entries );
 			ldap_pvt_mp_add( slap_counters.sc_refs, sc->sc_refs );
+			ldap_pvt_mp_add( slap_counters.sc_writes, sc->sc_writes );
+			ldap_pvt_mp_add( slap_counters.sc_regex_hits, sc->sc_regex_hits );
+			ldap_pvt_mp_add( slap_counters.sc_regex_compiles, sc->sc_regex_compiles );
 			ldap_pvt_mp_add( slap_counters.sc_ops_initiated, sc->sc_ops_initiated );
 			ldap_pvt_mp_add( slap_counters.sc_ops_completed, sc->sc_ops_completed );
 #ifdef SLAPD_MONITOR
@@ -24,6 +24,10 @@
  * is provided ``as is'' without express or implied warranty.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1			/* Needed for glibc sched_setaffinity() */
+#endif
+
 #include "portable.h"
 
 #include <stdio.h>
@@ -65,6 +69,25 @@ int deny_severity = LOG_NOTICE;
 # define LDAPI_MOD_URLEXT		"x-mod"
 #endif /* LDAP_PF_LOCAL */
 
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
+
+/* Each listener thread gets its own socket for a TCP listener,
+ * the kernel spreads incoming connections over them.
+ */
+#if defined(SO_REUSEPORT) && defined(F_DUPFD) && !defined(HAVE_WINSOCK)
+# define SLAP_REUSEPORT
+# define LDAP_REUSEPORT_URLEXT	"x-reuseport"
+#endif /* SO_REUSEPORT */
+
+#if defined(HAVE_SCHED_H) && defined(CPU_SET)
+# define SLAP_AFFINITY
+#endif
+
 #ifdef LDAP_PF_INET6
 int slap_inet4or6 = AF_UNSPEC;
 #else /* ! INETv6 */
@@ -82,6 +105,7 @@ struct runqueue_s slapd_rq;
 #endif
 int slapd_daemon_threads = 1;
 int slapd_daemon_mask;
+int slapd_daemon_affinity;
 
 #ifdef LDAP_TCP_BUFFER
 int slapd_tcp_rmem;
@@ -1114,6 +1138,227 @@ get_url_perms(
 }
 #endif /* LDAP_PF_LOCAL || SLAP_X_LISTENER_MOD */
 
+#ifdef SLAP_REUSEPORT
+/* Look for the x-reuseport extension; *others is set to the number
+ * of other extensions present.
+ */
+static int
+get_url_reuseport(
+	char	**exts,
+	int	*others )
+{
+	int	i, rc = 0;
+
+	*others = 0;
+	for ( i = 0; exts[ i ]; i++ ) {
+		char	*type = exts[ i ];
+
+		if ( type[ 0 ] == '!' ) {
+			type++;
+		}
+
+		if ( strcasecmp( type, LDAP_REUSEPORT_URLEXT ) == 0 ) {
+			rc = 1;
+		} else {
+			(*others)++;
+		}
+	}
+
+	return rc;
+}
+
+/* Open the sockets the other listener threads will accept on,
+ * bound to the same address as the listener. The number of
+ * listener threads is not configured yet and the privileges needed
+ * to bind may be dropped by then, so open as many as there can be
+ * threads; slapd_daemon() closes the ones it does not need.
+ */
+static ber_socket_t *
+slap_open_shards(
+	struct sockaddr *sa,
+	int addrlen )
+{
+	ber_socket_t	*sds, s;
+	int		i, n = 0, tmp = 1;
+
+	sds = ch_malloc( SLAPD_MAX_DAEMON_THREADS * sizeof( ber_socket_t ) );
+	for ( i = 1; i < SLAPD_MAX_DAEMON_THREADS; i++ ) {
+		s = socket( sa->sa_family, SOCK_STREAM, 0 );
+		if ( s == AC_SOCKET_INVALID ) {
+			break;
+		}
+		(void) setsockopt( s, SOL_SOCKET, SO_REUSEADDR,
+			(char *) &tmp, sizeof(tmp) );
+#if defined(LDAP_PF_INET6) && defined(IPV6_V6ONLY)
+		if ( sa->sa_family == AF_INET6 ) {
+			(void) setsockopt( s, IPPROTO_IPV6, IPV6_V6ONLY,
+				(char *) &tmp, sizeof(tmp) );
+		}
+#endif /* LDAP_PF_INET6 && IPV6_V6ONLY */
+		if ( setsockopt( s, SOL_SOCKET, SO_REUSEPORT,
+				(char *) &tmp, sizeof(tmp) ) == AC_SOCKET_ERROR ||
+			bind( s, sa, addrlen ) )
+		{
+			int err = sock_errno();
+			Debug( LDAP_DEBUG_ANY,
+				"daemon: reuseport bind(%ld) failed errno=%d (%s)\n",
+				(long) s, err, sock_errstr( err ) );
+			tcp_close( s );
+			break;
+		}
+		sds[ n++ ] = s;
+	}
+	sds[ n ] = AC_SOCKET_INVALID;
+
+	return sds;
+}
+
+static void
+slap_close_shards(
+	ber_socket_t *sds )
+{
+	int	i;
+
+	for ( i = 0; sds[ i ] != AC_SOCKET_INVALID; i++ ) {
+		tcp_close( sds[ i ] );
+	}
+	ch_free( sds );
+}
+
+/* Renumber socket s so that listener thread tid handles it.
+ * The descriptors closed here share the socket with the one kept,
+ * so they are released with close() rather than tcp_close(), which
+ * may shut the shared socket down.
+ */
+static ber_socket_t
+slap_sock_to_thread(
+	ber_socket_t s,
+	int tid )
+{
+	ber_socket_t	fd = tid, nfd;
+
+	while ( DAEMON_ID( s ) != tid ) {
+		nfd = fcntl( s, F_DUPFD, fd );
+		if ( nfd == AC_SOCKET_INVALID || nfd >= dtblsize ) {
+			Debug( LDAP_DEBUG_ANY,
+				"daemon: no descriptor for listener thread %d\n",
+				tid, 0, 0 );
+			if ( nfd != AC_SOCKET_INVALID ) {
+				close( nfd );
+			}
+			close( s );
+			return AC_SOCKET_INVALID;
+		}
+		if ( DAEMON_ID( nfd ) == tid ) {
+			close( s );
+			s = nfd;
+			break;
+		}
+		close( nfd );
+		/* next descriptor above nfd that belongs to tid */
+		fd = ( nfd & ~slapd_daemon_mask ) + tid;
+		if ( fd <= nfd ) {
+			fd += slapd_daemon_mask + 1;
+		}
+	}
+
+	return s;
+}
+
+/* Hand each listener thread its own socket of the listeners
+ * opened with x-reuseport, as extra entries of slap_listeners.
+ * They are marked with sl_shard, so that listings of the
+ * configured listeners, like cn=Monitor, can skip them.
+ */
+static void
+slap_shard_listeners( void )
+{
+	Listener	*sl, *li;
+	ber_socket_t	*sds, s;
+	int		l, n, i, t;
+
+	for ( n = 0; slap_listeners[ n ] != NULL; n++ ) /* empty */;
+
+	for ( l = 0; slap_listeners[ l ] != NULL; l++ ) {
+		sl = slap_listeners[ l ];
+		sds = sl->sl_shards;
+		if ( sds == NULL ) {
+			continue;
+		}
+		sl->sl_shards = NULL;
+
+		for ( i = 0, t = 0; t < slapd_daemon_threads &&
+			sds[ i ] != AC_SOCKET_INVALID; t++ )
+		{
+			if ( sl->sl_sd == AC_SOCKET_INVALID ||
+				t == DAEMON_ID( sl->sl_sd ) )
+			{
+				continue;
+			}
+			s = slap_sock_to_thread( sds[ i ], t );
+			sds[ i++ ] = AC_SOCKET_INVALID;
+			if ( s == AC_SOCKET_INVALID ) {
+				continue;
+			}
+
+			li = ch_malloc( sizeof( Listener ) );
+			*li = *sl;
+			li->sl_sd = s;
+			li->sl_shard = 1;
+			ber_dupbv( &li->sl_url, &sl->sl_url );
+			ber_dupbv( &li->sl_name, &sl->sl_name );
+
+			slap_listeners = ch_realloc( slap_listeners,
+				( n + 2 ) * sizeof( Listener * ) );
+			slap_listeners[ n++ ] = li;
+			slap_listeners[ n ] = NULL;
+
+			Debug( LDAP_DEBUG_TRACE,
+				"daemon: listener %s socket %ld for thread %d\n",
+				li->sl_url.bv_val, (long) s, t );
+		}
+		for ( ; sds[ i ] != AC_SOCKET_INVALID; i++ ) {
+			tcp_close( sds[ i ] );
+		}
+		ch_free( sds );
+	}
+}
+#endif /* SLAP_REUSEPORT */
+
+#ifdef SLAP_AFFINITY
+/* Pin listener thread tid to one of the CPUs slapd may run on */
+static void
+slap_daemon_pin( int tid )
+{
+	cpu_set_t	cpus;
+	int		i, n;
+
+	if ( sched_getaffinity( 0, sizeof( cpus ), &cpus ) != 0 ) {
+		return;
+	}
+
+	n = tid % CPU_COUNT( &cpus );
+	for ( i = 0; i < CPU_SETSIZE; i++ ) {
+		if ( CPU_ISSET( i, &cpus ) && n-- == 0 ) {
+			break;
+		}
+	}
+
+	CPU_ZERO( &cpus );
+	CPU_SET( i, &cpus );
+	if ( sched_setaffinity( 0, sizeof( cpus ), &cpus ) != 0 ) {
+		int err = errno;
+		Debug( LDAP_DEBUG_ANY,
+			"daemon: cannot pin listener thread %d to CPU %d errno=%d\n",
+			tid, i, err );
+	} else {
+		Debug( LDAP_DEBUG_TRACE,
+			"daemon: listener thread %d pinned to CPU %d\n",
+			tid, i, 0 );
+	}
+}
+#endif /* SLAP_AFFINITY */
+
 /* port = 0 indicates AF_LOCAL */
 static int
 slap_get_listener_addresses(
@@ -1277,6 +1522,7 @@ slap_open_listener(
 	struct sockaddr **sal, **psal;
 	int socktype = SOCK_STREAM;	/* default to COTS */
 	ber_socket_t s;
+	int reuseport = 0, others = 1;
 
 #if defined(LDAP_PF_LOCAL) || defined(SLAP_X_LISTENER_MOD)
 	/*
@@ -1297,6 +1543,8 @@ slap_open_listener(
 	l.sl_url.bv_val = NULL;
 	l.sl_mute = 0;
 	l.sl_busy = 0;
+	l.sl_shards = NULL;
+	l.sl_shard = 0;
 
 #ifndef HAVE_TLS
 	if( ldap_pvt_url_scheme2tls( lud->lud_scheme ) ) {
@@ -1352,8 +1600,19 @@ slap_open_listener(
 	l.sl_is_udp = ( tmp == LDAP_PROTO_UDP );
 #endif /* LDAP_CONNECTIONLESS */
 
-#if defined(LDAP_PF_LOCAL) || defined(SLAP_X_LISTENER_MOD)
+#ifdef SLAP_REUSEPORT
 	if ( lud->lud_exts ) {
+		reuseport = get_url_reuseport( lud->lud_exts, &others );
+		if ( reuseport && ( tmp == LDAP_PROTO_IPC || tmp == LDAP_PROTO_UDP )) {
+			Debug( LDAP_DEBUG_ANY, "daemon: "
+				LDAP_REUSEPORT_URLEXT " ignored for %s\n", url, 0, 0 );
+			reuseport = 0;
+		}
+	}
+#endif /* SLAP_REUSEPORT */
+
+#if defined(LDAP_PF_LOCAL) || defined(SLAP_X_LISTENER_MOD)
+	if ( lud->lud_exts && others ) {
 		err = get_url_perms( lud->lud_exts, &l.sl_perms, &crit );
 	} else {
 		l.sl_perms = S_IRWXU | S_IRWXO;
@@ -1440,6 +1699,19 @@ slap_open_listener(
 					(long) l.sl_sd, err, sock_errstr(err) );
 			}
 #endif /* SO_REUSEADDR */
+#ifdef SLAP_REUSEPORT
+			if ( reuseport ) {
+				tmp = 1;
+				rc = setsockopt( s, SOL_SOCKET, SO_REUSEPORT,
+					(char *) &tmp, sizeof(tmp) );
+				if ( rc == AC_SOCKET_ERROR ) {
+					int err = sock_errno();
+					Debug( LDAP_DEBUG_ANY, "slapd(%ld): "
+						"setsockopt(SO_REUSEPORT) failed errno=%d (%s)\n",
+						(long) l.sl_sd, err, sock_errstr(err) );
+				}
+			}
+#endif /* SLAP_REUSEPORT */
 		}
 
 		switch( (*sal)->sa_family ) {
@@ -1561,6 +1833,10 @@ slap_open_listener(
 			break;
 		}
 
+#ifdef SLAP_REUSEPORT
+		l.sl_shards = reuseport ? slap_open_shards( *sal, addrlen ) : NULL;
+#endif /* SLAP_REUSEPORT */
+
 		AC_MEMCPY(&l.sl_sa, *sal, addrlen);
 		ber_str2bv( url, 0, 1, &l.sl_url);
 		li = ch_malloc( sizeof( Listener ) );
@@ -1770,6 +2046,12 @@ destroy_listeners( void )
 			ber_memfree( lr->sl_name.bv_val );
 		}
 
+#ifdef SLAP_REUSEPORT
+		if ( lr->sl_shards ) {
+			slap_close_shards( lr->sl_shards );
+		}
+#endif /* SLAP_REUSEPORT */
+
 		free( lr );
 	}
 
@@ -2116,6 +2398,11 @@ slapd_daemon_task(
 
 #define SLAPD_IDLE_CHECK_LIMIT 4
 
+#ifdef SLAP_AFFINITY
+	if ( slapd_daemon_affinity )
+		slap_daemon_pin( tid );
+#endif /* SLAP_AFFINITY */
+
 	slapd_add( wake_sds[tid][0], 0, NULL, tid );
 	if ( tid )
 		goto loop;
@@ -2892,6 +3179,10 @@ slapd_daemon( void )
 		SLAP_SOCK_INIT(i);
 	}
 
+#ifdef SLAP_REUSEPORT
+	slap_shard_listeners();
+#endif /* SLAP_REUSEPORT */
+
 	for ( i=0; i<slapd_daemon_threads; i++ )
 	{
 		/* listener as a separate THREAD */
@@ -61,6 +61,7 @@ BerVarray default_referral = NULL;
 ldap_pvt_thread_pool_t	connection_pool;
 int		connection_pool_max = SLAP_MAX_WORKER_THREADS;
 int		connection_pool_queues = 1;
+int		connection_pool_steal = 0;
 int		slap_tool_thread_max = 1;
 
 slap_counters_t			slap_counters, *slap_counters_list;
@@ -289,6 +290,9 @@ void slap_counters_init( slap_counters_t *sc )
 	ldap_pvt_mp_init( sc->sc_pdu );
 	ldap_pvt_mp_init( sc->sc_entries );
 	ldap_pvt_mp_init( sc->sc_refs );
+	ldap_pvt_mp_init( sc->sc_writes );
+	ldap_pvt_mp_init( sc->sc_regex_hits );
+	ldap_pvt_mp_init( sc->sc_regex_compiles );
 
 	ldap_pvt_mp_init( sc->sc_ops_initiated );
 	ldap_pvt_mp_init( sc->sc_ops_completed );
@@ -310,6 +314,9 @@ void slap_counters_destroy( slap_counters_t *sc )
 	ldap_pvt_mp_clear( sc->sc_pdu );
 	ldap_pvt_mp_clear( sc->sc_entries );
 	ldap_pvt_mp_clear( sc->sc_refs );
+	ldap_pvt_mp_clear( sc->sc_writes );
+	ldap_pvt_mp_clear( sc->sc_regex_hits );
+	ldap_pvt_mp_clear( sc->sc_regex_compiles );
 
 	ldap_pvt_mp_clear( sc->sc_ops_initiated );
 	ldap_pvt_mp_clear( sc->sc_ops_completed );
@@ -35,6 +35,8 @@
 #include "lutil.h"
 #include "config.h"
 
+#include "../back-mdb/sorted.h"
+
 #include "../../../libraries/liblber/lber-int.h"	/* ber_rewind */
 
 /* RFC2891: Server Side Sorting
@@ -106,6 +108,7 @@ typedef struct sssvlv_info
 typedef struct sort_op
 {
 	Avlnode	*so_tree;
+	const mdb_sorted_t *so_sorted;	/* walked by the backend, instead of so_tree */
 	sort_ctrl *so_ctrl;
 	sssvlv_info *so_info;
 	int so_paged;
@@ -436,6 +439,249 @@ static void free_sort_ops( Connection *conn, sort_op **sos, int svi_max_percon )
 	}
 }
 	
+/* Sends one entry of a VLV window walked by the backend. Returns
+ * LDAP_NO_SUCH_OBJECT for an entry that no longer matches, which is
+ * passed over.
+ */
+static int send_id(
+	Operation		*op,
+	SlapReply		*rs,
+	sort_op			*so,
+	ID				id )
+{
+	Entry *e;
+
+	if ( so->so_sorted->sorted_entry( op, id, &e ) != LDAP_SUCCESS )
+		return LDAP_NO_SUCH_OBJECT;
+	rs->sr_entry = e;
+	rs->sr_flags = REP_ENTRY_MUSTRELEASE;
+	rs->sr_err = send_search_entry( op, rs );
+	return rs->sr_err;
+}
+
+/* Whether a candidate walked by the backend is a result of the search */
+static int match_id(
+	Operation		*op,
+	sort_op			*so,
+	ID				id )
+{
+	Entry *e;
+
+	if ( so->so_sorted->sorted_entry( op, id, &e ) != LDAP_SUCCESS )
+		return 0;
+	be_entry_release_r( op, e );
+	return 1;
+}
+
+/* The VLV window from the backend's walk of the candidates in sort
+ * order. The walk stops at the end of the window, keeping the IDs it
+ * passed last for the entries before the target. Entries are only
+ * fetched, and checked against the search, when they are sent, and
+ * the few that no longer match are passed over. Until the walk gets
+ * to the end, the number of candidates serves as the content count.
+ *
+ * Returns SLAP_CB_CONTINUE, with nothing sent, if the backend can't
+ * serve this search, and the entries have to be sorted in memory.
+ */
+static int send_list_ids(
+	Operation		*op,
+	SlapReply		*rs,
+	sort_op			*so)
+{
+	slap_overinst *on = (slap_overinst *)op->o_bd->bd_info;
+	const mdb_sorted_t *ms = so->so_sorted;
+	vlv_ctrl *vc = op->o_controls[vlv_cid];
+	sort_key *sk = so->so_ctrl->sc_keys;
+	struct berval bv = BER_BVNULL;
+	ID *ring = NULL, id, n, pos, kept, target = 0, k;
+	void *walk = NULL;
+	int nring, found, below, check, i, rc;
+	LDAPControl *ctrls[2];
+
+	rs->sr_attrs = op->ors_attrs;
+
+	/* so that releasing the entries reaches the backend */
+	op->o_bd->bd_info = (BackendInfo *)on->on_info;
+
+	if ( !BER_BVISNULL( &vc->vc_value )) {
+		MatchingRule *mr = sk->sk_ordering;
+
+		if ( mr->smr_normalize ) {
+			rc = mr->smr_normalize( SLAP_MR_VALUE_OF_SYNTAX,
+				mr->smr_syntax, mr, &vc->vc_value, &bv, op->o_tmpmemctx );
+			if ( rc ) {
+				so->so_vlv_rc = LDAP_INAPPROPRIATE_MATCHING;
+				goto vlv_err;
+			}
+		} else {
+			bv = vc->vc_value;
+		}
+	}
+
+	rc = ms->sorted_open( op, sk->sk_ad, sk->sk_direction < 0,
+		BER_BVISNULL( &bv ) ? NULL : &bv, &walk, &n );
+	/* The walk can't tell how many candidates match without fetching
+	 * them, so a search they might take past its size limit is sorted
+	 * in memory instead
+	 */
+	if ( rc != LDAP_SUCCESS || ( op->ors_slimit != SLAP_NO_LIMIT &&
+		n > (ID) op->ors_slimit )) {
+		rc = SLAP_CB_CONTINUE;
+		goto done;
+	}
+	rs->sr_err = LDAP_SUCCESS;
+	so->so_nentries = n;
+
+	/* Are we just counting an offset? */
+	if ( BER_BVISNULL( &bv )) {
+		if ( !n ) {
+			rc = LDAP_SUCCESS;
+			goto done;
+		}
+		if ( vc->vc_offset == vc->vc_count ) {
+			/* wants the last entry in the list: walk past the end,
+			 * the last candidate might not match */
+			target = n + 1;
+		} else if ( vc->vc_offset == 1 ) {
+			/* wants the first entry in the list */
+			target = 1;
+		} else if ( vc->vc_count && vc->vc_count != n ) {
+			if ( vc->vc_offset > vc->vc_count )
+				goto range_err;
+			target = n * vc->vc_offset / vc->vc_count;
+		} else {
+			if ( vc->vc_offset > n ) {
+range_err:
+				so->so_vlv_rc = LDAP_VLV_RANGE_ERROR;
+vlv_err:
+				pack_vlv_response_control( op, rs, so, ctrls );
+				ctrls[1] = NULL;
+				slap_add_ctrls( op, rs, ctrls );
+				rs->sr_err = LDAP_VLV_ERROR;
+				rc = LDAP_SUCCESS;
+				goto done;
+			}
+			target = vc->vc_offset;
+		}
+		if ( !target )
+			target = 1;
+	}
+
+	/* walk to the target, or for a value to the first candidate that
+	 * doesn't sort before it. The ring keeps the candidates passed last
+	 * for the entries before the target. Candidates the filter doesn't
+	 * match would leave the window short, so if any of those in the ring
+	 * don't match and earlier ones were dropped from it, walk again and
+	 * only keep those that match.
+	 */
+	nring = ( (ID) vc->vc_before < n ? vc->vc_before : n ) + 1;
+	ring = op->o_tmpalloc( nring * sizeof( ID ), op->o_tmpmemctx );
+	for ( check = 0; ; check = 1 ) {
+		for ( pos = kept = 0; ; pos++ ) {
+			if ( op->ors_tlimit != SLAP_NO_LIMIT &&
+				slap_get_time() > op->o_time + op->ors_tlimit ) {
+				rs->sr_err = LDAP_TIMELIMIT_EXCEEDED;
+				rc = LDAP_SUCCESS;
+				goto done;
+			}
+			rc = ms->sorted_next( op, walk, &id, &below );
+			if ( rc != LDAP_SUCCESS ||
+				( target ? pos + 1 == target : !below ))
+				break;
+			if ( check && !match_id( op, so, id ))
+				continue;
+			ring[kept++ % nring] = id;
+		}
+		if ( rc == LDAP_UNWILLING_TO_PERFORM ) {
+			rc = SLAP_CB_CONTINUE;
+			goto done;
+		}
+		found = rc == LDAP_SUCCESS;
+		if ( found ) {
+			so->so_vlv_target = pos + 1;
+			k = kept < nring - 1 ? kept : nring - 1;
+		} else if ( rc == LDAP_NO_SUCH_OBJECT ) {
+			/* past the end, so the count is known now. For an offset
+			 * the last entry is the target, a value sorts after them all.
+			 */
+			so->so_nentries = pos;
+			if ( target ) {
+				so->so_vlv_target = pos;
+				k = nring;
+			} else {
+				so->so_vlv_target = pos + 1;
+				k = nring > 1 ? nring - 1 : 1;
+			}
+			if ( k > kept )
+				k = kept;
+		} else {
+			rs->sr_err = LDAP_OTHER;
+			rc = LDAP_SUCCESS;
+			goto done;
+		}
+		if ( check || k == kept )
+			break;
+		for ( i = 1; i <= k; i++ )
+			if ( !match_id( op, so, ring[( kept - i ) % nring] ))
+				break;
+		if ( i > k )
+			break;
+		ms->sorted_close( op, walk );
+		walk = NULL;
+		rc = ms->sorted_open( op, sk->sk_ad, sk->sk_direction < 0,
+			BER_BVISNULL( &bv ) ? NULL : &bv, &walk, &n );
+		if ( rc != LDAP_SUCCESS ) {
+			rs->sr_err = LDAP_OTHER;
+			rc = LDAP_SUCCESS;
+			goto done;
+		}
+	}
+
+	/* the entries before the target */
+	for ( ; k && !slapd_shutdown; k-- ) {
+		rc = send_id( op, rs, so, ring[( kept - k ) % nring] );
+		if ( rc == LDAP_UNAVAILABLE || rc == LDAP_SIZELIMIT_EXCEEDED )
+			goto sent;
+	}
+
+	/* the target and the entries after it */
+	for ( i = 0; found && !slapd_shutdown; ) {
+		rc = send_id( op, rs, so, id );
+		if ( rc == LDAP_UNAVAILABLE || rc == LDAP_SIZELIMIT_EXCEEDED )
+			break;
+		if ( rc == LDAP_SUCCESS && ++i > vc->vc_after )
+			break;
+		if ( op->ors_tlimit != SLAP_NO_LIMIT &&
+			slap_get_time() > op->o_time + op->ors_tlimit ) {
+			rs->sr_err = LDAP_TIMELIMIT_EXCEEDED;
+			break;
+		}
+		rc = ms->sorted_next( op, walk, &id, &below );
+		if ( rc == LDAP_NO_SUCH_OBJECT ) {
+			so->so_nentries = pos + 1;
+			break;
+		}
+		if ( rc != LDAP_SUCCESS ) {
+			rs->sr_err = rc == LDAP_UNWILLING_TO_PERFORM ? rc : LDAP_OTHER;
+			break;
+		}
+		pos++;
+	}
+sent:
+	so->so_vlv_rc = LDAP_SUCCESS;
+	rc = LDAP_SUCCESS;
+
+done:
+	if ( ring )
+		op->o_tmpfree( ring, op->o_tmpmemctx );
+	if ( walk )
+		ms->sorted_close( op, walk );
+	if ( !BER_BVISNULL( &bv ) && bv.bv_val != vc->vc_value.bv_val )
+		op->o_tmpfree( bv.bv_val, op->o_tmpmemctx );
+	op->o_bd->bd_info = (BackendInfo *)on;
+	return rc;
+}
+
 static void send_list(
 	Operation		*op,
 	SlapReply		*rs,
@@ -701,7 +947,7 @@ static void send_result(
 		slap_add_ctrls( op, rs, ctrls );
 	send_ldap_result( op, rs );
 
-	if ( so->so_tree == NULL ) {
+	if ( so->so_tree == NULL && so->so_sorted == NULL ) {
 		/* Search finished, so clean up */
 		free_sort_op( op->o_conn, so );
 	}
@@ -795,6 +1041,48 @@ static int sssvlv_op_response(
 	return rs->sr_err;
 }
 
+/* With a single sort key that the database keeps an ordered index
+ * of, the backend can walk the candidates in order, and VLV requests
+ * then only fetch the entries they return. The walk reads the database
+ * directly, so it is only used when no overlay configured after this
+ * one would see the search.
+ */
+static const mdb_sorted_t *sorted_backend(
+	Operation		*op,
+	sort_ctrl		*sc )
+{
+	slap_overinst *on = (slap_overinst *)op->o_bd->bd_info;
+	BackendInfo *bi = on->on_info->oi_orig;
+	sort_key *sk = sc->sc_keys;
+
+	if ( sc->sc_nkeys != 1 || !bi->bi_extra || strcmp( bi->bi_type, "mdb" ) ||
+		SLAP_GLUE_INSTANCE( op->o_bd ) ||
+		sk->sk_ordering != sk->sk_ad->ad_type->sat_ordering )
+		return NULL;
+	for ( on = on->on_next; on; on = on->on_next ) {
+		if ( on->on_bi.bi_op_search )
+			return NULL;
+	}
+	return bi->bi_extra;
+}
+
+/* Install serversort response callback to handle a new search */
+static void sort_collect(
+	Operation		*op,
+	sort_op			*so )
+{
+	slap_callback *cb = op->o_tmpalloc( sizeof(slap_callback),
+		op->o_tmpmemctx );
+
+	cb->sc_cleanup		= NULL;
+	cb->sc_response		= sssvlv_op_response;
+	cb->sc_next			= op->o_callback;
+	cb->sc_private		= so;
+	cb->sc_writewait	= NULL;
+
+	op->o_callback		= cb;
+}
+
 static int sssvlv_op_search(
 	Operation		*op,
 	SlapReply		*rs)
@@ -899,9 +1187,17 @@ static int sssvlv_op_search(
 		/* are we continuing a VLV search? */
 		if ( so && vc && vc->vc_context ) {
 			so->so_ctrl = sc;
-			send_list( op, rs, so );
-			send_result( op, rs, so );
-			rc = LDAP_SUCCESS;
+			if ( so->so_sorted && send_list_ids( op, rs, so ) == SLAP_CB_CONTINUE ) {
+				/* the index no longer serves it, sort in memory */
+				so->so_sorted = NULL;
+				so->so_nentries = 0;
+				sort_collect( op, so );
+			} else {
+				if ( !so->so_sorted )
+					send_list( op, rs, so );
+				send_result( op, rs, so );
+				rc = LDAP_SUCCESS;
+			}
 		/* are we continuing a paged search? */
 		} else if ( so && ps && ps->ps_cookie ) {
 			so->so_ctrl = sc;
@@ -909,9 +1205,6 @@ static int sssvlv_op_search(
 			send_result( op, rs, so );
 			rc = LDAP_SUCCESS;
 		} else {
-			slap_callback *cb = op->o_tmpalloc( sizeof(slap_callback),
-				op->o_tmpmemctx );
-			/* Install serversort response callback to handle a new search */
 			if ( ps || vc ) {
 				so = ch_calloc( 1, sizeof(sort_op));
 			} else {
@@ -919,12 +1212,6 @@ static int sssvlv_op_search(
 			}
 			sort_conns[op->o_conn->c_conn_idx][sess_id] = so;
 
-			cb->sc_cleanup		= NULL;
-			cb->sc_response		= sssvlv_op_response;
-			cb->sc_next			= op->o_callback;
-			cb->sc_private		= so;
-			cb->sc_writewait	= NULL;
-
 			so->so_tree = NULL;
 			so->so_ctrl = sc;
 			so->so_info = si;
@@ -948,7 +1235,15 @@ static int sssvlv_op_search(
 			so->so_vcontext = (unsigned long)so;
 			so->so_nentries = 0;
 
-			op->o_callback		= cb;
+			if ( vc )
+				so->so_sorted = sorted_backend( op, sc );
+			if ( so->so_sorted && send_list_ids( op, rs, so ) != SLAP_CB_CONTINUE ) {
+				send_result( op, rs, so );
+				rc = LDAP_SUCCESS;
+			} else {
+				so->so_sorted = NULL;
+				sort_collect( op, so );
+			}
 		}
 	} else {
 		if ( so && !so->so_nentries ) {
@@ -23,6 +23,9 @@
 #ifdef SLAPD_OVER_SYNCPROV
 
 #include <ac/string.h>
+#include <ac/ctype.h>
+#include <ac/errno.h>
+#include <ac/unistd.h>
 #include "lutil.h"
 #include "slap.h"
 #include "config.h"
@@ -115,24 +118,44 @@ typedef struct syncmatches {
 
 /* Session log data */
 typedef struct slog_entry {
-	struct slog_entry *se_next;
 	struct berval se_uuid;
 	struct berval se_csn;
 	int	se_sid;
 	ber_tag_t	se_tag;
 } slog_entry;
 
+/* The log is a ring of entries in CSN order, so a consumer's
+ * position can be found by binary search. sl_mincsn/sl_sids/sl_numcsns
+ * must stay first, they are handled as a struct sync_cookie.
+ */
 typedef struct sessionlog {
 	BerVarray	sl_mincsn;
 	int		*sl_sids;
 	int		sl_numcsns;
 	int		sl_num;
 	int		sl_size;
-	slog_entry *sl_head;
-	slog_entry *sl_tail;
+	int		sl_alloc;	/* slots in sl_ring */
+	int		sl_first;	/* slot of the oldest entry */
+	slog_entry **sl_ring;
+	int		*sl_lsids;	/* SIDs of the logged entries */
+	int		*sl_lsidcnt;	/* and how many entries each has */
+	int		sl_numlsids;
+	FILE	*sl_fp;		/* syncprov-sessionlog-file, open to append */
+	int		sl_logged;	/* entries appended since it was written */
+	int		sl_rotating;	/* being rewritten without sl_mutex */
+	unsigned	sl_gen;	/* bumped whenever the file is replaced */
+	struct berval	sl_line;	/* line being appended */
+	ber_len_t	sl_linesize;
+	struct berval	sl_pending;	/* lines appended while rotating */
+	ber_len_t	sl_pendsize;
+	unsigned long	sl_seq;	/* last change announced in it */
+	unsigned long	*sl_intents;	/* announced changes still running */
+	int		sl_numintents;
 	ldap_pvt_thread_mutex_t sl_mutex;
 } sessionlog;
 
+#define SLOG_AT(sl, i)	((sl)->sl_ring[((sl)->sl_first + (i)) % (sl)->sl_alloc])
+
 /* The main state for this overlay */
 typedef struct syncprov_info_t {
 	syncops		*si_ops;
@@ -151,6 +174,7 @@ typedef struct syncprov_info_t {
 	time_t	si_chklast;	/* time of last checkpoint */
 	Avlnode	*si_mods;	/* entries being modified */
 	sessionlog	*si_logs;
+	char	*si_logfile;	/* where the sessionlog is kept across restarts */
 	ldap_pvt_thread_rdwr_t	si_csn_rwlock;
 	ldap_pvt_thread_mutex_t	si_ops_mutex;
 	ldap_pvt_thread_mutex_t	si_mods_mutex;
@@ -169,6 +193,7 @@ typedef struct opcookie {
 	short osid;	/* sid of op csn */
 	short rsid;	/* sid of relay */
 	short sreference;	/* Is the entry a reference? */
+	unsigned long sintent;	/* change announced in the sessionlog file */
 	syncres ssres;
 } opcookie;
 
@@ -1390,6 +1415,300 @@ syncprov_matchops( Operation *op, opcookie *opc, int saveit )
 	op->o_bd = b0;
 }
 
+/* With syncprov-sessionlog-file the session log is kept in a file,
+ * so it can be read back on startup. The file is rewritten from the
+ * log in memory when the database is opened and closed, and whenever
+ * as many entries as the log holds have been appended to it. Each
+ * logged entry is appended as it is added.
+ *
+ * The last kind of rewrite is a rotation, done by the operation that
+ * filled the file: the log is copied under sl_mutex, but written and
+ * synced without it. Meanwhile other operations keep appending to the
+ * old file, and their lines are also kept in sl_pending, to be added
+ * to the new file just before it replaces the old one.
+ *
+ * Other changes are found by their entryCSN when a consumer is
+ * refreshed, but a delete, or a rename that moves an entry out of
+ * scope, leaves nothing in the database to tell that the file missed
+ * it. So these are announced before they are made, with a "+<n>"
+ * line, and done with a "-<n>" line once they are logged or have
+ * failed. A file with an announced change that is not done is not used.
+ */
+static void
+syncprov_slog_cat( struct berval *bv, ber_len_t *size, const char *str,
+	ber_len_t len )
+{
+	if ( bv->bv_len + len > *size ) {
+		while ( bv->bv_len + len > *size )
+			*size = *size ? 2 * *size : 4096;
+		bv->bv_val = ch_realloc( bv->bv_val, *size );
+	}
+	AC_MEMCPY( bv->bv_val + bv->bv_len, str, len );
+	bv->bv_len += len;
+}
+
+static void
+syncprov_slog_print( struct berval *bv, ber_len_t *size, ber_tag_t tag,
+	struct berval *uuid, struct berval *csn )
+{
+	char buf[STRLENOF("18446744073709551615 ") + 2 * UUID_LEN + 1];
+	ber_len_t j;
+	int len;
+
+	assert( uuid->bv_len <= UUID_LEN );
+
+	len = sprintf( buf, "%lu ", (unsigned long) tag );
+	for ( j=0; j<uuid->bv_len; j++ )
+		len += sprintf( buf + len, "%02x", (unsigned char) uuid->bv_val[j] );
+	buf[len++] = ' ';
+	syncprov_slog_cat( bv, size, buf, len );
+	syncprov_slog_cat( bv, size, csn->bv_val, csn->bv_len );
+	syncprov_slog_cat( bv, size, "\n", 1 );
+}
+
+/* Append sl_line to the file, and keep it for the file being rotated
+ * in if there is one. Called with sl_mutex locked.
+ */
+static void
+syncprov_slog_put( sessionlog *sl )
+{
+	fwrite( sl->sl_line.bv_val, 1, sl->sl_line.bv_len, sl->sl_fp );
+	if ( sl->sl_rotating )
+		syncprov_slog_cat( &sl->sl_pending, &sl->sl_pendsize,
+			sl->sl_line.bv_val, sl->sl_line.bv_len );
+	sl->sl_line.bv_len = 0;
+}
+
+/* Append a "+<n>" or "-<n>" line. Called with sl_mutex locked. */
+static void
+syncprov_slog_put_seq( sessionlog *sl, char sign, unsigned long seq )
+{
+	char buf[STRLENOF("+18446744073709551615\n") + 1];
+	int len;
+
+	len = sprintf( buf, "%c%lu\n", sign, seq );
+	syncprov_slog_cat( &sl->sl_line, &sl->sl_linesize, buf, len );
+	syncprov_slog_put( sl );
+}
+
+/* Make sure what was appended to the file is written. Otherwise the
+ * file would miss changes, so it is removed until the log is written
+ * again. Called with sl_mutex locked.
+ */
+static void
+syncprov_slog_flush( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+	int rc;
+
+	if ( !fflush( sl->sl_fp ) && !ferror( sl->sl_fp ))
+		return;
+
+	rc = errno;
+	Debug( LDAP_DEBUG_ANY, "syncprov_slog_flush: cannot write %s: %s\n",
+		si->si_logfile, strerror( rc ), 0 );
+	fclose( sl->sl_fp );
+	sl->sl_fp = NULL;
+	unlink( si->si_logfile );
+}
+
+/* Copy the whole log as the contents of the file. Called with
+ * sl_mutex locked.
+ */
+static void
+syncprov_slog_snapshot( syncprov_info_t *si, struct berval *bv )
+{
+	sessionlog *sl = si->si_logs;
+	ber_len_t size = 0;
+	char buf[STRLENOF("+18446744073709551615\n") + 1];
+	int i;
+
+	BER_BVZERO( bv );
+	syncprov_slog_cat( bv, &size, "# syncprov sessionlog\n",
+		STRLENOF("# syncprov sessionlog\n") );
+	for ( i=0; i<si->si_numcsns; i++ ) {
+		syncprov_slog_cat( bv, &size, "ctxcsn: ", STRLENOF("ctxcsn: ") );
+		syncprov_slog_cat( bv, &size, si->si_ctxcsn[i].bv_val,
+			si->si_ctxcsn[i].bv_len );
+		syncprov_slog_cat( bv, &size, "\n", 1 );
+	}
+	for ( i=0; i<sl->sl_numcsns; i++ ) {
+		syncprov_slog_cat( bv, &size, "mincsn: ", STRLENOF("mincsn: ") );
+		syncprov_slog_cat( bv, &size, sl->sl_mincsn[i].bv_val,
+			sl->sl_mincsn[i].bv_len );
+		syncprov_slog_cat( bv, &size, "\n", 1 );
+	}
+	for ( i=0; i<sl->sl_num; i++ ) {
+		slog_entry *se = SLOG_AT( sl, i );
+		syncprov_slog_print( bv, &size, se->se_tag, &se->se_uuid, &se->se_csn );
+	}
+	for ( i=0; i<sl->sl_numintents; i++ )
+		syncprov_slog_cat( bv, &size, buf,
+			sprintf( buf, "+%lu\n", sl->sl_intents[i] ));
+}
+
+/* Write a copy of the log to tmp, and return it open to append to */
+static FILE *
+syncprov_slog_create( syncprov_info_t *si, struct berval *bv, char *tmp )
+{
+	FILE *fp;
+	int rc;
+
+	fp = fopen( tmp, "w" );
+	if ( !fp ) {
+		rc = errno;
+		Debug( LDAP_DEBUG_ANY, "syncprov_slog_create: cannot create %s: %s\n",
+			tmp, strerror( rc ), 0 );
+		return NULL;
+	}
+	fwrite( bv->bv_val, 1, bv->bv_len, fp );
+	if ( fflush( fp ) || ferror( fp ) || fsync( fileno( fp ))) {
+		rc = errno;
+		Debug( LDAP_DEBUG_ANY, "syncprov_slog_create: cannot write %s: %s\n",
+			tmp, strerror( rc ), 0 );
+		fclose( fp );
+		unlink( tmp );
+		return NULL;
+	}
+	return fp;
+}
+
+/* Write the whole log to the file and keep it open to append to.
+ * Called with sl_mutex locked.
+ */
+static void
+syncprov_slog_write( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+	struct berval bv;
+	char *tmp;
+	FILE *fp;
+	int rc;
+
+	if ( sl->sl_fp ) {
+		fclose( sl->sl_fp );
+		sl->sl_fp = NULL;
+	}
+	sl->sl_logged = 0;
+	/* a rotation in progress must not replace this */
+	sl->sl_gen++;
+
+	tmp = ch_malloc( strlen( si->si_logfile ) + STRLENOF(".tmp") + 1 );
+	sprintf( tmp, "%s.tmp", si->si_logfile );
+	syncprov_slog_snapshot( si, &bv );
+	fp = syncprov_slog_create( si, &bv, tmp );
+	ch_free( bv.bv_val );
+	if ( fp && rename( tmp, si->si_logfile )) {
+		rc = errno;
+		Debug( LDAP_DEBUG_ANY, "syncprov_slog_write: cannot write %s: %s\n",
+			si->si_logfile, strerror( rc ), 0 );
+		fclose( fp );
+		unlink( tmp );
+		fp = NULL;
+	}
+	if ( fp )
+		sl->sl_fp = fp;
+	else
+		unlink( si->si_logfile );
+	ch_free( tmp );
+}
+
+/* Rewrite the file once as many entries as the log holds have been
+ * appended to it, keeping sl_mutex only to copy the log and to put
+ * the new file in place. Called without sl_mutex.
+ */
+static void
+syncprov_slog_rotate( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+	struct berval bv;
+	unsigned gen;
+	char *tmp;
+	FILE *fp;
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+	if ( !sl->sl_fp || sl->sl_rotating || sl->sl_logged <= sl->sl_size ) {
+		ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+		return;
+	}
+	sl->sl_rotating = 1;
+	sl->sl_logged = 0;
+	sl->sl_pending.bv_len = 0;
+	gen = sl->sl_gen;
+	syncprov_slog_snapshot( si, &bv );
+	ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+
+	tmp = ch_malloc( strlen( si->si_logfile ) + STRLENOF(".new") + 1 );
+	sprintf( tmp, "%s.new", si->si_logfile );
+	fp = syncprov_slog_create( si, &bv, tmp );
+	ch_free( bv.bv_val );
+
+	ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+	if ( fp && ( !sl->sl_fp || sl->sl_gen != gen )) {
+		/* the file was rewritten or dropped meanwhile */
+		fclose( fp );
+		unlink( tmp );
+		fp = NULL;
+	}
+	if ( fp ) {
+		fwrite( sl->sl_pending.bv_val, 1, sl->sl_pending.bv_len, fp );
+		if ( fflush( fp ) || ferror( fp ) || rename( tmp, si->si_logfile )) {
+			/* keep appending to the old file */
+			rc = errno;
+			Debug( LDAP_DEBUG_ANY, "syncprov_slog_rotate: cannot write %s: %s\n",
+				si->si_logfile, strerror( rc ), 0 );
+			fclose( fp );
+			unlink( tmp );
+		} else {
+			fclose( sl->sl_fp );
+			sl->sl_fp = fp;
+			sl->sl_gen++;
+		}
+	}
+	sl->sl_rotating = 0;
+	sl->sl_pending.bv_len = 0;
+	ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+	ch_free( tmp );
+}
+
+/* Announce a delete or rename in the file before it is made */
+static void
+syncprov_slog_intent( syncprov_info_t *si, opcookie *opc )
+{
+	sessionlog *sl = si->si_logs;
+
+	ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+	if ( sl->sl_fp ) {
+		opc->sintent = ++sl->sl_seq;
+		if ( !( sl->sl_numintents & ( sl->sl_numintents + 1 )))
+			sl->sl_intents = ch_realloc( sl->sl_intents,
+				2 * ( sl->sl_numintents + 1 ) * sizeof( unsigned long ));
+		sl->sl_intents[sl->sl_numintents++] = opc->sintent;
+		syncprov_slog_put_seq( sl, '+', opc->sintent );
+		syncprov_slog_flush( si );
+	}
+	ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+}
+
+/* Mark an announced change as done. Called with sl_mutex locked. */
+static void
+syncprov_slog_done( syncprov_info_t *si, opcookie *opc )
+{
+	sessionlog *sl = si->si_logs;
+	int i;
+
+	for ( i=0; i<sl->sl_numintents; i++ ) {
+		if ( sl->sl_intents[i] == opc->sintent ) {
+			sl->sl_intents[i] = sl->sl_intents[--sl->sl_numintents];
+			break;
+		}
+	}
+	if ( sl->sl_fp )
+		syncprov_slog_put_seq( sl, '-', opc->sintent );
+	opc->sintent = 0;
+}
+
 static int
 syncprov_op_cleanup( Operation *op, SlapReply *rs )
 {
@@ -1405,6 +1724,16 @@ syncprov_op_cleanup( Operation *op, SlapReply *rs )
 		si->si_active--;
 	ldap_pvt_thread_mutex_unlock( &si->si_ops_mutex );
 
+	/* the announced change failed, or was not logged */
+	if ( opc->sintent ) {
+		sessionlog *sl = si->si_logs;
+		ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+		syncprov_slog_done( si, opc );
+		if ( sl->sl_fp )
+			syncprov_slog_flush( si );
+		ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+	}
+
 	for (sm = opc->smatches; sm; sm=snext) {
 		snext = sm->sm_next;
 		syncprov_free_syncop( sm->sm_op, 1 );
@@ -1519,6 +1848,160 @@ syncprov_checkpoint( Operation *op, slap_overinst *on )
 #endif
 }
 
+/* Count an entry of this SID in or out of the log */
+static void
+syncprov_slog_sid( sessionlog *sl, int sid, int incr )
+{
+	int i;
+
+	for ( i=0; i<sl->sl_numlsids; i++ ) {
+		if ( sl->sl_lsids[i] == sid )
+			break;
+	}
+	if ( i == sl->sl_numlsids ) {
+		assert( incr > 0 );
+		sl->sl_numlsids++;
+		sl->sl_lsids = ch_realloc( sl->sl_lsids, sl->sl_numlsids * sizeof(int) );
+		sl->sl_lsidcnt = ch_realloc( sl->sl_lsidcnt, sl->sl_numlsids * sizeof(int) );
+		sl->sl_lsids[i] = sid;
+		sl->sl_lsidcnt[i] = 0;
+	}
+	sl->sl_lsidcnt[i] += incr;
+	if ( !sl->sl_lsidcnt[i] ) {
+		sl->sl_numlsids--;
+		sl->sl_lsids[i] = sl->sl_lsids[sl->sl_numlsids];
+		sl->sl_lsidcnt[i] = sl->sl_lsidcnt[sl->sl_numlsids];
+	}
+}
+
+/* Drop an entry that is not in the ring, remembering its CSN
+ * as the oldest one the log can no longer replay.
+ */
+static void
+syncprov_slog_expire( sessionlog *sl, slog_entry *se )
+{
+	int i;
+
+	for ( i=0; i<sl->sl_numcsns; i++ )
+		if ( sl->sl_sids[i] >= se->se_sid )
+			break;
+	if  ( i == sl->sl_numcsns || sl->sl_sids[i] != se->se_sid ) {
+		slap_insert_csn_sids( (struct sync_cookie *)sl,
+			i, se->se_sid, &se->se_csn );
+	} else {
+		ber_bvreplace( &sl->sl_mincsn[i], &se->se_csn );
+	}
+	ch_free( se );
+}
+
+/* Remove the oldest entry from the ring */
+static slog_entry *
+syncprov_slog_shift( sessionlog *sl )
+{
+	slog_entry *se = sl->sl_ring[sl->sl_first];
+
+	sl->sl_first++;
+	if ( sl->sl_first == sl->sl_alloc )
+		sl->sl_first = 0;
+	sl->sl_num--;
+	syncprov_slog_sid( sl, se->se_sid, -1 );
+	return se;
+}
+
+/* Index of the first entry newer than csn */
+static int
+syncprov_slog_find( sessionlog *sl, struct berval *csn )
+{
+	int lo = 0, hi = sl->sl_num;
+
+	while ( lo < hi ) {
+		int mid = ( lo + hi ) >> 1;
+		if ( ber_bvcmp( &SLOG_AT( sl, mid )->se_csn, csn ) <= 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Size the ring to the configured sessionlog size */
+static void
+syncprov_slog_resize( sessionlog *sl )
+{
+	slog_entry **ring = NULL;
+	int i;
+
+	while ( sl->sl_num > sl->sl_size )
+		syncprov_slog_expire( sl, syncprov_slog_shift( sl ));
+	if ( sl->sl_size )
+		ring = ch_malloc( sl->sl_size * sizeof( slog_entry * ));
+	for ( i=0; i<sl->sl_num; i++ )
+		ring[i] = SLOG_AT( sl, i );
+	ch_free( sl->sl_ring );
+	sl->sl_ring = ring;
+	sl->sl_alloc = sl->sl_size;
+	sl->sl_first = 0;
+}
+
+/* Allocate a log record. UUIDs are not NUL-terminated. */
+static slog_entry *
+syncprov_slog_new( struct berval *uuid, struct berval *csn, ber_tag_t tag )
+{
+	slog_entry *se;
+
+	se = ch_malloc( sizeof( slog_entry ) + uuid->bv_len + csn->bv_len + 1 );
+	se->se_tag = tag;
+
+	se->se_uuid.bv_val = (char *)(&se[1]);
+	AC_MEMCPY( se->se_uuid.bv_val, uuid->bv_val, uuid->bv_len );
+	se->se_uuid.bv_len = uuid->bv_len;
+
+	se->se_csn.bv_val = se->se_uuid.bv_val + uuid->bv_len;
+	AC_MEMCPY( se->se_csn.bv_val, csn->bv_val, csn->bv_len );
+	se->se_csn.bv_val[csn->bv_len] = '\0';
+	se->se_csn.bv_len = csn->bv_len;
+	se->se_sid = slap_parse_csn_sid( &se->se_csn );
+	return se;
+}
+
+/* Add a record to the log, enter with sl->sl_mutex locked */
+static void
+syncprov_slog_insert( sessionlog *sl, slog_entry *se )
+{
+	if ( sl->sl_alloc != sl->sl_size )
+		syncprov_slog_resize( sl );
+	if ( !sl->sl_num && !sl->sl_mincsn ) {
+		sl->sl_numcsns = 1;
+		sl->sl_mincsn = ch_malloc( 2*sizeof( struct berval ));
+		sl->sl_sids = ch_malloc( sizeof( int ));
+		sl->sl_sids[0] = se->se_sid;
+		ber_dupbv( sl->sl_mincsn, &se->se_csn );
+		BER_BVZERO( &sl->sl_mincsn[1] );
+	}
+	if ( sl->sl_num == sl->sl_alloc ) {
+		/* Full, drop the oldest entry. That may be this one. */
+		if ( !sl->sl_num || ber_bvcmp( &se->se_csn,
+			&sl->sl_ring[sl->sl_first]->se_csn ) < 0 ) {
+			syncprov_slog_expire( sl, se );
+			return;
+		}
+		syncprov_slog_expire( sl, syncprov_slog_shift( sl ));
+	}
+	/* Keep the log in csn order. */
+	if ( !sl->sl_num || ber_bvcmp( &SLOG_AT( sl, sl->sl_num - 1 )->se_csn,
+		&se->se_csn ) <= 0 ) {
+		SLOG_AT( sl, sl->sl_num ) = se;
+	} else {
+		int i = syncprov_slog_find( sl, &se->se_csn ), k;
+
+		for ( k = sl->sl_num; k > i; k-- )
+			SLOG_AT( sl, k ) = SLOG_AT( sl, k - 1 );
+		SLOG_AT( sl, i ) = se;
+	}
+	sl->sl_num++;
+	syncprov_slog_sid( sl, se->se_sid, 1 );
+}
+
 static void
 syncprov_add_slog( Operation *op )
 {
@@ -1527,6 +2010,7 @@ syncprov_add_slog( Operation *op )
 	syncprov_info_t		*si = on->on_bi.bi_private;
 	sessionlog *sl;
 	slog_entry *se;
+	int rotate = 0;
 
 	sl = si->si_logs;
 	{
@@ -1537,79 +2021,36 @@ syncprov_add_slog( Operation *op )
 			 * wipe out anything in the log if we see them.
 			 */
 			ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
-			while ( se = sl->sl_head ) {
-				sl->sl_head = se->se_next;
-				ch_free( se );
-			}
-			sl->sl_tail = NULL;
-			sl->sl_num = 0;
+			while ( sl->sl_num )
+				ch_free( syncprov_slog_shift( sl ));
+			sl->sl_first = 0;
+			if ( opc->sintent )
+				syncprov_slog_done( si, opc );
+			if ( sl->sl_fp )
+				syncprov_slog_write( si );
 			ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
 			return;
 		}
 
-		/* Allocate a record. UUIDs are not NUL-terminated. */
-		se = ch_malloc( sizeof( slog_entry ) + opc->suuid.bv_len + 
-			op->o_csn.bv_len + 1 );
-		se->se_next = NULL;
-		se->se_tag = op->o_tag;
-
-		se->se_uuid.bv_val = (char *)(&se[1]);
-		AC_MEMCPY( se->se_uuid.bv_val, opc->suuid.bv_val, opc->suuid.bv_len );
-		se->se_uuid.bv_len = opc->suuid.bv_len;
-
-		se->se_csn.bv_val = se->se_uuid.bv_val + opc->suuid.bv_len;
-		AC_MEMCPY( se->se_csn.bv_val, op->o_csn.bv_val, op->o_csn.bv_len );
-		se->se_csn.bv_val[op->o_csn.bv_len] = '\0';
-		se->se_csn.bv_len = op->o_csn.bv_len;
-		se->se_sid = slap_parse_csn_sid( &se->se_csn );
+		se = syncprov_slog_new( &opc->suuid, &op->o_csn, op->o_tag );
 
 		ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
-		if ( sl->sl_head ) {
-			/* Keep the list in csn order. */
-			if ( ber_bvcmp( &sl->sl_tail->se_csn, &se->se_csn ) <= 0 ) {
-				sl->sl_tail->se_next = se;
-				sl->sl_tail = se;
-			} else {
-				slog_entry **sep;
-
-				for ( sep = &sl->sl_head; *sep; sep = &(*sep)->se_next ) {
-					if ( ber_bvcmp( &se->se_csn, &(*sep)->se_csn ) < 0 ) {
-						se->se_next = *sep;
-						*sep = se;
-						break;
-					}
-				}
-			}
-		} else {
-			sl->sl_head = se;
-			sl->sl_tail = se;
-			if ( !sl->sl_mincsn ) {
-				sl->sl_numcsns = 1;
-				sl->sl_mincsn = ch_malloc( 2*sizeof( struct berval ));
-				sl->sl_sids = ch_malloc( sizeof( int ));
-				sl->sl_sids[0] = se->se_sid;
-				ber_dupbv( sl->sl_mincsn, &se->se_csn );
-				BER_BVZERO( &sl->sl_mincsn[1] );
-			}
-		}
-		sl->sl_num++;
-		while ( sl->sl_num > sl->sl_size ) {
-			int i, j;
-			se = sl->sl_head;
-			sl->sl_head = se->se_next;
-			for ( i=0; i<sl->sl_numcsns; i++ )
-				if ( sl->sl_sids[i] >= se->se_sid )
-					break;
-			if  ( i == sl->sl_numcsns || sl->sl_sids[i] != se->se_sid ) {
-				slap_insert_csn_sids( (struct sync_cookie *)sl,
-					i, se->se_sid, &se->se_csn );
-			} else {
-				ber_bvreplace( &sl->sl_mincsn[i], &se->se_csn );
-			}
-			ch_free( se );
-			sl->sl_num--;
+		syncprov_slog_insert( sl, se );
+		if ( sl->sl_fp ) {
+			syncprov_slog_print( &sl->sl_line, &sl->sl_linesize, op->o_tag,
+				&opc->suuid, &op->o_csn );
+			syncprov_slog_put( sl );
+			if ( opc->sintent )
+				syncprov_slog_done( si, opc );
+			syncprov_slog_flush( si );
+			/* don't let the file grow past twice the log */
+			rotate = ++sl->sl_logged > sl->sl_size;
+		} else if ( opc->sintent ) {
+			syncprov_slog_done( si, opc );
 		}
 		ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+		if ( rotate )
+			syncprov_slog_rotate( si );
 	}
 }
 
@@ -1630,17 +2071,35 @@ syncprov_playlog( Operation *op, SlapReply *rs, sessionlog *sl,
 {
 	slap_overinst		*on = (slap_overinst *)op->o_bd->bd_info;
 	slog_entry *se;
-	int i, j, ndel, num, nmods, mmods;
+	int i, j, ndel, num, nmods, mmods, start;
 	char cbuf[LDAP_PVT_CSNSTR_BUFSIZE];
 	BerVarray uuids;
-	struct berval delcsn[2];
+	struct berval delcsn[2], *oldest = NULL;
 
 	if ( !sl->sl_num ) {
 		ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
 		return;
 	}
 
-	num = sl->sl_num;
+	/* If the cookie has a CSN for every SID in the log, nothing up to
+	 * the oldest of those CSNs needs to be replayed.
+	 */
+	for ( i=0; i<sl->sl_numlsids; i++ ) {
+		int k;
+		for ( k=0; k<srs->sr_state.numcsns; k++ ) {
+			if ( sl->sl_lsids[i] == srs->sr_state.sids[k] )
+				break;
+		}
+		if ( k == srs->sr_state.numcsns ) {
+			oldest = NULL;
+			break;
+		}
+		if ( !oldest || ber_bvcmp( &srs->sr_state.ctxcsn[k], oldest ) < 0 )
+			oldest = &srs->sr_state.ctxcsn[k];
+	}
+	start = oldest ? syncprov_slog_find( sl, oldest ) : 0;
+
+	num = sl->sl_num - start;
 	i = 0;
 	nmods = 0;
 
@@ -1658,8 +2117,9 @@ syncprov_playlog( Operation *op, SlapReply *rs, sessionlog *sl,
 	 */
 	Debug( LDAP_DEBUG_SYNC, "srs csn %s\n",
 		srs->sr_state.ctxcsn[0].bv_val, 0, 0 );
-	for ( se=sl->sl_head; se; se=se->se_next ) {
+	for ( ; start < sl->sl_num; start++ ) {
 		int k;
+		se = SLOG_AT( sl, start );
 		Debug( LDAP_DEBUG_SYNC, "log csn %s\n", se->se_csn.bv_val, 0, 0 );
 		ndel = 1;
 		for ( k=0; k<srs->sr_state.numcsns; k++ ) {
@@ -2198,6 +2658,10 @@ retry:
 	if (( have_psearches || si->si_logs ) && op->o_tag != LDAP_REQ_ADD )
 		syncprov_matchops( op, opc, 1 );
 
+	if (( op->o_tag == LDAP_REQ_DELETE || op->o_tag == LDAP_REQ_MODRDN ) &&
+		si->si_logs && si->si_logfile )
+		syncprov_slog_intent( si, opc );
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -2896,7 +3360,8 @@ enum {
 	SP_CHKPT = 1,
 	SP_SESSL,
 	SP_NOPRES,
-	SP_USEHINT
+	SP_USEHINT,
+	SP_SESSLF
 };
 
 static ConfigDriver sp_cf_gen;
@@ -2918,6 +3383,10 @@ static ConfigTable spcfg[] = {
 		sp_cf_gen, "( OLcfgOvAt:1.4 NAME 'olcSpReloadHint' "
 			"DESC 'Observe Reload Hint in Request control' "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "syncprov-sessionlog-file", "filename", 2, 2, 0, ARG_STRING|ARG_MAGIC|SP_SESSLF,
+		sp_cf_gen, "( OLcfgOvAt:1.5 NAME 'olcSpSessionlogFile' "
+			"DESC 'File holding the session log across restarts' "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -2930,6 +3399,7 @@ static ConfigOCs spocs[] = {
 			"$ olcSpSessionlog "
 			"$ olcSpNoPresent "
 			"$ olcSpReloadHint "
+			"$ olcSpSessionlogFile "
 		") )",
 			Cft_Overlay, spcfg },
 	{ NULL, 0, NULL }
@@ -2983,6 +3453,13 @@ sp_cf_gen(ConfigArgs *c)
 				rc = 1;
 			}
 			break;
+		case SP_SESSLF:
+			if ( si->si_logfile ) {
+				c->value_string = ch_strdup( si->si_logfile );
+			} else {
+				rc = 1;
+			}
+			break;
 		}
 		return rc;
 	} else if ( c->op == LDAP_MOD_DELETE ) {
@@ -3009,6 +3486,19 @@ sp_cf_gen(ConfigArgs *c)
 			else
 				rc = LDAP_NO_SUCH_ATTRIBUTE;
 			break;
+		case SP_SESSLF:
+			if ( si->si_logfile ) {
+				if ( si->si_logs && si->si_logs->sl_fp ) {
+					fclose( si->si_logs->sl_fp );
+					si->si_logs->sl_fp = NULL;
+					unlink( si->si_logfile );
+				}
+				ch_free( si->si_logfile );
+				si->si_logfile = NULL;
+			} else {
+				rc = LDAP_NO_SUCH_ATTRIBUTE;
+			}
+			break;
 		}
 		return rc;
 	}
@@ -3062,7 +3552,23 @@ sp_cf_gen(ConfigArgs *c)
 			sl->sl_sids = NULL;
 			sl->sl_num = 0;
 			sl->sl_numcsns = 0;
-			sl->sl_head = sl->sl_tail = NULL;
+			sl->sl_alloc = 0;
+			sl->sl_first = 0;
+			sl->sl_ring = NULL;
+			sl->sl_lsids = NULL;
+			sl->sl_lsidcnt = NULL;
+			sl->sl_numlsids = 0;
+			sl->sl_fp = NULL;
+			sl->sl_logged = 0;
+			sl->sl_rotating = 0;
+			sl->sl_gen = 0;
+			BER_BVZERO( &sl->sl_line );
+			sl->sl_linesize = 0;
+			BER_BVZERO( &sl->sl_pending );
+			sl->sl_pendsize = 0;
+			sl->sl_seq = 0;
+			sl->sl_intents = NULL;
+			sl->sl_numintents = 0;
 			ldap_pvt_thread_mutex_init( &sl->sl_mutex );
 			si->si_logs = sl;
 		}
@@ -3075,6 +3581,24 @@ sp_cf_gen(ConfigArgs *c)
 	case SP_USEHINT:
 		si->si_usehint = c->value_int;
 		break;
+	case SP_SESSLF:
+		if ( si->si_logfile ) {
+			if ( si->si_logs && si->si_logs->sl_fp ) {
+				fclose( si->si_logs->sl_fp );
+				si->si_logs->sl_fp = NULL;
+				unlink( si->si_logfile );
+			}
+			ch_free( si->si_logfile );
+		}
+		si->si_logfile = c->value_string;
+		/* start the file if the database is already open */
+		if ( si->si_logs && si->si_logs->sl_mincsn &&
+			( slapMode & SLAP_SERVER_RUNNING )) {
+			ldap_pvt_thread_mutex_lock( &si->si_logs->sl_mutex );
+			syncprov_slog_write( si );
+			ldap_pvt_thread_mutex_unlock( &si->si_logs->sl_mutex );
+		}
+		break;
 	}
 	return rc;
 }
@@ -3096,6 +3620,147 @@ syncprov_db_otask(
  * Then search for any entries newer than that. If no value exists,
  * just generate it. Cache whatever result.
  */
+static void
+syncprov_slog_load( syncprov_info_t *si )
+{
+	sessionlog *sl = si->si_logs;
+	FILE *fp;
+	char buf[256];
+	BerVarray ctxcsn = NULL, mincsn = NULL;
+	slog_entry **ses = NULL;
+	unsigned long *intents = NULL;
+	int i, k, nctx = 0, nmin = 0, nses = 0, nintents = 0, ok = 1;
+
+	fp = fopen( si->si_logfile, "r" );
+	if ( !fp )
+		goto write;
+
+	while ( ok && fgets( buf, sizeof( buf ), fp )) {
+		char *ptr = strchr( buf, '\n' );
+		struct berval bv;
+
+		if ( !ptr ) {
+			ok = 0;
+			break;
+		}
+		*ptr = '\0';
+		if ( buf[0] == '#' )
+			continue;
+		if ( !strncmp( buf, "ctxcsn: ", STRLENOF("ctxcsn: ") )) {
+			ber_str2bv( buf + STRLENOF("ctxcsn: "), 0, 0, &bv );
+			value_add_one( &ctxcsn, &bv );
+			nctx++;
+		} else if ( !strncmp( buf, "mincsn: ", STRLENOF("mincsn: ") )) {
+			ber_str2bv( buf + STRLENOF("mincsn: "), 0, 0, &bv );
+			value_add_one( &mincsn, &bv );
+			nmin++;
+		} else if ( buf[0] == '+' ) {
+			if ( !( nintents & ( nintents + 1 )))
+				intents = ch_realloc( intents,
+					2 * ( nintents + 1 ) * sizeof( unsigned long ));
+			intents[nintents++] = strtoul( buf + 1, NULL, 10 );
+		} else if ( buf[0] == '-' ) {
+			unsigned long seq = strtoul( buf + 1, NULL, 10 );
+			for ( i=0; i<nintents; i++ ) {
+				if ( intents[i] == seq ) {
+					intents[i] = intents[--nintents];
+					break;
+				}
+			}
+		} else {
+			/* <tag> <uuid in hex> <csn>, adds have no uuid */
+			char uuid[UUID_LEN];
+			unsigned long tag;
+			struct berval ubv;
+
+			tag = strtoul( buf, &ptr, 10 );
+			if ( *ptr++ != ' ' ) {
+				ok = 0;
+				break;
+			}
+			for ( i=0; i<UUID_LEN; i++ ) {
+				unsigned int c;
+				if ( !isxdigit( (unsigned char) ptr[0] ) ||
+					!isxdigit( (unsigned char) ptr[1] ) ||
+					sscanf( ptr, "%2x", &c ) != 1 )
+					break;
+				uuid[i] = c;
+				ptr += 2;
+			}
+			if (( i && i < UUID_LEN ) || *ptr++ != ' ' || !*ptr ) {
+				ok = 0;
+				break;
+			}
+			ubv.bv_val = uuid;
+			ubv.bv_len = i;
+			ber_str2bv( ptr, 0, 0, &bv );
+			if ( !( nses & ( nses + 1 )))
+				ses = ch_realloc( ses, 2 * ( nses + 1 ) * sizeof( slog_entry * ));
+			ses[nses++] = syncprov_slog_new( &ubv, &bv, tag );
+		}
+	}
+	if ( ferror( fp ))
+		ok = 0;
+	fclose( fp );
+
+	/* The log misses changes if a change was announced but is not
+	 * done, or if the database has a change newer than both the state
+	 * the file was written with and the entries appended since.
+	 */
+	if ( ok && ( !nmin || nintents ))
+		ok = 0;
+	for ( i=0; ok && i<si->si_numcsns; i++ ) {
+		int sid = si->si_sids[i];
+
+		for ( k=0; k<nctx; k++ ) {
+			if ( slap_parse_csn_sid( &ctxcsn[k] ) == sid &&
+				ber_bvcmp( &ctxcsn[k], &si->si_ctxcsn[i] ) >= 0 )
+				break;
+		}
+		if ( k < nctx )
+			continue;
+		for ( k=0; k<nses; k++ ) {
+			if ( ses[k]->se_sid == sid &&
+				ber_bvcmp( &ses[k]->se_csn, &si->si_ctxcsn[i] ) >= 0 )
+				break;
+		}
+		if ( k == nses )
+			ok = 0;
+	}
+
+	if ( ok ) {
+		ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+		ber_bvarray_free( sl->sl_mincsn );
+		ch_free( sl->sl_sids );
+		sl->sl_mincsn = mincsn;
+		mincsn = NULL;
+		sl->sl_numcsns = nmin;
+		sl->sl_sids = slap_parse_csn_sids( sl->sl_mincsn, nmin, NULL );
+		slap_sort_csn_sids( sl->sl_mincsn, sl->sl_sids, nmin, NULL );
+		for ( i=0; i<nses; i++ )
+			syncprov_slog_insert( sl, ses[i] );
+		ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+		Debug( LDAP_DEBUG_SYNC, "syncprov_slog_load: "
+			"%d sessionlog entries restored from %s\n",
+			nses, si->si_logfile, 0 );
+	} else {
+		for ( i=0; i<nses; i++ )
+			ch_free( ses[i] );
+		Debug( LDAP_DEBUG_ANY, "syncprov_slog_load: "
+			"ignoring %s, it misses changes made to the database\n",
+			si->si_logfile, 0, 0 );
+	}
+	ch_free( ses );
+	ch_free( intents );
+	ber_bvarray_free( ctxcsn );
+	ber_bvarray_free( mincsn );
+
+write:
+	ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+	syncprov_slog_write( si );
+	ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+}
+
 static int
 syncprov_db_open(
 	BackendDB *be,
@@ -3198,6 +3863,8 @@ syncprov_db_open(
 		sl->sl_sids = ch_malloc( si->si_numcsns * sizeof(int) );
 		for ( i=0; i < si->si_numcsns; i++ )
 			sl->sl_sids[i] = si->si_sids[i];
+		if ( si->si_logfile )
+			syncprov_slog_load( si );
 	}
 
 out:
@@ -3236,6 +3903,19 @@ syncprov_db_close(
 		op->o_ndn = be->be_rootndn;
 		syncprov_checkpoint( op, on );
 	}
+	if ( si->si_logs && si->si_logfile && si->si_numcsns ) {
+		sessionlog *sl = si->si_logs;
+
+		ldap_pvt_thread_mutex_lock( &sl->sl_mutex );
+		/* announced changes that never got to the backend */
+		sl->sl_numintents = 0;
+		syncprov_slog_write( si );
+		if ( sl->sl_fp ) {
+			fclose( sl->sl_fp );
+			sl->sl_fp = NULL;
+		}
+		ldap_pvt_thread_mutex_unlock( &sl->sl_mutex );
+	}
 
 #ifdef SLAP_CONFIG_DELETE
 	if ( !slapd_shutdown ) {
@@ -3302,13 +3982,18 @@ syncprov_db_destroy(
 	if ( si ) {
 		if ( si->si_logs ) {
 			sessionlog *sl = si->si_logs;
-			slog_entry *se = sl->sl_head;
-
-			while ( se ) {
-				slog_entry *se_next = se->se_next;
-				ch_free( se );
-				se = se_next;
-			}
+			int i;
+
+			for ( i=0; i<sl->sl_num; i++ )
+				ch_free( SLOG_AT( sl, i ));
+			ch_free( sl->sl_ring );
+			ch_free( sl->sl_lsids );
+			ch_free( sl->sl_lsidcnt );
+			ch_free( sl->sl_intents );
+			ch_free( sl->sl_line.bv_val );
+			ch_free( sl->sl_pending.bv_val );
+			if ( sl->sl_fp )
+				fclose( sl->sl_fp );
 			if ( sl->sl_mincsn )
 				ber_bvarray_free( sl->sl_mincsn );
 			if ( sl->sl_sids )
@@ -3317,6 +4002,8 @@ syncprov_db_destroy(
 			ldap_pvt_thread_mutex_destroy(&si->si_logs->sl_mutex);
 			ch_free( si->si_logs );
 		}
+		if ( si->si_logfile )
+			ch_free( si->si_logfile );
 		if ( si->si_ctxcsn )
 			ber_bvarray_free( si->si_ctxcsn );
 		if ( si->si_sids )
@@ -74,6 +74,7 @@ LDAP_SLAPD_F (int) acl_check_modlist LDAP_P((
 	Operation *op, Entry *e, Modifications *ml ));
 
 LDAP_SLAPD_F (void) acl_append( AccessControl **l, AccessControl *a, int pos );
+LDAP_SLAPD_F (void) acl_changed LDAP_P(( void ));
 
 #ifdef SLAP_DYNACL
 LDAP_SLAPD_F (int) slap_dynacl_register LDAP_P(( slap_dynacl_t *da ));
@@ -415,6 +416,8 @@ LDAP_SLAPD_F (int) backend_group LDAP_P((
 	ObjectClass *group_oc,
 	AttributeDescription *group_at
 ));
+LDAP_SLAPD_F (void) backend_group_forget LDAP_P(( struct berval *ndn,
+	int scope ));
 
 LDAP_SLAPD_F (int) backend_attribute LDAP_P((
 	Operation *op,
@@ -898,6 +901,7 @@ LDAP_SLAPD_V (slap_ssf_t) local_ssf;
 LDAP_SLAPD_V (struct runqueue_s) slapd_rq;
 LDAP_SLAPD_V (int) slapd_daemon_threads;
 LDAP_SLAPD_V (int) slapd_daemon_mask;
+LDAP_SLAPD_V (int) slapd_daemon_affinity;
 #ifdef LDAP_TCP_BUFFER
 LDAP_SLAPD_V (int) slapd_tcp_rmem;
 LDAP_SLAPD_V (int) slapd_tcp_wmem;
@@ -1619,6 +1623,11 @@ LDAP_SLAPD_F (void) slap_send_ldap_intermediate LDAP_P(( Operation *op, SlapRepl
 LDAP_SLAPD_F (void) slap_send_search_result LDAP_P(( Operation *op, SlapReply *rs ));
 LDAP_SLAPD_F (int) slap_send_search_reference LDAP_P(( Operation *op, SlapReply *rs ));
 LDAP_SLAPD_F (int) slap_send_search_entry LDAP_P(( Operation *op, SlapReply *rs ));
+LDAP_SLAPD_F (void) slap_sendbatch_begin LDAP_P(( Operation *op ));
+LDAP_SLAPD_F (void) slap_sendbatch_end LDAP_P(( Operation *op ));
+LDAP_SLAPD_F (void) slap_sendbatch_poll LDAP_P(( Operation *op, int idle ));
+LDAP_SLAPD_F (void *) slap_sendbatch_lookup LDAP_P(( Operation *op ));
+LDAP_SLAPD_F (void) slap_sendbatch_tick LDAP_P(( Operation *op, void *batch ));
 LDAP_SLAPD_F (int) slap_null_cb LDAP_P(( Operation *op, SlapReply *rs ));
 LDAP_SLAPD_F (int) slap_freeself_cb LDAP_P(( Operation *op, SlapReply *rs ));
 
@@ -2041,6 +2050,9 @@ LDAP_SLAPD_V (unsigned int) index_intlen_strlen;
 
 LDAP_SLAPD_V (ber_len_t) sockbuf_max_incoming;
 LDAP_SLAPD_V (ber_len_t) sockbuf_max_incoming_auth;
+LDAP_SLAPD_V (ber_len_t) slap_writebatch_size;
+LDAP_SLAPD_V (int)		slap_writebatch_latency;
+LDAP_SLAPD_V (ber_len_t) slap_group_cache_size;
 LDAP_SLAPD_V (int)		slap_conn_max_pending;
 LDAP_SLAPD_V (int)		slap_conn_max_pending_auth;
 
@@ -2080,6 +2092,7 @@ LDAP_SLAPD_V (time_t)		starttime;
 LDAP_SLAPD_V (ldap_pvt_thread_pool_t)	connection_pool;
 LDAP_SLAPD_V (int)			connection_pool_max;
 LDAP_SLAPD_V (int)			connection_pool_queues;
+LDAP_SLAPD_V (int)			connection_pool_steal;
 LDAP_SLAPD_V (int)			slap_tool_thread_max;
 
 LDAP_SLAPD_V (ldap_pvt_thread_mutex_t)	entry2str_mutex;
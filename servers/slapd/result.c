@@ -373,6 +373,9 @@ static long send_ldap_ber(
 
 		if ( ber_flush2( conn->c_sb, ber, LBER_FLUSH_FREE_NEVER ) == 0 ) {
 			ret = bytes;
+			ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
+			ldap_pvt_mp_add_ulong( op->o_counters->sc_writes, 1 );
+			ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
 			break;
 		}
 
@@ -439,6 +442,242 @@ fail:
 	return ret;
 }
 
+/*
+ * Output batching: while a search is being processed by its own
+ * thread, the entries and references it returns are collected in a
+ * per-thread buffer and written together, when the buffer is full,
+ * when the oldest of them has waited writebatch-latency milliseconds,
+ * or along with the final response. The latency is also checked by
+ * the backends between entries, see slap_sendbatch_poll() and
+ * slap_sendbatch_tick().
+ */
+typedef struct slap_sendbatch {
+	Connection	*sb_conn;
+	unsigned long	sb_opid;
+	int		sb_pdus;
+	unsigned	sb_ticks;
+	struct timeval	sb_start;
+	struct berval	sb_buf;
+	ber_len_t	sb_size;
+} slap_sendbatch;
+
+static void
+slap_sendbatch_free( void *key, void *data )
+{
+	slap_sendbatch *sb = data;
+
+	ch_free( sb->sb_buf.bv_val );
+	ch_free( sb );
+}
+
+/* Return the batch open for this op in the current thread, if any.
+ * Copies of op may be sent from other threads, so the key is looked
+ * up in the caller's own context rather than op->o_threadctx.
+ */
+static slap_sendbatch *
+slap_sendbatch_get( Operation *op )
+{
+	void *ctx = ldap_pvt_thread_pool_context();
+	void *data = NULL;
+	slap_sendbatch *sb;
+
+	if ( ctx == NULL || ldap_pvt_thread_pool_getkey( ctx,
+			(void *)slap_sendbatch_begin, &data, NULL ) || data == NULL )
+		return NULL;
+
+	sb = data;
+	if ( sb->sb_conn != op->o_conn || sb->sb_opid != op->o_opid )
+		return NULL;
+	return sb;
+}
+
+static long
+slap_sendbatch_flush( Operation *op, slap_sendbatch *sb )
+{
+	BerElementBuffer berbuf;
+	BerElement	*ber = (BerElement *) &berbuf;
+	long	ret;
+
+	ber_init2( ber, &sb->sb_buf, LBER_USE_DER );
+	ber_set_option( ber, LBER_OPT_BER_BYTES_TO_WRITE, &sb->sb_buf.bv_len );
+	ret = send_ldap_ber( op, ber );
+
+	sb->sb_buf.bv_len = 0;
+	sb->sb_pdus = 0;
+	return ret;
+}
+
+/* Tell if the oldest PDU of the batch has waited writebatch-latency
+ * milliseconds. Without a latency, PDUs wait for the buffer to fill.
+ */
+static int
+slap_sendbatch_due( slap_sendbatch *sb )
+{
+	struct timeval now;
+
+	if ( !slap_writebatch_latency )
+		return 0;
+
+	(void) gettimeofday( &now, NULL );
+	return ( now.tv_sec - sb->sb_start.tv_sec ) * 1000 +
+		( now.tv_usec - sb->sb_start.tv_usec ) / 1000 >=
+			slap_writebatch_latency;
+}
+
+/* Send one PDU of op; more is set when op has further PDUs to send
+ * before its final response.
+ */
+static long
+send_ldap_ber_batch(
+	Operation *op,
+	BerElement *ber,
+	int more )
+{
+	slap_sendbatch *sb = slap_sendbatch_get( op );
+	struct berval bv;
+	long ret;
+
+	if ( sb == NULL )
+		return send_ldap_ber( op, ber );
+
+	ber_flatten2( ber, &bv, 0 );
+	if ( sb->sb_pdus && sb->sb_buf.bv_len + bv.bv_len > slap_writebatch_size ) {
+		if ( slap_sendbatch_flush( op, sb ) < 0 )
+			return -1;
+	}
+	if ( bv.bv_len > slap_writebatch_size )
+		return send_ldap_ber( op, ber );
+
+	if ( sb->sb_size < sb->sb_buf.bv_len + bv.bv_len ) {
+		sb->sb_size = slap_writebatch_size;
+		sb->sb_buf.bv_val = ch_realloc( sb->sb_buf.bv_val, sb->sb_size );
+	}
+	AC_MEMCPY( sb->sb_buf.bv_val + sb->sb_buf.bv_len, bv.bv_val, bv.bv_len );
+	sb->sb_buf.bv_len += bv.bv_len;
+
+	if ( sb->sb_pdus++ == 0 ) {
+		if ( !more )
+			goto flush;
+		(void) gettimeofday( &sb->sb_start, NULL );
+	}
+
+	if ( more && !slap_sendbatch_due( sb ))
+		return bv.bv_len;
+
+flush:
+	ret = slap_sendbatch_flush( op, sb );
+	if ( ret <= 0 )
+		return ret;
+	return bv.bv_len;
+}
+
+/* Start batching the entries op sends from this thread */
+void
+slap_sendbatch_begin( Operation *op )
+{
+	void *ctx = ldap_pvt_thread_pool_context();
+	slap_sendbatch *sb;
+	void *data = NULL;
+
+	if ( !slap_writebatch_size || ctx == NULL || op->o_conn == NULL )
+		return;
+
+#ifdef LDAP_CONNECTIONLESS
+	if ( op->o_conn->c_is_udp )
+		return;
+#endif
+
+	if ( ldap_pvt_thread_pool_getkey( ctx,
+			(void *)slap_sendbatch_begin, &data, NULL ) || data == NULL )
+	{
+		sb = ch_calloc( 1, sizeof( slap_sendbatch ));
+		if ( ldap_pvt_thread_pool_setkey( ctx,
+				(void *)slap_sendbatch_begin, sb, slap_sendbatch_free,
+				NULL, NULL ))
+		{
+			ch_free( sb );
+			return;
+		}
+	} else {
+		sb = data;
+	}
+
+	sb->sb_conn = op->o_conn;
+	sb->sb_opid = op->o_opid;
+	sb->sb_pdus = 0;
+	sb->sb_ticks = 0;
+	sb->sb_buf.bv_len = 0;
+}
+
+/* Called by backends between the entries of a search, since the
+ * next PDU may be long in coming: writes the batch once its oldest
+ * PDU is due, or at once when idle is set because the backend is
+ * about to wait for more results.
+ */
+void
+slap_sendbatch_poll( Operation *op, int idle )
+{
+	slap_sendbatch *sb;
+
+	if ( !slap_writebatch_size || ( !idle && !slap_writebatch_latency ))
+		return;
+
+	sb = slap_sendbatch_get( op );
+	if ( sb == NULL || sb->sb_pdus == 0 )
+		return;
+
+	if ( idle || slap_sendbatch_due( sb ))
+		(void) slap_sendbatch_flush( op, sb );
+}
+
+/* Return the batch of op for a backend to check once per candidate
+ * with slap_sendbatch_tick(), or NULL if there is nothing to check.
+ * Looking it up costs a thread key lookup, so do it once per search.
+ */
+void *
+slap_sendbatch_lookup( Operation *op )
+{
+	if ( !slap_writebatch_size || !slap_writebatch_latency )
+		return NULL;
+
+	return slap_sendbatch_get( op );
+}
+
+/* Like slap_sendbatch_poll( op, 0 ) for a batch returned by
+ * slap_sendbatch_lookup(), but only reads the clock every
+ * SLAP_SENDBATCH_TICKS calls.
+ */
+#define SLAP_SENDBATCH_TICKS	64
+
+void
+slap_sendbatch_tick( Operation *op, void *batch )
+{
+	slap_sendbatch *sb = batch;
+
+	if ( sb->sb_pdus == 0 || ++sb->sb_ticks % SLAP_SENDBATCH_TICKS )
+		return;
+
+	if ( sb->sb_conn != op->o_conn || sb->sb_opid != op->o_opid )
+		return;
+
+	if ( slap_sendbatch_due( sb ))
+		(void) slap_sendbatch_flush( op, sb );
+}
+
+/* Write whatever op left in the batch and stop batching */
+void
+slap_sendbatch_end( Operation *op )
+{
+	slap_sendbatch *sb = slap_sendbatch_get( op );
+
+	if ( sb == NULL )
+		return;
+
+	if ( sb->sb_pdus )
+		(void) slap_sendbatch_flush( op, sb );
+	sb->sb_conn = NULL;
+}
+
 static int
 send_ldap_control( BerElement *ber, LDAPControl *c )
 {
@@ -745,7 +984,7 @@ send_ldap_response(
 	}
 
 	/* send BER */
-	bytes = send_ldap_ber( op, ber );
+	bytes = send_ldap_ber_batch( op, ber, 0 );
 #ifdef LDAP_CONNECTIONLESS
 	if (!op->o_conn || op->o_conn->c_is_udp == 0)
 #endif
@@ -1474,7 +1713,7 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 	rs_flush_entry( op, rs, NULL );
 
 	if ( op->o_res_ber == NULL ) {
-		bytes = send_ldap_ber( op, ber );
+		bytes = send_ldap_ber_batch( op, ber, 1 );
 		ber_free_buf( ber );
 
 		if ( bytes < 0 ) {
@@ -1642,7 +1881,7 @@ slap_send_search_reference( Operation *op, SlapReply *rs )
 #ifdef LDAP_CONNECTIONLESS
 	if (!op->o_conn || op->o_conn->c_is_udp == 0) {
 #endif
-	bytes = send_ldap_ber( op, ber );
+	bytes = send_ldap_ber_batch( op, ber, 1 );
 	ber_free_buf( ber );
 
 	if ( bytes < 0 ) {
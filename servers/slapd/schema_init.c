@@ -106,16 +106,28 @@
 #include "lutil.h"
 #include "lutil_hash.h"
 
+/* Index key hash functions. Indexers pick one from the
+ * SLAP_INDEX_HASH_* bits of their flags; without any, the one chosen
+ * by index_hash64 is used.
+ */
+typedef struct slap_hash_ops {
+	void (*sh_init)(lutil_HASH_CTX *ctx);
+	void (*sh_update)(lutil_HASH_CTX *ctx, unsigned char const *buf, ber_len_t len);
+	void (*sh_final)(unsigned char *digest, lutil_HASH_CTX *ctx);
+	int sh_len;
+} slap_hash_ops;
+
+static const slap_hash_ops hash_fnv32 = {
+	lutil_HASHInit, lutil_HASHUpdate, lutil_HASHFinal, LUTIL_HASH_BYTES };
+
 #ifdef LUTIL_HASH64_BYTES
 #define HASH_BYTES				LUTIL_HASH64_BYTES
-#define HASH_LEN	hashlen
-static void (*hashinit)(lutil_HASH_CTX *ctx) = lutil_HASHInit;
-static void (*hashupdate)(lutil_HASH_CTX *ctx,unsigned char const *buf, ber_len_t len) = lutil_HASHUpdate;
-static void (*hashfinal)(unsigned char digest[HASH_BYTES], lutil_HASH_CTX *ctx) = lutil_HASHFinal;
-static int hashlen = LUTIL_HASH_BYTES;
-#define HASH_Init(c)			hashinit(c)
-#define HASH_Update(c,buf,len)	hashupdate(c,buf,len)
-#define HASH_Final(d,c)			hashfinal(d,c)
+
+static const slap_hash_ops hash_fnv64 = {
+	lutil_HASH64Init, lutil_HASH64Update, lutil_HASH64Final, LUTIL_HASH64_BYTES };
+static const slap_hash_ops hash_w64 = {
+	lutil_HASHW64Init, lutil_HASHW64Update, lutil_HASHW64Final, LUTIL_HASH64_BYTES };
+static const slap_hash_ops *hash_default = &hash_fnv32;
 
 /* Toggle between 32 and 64 bit hashing, default to 32 for compatibility
    -1 to query, returns 1 if 64 bit, 0 if 32.
@@ -123,29 +135,33 @@ static int hashlen = LUTIL_HASH_BYTES;
 int slap_hash64( int onoff )
 {
 	if ( onoff < 0 ) {
-		return hashlen == LUTIL_HASH64_BYTES;
+		return hash_default == &hash_fnv64;
 	} else if ( onoff ) {
-		hashinit = lutil_HASH64Init;
-		hashupdate = lutil_HASH64Update;
-		hashfinal = lutil_HASH64Final;
-		hashlen = LUTIL_HASH64_BYTES;
+		hash_default = &hash_fnv64;
 	} else {
-		hashinit = lutil_HASHInit;
-		hashupdate = lutil_HASHUpdate;
-		hashfinal = lutil_HASHFinal;
-		hashlen = LUTIL_HASH_BYTES;
+		hash_default = &hash_fnv32;
 	}
 	return 0;
 }
 
+static const slap_hash_ops *
+hashSelect( slap_mask_t flags )
+{
+	switch ( flags & SLAP_INDEX_HASH_MASK ) {
+	case SLAP_INDEX_HASH_FNV32:
+		return &hash_fnv32;
+	case SLAP_INDEX_HASH_FNV64:
+		return &hash_fnv64;
+	case SLAP_INDEX_HASH_W64:
+		return &hash_w64;
+	}
+	return hash_default;
+}
+
 #else
 #define HASH_BYTES				LUTIL_HASH_BYTES
-#define HASH_LEN				HASH_BYTES
-#define HASH_Init(c)			lutil_HASHInit(c)
-#define HASH_Update(c,buf,len)	lutil_HASHUpdate(c,buf,len)
-#define HASH_Final(d,c)			lutil_HASHFinal(d,c)
 
-int slap_has64( int onoff )
+int slap_hash64( int onoff )
 {
 	if ( onoff < 0 )
 		return 0;
@@ -153,8 +169,16 @@ int slap_has64( int onoff )
 		return onoff ? -1 : 0;
 }
 
+#define hashSelect(flags)		(&hash_fnv32)
+
 #endif
-#define HASH_CONTEXT			lutil_HASH_CTX
+
+typedef struct slap_hash_ctx {
+	lutil_HASH_CTX hc_ctx;
+	const slap_hash_ops *hc_ops;
+} HASH_CONTEXT;
+
+#define HASH_LEN(flags)			(hashSelect(flags)->sh_len)
 
 /* approx matching rules */
 #define directoryStringApproxMatchOID	"1.3.6.1.4.1.4203.666.4.4"
@@ -645,19 +669,24 @@ octetStringOrderingMatch(
 static void
 hashPreset(
 	HASH_CONTEXT *HASHcontext,
+	slap_mask_t flags,
 	struct berval *prefix,
 	char pre,
 	Syntax *syntax,
 	MatchingRule *mr)
 {
-	HASH_Init(HASHcontext);
+	const slap_hash_ops *ops = hashSelect( flags );
+	lutil_HASH_CTX *ctx = &HASHcontext->hc_ctx;
+
+	HASHcontext->hc_ops = ops;
+	ops->sh_init(ctx);
 	if(prefix && prefix->bv_len > 0) {
-		HASH_Update(HASHcontext,
+		ops->sh_update(ctx,
 			(unsigned char *)prefix->bv_val, prefix->bv_len);
 	}
-	if(pre) HASH_Update(HASHcontext, (unsigned char*)&pre, sizeof(pre));
-	HASH_Update(HASHcontext, (unsigned char*)syntax->ssyn_oid, syntax->ssyn_oidlen);
-	HASH_Update(HASHcontext, (unsigned char*)mr->smr_oid, mr->smr_oidlen);
+	if(pre) ops->sh_update(ctx, (unsigned char*)&pre, sizeof(pre));
+	ops->sh_update(ctx, (unsigned char*)syntax->ssyn_oid, syntax->ssyn_oidlen);
+	ops->sh_update(ctx, (unsigned char*)mr->smr_oid, mr->smr_oidlen);
 	return;
 }
 
@@ -669,9 +698,9 @@ hashIter(
 	unsigned char *value,
 	int len)
 {
-	HASH_CONTEXT ctx = *HASHcontext;
-	HASH_Update( &ctx, value, len );
-	HASH_Final( HASHdigest, &ctx );
+	lutil_HASH_CTX ctx = HASHcontext->hc_ctx;
+	HASHcontext->hc_ops->sh_update( &ctx, value, len );
+	HASHcontext->hc_ops->sh_final( HASHdigest, &ctx );
 }
 
 /* Index generation function: Attribute values -> index hash keys */
@@ -692,7 +721,7 @@ int octetStringIndexer(
 	unsigned char HASHdigest[HASH_BYTES];
 	struct berval digest;
 	digest.bv_val = (char *)HASHdigest;
-	digest.bv_len = HASH_LEN;
+	digest.bv_len = HASH_LEN( flags );
 
 	for( i=0; !BER_BVISNULL( &values[i] ); i++ ) {
 		/* just count them */
@@ -706,7 +735,7 @@ int octetStringIndexer(
 	slen = syntax->ssyn_oidlen;
 	mlen = mr->smr_oidlen;
 
-	hashPreset( &HASHcontext, prefix, 0, syntax, mr);
+	hashPreset( &HASHcontext, flags, prefix, 0, syntax, mr);
 	for( i=0; !BER_BVISNULL( &values[i] ); i++ ) {
 		hashIter( &HASHcontext, HASHdigest,
 			(unsigned char *)values[i].bv_val, values[i].bv_len );
@@ -738,14 +767,14 @@ int octetStringFilter(
 	struct berval *value = (struct berval *) assertedValue;
 	struct berval digest;
 	digest.bv_val = (char *)HASHdigest;
-	digest.bv_len = HASH_LEN;
+	digest.bv_len = HASH_LEN( flags );
 
 	slen = syntax->ssyn_oidlen;
 	mlen = mr->smr_oidlen;
 
 	keys = slap_sl_malloc( sizeof( struct berval ) * 2, ctx );
 
-	hashPreset( &HASHcontext, prefix, 0, syntax, mr );
+	hashPreset( &HASHcontext, flags, prefix, 0, syntax, mr );
 	hashIter( &HASHcontext, HASHdigest,
 		(unsigned char *)value->bv_val, value->bv_len );
 
@@ -901,7 +930,7 @@ octetStringSubstringsIndexer(
 	unsigned char HASHdigest[HASH_BYTES];
 	struct berval digest;
 	digest.bv_val = (char *)HASHdigest;
-	digest.bv_len = HASH_LEN;
+	digest.bv_len = HASH_LEN( flags );
 
 	nkeys = 0;
 
@@ -944,11 +973,11 @@ octetStringSubstringsIndexer(
 	mlen = mr->smr_oidlen;
 
 	if ( flags & SLAP_INDEX_SUBSTR_ANY )
-		hashPreset( &HCany, prefix, SLAP_INDEX_SUBSTR_PREFIX, syntax, mr );
+		hashPreset( &HCany, flags, prefix, SLAP_INDEX_SUBSTR_PREFIX, syntax, mr );
 	if( flags & SLAP_INDEX_SUBSTR_INITIAL )
-		hashPreset( &HCini, prefix, SLAP_INDEX_SUBSTR_INITIAL_PREFIX, syntax, mr );
+		hashPreset( &HCini, flags, prefix, SLAP_INDEX_SUBSTR_INITIAL_PREFIX, syntax, mr );
 	if( flags & SLAP_INDEX_SUBSTR_FINAL )
-		hashPreset( &HCfin, prefix, SLAP_INDEX_SUBSTR_FINAL_PREFIX, syntax, mr );
+		hashPreset( &HCfin, flags, prefix, SLAP_INDEX_SUBSTR_FINAL_PREFIX, syntax, mr );
 
 	nkeys = 0;
 	for ( i = 0; !BER_BVISNULL( &values[i] ); i++ ) {
@@ -1066,7 +1095,7 @@ octetStringSubstringsFilter (
 	}
 
 	digest.bv_val = (char *)HASHdigest;
-	digest.bv_len = HASH_LEN;
+	digest.bv_len = HASH_LEN( flags );
 
 	slen = syntax->ssyn_oidlen;
 	mlen = mr->smr_oidlen;
@@ -1084,7 +1113,7 @@ octetStringSubstringsFilter (
 		klen = index_substr_if_maxlen < value->bv_len
 			? index_substr_if_maxlen : value->bv_len;
 
-		hashPreset( &HASHcontext, prefix, pre, syntax, mr );
+		hashPreset( &HASHcontext, flags, prefix, pre, syntax, mr );
 		hashIter( &HASHcontext, HASHdigest,
 			(unsigned char *)value->bv_val, klen );
 		ber_dupbv_x( &keys[nkeys++], &digest, ctx );
@@ -1096,7 +1125,7 @@ octetStringSubstringsFilter (
 		{
 			ber_len_t j;
 			pre = SLAP_INDEX_SUBSTR_PREFIX;
-			hashPreset( &HASHcontext, prefix, pre, syntax, mr);
+			hashPreset( &HASHcontext, flags, prefix, pre, syntax, mr);
 			for ( j=index_substr_if_maxlen-1; j <= value->bv_len - index_substr_any_len; j+=index_substr_any_step )
 			{
 				hashIter( &HASHcontext, HASHdigest,
@@ -1118,7 +1147,7 @@ octetStringSubstringsFilter (
 
 			value = &sa->sa_any[i];
 
-			hashPreset( &HASHcontext, prefix, pre, syntax, mr);
+			hashPreset( &HASHcontext, flags, prefix, pre, syntax, mr);
 			for(j=0;
 				j <= value->bv_len - index_substr_any_len;
 				j += index_substr_any_step )
@@ -1140,7 +1169,7 @@ octetStringSubstringsFilter (
 		klen = index_substr_if_maxlen < value->bv_len
 			? index_substr_if_maxlen : value->bv_len;
 
-		hashPreset( &HASHcontext, prefix, pre, syntax, mr );
+		hashPreset( &HASHcontext, flags, prefix, pre, syntax, mr );
 		hashIter( &HASHcontext, HASHdigest,
 			(unsigned char *)&value->bv_val[value->bv_len-klen], klen );
 		ber_dupbv_x( &keys[nkeys++], &digest, ctx );
@@ -1152,7 +1181,7 @@ octetStringSubstringsFilter (
 		{
 			ber_len_t j;
 			pre = SLAP_INDEX_SUBSTR_PREFIX;
-			hashPreset( &HASHcontext, prefix, pre, syntax, mr);
+			hashPreset( &HASHcontext, flags, prefix, pre, syntax, mr);
 			for ( j=0; j <= value->bv_len - index_substr_if_maxlen; j+=index_substr_any_step )
 			{
 				hashIter( &HASHcontext, HASHdigest,
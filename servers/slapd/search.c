@@ -244,7 +244,9 @@ do_search(
 	}
 
 	op->o_bd = frontendDB;
+	slap_sendbatch_begin( op );
 	rs->sr_err = frontendDB->be_search( op, rs );
+	slap_sendbatch_end( op );
 
 return_results:;
 	if ( !BER_BVISNULL( &op->o_req_dn ) ) {
@@ -141,6 +141,11 @@ LDAP_BEGIN_DECL
 #define SLAP_SB_MAX_INCOMING_DEFAULT ((1<<18) - 1)
 #define SLAP_SB_MAX_INCOMING_AUTH ((1<<24) - 1)
 
+#define SLAP_WRITEBATCH_SIZE_DEFAULT	(1<<16)
+#define SLAP_WRITEBATCH_LATENCY_DEFAULT	10	/* milliseconds */
+
+#define SLAP_GROUP_CACHE_SIZE_DEFAULT	(1<<16)
+
 #define SLAP_CONN_MAX_PENDING_DEFAULT	100
 #define SLAP_CONN_MAX_PENDING_AUTH	1000
 
@@ -280,6 +285,12 @@ typedef struct slap_ssf_set {
 #define SLAP_INDEX_NOSUBTYPES    0x1000UL /* don't use index w/ subtypes */
 #define SLAP_INDEX_NOTAGS        0x2000UL /* don't use index w/ tags */
 
+/* hash used for index keys; none means the global index_hash64 choice */
+#define SLAP_INDEX_HASH_MASK     0x030000UL
+#define SLAP_INDEX_HASH_FNV32    0x010000UL
+#define SLAP_INDEX_HASH_FNV64    0x020000UL
+#define SLAP_INDEX_HASH_W64      0x030000UL
+
 /*
  * there is a single index for each attribute.  these prefixes ensure
  * that there is no collision among keys.
@@ -1548,6 +1559,7 @@ typedef struct AccessControl {
 
 	/* "by" part: list of who has what access to the entries */
 	Access	*acl_access;
+	int	acl_memo;	/* "by" part does not depend on the entry */
 
 	struct AccessControl	*acl_next;
 } AccessControl;
@@ -2328,6 +2340,7 @@ struct BackendInfo {
 #define SLAP_BFLAG_CONFIG			0x0002U /* a config backend */
 #define SLAP_BFLAG_FRONTEND			0x0004U /* the frontendDB */
 #define SLAP_BFLAG_NOLASTMODCMD		0x0010U
+#define SLAP_BFLAG_GROUPCACHE		0x0020U /* reports writes to the group cache */
 #define SLAP_BFLAG_INCREMENT		0x0100U
 #define SLAP_BFLAG_ALIASES			0x1000U
 #define SLAP_BFLAG_REFERRALS		0x2000U
@@ -2351,6 +2364,7 @@ struct BackendInfo {
 #define SLAP_SUBENTRIES(be)	(SLAP_BFLAGS(be) & SLAP_BFLAG_SUBENTRIES)
 #define SLAP_DYNAMIC(be)	((SLAP_BFLAGS(be) & SLAP_BFLAG_DYNAMIC) || (SLAP_DBFLAGS(be) & SLAP_DBFLAG_DYNAMIC))
 #define SLAP_NOLASTMODCMD(be)	(SLAP_BFLAGS(be) & SLAP_BFLAG_NOLASTMODCMD)
+#define SLAP_GROUPCACHE(be)	(SLAP_BFLAGS(be) & SLAP_BFLAG_GROUPCACHE)
 #define SLAP_LASTMODCMD(be)	(!SLAP_NOLASTMODCMD(be))
 
 /* overlay specific */
@@ -2539,6 +2553,9 @@ typedef struct slap_counters_t {
 	ldap_pvt_mp_t		sc_pdu;
 	ldap_pvt_mp_t		sc_entries;
 	ldap_pvt_mp_t		sc_refs;
+	ldap_pvt_mp_t		sc_writes;
+	ldap_pvt_mp_t		sc_regex_hits;
+	ldap_pvt_mp_t		sc_regex_compiles;
 
 	ldap_pvt_mp_t		sc_ops_completed;
 	ldap_pvt_mp_t		sc_ops_initiated;
@@ -3041,6 +3058,8 @@ struct Listener {
 	int	sl_mute;	/* Listener is temporarily disabled due to emfile */
 	int	sl_busy;	/* Listener is busy (accept thread activated) */
 	ber_socket_t sl_sd;
+	ber_socket_t *sl_shards;	/* x-reuseport sockets not yet given to threads */
+	int	sl_shard;	/* extra x-reuseport socket of another listener */
 	Sockaddr sl_sa;
 #define sl_addr	sl_sa.sa_in_addr
 #define LDAP_TCP_BUFFER
@@ -38,6 +38,25 @@
 
 #define	UUIDLEN	16
 
+/*
+ * Set of the UUIDs sent during a present phase: open addressing with
+ * linear probing over one array of UUIDs, with a state byte per slot
+ * so that entries can be removed as they are found.
+ */
+typedef struct presentlist {
+	unsigned char	*pl_uuids;	/* pl_size UUIDs, then pl_size states */
+	unsigned char	*pl_state;
+	unsigned long	pl_size;	/* a power of two */
+	unsigned long	pl_used;	/* slots not empty */
+	unsigned long	pl_count;	/* UUIDs in the set */
+} presentlist;
+
+#define	PL_EMPTY	0
+#define	PL_USED		1
+#define	PL_DELETED	2
+
+#define	PL_MINSIZE	1024
+
 struct nonpresent_entry {
 	struct berval *npe_name;
 	struct berval *npe_nname;
@@ -122,7 +141,7 @@ typedef struct syncinfo_s {
 	int			si_strict_refresh;	/* stop listening during fallback refresh */
 	int			si_too_old;
 	ber_int_t	si_msgid;
-	Avlnode			*si_presentlist;
+	presentlist		*si_presentlist;
 	LDAP			*si_ld;
 	Connection		*si_conn;
 	LDAP_LIST_HEAD(np, nonpresent_entry)	si_nonpresentlist;
@@ -133,11 +152,10 @@ typedef struct syncinfo_s {
 	ldap_pvt_thread_mutex_t	si_mutex;
 } syncinfo_t;
 
-static int syncuuid_cmp( const void *, const void * );
 static int presentlist_insert( syncinfo_t* si, struct berval *syncUUID );
-static void presentlist_delete( Avlnode **av, struct berval *syncUUID );
-static char *presentlist_find( Avlnode *av, struct berval *syncUUID );
-static int presentlist_free( Avlnode *av );
+static void presentlist_delete( presentlist *pl, struct berval *syncUUID );
+static int presentlist_find( presentlist *pl, struct berval *syncUUID );
+static int presentlist_free( presentlist *pl );
 static void syncrepl_del_nonpresent( Operation *, syncinfo_t *, BerVarray, struct sync_cookie *, int );
 static int syncrepl_message_to_op(
 					syncinfo_t *, Operation *, LDAPMessage * );
@@ -2780,7 +2798,57 @@ typedef struct dninfo {
 	AttributeDescription *newDesc;	/* for renames */
 } dninfo;
 
-#define HASHUUID	1
+/* FNV-1a; UUIDs differ most in their first, time-based, bytes */
+static unsigned long
+presentlist_hash( const unsigned char *uuid )
+{
+	unsigned long h = 2166136261UL;
+	int i;
+
+	for ( i = 0; i < UUIDLEN; i++ ) {
+		h ^= uuid[i];
+		h *= 16777619UL;
+	}
+	return h;
+}
+
+/* the slot holding uuid, or the empty slot ending its chain */
+static unsigned long
+presentlist_slot( presentlist *pl, const unsigned char *uuid )
+{
+	unsigned long mask = pl->pl_size - 1;
+	unsigned long i = presentlist_hash( uuid ) & mask;
+
+	while ( pl->pl_state[i] != PL_EMPTY ) {
+		if ( pl->pl_state[i] == PL_USED &&
+			memcmp( &pl->pl_uuids[i * UUIDLEN], uuid, UUIDLEN ) == 0 )
+			break;
+		i = ( i + 1 ) & mask;
+	}
+	return i;
+}
+
+static void
+presentlist_resize( presentlist *pl, unsigned long size )
+{
+	unsigned char *uuids = pl->pl_uuids, *state = pl->pl_state;
+	unsigned long i, j, oldsize = pl->pl_size;
+
+	pl->pl_uuids = ch_malloc( size * ( UUIDLEN + 1 ) );
+	pl->pl_state = pl->pl_uuids + size * UUIDLEN;
+	memset( pl->pl_state, PL_EMPTY, size );
+	pl->pl_size = size;
+	pl->pl_used = pl->pl_count;
+
+	for ( i = 0; i < oldsize; i++ ) {
+		if ( state[i] != PL_USED )
+			continue;
+		j = presentlist_slot( pl, &uuids[i * UUIDLEN] );
+		AC_MEMCPY( &pl->pl_uuids[j * UUIDLEN], &uuids[i * UUIDLEN], UUIDLEN );
+		pl->pl_state[j] = PL_USED;
+	}
+	ch_free( uuids );
+}
 
 /* return 1 if inserted, 0 otherwise */
 static int
@@ -2788,96 +2856,74 @@ presentlist_insert(
 	syncinfo_t* si,
 	struct berval *syncUUID )
 {
-	char *val;
-
-#ifdef HASHUUID
-	Avlnode **av;
-	unsigned short s;
-
-	if ( !si->si_presentlist )
-		si->si_presentlist = ch_calloc(65536, sizeof( Avlnode * ));
+	presentlist *pl = si->si_presentlist;
+	const unsigned char *uuid = (const unsigned char *)syncUUID->bv_val;
+	unsigned long i;
 
-	av = (Avlnode **)si->si_presentlist;
-
-	val = ch_malloc(UUIDLEN-2);
-	memcpy(&s, syncUUID->bv_val, 2);
-	memcpy(val, syncUUID->bv_val+2, UUIDLEN-2);
-
-	if ( avl_insert( &av[s], val,
-		syncuuid_cmp, avl_dup_error ) )
-	{
-		ch_free( val );
-		return 0;
+	if ( !pl ) {
+		pl = ch_calloc( 1, sizeof( presentlist ) );
+		presentlist_resize( pl, PL_MINSIZE );
+		si->si_presentlist = pl;
 	}
-#else
-	val = ch_malloc(UUIDLEN);
 
-	AC_MEMCPY( val, syncUUID->bv_val, UUIDLEN );
+	/* keep at least a quarter of the slots empty */
+	if ( ( pl->pl_used + 1 ) * 4 > pl->pl_size * 3 ) {
+		presentlist_resize( pl, pl->pl_count * 2 < pl->pl_size ?
+			pl->pl_size : pl->pl_size * 2 );
+	}
 
-	if ( avl_insert( &si->si_presentlist, val,
-		syncuuid_cmp, avl_dup_error ) )
-	{
-		ch_free( val );
+	i = presentlist_slot( pl, uuid );
+	if ( pl->pl_state[i] == PL_USED )
 		return 0;
-	}
-#endif
+
+	AC_MEMCPY( &pl->pl_uuids[i * UUIDLEN], uuid, UUIDLEN );
+	pl->pl_state[i] = PL_USED;
+	pl->pl_used++;
+	pl->pl_count++;
 
 	return 1;
 }
 
-static char *
+static int
 presentlist_find(
-	Avlnode *av,
+	presentlist *pl,
 	struct berval *val )
 {
-#ifdef HASHUUID
-	Avlnode **a2 = (Avlnode **)av;
-	unsigned short s;
-
-	if (!av)
-		return NULL;
+	if ( !pl )
+		return 0;
 
-	memcpy(&s, val->bv_val, 2);
-	return avl_find( a2[s], val->bv_val+2, syncuuid_cmp );
-#else
-	return avl_find( av, val->bv_val, syncuuid_cmp );
-#endif
+	return pl->pl_state[ presentlist_slot( pl,
+		(const unsigned char *)val->bv_val ) ] == PL_USED;
 }
 
 static int
-presentlist_free( Avlnode *av )
+presentlist_free( presentlist *pl )
 {
-#ifdef HASHUUID
-	Avlnode **a2 = (Avlnode **)av;
-	int i, count = 0;
+	int count = 0;
 
-	if ( av ) {
-		for (i=0; i<65536; i++) {
-			if (a2[i])
-				count += avl_free( a2[i], ch_free );
-		}
-		ch_free( av );
+	if ( pl ) {
+		count = pl->pl_count;
+		ch_free( pl->pl_uuids );
+		ch_free( pl );
 	}
 	return count;
-#else
-	return avl_free( av, ch_free );
-#endif
 }
 
 static void
 presentlist_delete(
-	Avlnode **av,
+	presentlist *pl,
 	struct berval *val )
 {
-#ifdef HASHUUID
-	Avlnode **a2 = *(Avlnode ***)av;
-	unsigned short s;
+	unsigned long i;
 
-	memcpy(&s, val->bv_val, 2);
-	avl_delete( &a2[s], val->bv_val+2, syncuuid_cmp );
-#else
-	avl_delete( av, val->bv_val, syncuuid_cmp );
-#endif
+	if ( !pl )
+		return;
+
+	i = presentlist_slot( pl, (const unsigned char *)val->bv_val );
+	if ( pl->pl_state[i] == PL_USED ) {
+		pl->pl_state[i] = PL_DELETED;
+		pl->pl_count--;
+	}
 }
 
 static int
@@ -4418,7 +4464,7 @@ nonpresent_callback(
 	syncinfo_t *si = op->o_callback->sc_private;
 	Attribute *a;
 	int count = 0;
-	char *present_uuid = NULL;
+	int present_uuid = 0;
 	struct nonpresent_entry *np_entry;
 
 	if ( rs->sr_type == REP_RESULT ) {
@@ -4446,7 +4492,7 @@ nonpresent_callback(
 			if ( a == NULL ) return 0;
 		}
 
-		if ( present_uuid == NULL ) {
+		if ( !present_uuid ) {
 			np_entry = (struct nonpresent_entry *)
 				ch_calloc( 1, sizeof( struct nonpresent_entry ) );
 			np_entry->npe_name = ber_dupbv( NULL, &rs->sr_entry->e_name );
@@ -4454,8 +4500,7 @@ nonpresent_callback(
 			LDAP_LIST_INSERT_HEAD( &si->si_nonpresentlist, np_entry, npe_link );
 
 		} else {
-			presentlist_delete( &si->si_presentlist, &a->a_nvals[0] );
-			ch_free( present_uuid );
+			presentlist_delete( si->si_presentlist, &a->a_nvals[0] );
 		}
 	}
 	return LDAP_SUCCESS;
@@ -4582,16 +4627,6 @@ done:;
 	return new;
 }
 
-static int
-syncuuid_cmp( const void* v_uuid1, const void* v_uuid2 )
-{
-#ifdef HASHUUID
-	return ( memcmp( v_uuid1, v_uuid2, UUIDLEN-2 ));
-#else
-	return ( memcmp( v_uuid1, v_uuid2, UUIDLEN ));
-#endif
-}
-
 void
 syncinfo_free( syncinfo_t *sie, int free_all )
 {
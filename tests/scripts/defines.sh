@@ -37,6 +37,7 @@ PPOLICY=${AC_ppolicy-ppolicyno}
 REFINT=${AC_refint-refintno}
 RETCODE=${AC_retcode-retcodeno}
 RWM=${AC_rwm-rwmno}
+SSSVLV=${AC_sssvlv-sssvlvno}
 SYNCPROV=${AC_syncprov-syncprovno}
 TRANSLUCENT=${AC_translucent-translucentno}
 UNIQUE=${AC_unique-uniqueno}
@@ -80,6 +81,11 @@ CLIENTDIR=../clients/tools
 
 # conf
 CONF=$DATADIR/slapd.conf
+GROUPCOMMITCONF=$DATADIR/slapd-groupcommit.conf
+ENTRYCACHECONF=$DATADIR/slapd-entrycache.conf
+ACLINDEXCONF=$DATADIR/slapd-aclindex.conf
+GROUPCACHECONF=$DATADIR/slapd-groupcache.conf
+SSSVLVCONF=$DATADIR/slapd-sssvlv.conf
 CONFTWO=$DATADIR/slapd2.conf
 CONF2DB=$DATADIR/slapd-2db.conf
 MCONF=$DATADIR/slapd-master.conf
@@ -89,6 +95,7 @@ WHOAMICONF=$DATADIR/slapd-whoami.conf
 ACLCONF=$DATADIR/slapd-acl.conf
 RCONF=$DATADIR/slapd-referrals.conf
 SRMASTERCONF=$DATADIR/slapd-syncrepl-master.conf
+SLOGFILECONF=$DATADIR/slapd-syncprov-slogfile.conf
 DSRMASTERCONF=$DATADIR/slapd-deltasync-master.conf
 DSRSLAVECONF=$DATADIR/slapd-deltasync-slave.conf
 PPOLICYCONF=$DATADIR/slapd-ppolicy.conf